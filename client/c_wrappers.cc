@@ -67,6 +67,12 @@ hyperclient_destroy(struct hyperclient* client)
     delete client;
 }
 
+void
+hyperclient_set_read_mode(struct hyperclient* client, enum hyperclient_read_mode mode)
+{
+    client->set_read_mode(mode);
+}
+
 enum hyperclient_returncode
 hyperclient_add_space(struct hyperclient* client, const char* description)
 {
@@ -113,6 +119,53 @@ hyperclient_rm_space(struct hyperclient* client, const char* space)
     }
 }
 
+enum hyperclient_returncode
+hyperclient_add_index(struct hyperclient* client, const char* space,
+                      const char* description, uint16_t* id)
+{
+    try
+    {
+        return client->add_index(space, description, id);
+    }
+    catch (po6::error& e)
+    {
+        errno = e;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (std::bad_alloc& ba)
+    {
+        errno = ENOMEM;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (...)
+    {
+        return HYPERCLIENT_EXCEPTION;
+    }
+}
+
+enum hyperclient_returncode
+hyperclient_rm_index(struct hyperclient* client, const char* space, uint16_t id)
+{
+    try
+    {
+        return client->rm_index(space, id);
+    }
+    catch (po6::error& e)
+    {
+        errno = e;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (std::bad_alloc& ba)
+    {
+        errno = ENOMEM;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (...)
+    {
+        return HYPERCLIENT_EXCEPTION;
+    }
+}
+
 int64_t
 hyperclient_get(struct hyperclient* client, const char* space, const char* key,
                 size_t key_sz, hyperclient_returncode* status,
@@ -174,6 +227,25 @@ hyperclient_group_del(struct hyperclient* client, const char* space,
     C_WRAP_EXCEPT(client->group_del(space, checks, checks_sz, status));
 }
 
+int64_t
+hyperclient_multi_put(struct hyperclient* client, const char* space,
+                      size_t num_objects, const char* const* keys, const size_t* keys_sz,
+                      const struct hyperclient_attribute* const* attrs, const size_t* attrs_sz,
+                      enum hyperclient_returncode* statuses,
+                      enum hyperclient_returncode* status)
+{
+    C_WRAP_EXCEPT(client->multi_put(space, num_objects, keys, keys_sz, attrs, attrs_sz, statuses, status));
+}
+
+int64_t
+hyperclient_multi_del(struct hyperclient* client, const char* space,
+                      size_t num_keys, const char* const* keys, const size_t* keys_sz,
+                      enum hyperclient_returncode* statuses,
+                      enum hyperclient_returncode* status)
+{
+    C_WRAP_EXCEPT(client->multi_del(space, num_keys, keys, keys_sz, statuses, status));
+}
+
 int64_t
 hyperclient_count(struct hyperclient* client, const char* space,
                   const struct hyperclient_attribute_check* checks, size_t checks_sz,
@@ -182,6 +254,88 @@ hyperclient_count(struct hyperclient* client, const char* space,
     C_WRAP_EXCEPT(client->count(space, checks, checks_sz, status, result));
 }
 
+int64_t
+hyperclient_count_approx(struct hyperclient* client, const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         enum hyperclient_returncode* status,
+                         uint64_t* result, uint64_t* error)
+{
+    C_WRAP_EXCEPT(client->count_approx(space, checks, checks_sz, status, result, error));
+}
+
+int64_t
+hyperclient_sample(struct hyperclient* client, const char* space,
+                   const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                   uint64_t n,
+                   enum hyperclient_returncode* status,
+                   struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    C_WRAP_EXCEPT(client->sample(space, checks, checks_sz, n, status, attrs, attrs_sz));
+}
+
+int64_t
+hyperclient_split_space(struct hyperclient* client, const char* space,
+                        uint64_t n,
+                        enum hyperclient_returncode* status,
+                        char** split, size_t* split_sz)
+{
+    C_WRAP_EXCEPT(client->split_space(space, n, status, split, split_sz));
+}
+
+int64_t
+hyperclient_search_split(struct hyperclient* client, const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         const char* split, size_t split_sz,
+                         enum hyperclient_returncode* status,
+                         struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    C_WRAP_EXCEPT(client->search_split(space, checks, checks_sz, split, split_sz,
+                                       status, attrs, attrs_sz));
+}
+
+int64_t
+hyperclient_export_space(struct hyperclient* client, const char* space,
+                         enum hyperclient_returncode* status,
+                         char** batch, size_t* batch_sz)
+{
+    C_WRAP_EXCEPT(client->export_space(space, status, batch, batch_sz));
+}
+
+int64_t
+hyperclient_subscribe(struct hyperclient* client, const char* space,
+                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                      const char* resume, size_t resume_sz,
+                      enum hyperclient_returncode* status,
+                      struct hyperclient_attribute** attrs, size_t* attrs_sz,
+                      const char** cursor, size_t* cursor_sz)
+{
+    C_WRAP_EXCEPT(client->subscribe(space, checks, checks_sz, resume, resume_sz,
+                                    status, attrs, attrs_sz, cursor, cursor_sz));
+}
+
+enum hyperclient_returncode
+hyperclient_unsubscribe(struct hyperclient* client, int64_t id)
+{
+    try
+    {
+        return client->unsubscribe(id);
+    }
+    catch (po6::error& e)
+    {
+        errno = e;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (std::bad_alloc& ba)
+    {
+        errno = ENOMEM;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (...)
+    {
+        return HYPERCLIENT_EXCEPTION;
+    }
+}
+
 int64_t
 hyperclient_loop(struct hyperclient* client, int timeout, hyperclient_returncode* status)
 {
@@ -25,6 +25,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <regex.h>
+
 // C++
 #include <iostream>
 #include <fstream>
@@ -32,10 +35,14 @@
 
 // STL
 #include <algorithm>
+#include <string>
 
 // po6
 #include <po6/net/location.h>
 
+// CityHash
+#include <city.h>
+
 #include <glog/logging.h>
 
 // e
@@ -70,12 +77,18 @@
 #include "client/keyop_info.h"
 #include "client/pending.h"
 #include "client/pending_count.h"
+#include "client/pending_count_approx.h"
+#include "client/pending_export.h"
 #include "client/pending_get.h"
 #include "client/pending_group_del.h"
+#include "client/pending_multi_atomic.h"
+#include "client/pending_sample.h"
 #include "client/pending_search.h"
 #include "client/pending_search_description.h"
 #include "client/pending_sorted_search.h"
+#include "client/pending_split_space.h"
 #include "client/pending_statusonly.h"
+#include "client/pending_subscribe.h"
 #include "client/refcount.h"
 #include "client/space_description.h"
 #include "client/wrap.h"
@@ -103,6 +116,44 @@ using hyperdex::virtual_server_id;
         return -1; \
     }
 
+// GETs in HYPERCLIENT_READ_ANY mode carry the last version read for the key,
+// remembered in a table with this many slots
+#define SESSION_VERSIONS 4096
+
+// Translate the returncode with which the coordinator answered an RPC
+static hyperclient_returncode
+coordinator_status(const char* output, size_t output_sz)
+{
+    if (output_sz < 2)
+    {
+        return HYPERCLIENT_SUCCESS;
+    }
+
+    uint16_t x;
+    e::unpack16be(output, &x);
+    coordinator_returncode rc = static_cast<coordinator_returncode>(x);
+
+    switch (rc)
+    {
+        case hyperdex::COORD_SUCCESS:
+            return HYPERCLIENT_SUCCESS;
+        case hyperdex::COORD_MALFORMED:
+            return HYPERCLIENT_INTERNAL;
+        case hyperdex::COORD_DUPLICATE:
+            return HYPERCLIENT_DUPLICATE;
+        case hyperdex::COORD_NOT_FOUND:
+            return HYPERCLIENT_NOTFOUND;
+        case hyperdex::COORD_INITIALIZED:
+            return HYPERCLIENT_COORDFAIL;
+        case hyperdex::COORD_UNINITIALIZED:
+            return HYPERCLIENT_COORDFAIL;
+        case hyperdex::COORD_TRANSFER_IN_PROGRESS:
+            return HYPERCLIENT_INTERNAL;
+        default:
+            return HYPERCLIENT_INTERNAL;
+    }
+}
+
 hyperclient :: hyperclient(const char* coordinator, uint16_t port)
     : m_config(new hyperdex::configuration())
     , m_busybee_mapper(new hyperdex::mapper(m_config.get()))
@@ -114,6 +165,9 @@ hyperclient :: hyperclient(const char* coordinator, uint16_t port)
     , m_server_nonce(1)
     , m_client_id(1)
     , m_have_seen_config(false)
+    , m_read_mode(HYPERCLIENT_READ_LEADER)
+    , m_read_choice(0)
+    , m_session_versions(SESSION_VERSIONS)
 {
     std::ofstream file;
     file.open("configuration.txt");
@@ -255,6 +309,90 @@ hyperclient :: rm_space(const char* space)
     return status;
 }
 
+hyperclient_returncode
+hyperclient :: add_index(const char* space, const char* description, uint16_t* id)
+{
+    hyperclient_returncode status;
+
+    if (maintain_coord_connection(&status) < 0)
+    {
+        return status;
+    }
+
+    const hyperdex::schema* sc = m_config->get_schema(space);
+
+    if (!sc)
+    {
+        return HYPERCLIENT_UNKNOWNSPACE;
+    }
+
+    hyperdex::index idx;
+
+    if (!hyperdex::index_description_to_index(*sc, description, &idx))
+    {
+        return HYPERCLIENT_BADSPACE;
+    }
+
+    e::slice name(space, strlen(space));
+    size_t sz = sizeof(uint32_t) + name.size() + pack_size(idx);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(0) << name << idx;
+    const char* output;
+    size_t output_sz;
+
+    if (!m_coord->make_rpc("add-index", reinterpret_cast<const char*>(msg->data()), msg->size(),
+                           &status, &output, &output_sz))
+    {
+        return status;
+    }
+
+    status = coordinator_status(output, output_sz);
+
+    if (status == HYPERCLIENT_SUCCESS && output_sz >= 2 * sizeof(uint16_t))
+    {
+        e::unpack16be(output + sizeof(uint16_t), id);
+    }
+
+    if (output)
+    {
+        replicant_destroy_output(output, output_sz);
+    }
+
+    return status;
+}
+
+hyperclient_returncode
+hyperclient :: rm_index(const char* space, uint16_t id)
+{
+    hyperclient_returncode status;
+    e::slice name(space, strlen(space));
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sizeof(uint32_t) + name.size() + sizeof(uint16_t)));
+    msg->pack_at(0) << name << id;
+    const char* output;
+    size_t output_sz;
+
+    if (!m_coord->make_rpc("rm-index", reinterpret_cast<const char*>(msg->data()), msg->size(),
+                           &status, &output, &output_sz))
+    {
+        return status;
+    }
+
+    status = coordinator_status(output, output_sz);
+
+    if (output)
+    {
+        replicant_destroy_output(output, output_sz);
+    }
+
+    return status;
+}
+
+void
+hyperclient :: set_read_mode(hyperclient_read_mode mode)
+{
+    m_read_mode = mode;
+}
+
 int64_t
 hyperclient :: get(const char* space, const char* key, size_t key_sz,
                    hyperclient_returncode* status,
@@ -263,10 +401,17 @@ hyperclient :: get(const char* space, const char* key, size_t key_sz,
     MAINTAIN_COORD_CONNECTION(status)
     const hyperdex::schema* sc = m_config->get_schema(space);
     VALIDATE_KEY(sc, key, key_sz) // Checks sc
-    e::intrusive_ptr<pending> op = new pending_get(status, attrs, attrs_sz);
-    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key_sz;
+    e::intrusive_ptr<pending> op = new pending_get(space, key, key_sz, status, attrs, attrs_sz);
+    uint64_t min_version = 0;
+
+    if (m_read_mode == HYPERCLIENT_READ_ANY)
+    {
+        min_version = session_version(space, key, key_sz);
+    }
+
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key_sz + sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << e::slice(key, key_sz);
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << e::slice(key, key_sz) << min_version;
     //LOG(INFO) << "get" << " ";
     m_op_id = 0;
     return add_keyop(space, key, key_sz, msg, op);
@@ -294,6 +439,31 @@ hyperclient :: del(const char* space, const char* key, size_t key_sz,
     return perform_funcall1(opinfo, space, key, key_sz, NULL, 0, NULL, 0, status);
 }
 
+int64_t
+hyperclient :: multi_put(const char* space, size_t num_objects,
+                         const char* const* keys, const size_t* keys_sz,
+                         const struct hyperclient_attribute* const* attrs, const size_t* attrs_sz,
+                         hyperclient_returncode* statuses,
+                         hyperclient_returncode* status)
+{
+    const hyperclient_keyop_info* opinfo;
+    opinfo = hyperclient_keyop_info_lookup("put", 3);
+    return perform_multi(opinfo, space, num_objects, keys, keys_sz,
+                         attrs, attrs_sz, statuses, status);
+}
+
+int64_t
+hyperclient :: multi_del(const char* space, size_t num_keys,
+                         const char* const* keys, const size_t* keys_sz,
+                         hyperclient_returncode* statuses,
+                         hyperclient_returncode* status)
+{
+    const hyperclient_keyop_info* opinfo;
+    opinfo = hyperclient_keyop_info_lookup("del", 3);
+    return perform_multi(opinfo, space, num_keys, keys, keys_sz,
+                         NULL, NULL, statuses, status);
+}
+
 #define HYPERCLIENT_CPPDEF(OPNAME) \
     int64_t \
     hyperclient :: OPNAME(const char* space, const char* key, size_t key_sz, \
@@ -499,12 +669,6 @@ hyperclient :: search_describe(const char* space,
     return search_id;
 }
 
-static void
-delete_bracket_auto_ptr(std::auto_ptr<e::buffer>* ptrs)
-{
-    delete[] ptrs;
-}
-
 int64_t
 hyperclient :: sorted_search(const char* space,
                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
@@ -530,75 +694,412 @@ hyperclient :: sorted_search(const char* space,
         sort_by_type != HYPERDATATYPE_INT64 &&
         sort_by_type != HYPERDATATYPE_FLOAT)
     {
-        *status = HYPERCLIENT_WRONGTYPE;
-        return -1 - checks_sz;
+        *status = HYPERCLIENT_WRONGTYPE;
+        return -1 - checks_sz;
+    }
+
+    int64_t search_id = m_client_id;
+    ++m_client_id;
+    int8_t max = maximize ? 1 : 0;
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + sizeof(uint64_t)
+              + pack_size(chks)
+              + sizeof(limit)
+              + sizeof(sort_by_no)
+              + sizeof(max);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(search_id) << chks << limit << sort_by_no << max;
+    e::intrusive_ptr<pending_sorted_search::state> state;
+    state = new pending_sorted_search::state(servers, limit, sort_by_no, sort_by_type, maximize);
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_sorted_search(search_id, state, i, hyperdex::REQ_SORTED_SEARCH, status, attrs, attrs_sz);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+            state->fail_stream(i);
+        }
+    }
+
+    return search_id;
+}
+
+int64_t
+hyperclient :: group_del(const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         enum hyperclient_returncode* status)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    int64_t search_id = m_client_id;
+    ++m_client_id;
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + pack_size(chks);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks;
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_group_del(search_id, hyperdex::REQ_GROUP_DEL, hyperdex::RESP_GROUP_DEL, ref, status);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return search_id;
+}
+
+#define HYPERCLIENT_GROUP_CPPDEF(OPNAME) \
+    int64_t \
+    hyperclient :: group_ ## OPNAME(const char* space, \
+                                    const struct hyperclient_attribute_check* checks, size_t checks_sz, \
+                                    const struct hyperclient_attribute* attrs, size_t attrs_sz, \
+                                    enum hyperclient_returncode* status) \
+    { \
+        const hyperclient_keyop_info* opinfo; \
+        opinfo = hyperclient_keyop_info_lookup(XSTR(OPNAME), strlen(XSTR(OPNAME))); \
+        return perform_group_funcall(opinfo, space, checks, checks_sz, attrs, attrs_sz, status); \
+    } \
+    extern "C" \
+    { \
+    int64_t \
+    hyperclient_group_ ## OPNAME(struct hyperclient* client, const char* space, \
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz, \
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz, \
+                                 hyperclient_returncode* status) \
+    { \
+        C_WRAP_EXCEPT(client->group_ ## OPNAME(space, checks, checks_sz, attrs, attrs_sz, status)); \
+    } \
+    }
+
+HYPERCLIENT_GROUP_CPPDEF(put)
+HYPERCLIENT_GROUP_CPPDEF(atomic_add)
+HYPERCLIENT_GROUP_CPPDEF(atomic_sub)
+HYPERCLIENT_GROUP_CPPDEF(atomic_mul)
+HYPERCLIENT_GROUP_CPPDEF(atomic_div)
+HYPERCLIENT_GROUP_CPPDEF(atomic_mod)
+HYPERCLIENT_GROUP_CPPDEF(atomic_and)
+HYPERCLIENT_GROUP_CPPDEF(atomic_or)
+HYPERCLIENT_GROUP_CPPDEF(atomic_xor)
+HYPERCLIENT_GROUP_CPPDEF(string_prepend)
+HYPERCLIENT_GROUP_CPPDEF(string_append)
+HYPERCLIENT_GROUP_CPPDEF(list_lpush)
+HYPERCLIENT_GROUP_CPPDEF(list_rpush)
+HYPERCLIENT_GROUP_CPPDEF(set_add)
+HYPERCLIENT_GROUP_CPPDEF(set_remove)
+HYPERCLIENT_GROUP_CPPDEF(set_intersect)
+HYPERCLIENT_GROUP_CPPDEF(set_union)
+
+int64_t
+hyperclient :: count(const char* space,
+                     const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                     enum hyperclient_returncode* status,
+                     uint64_t* result)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    int64_t search_id = m_client_id;
+    ++m_client_id;
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + pack_size(chks);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks;
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_count(search_id, ref, status, result);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return search_id;
+}
+
+int64_t
+hyperclient :: count_approx(const char* space,
+                            const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                            enum hyperclient_returncode* status,
+                            uint64_t* result, uint64_t* error)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    int64_t search_id = m_client_id;
+    ++m_client_id;
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + pack_size(chks);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks;
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_count_approx(search_id, ref, status, result, error);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return search_id;
+}
+
+int64_t
+hyperclient :: sample(const char* space,
+                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                      uint64_t n,
+                      enum hyperclient_returncode* status,
+                      struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    int64_t search_id = m_client_id;
+    ++m_client_id;
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + pack_size(chks)
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks << n;
+    e::intrusive_ptr<pending_sample::state> state;
+    state = new pending_sample::state(n);
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_sample(search_id, state, status, attrs, attrs_sz);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return search_id;
+}
+
+int64_t
+hyperclient :: split_space(const char* space, uint64_t n,
+                           enum hyperclient_returncode* status,
+                           char** split, size_t* split_sz)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, NULL, 0, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    int64_t split_id = m_client_id;
+    ++m_client_id;
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << n;
+    e::intrusive_ptr<pending_split_space::state> state;
+    state = new pending_split_space::state();
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_split_space(split_id, state, status, split, split_sz);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(split_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(split_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return split_id;
+}
+
+int64_t
+hyperclient :: search_split(const char* space,
+                            const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                            const char* split, size_t split_sz,
+                            enum hyperclient_returncode* status,
+                            struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    hyperdex::region_id ri;
+    e::slice lower;
+    e::slice upper;
+
+    if (!pending_split_space::parse(split, split_sz, &ri, &lower, &upper))
+    {
+        *status = HYPERCLIENT_WRONGTYPE;
+        return -1;
+    }
+
+    hyperdex::virtual_server_id vsi = m_config->tail_of_region(ri);
+
+    if (vsi == hyperdex::virtual_server_id())
+    {
+        *status = HYPERCLIENT_RECONFIGURE;
+        return -1;
     }
 
     int64_t search_id = m_client_id;
     ++m_client_id;
-    int8_t max = maximize ? 1 : 0;
     size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + sizeof(int64_t)
               + pack_size(chks)
-              + sizeof(limit)
-              + sizeof(sort_by_no)
-              + sizeof(max);
+              + hyperdex::pack_size(lower)
+              + hyperdex::pack_size(upper);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks << limit << sort_by_no << max;
-    std::auto_ptr<e::buffer>* backings = new std::auto_ptr<e::buffer>[servers.size()];
-    e::guard g = e::makeguard(delete_bracket_auto_ptr, backings);
-    e::intrusive_ptr<pending_sorted_search::state> state;
-    state = new pending_sorted_search::state(backings, limit, sort_by_no, sort_by_type, maximize);
-    g.dismiss();
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << search_id << chks << lower << upper;
+    e::intrusive_ptr<refcount> ref(new refcount());
+    e::intrusive_ptr<pending> op = new pending_search(search_id, ref, status, attrs, attrs_sz);
+    op->set_server_visible_nonce(m_server_nonce);
+    ++m_server_nonce;
+    op->set_sent_to(vsi);
+    m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
 
-    for (size_t i = 0; i < servers.size(); ++i)
+    if (send(op, msg) < 0)
     {
-        e::intrusive_ptr<pending> op = new pending_sorted_search(search_id, state, status, attrs, attrs_sz);
-        op->set_server_visible_nonce(m_server_nonce);
-        ++m_server_nonce;
-        op->set_sent_to(servers[i]);
-        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
-        std::auto_ptr<e::buffer> tosend(msg->copy());
-
-        if (send(op, tosend) < 0)
-        {
-#ifdef _MSC_VER
-            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
-#else
-            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
-#endif
-            m_incomplete.erase(op->server_visible_nonce());
-        }
+        m_incomplete.erase(op->server_visible_nonce());
+        *status = HYPERCLIENT_RECONFIGURE;
+        return -1;
     }
 
     return search_id;
 }
 
 int64_t
-hyperclient :: group_del(const char* space,
-                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
-                         enum hyperclient_returncode* status)
+hyperclient :: export_space(const char* space,
+                            enum hyperclient_returncode* status,
+                            char** batch, size_t* batch_sz)
 {
     MAINTAIN_COORD_CONNECTION(status)
     std::vector<hyperdex::attribute_check> chks;
     std::vector<hyperdex::virtual_server_id> servers;
-    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+    int64_t ret = prepare_searchop(space, NULL, 0, status, &chks, &servers);
 
     if (ret < 0)
     {
         return ret;
     }
 
-    int64_t search_id = m_client_id;
+    int64_t export_id = m_client_id;
     ++m_client_id;
     size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
-              + pack_size(chks);
+              + sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks;
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(export_id);
     e::intrusive_ptr<refcount> ref(new refcount());
 
     for (size_t i = 0; i < servers.size(); ++i)
     {
-        e::intrusive_ptr<pending> op = new pending_group_del(search_id, ref, status);
+        e::intrusive_ptr<pending> op = new pending_export(export_id, ref, status, batch, batch_sz);
         op->set_server_visible_nonce(m_server_nonce);
         ++m_server_nonce;
         op->set_sent_to(servers[i]);
@@ -608,22 +1109,24 @@ hyperclient :: group_del(const char* space,
         if (send(op, tosend) < 0)
         {
 #ifdef _MSC_VER
-            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(export_id, status, HYPERCLIENT_RECONFIGURE, 0)));
 #else
-            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+            m_complete_failed.push(complete(export_id, status, HYPERCLIENT_RECONFIGURE, 0));
 #endif
             m_incomplete.erase(op->server_visible_nonce());
         }
     }
 
-    return search_id;
+    return export_id;
 }
 
 int64_t
-hyperclient :: count(const char* space,
-                     const struct hyperclient_attribute_check* checks, size_t checks_sz,
-                     enum hyperclient_returncode* status,
-                     uint64_t* result)
+hyperclient :: subscribe(const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         const char* resume, size_t resume_sz,
+                         enum hyperclient_returncode* status,
+                         struct hyperclient_attribute** attrs, size_t* attrs_sz,
+                         const char** cursor, size_t* cursor_sz)
 {
     MAINTAIN_COORD_CONNECTION(status)
     std::vector<hyperdex::attribute_check> chks;
@@ -635,35 +1138,88 @@ hyperclient :: count(const char* space,
         return ret;
     }
 
-    int64_t search_id = m_client_id;
+    // Every write to a key passes through the tail of the key's region in the
+    // key subspace, so the subscription covers those regions regardless of
+    // the checks, unless the key itself is fixed.
+    std::vector<hyperdex::region_id> regions;
+
+    for (size_t i = 0; i < chks.size(); ++i)
+    {
+        if (chks[i].attr == 0 && chks[i].predicate == HYPERPREDICATE_EQUALS)
+        {
+            regions.push_back(m_config->get_region_id(m_config->point_leader(space, chks[i].value)));
+            break;
+        }
+    }
+
+    if (regions.empty())
+    {
+        m_config->key_regions(space, &regions);
+    }
+
+    e::intrusive_ptr<pending_subscribe::state> state;
+    state = new pending_subscribe::state(chks, cursor, cursor_sz);
+
+    if (resume && !state->resume(resume, resume_sz))
+    {
+        *status = HYPERCLIENT_WRONGTYPE;
+        return -1;
+    }
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        state->add_region(regions[i]);
+    }
+
+    int64_t sub_id = m_client_id;
     ++m_client_id;
-    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
-              + pack_size(chks);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks;
-    e::intrusive_ptr<refcount> ref(new refcount());
 
-    for (size_t i = 0; i < servers.size(); ++i)
+    for (size_t i = 0; i < regions.size(); ++i)
     {
-        e::intrusive_ptr<pending> op = new pending_count(search_id, ref, status, result);
-        op->set_server_visible_nonce(m_server_nonce);
-        ++m_server_nonce;
-        op->set_sent_to(servers[i]);
-        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
-        std::auto_ptr<e::buffer> tosend(msg->copy());
+        hyperdex::virtual_server_id tail = m_config->tail_of_region(regions[i]);
+        e::intrusive_ptr<pending_subscribe> op;
+        op = new pending_subscribe(sub_id, regions[i], state, status, attrs, attrs_sz);
+        op->set_sent_to(tail);
 
-        if (send(op, tosend) < 0)
+        if (tail == hyperdex::virtual_server_id() || op->poll(this) < 0)
         {
 #ifdef _MSC_VER
-            m_complete_failed.push(std::shared_ptr<complete>(new complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(sub_id, status, HYPERCLIENT_RECONFIGURE, 0)));
 #else
-            m_complete_failed.push(complete(search_id, status, HYPERCLIENT_RECONFIGURE, 0));
+            m_complete_failed.push(complete(sub_id, status, HYPERCLIENT_RECONFIGURE, 0));
 #endif
-            m_incomplete.erase(op->server_visible_nonce());
         }
     }
 
-    return search_id;
+    return sub_id;
+}
+
+hyperclient_returncode
+hyperclient :: unsubscribe(int64_t id)
+{
+    std::vector<e::intrusive_ptr<pending> > ops;
+
+    for (incomplete_map_t::iterator it = m_incomplete.begin();
+            it != m_incomplete.end(); ++it)
+    {
+        if (it->second->client_visible_id() == id &&
+            it->second->request_type() == hyperdex::REQ_SUBSCRIBE)
+        {
+            ops.push_back(it->second);
+        }
+    }
+
+    if (ops.empty())
+    {
+        return HYPERCLIENT_NONEPENDING;
+    }
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        static_cast<pending_subscribe*>(ops[i].get())->stop(this);
+    }
+
+    return HYPERCLIENT_SUCCESS;
 }
 
 int64_t
@@ -1300,6 +1856,184 @@ hyperclient :: perform_funcall2(const hyperclient_keyop_info* opinfo,
     return add_keyop(space, key, key_sz, msg, op);
 }
 
+int64_t
+hyperclient :: perform_group_funcall(const hyperclient_keyop_info* opinfo,
+                                     const char* space,
+                                     const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                     const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                     hyperclient_returncode* status)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    // prepare_searchop checked the space exists
+    const hyperdex::schema* sc = m_config->get_schema(space);
+    assert(sc);
+
+    // Prepare the ops
+    std::vector<funcall> ops;
+    size_t num_ops = prepare_ops(sc, opinfo, attrs, attrs_sz, status, &ops);
+
+    if (num_ops < attrs_sz)
+    {
+        return -1 - checks_sz - num_ops;
+    }
+
+    std::sort(ops.begin(), ops.end());
+    int64_t group_id = m_client_id;
+    ++m_client_id;
+    // Group operations only ever modify objects the search found, so they
+    // never create objects.
+    uint8_t flags = 1 | (opinfo->has_funcalls ? 128 : 0);
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + pack_size(chks)
+              + sizeof(uint8_t)
+              + pack_size(ops);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks << flags << ops;
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_group_del(group_id, hyperdex::REQ_GROUP_ATOMIC, hyperdex::RESP_GROUP_ATOMIC, ref, status);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(group_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(group_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return group_id;
+}
+
+int64_t
+hyperclient :: perform_multi(const hyperclient_keyop_info* opinfo,
+                             const char* space, size_t num_objects,
+                             const char* const* keys, const size_t* keys_sz,
+                             const struct hyperclient_attribute* const* attrs, const size_t* attrs_sz,
+                             hyperclient_returncode* statuses,
+                             hyperclient_returncode* status)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    const hyperdex::schema* sc = m_config->get_schema(space);
+
+    if (!sc)
+    {
+        *status = HYPERCLIENT_UNKNOWNSPACE;
+        return -1;
+    }
+
+    if (num_objects == 0)
+    {
+        *status = HYPERCLIENT_NONEPENDING;
+        return -1;
+    }
+
+    // Prepare the ops and find the point leader of every key before sending
+    // anything, so that a bad key fails the whole call
+    std::vector<std::vector<funcall> > ops(num_objects);
+    typedef std::map<hyperdex::virtual_server_id, std::vector<size_t> > leader_map_t;
+    leader_map_t leaders;
+
+    for (size_t i = 0; i < num_objects; ++i)
+    {
+        if (!validate_as_type(e::slice(keys[i], keys_sz[i]), sc->attrs[0].type))
+        {
+            statuses[i] = HYPERCLIENT_WRONGTYPE;
+            *status = HYPERCLIENT_WRONGTYPE;
+            return -1;
+        }
+
+        size_t obj_attrs_sz = attrs ? attrs_sz[i] : 0;
+        size_t num_ops = prepare_ops(sc, opinfo, attrs ? attrs[i] : NULL, obj_attrs_sz, status, &ops[i]);
+
+        if (num_ops < obj_attrs_sz)
+        {
+            statuses[i] = *status;
+            return -2 - num_ops;
+        }
+
+        std::sort(ops[i].begin(), ops[i].end());
+        hyperdex::virtual_server_id vsi = m_config->point_leader(space, e::slice(keys[i], keys_sz[i]));
+
+        if (vsi == hyperdex::virtual_server_id())
+        {
+            statuses[i] = HYPERCLIENT_RECONFIGURE;
+            *status = HYPERCLIENT_RECONFIGURE;
+            return -1;
+        }
+
+        leaders[vsi].push_back(i);
+    }
+
+    int64_t multi_id = m_client_id;
+    ++m_client_id;
+    uint8_t flags = (opinfo->fail_if_not_exist ? 1 : 0)
+                  | (opinfo->fail_if_exist ? 2 : 0)
+                  | (opinfo->has_funcalls ? 128 : 0);
+    std::vector<attribute_check> chks;
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    // One request per point leader, carrying each of its keys with the nonce
+    // that key's response will be sent under
+    for (leader_map_t::iterator l = leaders.begin(); l != leaders.end(); ++l)
+    {
+        const std::vector<size_t>& idxs(l->second);
+        std::vector<e::intrusive_ptr<pending> > group;
+        size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint32_t);
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            sz += sizeof(int64_t)
+                + sizeof(uint32_t) + keys_sz[idxs[i]]
+                + sizeof(uint8_t)
+                + pack_size(chks)
+                + pack_size(ops[idxs[i]]);
+        }
+
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::buffer::packer pa = msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ);
+        pa = pa << static_cast<uint32_t>(idxs.size());
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            size_t idx = idxs[i];
+            e::intrusive_ptr<pending> op = new pending_multi_atomic(multi_id, ref, &statuses[idx]);
+            op->set_server_visible_nonce(m_server_nonce);
+            ++m_server_nonce;
+            op->set_sent_to(l->first);
+            m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+            group.push_back(op);
+            pa = pa << op->server_visible_nonce()
+                    << e::slice(keys[idx], keys_sz[idx])
+                    << flags << chks << ops[idx];
+        }
+
+        // On failure, send has already failed every op in m_incomplete that
+        // went to this server, including this group
+        send(group.front(), msg);
+    }
+
+    return multi_id;
+}
+
 int64_t
 hyperclient :: prepare_searchop(const char* space,
                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
@@ -1361,6 +2095,21 @@ hyperclient :: prepare_searchop(const char* space,
     return 0;
 }
 
+static bool
+validate_regex(const char* regex, size_t regex_sz)
+{
+    std::string r(regex, regex_sz);
+    regex_t re;
+
+    if (regcomp(&re, r.c_str(), REG_EXTENDED | REG_NOSUB) != 0)
+    {
+        return false;
+    }
+
+    regfree(&re);
+    return true;
+}
+
 static bool
 validate_check(const hyperdex::schema* sc,
                const hyperclient_attribute_check* chk,
@@ -1379,6 +2128,16 @@ validate_check(const hyperdex::schema* sc,
         case HYPERPREDICATE_CONTAINS_LESS_THAN:
             return validate_as_type(e::slice(chk->value, chk->value_sz), chk->datatype) &&
                    chk->datatype == HYPERDATATYPE_INT64;
+        case HYPERPREDICATE_PREFIX:
+            return sc->attrs[attrnum].type == HYPERDATATYPE_STRING &&
+                   chk->datatype == HYPERDATATYPE_STRING;
+        case HYPERPREDICATE_REGEX:
+            return sc->attrs[attrnum].type == HYPERDATATYPE_STRING &&
+                   chk->datatype == HYPERDATATYPE_STRING;
+        case HYPERPREDICATE_IN:
+            return CONTAINER_TYPE(chk->datatype) == HYPERDATATYPE_LIST_GENERIC &&
+                   CONTAINER_ELEM(chk->datatype) == sc->attrs[attrnum].type &&
+                   validate_as_type(e::slice(chk->value, chk->value_sz), chk->datatype);
         default:
             return false;
     }
@@ -1408,6 +2167,14 @@ hyperclient :: prepare_checks(const hyperdex::schema* sc,
             return i;
         }
 
+        // the same error the daemon reports for a pattern it cannot compile
+        if (checks[i].predicate == HYPERPREDICATE_REGEX &&
+            !validate_regex(checks[i].value, checks[i].value_sz))
+        {
+            *status = HYPERCLIENT_BADSEARCH;
+            return i;
+        }
+
         attribute_check c;
         c.attr = attrnum;
         c.value = e::slice(checks[i].value, checks[i].value_sz);
@@ -1527,6 +2294,11 @@ hyperclient :: add_keyop(const char* space, const char* key, size_t key_sz,
         return -1;
     }
 
+    if (op->request_type() == hyperdex::REQ_GET)
+    {
+        vsi = read_replica(vsi);
+    }
+
     LOG(INFO) << (m_op_id ? "PUT" : "GET")  << " " << m_config->get_server_id(vsi) <<" "<< m_config->get_address(m_config->get_server_id(vsi)) << "\n";
 
     op->set_server_visible_nonce(m_server_nonce);
@@ -1548,6 +2320,79 @@ hyperclient :: add_keyop(const char* space, const char* key, size_t key_sz,
     }
 }
 
+hyperdex::virtual_server_id
+hyperclient :: read_replica(const hyperdex::virtual_server_id& leader)
+{
+    hyperdex::region_id ri = m_config->get_region_id(leader);
+
+    switch (m_read_mode)
+    {
+        case HYPERCLIENT_READ_TAIL:
+            return m_config->tail_of_region(ri);
+        case HYPERCLIENT_READ_ANY:
+            break;
+        case HYPERCLIENT_READ_LEADER:
+        default:
+            return leader;
+    }
+
+    size_t replicas = 0;
+
+    for (hyperdex::virtual_server_id vsi = leader;
+            vsi != hyperdex::virtual_server_id();
+            vsi = m_config->next_in_region(vsi))
+    {
+        ++replicas;
+    }
+
+    hyperdex::virtual_server_id vsi = leader;
+
+    for (size_t i = m_read_choice % replicas; i > 0; --i)
+    {
+        vsi = m_config->next_in_region(vsi);
+    }
+
+    ++m_read_choice;
+    return vsi;
+}
+
+uint64_t
+hyperclient :: session_version(const char* space, const char* key, size_t key_sz)
+{
+    uint64_t fp = CityHash64WithSeed(key, key_sz, CityHash64(space, strlen(space)));
+    const std::pair<uint64_t, uint64_t>& slot(m_session_versions[fp % m_session_versions.size()]);
+    return slot.first == fp ? slot.second : 0;
+}
+
+void
+hyperclient :: saw_version(const char* space, const char* key, size_t key_sz,
+                           uint64_t version, bool authoritative)
+{
+    uint64_t fp = CityHash64WithSeed(key, key_sz, CityHash64(space, strlen(space)));
+    std::pair<uint64_t, uint64_t>& slot(m_session_versions[fp % m_session_versions.size()]);
+
+    if (slot.first != fp || authoritative)
+    {
+        slot = std::make_pair(fp, version);
+    }
+    else
+    {
+        slot.second = std::max(slot.second, version);
+    }
+}
+
+void
+hyperclient :: forget_version(const char* space, const char* key, size_t key_sz)
+{
+    uint64_t fp = CityHash64WithSeed(key, key_sz, CityHash64(space, strlen(space)));
+    std::pair<uint64_t, uint64_t>& slot(m_session_versions[fp % m_session_versions.size()]);
+
+    if (slot.first == fp)
+    {
+        slot = std::make_pair(uint64_t(0), uint64_t(0));
+    }
+}
+
 int64_t
 hyperclient :: send(e::intrusive_ptr<pending> op,
                     std::auto_ptr<e::buffer> msg)
@@ -1640,6 +2485,7 @@ operator << (std::ostream& lhs, hyperclient_returncode rhs)
         STRINGIFY(HYPERCLIENT_INTERRUPTED);
         STRINGIFY(HYPERCLIENT_CLUSTER_JUMP);
         STRINGIFY(HYPERCLIENT_COORD_LOGGED);
+        STRINGIFY(HYPERCLIENT_BADSEARCH);
         STRINGIFY(HYPERCLIENT_INTERNAL);
         STRINGIFY(HYPERCLIENT_EXCEPTION);
         STRINGIFY(HYPERCLIENT_GARBAGE);
@@ -100,6 +100,7 @@ enum hyperclient_returncode
     HYPERCLIENT_INTERRUPTED  = 8530,
     HYPERCLIENT_CLUSTER_JUMP = 8531,
     HYPERCLIENT_COORD_LOGGED = 8532,
+    HYPERCLIENT_BADSEARCH    = 8533,
 
     /* This should never happen.  It indicates a bug */
     HYPERCLIENT_INTERNAL     = 8573,
@@ -107,17 +108,51 @@ enum hyperclient_returncode
     HYPERCLIENT_GARBAGE      = 8575
 };
 
+/* Where hyperclient_get sends its requests */
+enum hyperclient_read_mode
+{
+    /* The point leader for the key (the default) */
+    HYPERCLIENT_READ_LEADER = 0,
+    /* The tail of the key's chain, which always holds the latest committed
+     * value */
+    HYPERCLIENT_READ_TAIL   = 1,
+    /* Any replica of the key, spreading reads across the chain.  The client
+     * remembers the version it last read for recently read keys, and a
+     * replica that has not yet committed that version passes the read to the
+     * tail, so reads of a key never go back in time.  Writes complete only
+     * once every replica has committed them, so a read always sees the
+     * client's own completed writes. */
+    HYPERCLIENT_READ_ANY    = 2
+};
+
 struct hyperclient*
 hyperclient_create(const char* coordinator, uint16_t port);
 void
 hyperclient_destroy(struct hyperclient* client);
 
+/* Choose where subsequent GETs are sent */
+void
+hyperclient_set_read_mode(struct hyperclient* client, enum hyperclient_read_mode mode);
+
 enum hyperclient_returncode
 hyperclient_add_space(struct hyperclient* client, const char* description);
 
 enum hyperclient_returncode
 hyperclient_rm_space(struct hyperclient* client, const char* space);
 
+/* Add an index to an existing space.  The description is written as in the
+ * description of a space (e.g., "index last include first").  Daemons build
+ * the index for the objects they already hold in the background, and searches
+ * use it once it is built.  On success, "id" identifies the index for
+ * hyperclient_rm_index.
+ */
+enum hyperclient_returncode
+hyperclient_add_index(struct hyperclient* client, const char* space,
+                      const char* description, uint16_t* id);
+
+enum hyperclient_returncode
+hyperclient_rm_index(struct hyperclient* client, const char* space, uint16_t id);
+
 /* All values return a 64-bit integer, which uniquely identifies the request
  * until its completion.  Positive values indicate valid identifiers.  Negative
  * values indicate that the request fails immediately for the reason stored in
@@ -199,6 +234,37 @@ int64_t
 hyperclient_del(struct hyperclient* client, const char* space, const char* key,
                 size_t key_sz, enum hyperclient_returncode* status);
 
+/* Store (or delete) many objects in "space" with one call.
+ *
+ * Each key behaves as a call to ``hyperclient_put`` (or ``hyperclient_del``),
+ * and its outcome is written to the matching entry of "statuses".  Keys with
+ * the same point leader travel to it in a single request.  The call completes
+ * when every key has been answered; as with the group calls, it may also
+ * complete once for each key whose server fails.
+ *
+ * If this returns a value < 0, nothing was sent.  The status of the key at
+ * fault, and *status, will be set to the error.  If *status ==
+ * HYPERCLIENT_UNKNOWNATTR, then abs(returned value) - 2 == the attribute of
+ * that key which caused the error.
+ *
+ * - space, keys, attrs must point to memory that exists for the duration of
+ *   this call
+ * - client, statuses, status must point to memory that exists until the
+ *   request is considered complete
+ */
+int64_t
+hyperclient_multi_put(struct hyperclient* client, const char* space,
+                      size_t num_objects, const char* const* keys, const size_t* keys_sz,
+                      const struct hyperclient_attribute* const* attrs, const size_t* attrs_sz,
+                      enum hyperclient_returncode* statuses,
+                      enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_multi_del(struct hyperclient* client, const char* space,
+                      size_t num_keys, const char* const* keys, const size_t* keys_sz,
+                      enum hyperclient_returncode* statuses,
+                      enum hyperclient_returncode* status);
+
 /* Atomically add the values given to the existing attribute values
  *
  * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR, then
@@ -592,6 +658,12 @@ hyperclient_search(struct hyperclient* client, const char* space,
                    struct hyperclient_attribute** attrs, size_t* attrs_sz);
 
 /* Perform a search, and build a string describing the costs of the search.
+ *
+ * Each region contributes a block of lines, each a keyword followed by
+ * "name=value" fields:  the "plan" chosen, the "candidate" indices considered
+ * with their estimated sizes, the "scan" that executed the plan (index entries
+ * visited, object gets, bytes read, rows returned, wall and CPU time), and for
+ * each "check" the number of objects that passed it and every check before it.
  */
 int64_t
 hyperclient_search_describe(struct hyperclient* client, const char* space,
@@ -637,11 +709,251 @@ hyperclient_group_del(struct hyperclient* client, const char* space,
                       const struct hyperclient_attribute_check* checks, size_t checks_sz,
                       enum hyperclient_returncode* status);
 
+/* Apply an operation to every object which matches "checks".
+ *
+ * Each of these behaves like the single-key operation of the same name, applied
+ * to the objects that a call to ``hyperclient_search`` would return.  Servers
+ * send the keys they find to their point leaders in batches, and the point
+ * leader re-evaluates "checks" atomically with the update, so an object which
+ * no longer matches is left untouched.  Objects are never created.  The call
+ * completes once every server has dispatched its updates.
+ *
+ * Like ``hyperclient_group_del``, this is a best effort call.
+ *
+ * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR, then
+ * abs(returned value) - 1 == the attribute which caused the error.  If the
+ * attr's index >= checks_sz, it is an index into attrs.
+ */
+int64_t
+hyperclient_group_put(struct hyperclient* client, const char* space,
+                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                      const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                      enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_add(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_sub(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_mul(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_div(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_mod(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_and(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_or(struct hyperclient* client, const char* space,
+                            const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                            const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                            enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_atomic_xor(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_string_prepend(struct hyperclient* client, const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_string_append(struct hyperclient* client, const char* space,
+                                const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_list_lpush(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_list_rpush(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_set_add(struct hyperclient* client, const char* space,
+                          const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                          const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                          enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_set_remove(struct hyperclient* client, const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                             enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_set_intersect(struct hyperclient* client, const char* space,
+                                const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                enum hyperclient_returncode* status);
+
+int64_t
+hyperclient_group_set_union(struct hyperclient* client, const char* space,
+                            const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                            const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                            enum hyperclient_returncode* status);
+
 int64_t
 hyperclient_count(struct hyperclient* client, const char* space,
                   const struct hyperclient_attribute_check* checks, size_t checks_sz,
                   enum hyperclient_returncode* status, uint64_t* result);
 
+/* Estimate the number of objects which match "checks" without visiting all of
+ * them.  Each region examines a bounded number of candidates and extrapolates
+ * using the storage layer's size estimates.  When the call completes, "result"
+ * holds the estimate, and "error" the half-width of an approximate 95%
+ * confidence interval around it (zero if every region counted exactly).
+ */
+int64_t
+hyperclient_count_approx(struct hyperclient* client, const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         enum hyperclient_returncode* status,
+                         uint64_t* result, uint64_t* error);
+
+/* Retrieve a uniform random sample of at most "n" objects which match
+ * "checks".  Results are returned as with hyperclient_search, ending with
+ * HYPERCLIENT_SEARCHDONE.
+ *
+ * Each region returns a uniform sample of its matching objects, and the client
+ * combines them in proportion to the regions' sizes.  Only the sample crosses
+ * the network, but each region still visits every candidate selected by the
+ * search's index.
+ */
+int64_t
+hyperclient_sample(struct hyperclient* client, const char* space,
+                   const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                   uint64_t n,
+                   enum hyperclient_returncode* status,
+                   struct hyperclient_attribute** attrs, size_t* attrs_sz);
+
+/* Divide "space" into ranges of roughly equal size for searching in parallel.
+ * Each region is cut into at most "n" ranges of its keys, using the storage
+ * layer's size estimates.  Every range is returned as a separate
+ * HYPERCLIENT_SUCCESS result, ending with HYPERCLIENT_SEARCHDONE.  *split
+ * points to an opaque token describing the range, allocated with malloc; the
+ * caller must free it.
+ *
+ * Searching every range with hyperclient_search_split visits each object of
+ * the space exactly once.  Ranges are searched by scanning their objects, so
+ * this suits searches that would read most of the space anyway.
+ */
+int64_t
+hyperclient_split_space(struct hyperclient* client, const char* space,
+                        uint64_t n,
+                        enum hyperclient_returncode* status,
+                        char** split, size_t* split_sz);
+
+/* Perform a search, as with hyperclient_search, over just the range described
+ * by "split", a token returned by hyperclient_split_space.  Fails with
+ * HYPERCLIENT_WRONGTYPE if the token does not parse.
+ */
+int64_t
+hyperclient_search_split(struct hyperclient* client, const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         const char* split, size_t split_sz,
+                         enum hyperclient_returncode* status,
+                         struct hyperclient_attribute** attrs, size_t* attrs_sz);
+
+/* Export every object in "space".  Every region of the space streams its
+ * objects concurrently, from a consistent snapshot of the region, and each
+ * batch is returned as a separate HYPERCLIENT_SUCCESS result, ending with
+ * HYPERCLIENT_SEARCHDONE.  *batch points to the batch, allocated with malloc;
+ * the caller must free it.  A region that dropped its part of the export
+ * (servers drop exports the client has not asked for in a minute) reports
+ * HYPERCLIENT_SERVERERROR instead of a batch, and the export is incomplete.
+ *
+ * Batches are in a stable binary format, and may simply be concatenated to
+ * form an export file.  All integers are big-endian.  Each batch is:
+ *
+ * - uint64_t:  the region the objects came from
+ * - uint64_t:  the number of objects in the batch
+ * - uint32_t:  the size of the objects, uncompressed
+ * - uint32_t:  the size of the objects, compressed
+ * - the objects, compressed with snappy
+ *
+ * Each object is a uint32_t length and the key, followed by a uint32_t length
+ * and the value:  a uint64_t version, a uint16_t count of the secondary
+ * attributes, and each secondary attribute as a uint32_t length and its bytes,
+ * encoded as for hyperclient_attribute.
+ */
+int64_t
+hyperclient_export_space(struct hyperclient* client, const char* space,
+                         enum hyperclient_returncode* status,
+                         char** batch, size_t* batch_sz);
+
+/* Subscribe to changes to the objects which match "checks".  Instead of
+ * finishing, the subscription returns an event each time a write commits:
+ *
+ * - HYPERCLIENT_SUCCESS:  attrs holds an object which was written and now
+ *   matches "checks".
+ * - HYPERCLIENT_NOTFOUND:  attrs holds the last matching value of an object
+ *   which was deleted, or which was changed so that it no longer matches.
+ * - HYPERCLIENT_OVERFLOW:  changes were lost because the subscription resumed
+ *   from a position the servers no longer remember.  Re-run a search to
+ *   resynchronize; the subscription continues from the present.
+ * - HYPERCLIENT_RECONFIGURE:  part of the cluster stopped serving the
+ *   subscription.  Subscribe again, resuming from the last cursor.
+ * - HYPERCLIENT_SEARCHDONE:  the subscription has ended after a call to
+ *   hyperclient_unsubscribe.
+ *
+ * Each event updates *cursor and *cursor_sz to describe the position of the
+ * subscription.  This memory belongs to the client and is only valid until the
+ * next call to hyperclient_loop; copy it to keep it.  Passing a saved cursor as
+ * "resume" to a later subscription (possibly from another client) returns
+ * every change after that position that the servers still remember.  Pass
+ * NULL to start from the present.
+ *
+ * Events are evaluated against each committed value, in commit order for any
+ * one key.  Objects which already match when the subscription starts are not
+ * returned; use hyperclient_search for those.
+ */
+int64_t
+hyperclient_subscribe(struct hyperclient* client, const char* space,
+                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                      const char* resume, size_t resume_sz,
+                      enum hyperclient_returncode* status,
+                      struct hyperclient_attribute** attrs, size_t* attrs_sz,
+                      const char** cursor, size_t* cursor_sz);
+
+/* End the subscription identified by "id".  The subscription will return
+ * HYPERCLIENT_SEARCHDONE once the servers have stopped it.
+ */
+enum hyperclient_returncode
+hyperclient_unsubscribe(struct hyperclient* client, int64_t id);
+
 /* Handle I/O until at least one event is complete (either a key-op finishes, or
  * a search returns one item).
  *
@@ -718,6 +1030,9 @@ class hyperclient
     public:
         hyperclient_returncode add_space(const char* description);
         hyperclient_returncode rm_space(const char* space);
+        hyperclient_returncode add_index(const char* space, const char* description, uint16_t* id);
+        hyperclient_returncode rm_index(const char* space, uint16_t id);
+        void set_read_mode(hyperclient_read_mode mode);
 
     public:
         int64_t get(const char* space, const char* key, size_t key_sz,
@@ -735,6 +1050,15 @@ class hyperclient
                          hyperclient_returncode* status);
         int64_t del(const char* space, const char* key, size_t key_sz,
                     hyperclient_returncode* status);
+        int64_t multi_put(const char* space, size_t num_objects,
+                          const char* const* keys, const size_t* keys_sz,
+                          const struct hyperclient_attribute* const* attrs, const size_t* attrs_sz,
+                          hyperclient_returncode* statuses,
+                          hyperclient_returncode* status);
+        int64_t multi_del(const char* space, size_t num_keys,
+                          const char* const* keys, const size_t* keys_sz,
+                          hyperclient_returncode* statuses,
+                          hyperclient_returncode* status);
         int64_t atomic_add(const char* space, const char* key, size_t key_sz,
                            const struct hyperclient_attribute* attrs, size_t attrs_sz,
                            enum hyperclient_returncode* status);
@@ -840,9 +1164,104 @@ class hyperclient
         int64_t group_del(const char* space,
                           const struct hyperclient_attribute_check* checks, size_t checks_sz,
                           enum hyperclient_returncode* status);
+        int64_t group_put(const char* space,
+                          const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                          const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                          enum hyperclient_returncode* status);
+        int64_t group_atomic_add(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_atomic_sub(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_atomic_mul(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_atomic_div(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_atomic_mod(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_atomic_and(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_atomic_or(const char* space,
+                                const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                enum hyperclient_returncode* status);
+        int64_t group_atomic_xor(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_string_prepend(const char* space,
+                                     const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                     const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                     enum hyperclient_returncode* status);
+        int64_t group_string_append(const char* space,
+                                    const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                    const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                    enum hyperclient_returncode* status);
+        int64_t group_list_lpush(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_list_rpush(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_set_add(const char* space,
+                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                              const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                              enum hyperclient_returncode* status);
+        int64_t group_set_remove(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                 enum hyperclient_returncode* status);
+        int64_t group_set_intersect(const char* space,
+                                    const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                    const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                    enum hyperclient_returncode* status);
+        int64_t group_set_union(const char* space,
+                                const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                enum hyperclient_returncode* status);
         int64_t count(const char* space,
                       const struct hyperclient_attribute_check* checks, size_t checks_sz,
                       enum hyperclient_returncode* status, uint64_t* result);
+        int64_t count_approx(const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             enum hyperclient_returncode* status,
+                             uint64_t* result, uint64_t* error);
+        int64_t sample(const char* space,
+                       const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                       uint64_t n,
+                       enum hyperclient_returncode* status,
+                       struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t split_space(const char* space, uint64_t n,
+                            enum hyperclient_returncode* status,
+                            char** split, size_t* split_sz);
+        int64_t search_split(const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             const char* split, size_t split_sz,
+                             enum hyperclient_returncode* status,
+                             struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t export_space(const char* space,
+                             enum hyperclient_returncode* status,
+                             char** batch, size_t* batch_sz);
+        int64_t subscribe(const char* space,
+                          const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                          const char* resume, size_t resume_sz,
+                          enum hyperclient_returncode* status,
+                          struct hyperclient_attribute** attrs, size_t* attrs_sz,
+                          const char** cursor, size_t* cursor_sz);
+        hyperclient_returncode unsubscribe(int64_t id);
         int64_t loop(int timeout, hyperclient_returncode* status);
         // Introspect things
         hyperdatatype attribute_type(const char* space, const char* name,
@@ -854,12 +1273,18 @@ class hyperclient
         class description;
         class pending;
         class pending_count;
+        class pending_count_approx;
+        class pending_export;
         class pending_get;
         class pending_group_del;
+        class pending_multi_atomic;
+        class pending_sample;
         class pending_search;
         class pending_search_description;
         class pending_sorted_search;
+        class pending_split_space;
         class pending_statusonly;
+        class pending_subscribe;
         class refcount;
         typedef std::map<int64_t, e::intrusive_ptr<pending> > incomplete_map_t;
         friend class hyperdex::tool_wrapper;
@@ -883,6 +1308,17 @@ class hyperclient
                                  const struct hyperclient_attribute_check* checks, size_t checks_sz,
                                  const struct hyperclient_map_attribute* attrs, size_t attrs_sz,
                                  hyperclient_returncode* status);
+        int64_t perform_group_funcall(const struct hyperclient_keyop_info* opinfo,
+                                      const char* space,
+                                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                      const struct hyperclient_attribute* attrs, size_t attrs_sz,
+                                      hyperclient_returncode* status);
+        int64_t perform_multi(const struct hyperclient_keyop_info* opinfo,
+                              const char* space, size_t num_objects,
+                              const char* const* keys, const size_t* keys_sz,
+                              const struct hyperclient_attribute* const* attrs, const size_t* attrs_sz,
+                              hyperclient_returncode* statuses,
+                              hyperclient_returncode* status);
         int64_t prepare_searchop(const char* space,
                                  const struct hyperclient_attribute_check* checks, size_t checks_sz,
                                  hyperclient_returncode* status,
@@ -917,6 +1353,15 @@ class hyperclient
                           e::intrusive_ptr<pending> op);
         int64_t send(e::intrusive_ptr<pending> op,
                      std::auto_ptr<e::buffer> msg);
+        // the replica that a GET for a key led by "leader" should go to
+        hyperdex::virtual_server_id read_replica(const hyperdex::virtual_server_id& leader);
+        // the session version token for a key
+        uint64_t session_version(const char* space, const char* key, size_t key_sz);
+        // "authoritative" versions come from the tail and replace whatever
+        // was recorded; others only ever advance it
+        void saw_version(const char* space, const char* key, size_t key_sz,
+                         uint64_t version, bool authoritative);
+        void forget_version(const char* space, const char* key, size_t key_sz);
         void killall(const hyperdex::server_id& id, hyperclient_returncode status);
 
     private:
@@ -935,6 +1380,11 @@ class hyperclient
         int64_t m_client_id;
         bool m_have_seen_config;
         uint16_t m_op_id;
+        hyperclient_read_mode m_read_mode;
+        uint64_t m_read_choice;
+        // (key fingerprint, version) of recently read keys, indexed by
+        // fingerprint
+        std::vector<std::pair<uint64_t, uint64_t> > m_session_versions;
 };
 
 std::ostream&
@@ -33,6 +33,7 @@ public class HyperClientException extends Exception
 		errorMap.put(hyperclient_returncode.HYPERCLIENT_INTERRUPTED,"Interrupted by a signal");
 		errorMap.put(hyperclient_returncode.HYPERCLIENT_CLUSTER_JUMP,"The cluster changed identities");
 		errorMap.put(hyperclient_returncode.HYPERCLIENT_COORD_LOGGED,"HYPERCLIENT_COORD_LOGGED");
+		errorMap.put(hyperclient_returncode.HYPERCLIENT_BADSEARCH,"The search predicate is malformed");
 		errorMap.put(hyperclient_returncode.HYPERCLIENT_INTERNAL,"Internal Error (file a bug)");
 		errorMap.put(hyperclient_returncode.HYPERCLIENT_EXCEPTION,"Internal Exception (file a bug)");
 		errorMap.put(hyperclient_returncode.HYPERCLIENT_GARBAGE,"Internal Corruption (file a bug)");
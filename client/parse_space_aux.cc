@@ -35,6 +35,7 @@ extern "C"
 {
 
 struct hyperparse_space* hyperparsed_space = NULL;
+struct hyperparse_index* hyperparsed_index = NULL;
 int hyperparsed_error = 0;
 
 static void
@@ -114,6 +115,81 @@ free_subspace_list(struct hyperparse_subspace_list* sl)
     free(sl);
 }
 
+static void
+free_filter(struct hyperparse_filter* f)
+{
+    if (f->attr)
+    {
+        free(f->attr);
+    }
+
+    if (f->str)
+    {
+        free(f->str);
+    }
+
+    free(f);
+}
+
+static void
+free_filter_list(struct hyperparse_filter_list* fl)
+{
+    if (fl->filter)
+    {
+        free_filter(fl->filter);
+    }
+
+    while (fl->next)
+    {
+        struct hyperparse_filter_list* tmp = fl->next;
+        fl->next = tmp->next;
+        tmp->next = NULL;
+        free_filter_list(tmp);
+    }
+
+    free(fl);
+}
+
+static void
+free_index(struct hyperparse_index* i)
+{
+    if (i->attrs)
+    {
+        free_identifier_list(i->attrs);
+    }
+
+    if (i->include)
+    {
+        free_identifier_list(i->include);
+    }
+
+    if (i->filters)
+    {
+        free_filter_list(i->filters);
+    }
+
+    free(i);
+}
+
+static void
+free_index_list(struct hyperparse_index_list* il)
+{
+    if (il->index)
+    {
+        free_index(il->index);
+    }
+
+    while (il->next)
+    {
+        struct hyperparse_index_list* tmp = il->next;
+        il->next = tmp->next;
+        tmp->next = NULL;
+        free_index_list(tmp);
+    }
+
+    free(il);
+}
+
 void
 hyperparse_free(struct hyperparse_space* s)
 {
@@ -141,6 +217,20 @@ hyperparse_free(struct hyperparse_space* s)
     {
         free_subspace_list(s->subspaces);
     }
+
+    if (s->indices)
+    {
+        free_index_list(s->indices);
+    }
+}
+
+void
+hyperparse_free_index(struct hyperparse_index* i)
+{
+    if (i)
+    {
+        free_index(i);
+    }
 }
 
 struct hyperparse_space*
@@ -149,7 +239,8 @@ hyperparse_create_space(char* name,
                         struct hyperparse_attribute_list* attrs,
                         uint64_t fault_tolerance,
                         uint64_t partitioning,
-                        struct hyperparse_subspace_list* subspaces)
+                        struct hyperparse_subspace_list* subspaces,
+                        struct hyperparse_index_list* indices)
 {
     struct hyperparse_space* s = reinterpret_cast<struct hyperparse_space*>(malloc(sizeof(struct hyperparse_space)));
     s->name = name;
@@ -158,6 +249,7 @@ hyperparse_create_space(char* name,
     s->fault_tolerance = fault_tolerance;
     s->partitioning = partitioning;
     s->subspaces = subspaces;
+    s->indices = indices;
     return s;
 }
 
@@ -232,6 +324,84 @@ hyperparse_create_subspace(struct hyperparse_identifier_list* attrs)
     return s;
 }
 
+struct hyperparse_index_list*
+hyperparse_create_index_list(struct hyperparse_index* index,
+                             struct hyperparse_index_list* list)
+{
+    struct hyperparse_index_list* il = reinterpret_cast<struct hyperparse_index_list*>(malloc(sizeof(struct hyperparse_index_list)));
+    struct hyperparse_index_list* tmp = list;
+    il->index = index;
+    il->next = NULL;
+
+    if (list)
+    {
+        while (tmp->next)
+        {
+            tmp = tmp->next;
+        }
+
+        tmp->next = il;
+        tmp = list;
+    }
+    else
+    {
+        tmp = il;
+    }
+
+    return tmp;
+}
+
+struct hyperparse_index*
+hyperparse_create_index(struct hyperparse_identifier_list* attrs,
+                        struct hyperparse_identifier_list* include,
+                        struct hyperparse_filter_list* filters)
+{
+    struct hyperparse_index* i = reinterpret_cast<struct hyperparse_index*>(malloc(sizeof(struct hyperparse_index)));
+    i->attrs = attrs;
+    i->include = include;
+    i->filters = filters;
+    return i;
+}
+
+struct hyperparse_filter_list*
+hyperparse_create_filter_list(struct hyperparse_filter* filter,
+                              struct hyperparse_filter_list* list)
+{
+    struct hyperparse_filter_list* fl = reinterpret_cast<struct hyperparse_filter_list*>(malloc(sizeof(struct hyperparse_filter_list)));
+    struct hyperparse_filter_list* tmp = list;
+    fl->filter = filter;
+    fl->next = NULL;
+
+    if (list)
+    {
+        while (tmp->next)
+        {
+            tmp = tmp->next;
+        }
+
+        tmp->next = fl;
+        tmp = list;
+    }
+    else
+    {
+        tmp = fl;
+    }
+
+    return tmp;
+}
+
+struct hyperparse_filter*
+hyperparse_create_filter(char* attr, enum hyperpredicate predicate,
+                         char* str, uint64_t num)
+{
+    struct hyperparse_filter* f = reinterpret_cast<struct hyperparse_filter*>(malloc(sizeof(struct hyperparse_filter)));
+    f->attr = attr;
+    f->predicate = predicate;
+    f->str = str;
+    f->num = num;
+    return f;
+}
+
 struct hyperparse_identifier_list*
 hyperparse_create_identifier_list(char* name, struct hyperparse_identifier_list* list)
 {
@@ -43,6 +43,10 @@ extern "C"
 struct hyperparse_space;
 struct hyperparse_subspace_list;
 struct hyperparse_subspace;
+struct hyperparse_index_list;
+struct hyperparse_index;
+struct hyperparse_filter_list;
+struct hyperparse_filter;
 struct hyperparse_attribute_list;
 struct hyperparse_attribute;
 
@@ -54,6 +58,7 @@ struct hyperparse_space
     uint64_t fault_tolerance;
     uint64_t partitioning;
     struct hyperparse_subspace_list* subspaces;
+    struct hyperparse_index_list* indices;
 };
 
 struct hyperparse_subspace_list
@@ -67,6 +72,33 @@ struct hyperparse_subspace
     struct hyperparse_identifier_list* attrs;
 };
 
+struct hyperparse_index_list
+{
+    struct hyperparse_index* index;
+    struct hyperparse_index_list* next;
+};
+
+struct hyperparse_index
+{
+    struct hyperparse_identifier_list* attrs;
+    struct hyperparse_identifier_list* include;
+    struct hyperparse_filter_list* filters;
+};
+
+struct hyperparse_filter_list
+{
+    struct hyperparse_filter* filter;
+    struct hyperparse_filter_list* next;
+};
+
+struct hyperparse_filter
+{
+    char* attr;
+    enum hyperpredicate predicate;
+    char* str; /* NULL when the value is a number */
+    uint64_t num;
+};
+
 struct hyperparse_attribute_list
 {
     struct hyperparse_attribute* attr;
@@ -86,9 +118,11 @@ struct hyperparse_identifier_list
 };
 
 extern struct hyperparse_space* hyperparsed_space;
+extern struct hyperparse_index* hyperparsed_index;
 extern int hyperparsed_error;
 
 void hyperparse_free(struct hyperparse_space* s);
+void hyperparse_free_index(struct hyperparse_index* i);
 
 struct hyperparse_space*
 hyperparse_create_space(char* name,
@@ -96,7 +130,8 @@ hyperparse_create_space(char* name,
                         struct hyperparse_attribute_list* attrs,
                         uint64_t fault_tolerance,
                         uint64_t partitioning,
-                        struct hyperparse_subspace_list* subspaces);
+                        struct hyperparse_subspace_list* subspaces,
+                        struct hyperparse_index_list* indices);
 
 struct hyperparse_attribute_list*
 hyperparse_create_attribute_list(struct hyperparse_attribute* attr,
@@ -112,6 +147,23 @@ hyperparse_create_subspace_list(struct hyperparse_subspace* subspace,
 struct hyperparse_subspace*
 hyperparse_create_subspace(struct hyperparse_identifier_list* attrs);
 
+struct hyperparse_index_list*
+hyperparse_create_index_list(struct hyperparse_index* index,
+                             struct hyperparse_index_list* list);
+
+struct hyperparse_index*
+hyperparse_create_index(struct hyperparse_identifier_list* attrs,
+                        struct hyperparse_identifier_list* include,
+                        struct hyperparse_filter_list* filters);
+
+struct hyperparse_filter_list*
+hyperparse_create_filter_list(struct hyperparse_filter* filter,
+                              struct hyperparse_filter_list* list);
+
+struct hyperparse_filter*
+hyperparse_create_filter(char* attr, enum hyperpredicate predicate,
+                         char* str, uint64_t num);
+
 struct hyperparse_identifier_list*
 hyperparse_create_identifier_list(char* name, struct hyperparse_identifier_list* list);
 
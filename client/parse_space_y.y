@@ -46,8 +46,13 @@ void yyerror(char* s);
     struct hyperparse_attribute_list* attrs;
     struct hyperparse_subspace* subspace;
     struct hyperparse_subspace_list* subspaces;
+    struct hyperparse_index* index;
+    struct hyperparse_index_list* indices;
+    struct hyperparse_filter* filter;
+    struct hyperparse_filter_list* filters;
     struct hyperparse_identifier_list* identifiers;
     enum hyperdatatype type;
+    enum hyperpredicate pred;
 }
 
 %token SPACE
@@ -58,6 +63,12 @@ void yyerror(char* s);
 %token CREATE
 %token PARTITIONS
 %token SUBSPACE
+%token INDEX
+%token INCLUDE
+%token WHERE
+%token EQ
+%token LE
+%token GE
 %token COLON
 %token COMMA
 %token OP
@@ -70,6 +81,7 @@ void yyerror(char* s);
 %token MAP
 %token <str> IDENTIFIER
 %token <num> NUMBER
+%token <str> QUOTED
 
 %type <space> space
 %type <attrs> attribute_list
@@ -79,15 +91,25 @@ void yyerror(char* s);
 %type <num> partitions
 %type <subspaces> subspace_list
 %type <subspace> subspace
+%type <indices> index_list
+%type <index> index
+%type <identifiers> index_include
+%type <filters> index_where
+%type <filters> filter_list
+%type <filter> filter
+%type <pred> predicate
 %type <identifiers> identifier_list;
 
 %%
 
+statement : space
+          | INDEX index { hyperparsed_index = $2; };
+
 space : SPACE IDENTIFIER KEY attribute ATTRIBUTES attribute_list
-        subspace_list partitions fault_tolerance
-        { hyperparsed_space = hyperparse_create_space($2, $4, $6, $9, $8, $7); }
+        subspace_list index_list partitions fault_tolerance
+        { hyperparsed_space = hyperparse_create_space($2, $4, $6, $10, $9, $7, $8); }
       | SPACE IDENTIFIER KEY attribute partitions fault_tolerance
-        { hyperparsed_space = hyperparse_create_space($2, $4, NULL, $6, $5, NULL); };
+        { hyperparsed_space = hyperparse_create_space($2, $4, NULL, $6, $5, NULL, NULL); };
 
 fault_tolerance :                          { $$ = 2; }
                 | TOLERATE NUMBER FAILURES { $$ = $2; };
@@ -100,6 +122,27 @@ subspace_list :                                 { $$ = NULL; }
 
 subspace : identifier_list { $$ = hyperparse_create_subspace($1); } /*XXX*/
 
+index_list :                        { $$ = NULL; }
+           | index_list INDEX index { $$ = hyperparse_create_index_list($3, $1); };
+
+index : identifier_list index_include index_where { $$ = hyperparse_create_index($1, $2, $3); };
+
+index_include :                         { $$ = NULL; }
+              | INCLUDE identifier_list { $$ = $2; };
+
+index_where :                   { $$ = NULL; }
+            | WHERE filter_list { $$ = $2; };
+
+filter_list : filter                   { $$ = hyperparse_create_filter_list($1, NULL); }
+            | filter_list COMMA filter { $$ = hyperparse_create_filter_list($3, $1); };
+
+filter : IDENTIFIER predicate QUOTED { $$ = hyperparse_create_filter($1, $2, $3, 0); }
+       | IDENTIFIER predicate NUMBER { $$ = hyperparse_create_filter($1, $2, NULL, $3); };
+
+predicate : EQ { $$ = HYPERPREDICATE_EQUALS; }
+          | LE { $$ = HYPERPREDICATE_LESS_EQUAL; }
+          | GE { $$ = HYPERPREDICATE_GREATER_EQUAL; };
+
 attribute_list : attribute                      { $$ = hyperparse_create_attribute_list($1, NULL); }
                | attribute_list COMMA attribute   { $$ = hyperparse_create_attribute_list($3, $1); };
 
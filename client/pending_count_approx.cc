@@ -0,0 +1,100 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <math.h>
+
+// HyperDex
+#include "client/constants.h"
+#include "client/complete.h"
+#include "client/pending_count_approx.h"
+#include "client/util.h"
+
+hyperclient :: pending_count_approx :: pending_count_approx(int64_t count_id,
+                                                            e::intrusive_ptr<refcount> ref,
+                                                            hyperclient_returncode* status,
+                                                            uint64_t* result,
+                                                            uint64_t* error)
+    : pending(status)
+    , m_ref(ref)
+    , m_result(result)
+    , m_error(error)
+{
+    this->set_client_visible_id(count_id);
+}
+
+hyperclient :: pending_count_approx :: ~pending_count_approx() throw ()
+{
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_count_approx :: request_type()
+{
+    return hyperdex::REQ_COUNT_APPROX;
+}
+
+int64_t
+hyperclient :: pending_count_approx :: handle_response(hyperclient* cl,
+                                                       const hyperdex::server_id& sender,
+                                                       std::auto_ptr<e::buffer> msg,
+                                                       hyperdex::network_msgtype type,
+                                                       hyperclient_returncode* status)
+{
+    *status = HYPERCLIENT_SUCCESS;
+
+    if (type != hyperdex::RESP_COUNT_APPROX)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    uint64_t estimate;
+    uint64_t variance;
+    up = up >> estimate >> variance;
+
+    if (up.error())
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    // regions are estimated independently, so their variances add
+    *m_result += estimate;
+    *m_error += variance;
+
+    if (m_ref->last_reference())
+    {
+        // report the half-width of a 95% confidence interval
+        *m_error = ceil(1.96 * sqrt(static_cast<double>(*m_error)));
+        return client_visible_id();
+    }
+    else
+    {
+        return 0;
+    }
+}
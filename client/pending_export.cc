@@ -0,0 +1,173 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "client/constants.h"
+#include "client/complete.h"
+#include "client/pending_export.h"
+
+hyperclient :: pending_export :: pending_export(int64_t export_id,
+                                                e::intrusive_ptr<refcount> ref,
+                                                hyperclient_returncode* status,
+                                                char** batch,
+                                                size_t* batch_sz)
+    : pending(status)
+    , m_export_id(export_id)
+    , m_reqtype(hyperdex::REQ_EXPORT_START)
+    , m_ref(ref)
+    , m_batch(batch)
+    , m_batch_sz(batch_sz)
+{
+    this->set_client_visible_id(export_id);
+}
+
+hyperclient :: pending_export :: ~pending_export() throw ()
+{
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_export :: request_type()
+{
+    return m_reqtype;
+}
+
+int64_t
+hyperclient :: pending_export :: handle_response(hyperclient* cl,
+                                                 const hyperdex::server_id& sender,
+                                                 std::auto_ptr<e::buffer> msg,
+                                                 hyperdex::network_msgtype type,
+                                                 hyperclient_returncode* status)
+{
+    *status = HYPERCLIENT_SUCCESS;
+    uint8_t flags = 0;
+    e::slice frame;
+
+    if (type != hyperdex::RESP_EXPORT_BATCH ||
+        (msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP) >> flags >> frame).error() ||
+        (!frame.empty() && frame.size() < 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t)))
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+
+        if (m_ref->last_reference())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+
+        return 0;
+    }
+
+    if (flags & 2)
+    {
+        // the server no longer has the export; what was returned is partial
+        set_status(HYPERCLIENT_SERVERERROR);
+
+        if (m_ref->last_reference())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+
+        return client_visible_id();
+    }
+
+    if (flags & 1)
+    {
+        std::auto_ptr<e::buffer> smsg(e::buffer::create(HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint64_t)));
+        smsg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(m_export_id);
+        set_server_visible_nonce(cl->m_server_nonce);
+        ++cl->m_server_nonce;
+        m_reqtype = hyperdex::REQ_EXPORT_NEXT;
+
+        if (cl->send(this, smsg) < 0)
+        {
+            cl->killall(sender, HYPERCLIENT_RECONFIGURE);
+
+            if (m_ref->last_reference())
+            {
+#ifdef _MSC_VER
+                cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+                cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+            }
+
+            return 0;
+        }
+
+        cl->m_incomplete.insert(std::make_pair(server_visible_nonce(), this));
+    }
+    else if (m_ref->last_reference())
+    {
+#ifdef _MSC_VER
+        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+    }
+
+    uint64_t count = 0;
+
+    if (!frame.empty())
+    {
+        e::unpack64be(frame.data() + sizeof(uint64_t), &count);
+    }
+
+    // empty regions produce empty batches, which are not worth returning
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    char* ret = static_cast<char*>(malloc(frame.size()));
+
+    if (!ret)
+    {
+        set_status(HYPERCLIENT_NOMEM);
+        return client_visible_id();
+    }
+
+    memmove(ret, frame.data(), frame.size());
+    *m_batch = ret;
+    *m_batch_sz = frame.size();
+    set_status(HYPERCLIENT_SUCCESS);
+    return client_visible_id();
+}
@@ -26,17 +26,23 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 // HyperClient
+#include "common/configuration.h"
 #include "common/network_returncode.h"
 #include "client/constants.h"
 #include "client/pending_get.h"
 #include "client/util.h"
 
-hyperclient :: pending_get :: pending_get(hyperclient_returncode* status,
+hyperclient :: pending_get :: pending_get(const char* space,
+                                          const char* key, size_t key_sz,
+                                          hyperclient_returncode* status,
                                           struct hyperclient_attribute** attrs,
                                           size_t* attrs_sz)
     : pending(status)
+    , m_space(space)
+    , m_key(key, key_sz)
     , m_attrs(attrs)
     , m_attrs_sz(attrs_sz)
+    , m_at_tail(false)
 {
 }
 
@@ -80,6 +86,12 @@ hyperclient :: pending_get :: handle_response(hyperclient* cl,
         case hyperdex::NET_SUCCESS:
             break;
         case hyperdex::NET_NOTFOUND:
+            if (m_at_tail)
+            {
+                // the object is gone, so there is no version to wait for
+                cl->forget_version(m_space.c_str(), m_key.data(), m_key.size());
+            }
+
             set_status(HYPERCLIENT_NOTFOUND);
             return client_visible_id();
         case hyperdex::NET_BADDIMSPEC:
@@ -91,6 +103,8 @@ hyperclient :: pending_get :: handle_response(hyperclient* cl,
         case hyperdex::NET_READONLY:
             set_status(HYPERCLIENT_READONLY);
             return client_visible_id();
+        case hyperdex::NET_STALE:
+            return retry_at_tail(cl);
         case hyperdex::NET_SERVERERROR:
         case hyperdex::NET_CMPFAIL:
         case hyperdex::NET_BADMICROS:
@@ -101,14 +115,22 @@ hyperclient :: pending_get :: handle_response(hyperclient* cl,
     }
 
     std::vector<e::slice> value;
+    uint64_t version = 0;
     up = up >> value;
 
+    if (up.remain() > 0)
+    {
+        up = up >> version;
+    }
+
     if (up.error())
     {
         cl->killall(id, HYPERCLIENT_SERVERERROR);
         return 0;
     }
 
+    cl->saw_version(m_space.c_str(), m_key.data(), m_key.size(), version, m_at_tail);
+
     hyperclient_returncode op_status;
 
     if (!value_to_attributes(*cl->m_config, this->sent_to(), NULL, 0,
@@ -121,3 +143,35 @@ hyperclient :: pending_get :: handle_response(hyperclient* cl,
     set_status(HYPERCLIENT_SUCCESS);
     return client_visible_id();
 }
+
+int64_t
+hyperclient :: pending_get :: retry_at_tail(hyperclient* cl)
+{
+    // The replica has not yet committed the version we last read.  The tail
+    // has, so ask it without a version to wait for.
+    hyperdex::region_id ri = cl->m_config->get_region_id(sent_to());
+    hyperdex::virtual_server_id tail = cl->m_config->tail_of_region(ri);
+
+    if (tail == hyperdex::virtual_server_id())
+    {
+        set_status(HYPERCLIENT_RECONFIGURE);
+        return client_visible_id();
+    }
+
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + m_key.size() + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << e::slice(m_key.data(), m_key.size())
+                                              << static_cast<uint64_t>(0);
+    set_server_visible_nonce(cl->m_server_nonce);
+    ++cl->m_server_nonce;
+    set_sent_to(tail);
+    m_at_tail = true;
+
+    if (cl->send(this, msg) < 0)
+    {
+        return client_visible_id();
+    }
+
+    cl->m_incomplete.insert(std::make_pair(server_visible_nonce(), this));
+    return 0;
+}
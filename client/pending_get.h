@@ -28,13 +28,17 @@
 #ifndef hyperdex_client_pending_get_h_
 #define hyperdex_client_pending_get_h_
 
+// STL
+#include <string>
+
 // HyperDex
 #include "client/pending.h"
 
 class hyperclient::pending_get : public hyperclient::pending
 {
     public:
-        pending_get(hyperclient_returncode* status,
+        pending_get(const char* space, const char* key, size_t key_sz,
+                    hyperclient_returncode* status,
                     struct hyperclient_attribute** attrs,
                     size_t* attrs_sz);
         virtual ~pending_get() throw ();
@@ -47,6 +51,9 @@ class hyperclient::pending_get : public hyperclient::pending
                                         hyperdex::network_msgtype type,
                                         hyperclient_returncode* status);
 
+    private:
+        int64_t retry_at_tail(hyperclient* cl);
+
     private:
         pending_get(const pending_get& other);
 
@@ -54,8 +61,12 @@ class hyperclient::pending_get : public hyperclient::pending
         pending_get& operator = (const pending_get& rhs);
 
     private:
+        std::string m_space;
+        std::string m_key;
         hyperclient_attribute** m_attrs;
         size_t* m_attrs_sz;
+        // the request was retried at the tail, whose answer is authoritative
+        bool m_at_tail;
 };
 
 #endif // hyperdex_client_pending_get_h_
@@ -32,9 +32,13 @@
 #include "client/util.h"
 
 hyperclient :: pending_group_del :: pending_group_del(int64_t group_del_id,
+                                                      hyperdex::network_msgtype reqtype,
+                                                      hyperdex::network_msgtype resptype,
                                                       e::intrusive_ptr<refcount> ref,
                                                       hyperclient_returncode* status)
     : pending(status)
+    , m_reqtype(reqtype)
+    , m_resptype(resptype)
     , m_ref(ref)
 {
     this->set_client_visible_id(group_del_id);
@@ -47,7 +51,7 @@ hyperclient :: pending_group_del :: ~pending_group_del() throw ()
 hyperdex::network_msgtype
 hyperclient :: pending_group_del :: request_type()
 {
-    return hyperdex::REQ_GROUP_DEL;
+    return m_reqtype;
 }
 
 int64_t
@@ -59,7 +63,7 @@ hyperclient :: pending_group_del :: handle_response(hyperclient* cl,
 {
     *status = HYPERCLIENT_SUCCESS;
 
-    if (type != hyperdex::RESP_GROUP_DEL)
+    if (type != m_resptype)
     {
         cl->killall(sender, HYPERCLIENT_SERVERERROR);
         return 0;
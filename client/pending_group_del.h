@@ -39,10 +39,14 @@
 #include "client/pending.h"
 #include "client/refcount.h"
 
+// Used for every group operation:  each server reports once when it has
+// dispatched the operation to the objects it found.
 class hyperclient::pending_group_del : public hyperclient::pending
 {
     public:
         pending_group_del(int64_t group_del_id,
+                          hyperdex::network_msgtype reqtype,
+                          hyperdex::network_msgtype resptype,
                           e::intrusive_ptr<refcount> ref,
                           hyperclient_returncode* status);
         virtual ~pending_group_del() throw ();
@@ -62,6 +66,8 @@ class hyperclient::pending_group_del : public hyperclient::pending
         pending_group_del& operator = (const pending_group_del& rhs);
 
     private:
+        hyperdex::network_msgtype m_reqtype;
+        hyperdex::network_msgtype m_resptype;
         e::intrusive_ptr<refcount> m_ref;
 };
 
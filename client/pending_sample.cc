@@ -0,0 +1,306 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "client/constants.h"
+#include "client/complete.h"
+#include "client/pending_sample.h"
+#include "client/util.h"
+
+#ifdef _MSC_VER
+typedef std::shared_ptr<e::buffer> buffer_ptr;
+#else
+typedef std::tr1::shared_ptr<e::buffer> buffer_ptr;
+#endif
+
+class hyperclient::pending_sample::state::item
+{
+    public:
+        item();
+        item(const e::slice& key,
+             const std::vector<e::slice>& value,
+             buffer_ptr backing);
+        item(const item&);
+        ~item() throw ();
+
+    public:
+        item& operator = (const item&);
+
+    public:
+        e::slice key;
+        std::vector<e::slice> value;
+        buffer_ptr backing;
+};
+
+class hyperclient::pending_sample::state::region
+{
+    public:
+        region();
+        ~region() throw ();
+
+    public:
+        // matching objects in the region not yet drawn
+        uint64_t remaining;
+        std::vector<item> items;
+        size_t taken;
+};
+
+hyperclient :: pending_sample :: pending_sample(int64_t sample_id,
+                                                e::intrusive_ptr<state> st,
+                                                hyperclient_returncode* status,
+                                                hyperclient_attribute** attrs,
+                                                size_t* attrs_sz)
+    : pending(status)
+    , m_state(st)
+    , m_attrs(attrs)
+    , m_attrs_sz(attrs_sz)
+{
+    this->set_client_visible_id(sample_id);
+}
+
+hyperclient :: pending_sample :: ~pending_sample() throw ()
+{
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_sample :: request_type()
+{
+    return hyperdex::REQ_SAMPLE;
+}
+
+int64_t
+hyperclient :: pending_sample :: handle_response(hyperclient* cl,
+                                                 const server_id& sender,
+                                                 std::auto_ptr<e::buffer> msg,
+                                                 hyperdex::network_msgtype type,
+                                                 hyperclient_returncode* status)
+{
+    assert(m_state->m_ref > 0);
+    *status = HYPERCLIENT_SUCCESS;
+
+    if (type != hyperdex::RESP_SAMPLE)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    uint64_t seen = 0;
+    uint64_t seed = 0;
+    uint64_t num_results = 0;
+    up = up >> seen >> seed >> num_results;
+    buffer_ptr backing(msg.release());
+    state::region r;
+    r.remaining = seen;
+
+    for (uint64_t i = 0; !up.error() && i < num_results; ++i)
+    {
+        e::slice key;
+        std::vector<e::slice> value;
+        up = up >> key >> value;
+        r.items.push_back(state::item(key, value, backing));
+    }
+
+    if (up.error() || r.items.size() != std::min(m_state->m_n, seen))
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    m_state->m_seed ^= seed;
+    m_state->m_regions.push_back(r);
+
+    if (m_state->m_ref == 1)
+    {
+        m_state->merge();
+
+        for (size_t i = 0; i < m_state->m_results.size(); ++i)
+        {
+            int64_t nonce = cl->m_server_nonce;
+            cl->m_incomplete.insert(std::make_pair(nonce, this));
+            cl->m_complete_succeeded.push(nonce);
+            ++cl->m_server_nonce;
+        }
+
+        if (m_state->m_results.empty())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+    }
+
+    return 0;
+}
+
+int64_t
+hyperclient :: pending_sample :: return_one(hyperclient* cl,
+                                            hyperclient_returncode* status)
+{
+    assert(m_state->m_returned < m_state->m_results.size());
+    hyperclient_returncode op_status;
+    state::item& it(m_state->m_results[m_state->m_returned]);
+
+    if (value_to_attributes(*cl->m_config, this->sent_to(), it.key.data(), it.key.size(),
+                            it.value, status, &op_status, m_attrs, m_attrs_sz))
+    {
+        set_status(HYPERCLIENT_SUCCESS);
+    }
+    else
+    {
+        set_status(op_status);
+    }
+
+    ++m_state->m_returned;
+
+    if (m_state->m_returned == m_state->m_results.size())
+    {
+#ifdef _MSC_VER
+        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+    }
+
+    return client_visible_id();
+}
+
+hyperclient :: pending_sample :: state :: item :: item()
+    : key()
+    , value()
+    , backing()
+{
+}
+
+hyperclient :: pending_sample :: state :: item :: item(const e::slice& _key,
+                                                       const std::vector<e::slice>& _value,
+                                                       buffer_ptr _backing)
+    : key(_key)
+    , value(_value)
+    , backing(_backing)
+{
+}
+
+hyperclient :: pending_sample :: state :: item :: item(const item& other)
+    : key(other.key)
+    , value(other.value)
+    , backing(other.backing)
+{
+}
+
+hyperclient :: pending_sample :: state :: item :: ~item() throw ()
+{
+}
+
+hyperclient::pending_sample::state::item&
+hyperclient :: pending_sample :: state :: item :: operator = (const item& other)
+{
+    key = other.key;
+    value = other.value;
+    backing = other.backing;
+    return *this;
+}
+
+hyperclient :: pending_sample :: state :: region :: region()
+    : remaining(0)
+    , items()
+    , taken(0)
+{
+}
+
+hyperclient :: pending_sample :: state :: region :: ~region() throw ()
+{
+}
+
+hyperclient :: pending_sample :: state :: state(uint64_t n)
+    : m_ref(0)
+    , m_n(n)
+    , m_seed(0)
+    , m_regions()
+    , m_results()
+    , m_returned(0)
+{
+}
+
+hyperclient :: pending_sample :: state :: ~state() throw ()
+{
+}
+
+uint64_t
+hyperclient :: pending_sample :: state :: random()
+{
+    // xorshift64*; the seed combines the servers' random seeds
+    if (m_seed == 0)
+    {
+        m_seed = 0x9e3779b97f4a7c15ULL;
+    }
+
+    m_seed ^= m_seed >> 12;
+    m_seed ^= m_seed << 25;
+    m_seed ^= m_seed >> 27;
+    return m_seed * 2685821657736338717ULL;
+}
+
+void
+hyperclient :: pending_sample :: state :: merge()
+{
+    uint64_t remaining = 0;
+
+    for (size_t i = 0; i < m_regions.size(); ++i)
+    {
+        remaining += m_regions[i].remaining;
+    }
+
+    // Draw without replacement:  pick a region with probability proportional
+    // to its undrawn objects, then a random undrawn item from its sample.  A
+    // region's sample holds min(n, seen) items, so it never runs dry first.
+    while (m_results.size() < m_n && remaining > 0)
+    {
+        uint64_t r = random() % remaining;
+        size_t idx = 0;
+
+        while (r >= m_regions[idx].remaining)
+        {
+            r -= m_regions[idx].remaining;
+            ++idx;
+        }
+
+        region& reg(m_regions[idx]);
+        assert(reg.taken < reg.items.size());
+        size_t pick = reg.taken + random() % (reg.items.size() - reg.taken);
+        std::swap(reg.items[reg.taken], reg.items[pick]);
+        m_results.push_back(reg.items[reg.taken]);
+        ++reg.taken;
+        --reg.remaining;
+        --remaining;
+    }
+}
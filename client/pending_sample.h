@@ -0,0 +1,114 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_client_pending_sample_h_
+#define hyperdex_client_pending_sample_h_
+
+// STL
+#include <vector>
+#ifdef _MSC_VER
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+// HyperDex
+#include "client/pending.h"
+
+class hyperclient::pending_sample : public hyperclient::pending
+{
+    public:
+        class state;
+
+    public:
+        pending_sample(int64_t sample_id,
+                       e::intrusive_ptr<state> st,
+                       hyperclient_returncode* status,
+                       hyperclient_attribute** attrs,
+                       size_t* attrs_sz);
+        virtual ~pending_sample() throw ();
+
+    public:
+        virtual hyperdex::network_msgtype request_type();
+        virtual int64_t handle_response(hyperclient* cl,
+                                        const server_id& id,
+                                        std::auto_ptr<e::buffer> msg,
+                                        hyperdex::network_msgtype type,
+                                        hyperclient_returncode* status);
+        virtual int64_t return_one(hyperclient* cl,
+                                   hyperclient_returncode* status);
+
+    private:
+        pending_sample(const pending_sample& other);
+
+    private:
+        pending_sample& operator = (const pending_sample& rhs);
+
+    private:
+        e::intrusive_ptr<state> m_state;
+        hyperclient_attribute** m_attrs;
+        size_t* m_attrs_sz;
+};
+
+// Each server returns a uniform sample of its region along with the number of
+// objects it sampled from.  Once every region has answered, the state draws
+// from the regions in proportion to those numbers, which makes the combined
+// sample uniform over the whole space.
+class hyperclient::pending_sample::state
+{
+    public:
+        state(uint64_t n);
+        ~state() throw ();
+
+    private:
+        friend class e::intrusive_ptr<hyperclient::pending_sample::state>;
+        friend class hyperclient::pending_sample;
+        class item;
+        class region;
+
+    private:
+        state(const state&);
+
+    private:
+        void inc() { ++m_ref; }
+        void dec() { if (--m_ref == 0) delete this; }
+        uint64_t random();
+        void merge();
+
+    private:
+        state& operator = (const state&);
+
+    private:
+        size_t m_ref;
+        const uint64_t m_n;
+        uint64_t m_seed;
+        std::vector<region> m_regions;
+        std::vector<item> m_results;
+        size_t m_returned;
+};
+
+#endif // hyperdex_client_pending_sample_h_
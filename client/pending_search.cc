@@ -29,6 +29,7 @@
 #include <e/guard.h>
 
 // HyperDex
+#include "common/network_returncode.h"
 #include "client/constants.h"
 #include "client/complete.h"
 #include "client/pending_search.h"
@@ -77,6 +78,30 @@ hyperclient :: pending_search :: handle_response(hyperclient* cl,
     // If it is a SEARCH_DONE message.
     if (type == hyperdex::RESP_SEARCH_DONE)
     {
+        e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+        uint16_t response = static_cast<uint16_t>(hyperdex::NET_SUCCESS);
+
+        if (up.remain() >= sizeof(uint16_t))
+        {
+            up = up >> response;
+        }
+
+        if (static_cast<hyperdex::network_returncode>(response) == hyperdex::NET_BADSEARCH)
+        {
+            set_status(HYPERCLIENT_BADSEARCH);
+
+            if (m_ref->last_reference())
+            {
+#ifdef _MSC_VER
+                cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+                cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+            }
+
+            return client_visible_id();
+        }
+
         if (m_ref->last_reference())
         {
             set_status(HYPERCLIENT_SEARCHDONE);
@@ -27,9 +27,6 @@
 
 // STL
 #include <algorithm>
-#ifdef _MSC_VER
-#include <functional>
-#endif
 
 // e
 #include <e/endian.h>
@@ -41,13 +38,20 @@
 #include "client/pending_sorted_search.h"
 #include "client/util.h"
 
+#ifdef _MSC_VER
+typedef std::shared_ptr<e::buffer> buffer_ptr;
+#else
+typedef std::tr1::shared_ptr<e::buffer> buffer_ptr;
+#endif
+
 class hyperclient::pending_sorted_search::state::item
 {
     public:
         item();
         item(pending_sorted_search::state* st,
              const e::slice& key,
-             const std::vector<e::slice>& value);
+             const std::vector<e::slice>& value,
+             buffer_ptr backing);
         item(const item&);
         ~item() throw ();
 
@@ -60,19 +64,42 @@ class hyperclient::pending_sorted_search::state::item
         pending_sorted_search::state* st;
         e::slice key;
         std::vector<e::slice> value;
+        // keeps the batch alive until its last item is returned
+        buffer_ptr backing;
+};
+
+class hyperclient::pending_sorted_search::state::stream
+{
+    public:
+        stream(const hyperdex::virtual_server_id& server);
+        ~stream() throw ();
+
+    public:
+        bool ready() const { return !items.empty() || !more; }
+
+    public:
+        hyperdex::virtual_server_id server;
+        std::deque<item> items;
+        bool more;
+        bool waiting;
 };
 
 hyperclient :: pending_sorted_search :: pending_sorted_search(int64_t searchid,
                                                               e::intrusive_ptr<state> st,
+                                                              size_t stream,
+                                                              hyperdex::network_msgtype reqtype,
                                                               hyperclient_returncode* status,
                                                               hyperclient_attribute** attrs,
                                                               size_t* attrs_sz)
     : pending(status)
+    , m_reqtype(reqtype)
     , m_state(st)
+    , m_stream(stream)
     , m_attrs(attrs)
     , m_attrs_sz(attrs_sz)
 {
     this->set_client_visible_id(searchid);
+    this->set_sent_to(m_state->m_streams[m_stream].server);
 }
 
 hyperclient :: pending_sorted_search :: ~pending_sorted_search() throw ()
@@ -82,7 +109,7 @@ hyperclient :: pending_sorted_search :: ~pending_sorted_search() throw ()
 hyperdex::network_msgtype
 hyperclient :: pending_sorted_search :: request_type()
 {
-    return hyperdex::REQ_SORTED_SEARCH;
+    return m_reqtype;
 }
 
 int64_t
@@ -94,70 +121,54 @@ hyperclient :: pending_sorted_search :: handle_response(hyperclient* cl,
 {
     assert(m_state->m_ref > 0);
     *status = HYPERCLIENT_SUCCESS;
+    state::stream& s(m_state->m_streams[m_stream]);
+    s.waiting = false;
+    uint8_t flags = 0;
+    uint64_t num_results = 0;
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    up = up >> flags >> num_results;
+    buffer_ptr backing(msg.release());
+    std::deque<state::item> items;
 
-    if (type != hyperdex::RESP_SORTED_SEARCH)
+    for (uint64_t i = 0; !up.error() && i < num_results; ++i)
     {
-        cl->killall(sender, HYPERCLIENT_SERVERERROR);
-        return 0;
+        e::slice key;
+        std::vector<e::slice> value;
+        up = up >> key >> value;
+        items.push_back(state::item(m_state.get(), key, value, backing));
     }
 
-    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
-    uint64_t num_results = 0;
-    up = up >> num_results;
-
-    if (up.error())
+    if (type != hyperdex::RESP_SORTED_SEARCH || up.error())
     {
+        // treat the stream as exhausted, and let the others finish
+        s.more = false;
         cl->killall(sender, HYPERCLIENT_SERVERERROR);
-        return 0;
+#ifdef _MSC_VER
+        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SERVERERROR, 0)));
+#else
+        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SERVERERROR, 0));
+#endif
     }
-
-    for (uint64_t i = 0; i < num_results; ++i)
+    else if (m_state->m_done)
     {
-        e::slice key;
-        std::vector<e::slice> value;
-        up = up >> key >> value;
+        // we already have enough results; release the server's state
+        s.more = flags & 1;
 
-        if (up.error())
+        if (s.more)
         {
-            cl->killall(sender, HYPERCLIENT_SERVERERROR);
-            return 0;
+            request(cl, m_stream, hyperdex::REQ_SORTED_SEARCH_STOP);
         }
 
-        m_state->m_results.push_back(state::item(m_state.get(), key, value));
-        std::push_heap(m_state->m_results.begin(), m_state->m_results.end());
-
-        if (m_state->m_results.size() > m_state->m_limit)
-        {
-            std::pop_heap(m_state->m_results.begin(), m_state->m_results.end());
-            m_state->m_results.pop_back();
-        }
+        s.more = false;
     }
-
-    m_state->m_backings[m_state->m_backing_idx] = msg;
-    ++m_state->m_backing_idx;
-
-    if (m_state->m_ref == 1)
+    else
     {
-        std::sort(m_state->m_results.begin(), m_state->m_results.end(), std::greater<state::item>());
-
-        for (size_t i = 0; i < m_state->m_results.size(); ++i)
-        {
-            int64_t nonce = cl->m_server_nonce;
-            cl->m_incomplete.insert(std::make_pair(nonce, this));
-            cl->m_complete_succeeded.push(nonce);
-            ++cl->m_server_nonce;
-        }
-
-        if (m_state->m_results.empty())
-        {
-#ifdef _MSC_VER
-            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
-#else
-            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
-#endif
-        }
+        s.items.swap(items);
+        s.more = flags & 1;
     }
 
+    merge(cl);
+    maybe_done(cl);
     return 0;
 }
 
@@ -165,13 +176,13 @@ int64_t
 hyperclient :: pending_sorted_search :: return_one(hyperclient* cl,
                                                    hyperclient_returncode* status)
 {
-    assert(m_state->m_returned < m_state->m_results.size());
+    assert(!m_state->m_results.empty());
     hyperclient_returncode op_status;
-    e::slice& key(m_state->m_results[m_state->m_returned].key);
-    std::vector<e::slice>& value(m_state->m_results[m_state->m_returned].value);
+    state::item it(m_state->m_results.front());
+    m_state->m_results.pop();
 
-    if (value_to_attributes(*cl->m_config, this->sent_to(), key.data(), key.size(),
-                            value, status, &op_status, m_attrs, m_attrs_sz))
+    if (value_to_attributes(*cl->m_config, this->sent_to(), it.key.data(), it.key.size(),
+                            it.value, status, &op_status, m_attrs, m_attrs_sz))
     {
         set_status(HYPERCLIENT_SUCCESS);
     }
@@ -180,33 +191,149 @@ hyperclient :: pending_sorted_search :: return_one(hyperclient* cl,
         set_status(op_status);
     }
 
-    ++m_state->m_returned;
+    maybe_done(cl);
+    return client_visible_id();
+}
+
+void
+hyperclient :: pending_sorted_search :: merge(hyperclient* cl)
+{
+    while (!m_state->m_done)
+    {
+        size_t best = m_state->m_streams.size();
+        bool ready = true;
+
+        for (size_t i = 0; i < m_state->m_streams.size(); ++i)
+        {
+            state::stream& s(m_state->m_streams[i]);
+
+            if (!s.ready())
+            {
+                if (!s.waiting)
+                {
+                    request(cl, i, hyperdex::REQ_SORTED_SEARCH_NEXT);
+                }
+
+                ready = ready && s.ready();
+                continue;
+            }
+
+            if (!s.items.empty() &&
+                (best == m_state->m_streams.size() ||
+                 s.items.front() > m_state->m_streams[best].items.front()))
+            {
+                best = i;
+            }
+        }
+
+        if (m_state->m_merged == m_state->m_limit ||
+            (ready && best == m_state->m_streams.size()))
+        {
+            m_state->m_done = true;
+
+            for (size_t i = 0; i < m_state->m_streams.size(); ++i)
+            {
+                state::stream& s(m_state->m_streams[i]);
+                s.items.clear();
+
+                if (s.more && !s.waiting)
+                {
+                    request(cl, i, hyperdex::REQ_SORTED_SEARCH_STOP);
+                    s.more = false;
+                }
+            }
+
+            break;
+        }
+
+        if (!ready)
+        {
+            break;
+        }
+
+        m_state->m_results.push(m_state->m_streams[best].items.front());
+        m_state->m_streams[best].items.pop_front();
+        ++m_state->m_merged;
+        int64_t nonce = cl->m_server_nonce;
+        ++cl->m_server_nonce;
+        cl->m_incomplete.insert(std::make_pair(nonce, this));
+        cl->m_complete_succeeded.push(nonce);
+    }
+}
 
-    if (m_state->m_returned == m_state->m_results.size())
+void
+hyperclient :: pending_sorted_search :: request(hyperclient* cl,
+                                                size_t stream,
+                                                hyperdex::network_msgtype reqtype)
+{
+    state::stream& s(m_state->m_streams[stream]);
+    e::intrusive_ptr<pending> op = new pending_sorted_search(client_visible_id(), m_state,
+                                                             stream, reqtype, status_ptr(),
+                                                             m_attrs, m_attrs_sz);
+    op->set_server_visible_nonce(cl->m_server_nonce);
+    ++cl->m_server_nonce;
+    std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint64_t)));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(client_visible_id());
+
+    if (cl->send(op, msg) < 0)
     {
+        s.more = false;
 #ifdef _MSC_VER
-        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_RECONFIGURE, 0)));
 #else
-        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_RECONFIGURE, 0));
 #endif
+        return;
     }
 
-    return client_visible_id();
+    // the server does not respond to a stop
+    if (reqtype == hyperdex::REQ_SORTED_SEARCH_NEXT)
+    {
+        s.waiting = true;
+        cl->m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+    }
+}
+
+void
+hyperclient :: pending_sorted_search :: maybe_done(hyperclient* cl)
+{
+    if (!m_state->m_done || m_state->m_reported_done || !m_state->m_results.empty())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < m_state->m_streams.size(); ++i)
+    {
+        if (m_state->m_streams[i].waiting)
+        {
+            return;
+        }
+    }
+
+    m_state->m_reported_done = true;
+#ifdef _MSC_VER
+    cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+    cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
 }
 
 hyperclient :: pending_sorted_search :: state :: item :: item()
     : st(NULL)
     , key()
     , value()
+    , backing()
 {
 }
 
 hyperclient :: pending_sorted_search :: state :: item :: item(pending_sorted_search::state* _st,
                                                               const e::slice& _key,
-                                                              const std::vector<e::slice>& _value)
+                                                              const std::vector<e::slice>& _value,
+                                                              buffer_ptr _backing)
     : st(_st)
     , key(_key)
     , value(_value)
+    , backing(_backing)
 {
 }
 
@@ -214,6 +341,7 @@ hyperclient :: pending_sorted_search :: state :: item :: item(const item& other)
     : st(other.st)
     , key(other.key)
     , value(other.value)
+    , backing(other.backing)
 {
 }
 
@@ -227,6 +355,7 @@ hyperclient :: pending_sorted_search :: state :: item :: operator = (const item&
     st = other.st;
     key = other.key;
     value = other.value;
+    backing = other.backing;
     return *this;
 }
 
@@ -286,7 +415,19 @@ hyperclient :: pending_sorted_search :: state :: item :: operator > (const item&
     }
 }
 
-hyperclient :: pending_sorted_search :: state :: state(std::auto_ptr<e::buffer>* backings,
+hyperclient :: pending_sorted_search :: state :: stream :: stream(const hyperdex::virtual_server_id& _server)
+    : server(_server)
+    , items()
+    , more(true)
+    , waiting(true)
+{
+}
+
+hyperclient :: pending_sorted_search :: state :: stream :: ~stream() throw ()
+{
+}
+
+hyperclient :: pending_sorted_search :: state :: state(const std::vector<hyperdex::virtual_server_id>& servers,
                                                        uint64_t _limit,
                                                        uint16_t _sort_by,
                                                        hyperdatatype type,
@@ -296,17 +437,26 @@ hyperclient :: pending_sorted_search :: state :: state(std::auto_ptr<e::buffer>*
     , m_sort_by(_sort_by)
     , m_sort_type(type)
     , m_maximize(maximize)
+    , m_streams()
     , m_results()
-    , m_backings(backings)
-    , m_backing_idx(0)
-    , m_returned(0)
+    , m_merged(0)
+    , m_done(false)
+    , m_reported_done(false)
 {
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        m_streams.push_back(stream(servers[i]));
+    }
 }
 
 hyperclient :: pending_sorted_search :: state :: ~state() throw ()
 {
-    if (m_backings)
-    {
-        delete[] m_backings;
-    }
+}
+
+void
+hyperclient :: pending_sorted_search :: state :: fail_stream(size_t idx)
+{
+    assert(idx < m_streams.size());
+    m_streams[idx].more = false;
+    m_streams[idx].waiting = false;
 }
@@ -29,6 +29,8 @@
 #define hyperdex_client_pending_sorted_search_h_
 
 // STL
+#include <deque>
+#include <queue>
 #ifdef _MSC_VER
 #include <memory>
 #else
@@ -46,6 +48,8 @@ class hyperclient::pending_sorted_search : public hyperclient::pending
     public:
         pending_sorted_search(int64_t searchid,
                               e::intrusive_ptr<state> st,
+                              size_t stream,
+                              hyperdex::network_msgtype reqtype,
                               hyperclient_returncode* status,
                               hyperclient_attribute** attrs,
                               size_t* attrs_sz);
@@ -68,23 +72,39 @@ class hyperclient::pending_sorted_search : public hyperclient::pending
         pending_sorted_search& operator = (const pending_sorted_search& rhs);
 
     private:
+        // move results into the output queue while every stream has one
+        void merge(hyperclient* cl);
+        // ask a stream's server for its next (or no more) batch
+        void request(hyperclient* cl, size_t stream, hyperdex::network_msgtype reqtype);
+        void maybe_done(hyperclient* cl);
+
+    private:
+        hyperdex::network_msgtype m_reqtype;
         e::intrusive_ptr<state> m_state;
+        size_t m_stream;
         hyperclient_attribute** m_attrs;
         size_t* m_attrs_sz;
 };
 
+// Each server streams its top results in ordered batches.  The state merges
+// the streams incrementally, holding at most one batch per server.
 class hyperclient::pending_sorted_search::state
 {
     public:
-        state(std::auto_ptr<e::buffer>* backings,
+        state(const std::vector<hyperdex::virtual_server_id>& servers,
               uint64_t limit, uint16_t sort_by,
               hyperdatatype type, bool maximize);
         ~state() throw ();
 
+    public:
+        // the request to the stream's server could not be sent
+        void fail_stream(size_t stream);
+
     private:
         friend class e::intrusive_ptr<hyperclient::pending_sorted_search::state>;
         friend class hyperclient::pending_sorted_search;
         class item;
+        class stream;
 
     private:
         state(const state&);
@@ -102,10 +122,11 @@ class hyperclient::pending_sorted_search::state
         const uint16_t m_sort_by;
         hyperdatatype m_sort_type;
         bool m_maximize;
-        std::vector<item> m_results;
-        std::auto_ptr<e::buffer>* m_backings;
-        size_t m_backing_idx;
-        size_t m_returned;
+        std::vector<stream> m_streams;
+        std::queue<item> m_results;
+        uint64_t m_merged;
+        bool m_done;
+        bool m_reported_done;
 };
 
 #endif // hyperdex_client_pending_sorted_search_h_
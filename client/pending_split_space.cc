@@ -0,0 +1,234 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "common/configuration.h"
+#include "client/constants.h"
+#include "client/complete.h"
+#include "client/pending_split_space.h"
+
+// A token is the region id followed by the lower and upper bounds of the
+// range, each prefixed by its length.  An empty bound is unbounded.
+static std::string
+encode_token(const hyperdex::region_id& ri,
+             const e::slice& lower,
+             const e::slice& upper)
+{
+    std::string token(sizeof(uint64_t) + 2 * sizeof(uint32_t)
+                      + lower.size() + upper.size(), '\0');
+    char* ptr = &token[0];
+    ptr = e::pack64be(ri.get(), ptr);
+    ptr = e::pack32be(lower.size(), ptr);
+    memmove(ptr, lower.data(), lower.size());
+    ptr += lower.size();
+    ptr = e::pack32be(upper.size(), ptr);
+    memmove(ptr, upper.data(), upper.size());
+    return token;
+}
+
+hyperclient :: pending_split_space :: pending_split_space(int64_t split_id,
+                                                          e::intrusive_ptr<state> st,
+                                                          hyperclient_returncode* status,
+                                                          char** split,
+                                                          size_t* split_sz)
+    : pending(status)
+    , m_state(st)
+    , m_split(split)
+    , m_split_sz(split_sz)
+{
+    this->set_client_visible_id(split_id);
+}
+
+hyperclient :: pending_split_space :: ~pending_split_space() throw ()
+{
+}
+
+bool
+hyperclient :: pending_split_space :: parse(const char* split, size_t split_sz,
+                                            hyperdex::region_id* ri,
+                                            e::slice* lower,
+                                            e::slice* upper)
+{
+    const char* ptr = split;
+    const char* end = split + split_sz;
+    uint64_t region;
+    uint32_t lower_sz;
+    uint32_t upper_sz;
+
+    if (static_cast<size_t>(end - ptr) < sizeof(uint64_t) + sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    ptr = e::unpack64be(ptr, &region);
+    ptr = e::unpack32be(ptr, &lower_sz);
+
+    if (static_cast<size_t>(end - ptr) < lower_sz + sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    *lower = e::slice(ptr, lower_sz);
+    ptr = e::unpack32be(ptr + lower_sz, &upper_sz);
+
+    if (static_cast<size_t>(end - ptr) != upper_sz)
+    {
+        return false;
+    }
+
+    *upper = e::slice(ptr, upper_sz);
+    *ri = hyperdex::region_id(region);
+    return true;
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_split_space :: request_type()
+{
+    return hyperdex::REQ_SEARCH_SPLITS;
+}
+
+int64_t
+hyperclient :: pending_split_space :: handle_response(hyperclient* cl,
+                                                      const server_id& sender,
+                                                      std::auto_ptr<e::buffer> msg,
+                                                      hyperdex::network_msgtype type,
+                                                      hyperclient_returncode* status)
+{
+    assert(m_state->m_ref > 0);
+    *status = HYPERCLIENT_SUCCESS;
+
+    if (type != hyperdex::RESP_SEARCH_SPLITS)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    uint64_t region = 0;
+    std::vector<e::slice> splits;
+    up = up >> region >> splits;
+
+    if (up.error() || cl->m_config->get_region_id(sent_to()).get() != region)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    m_state->add_region(hyperdex::region_id(region), splits);
+
+    if (m_state->m_ref == 1)
+    {
+        for (size_t i = 0; i < m_state->m_tokens.size(); ++i)
+        {
+            int64_t nonce = cl->m_server_nonce;
+            cl->m_incomplete.insert(std::make_pair(nonce, this));
+            cl->m_complete_succeeded.push(nonce);
+            ++cl->m_server_nonce;
+        }
+
+        if (m_state->m_tokens.empty())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+    }
+
+    return 0;
+}
+
+int64_t
+hyperclient :: pending_split_space :: return_one(hyperclient* cl,
+                                                 hyperclient_returncode* status)
+{
+    assert(m_state->m_returned < m_state->m_tokens.size());
+    *status = HYPERCLIENT_SUCCESS;
+    const std::string& token(m_state->m_tokens[m_state->m_returned]);
+    // the state goes away with the last token, so the caller gets a copy
+    char* ret = static_cast<char*>(malloc(token.size()));
+
+    if (ret)
+    {
+        memmove(ret, token.data(), token.size());
+        *m_split = ret;
+        *m_split_sz = token.size();
+        set_status(HYPERCLIENT_SUCCESS);
+    }
+    else
+    {
+        set_status(HYPERCLIENT_NOMEM);
+    }
+
+    ++m_state->m_returned;
+
+    if (m_state->m_returned == m_state->m_tokens.size())
+    {
+#ifdef _MSC_VER
+        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+    }
+
+    return client_visible_id();
+}
+
+hyperclient :: pending_split_space :: state :: state()
+    : m_ref(0)
+    , m_tokens()
+    , m_returned(0)
+{
+}
+
+hyperclient :: pending_split_space :: state :: ~state() throw ()
+{
+}
+
+void
+hyperclient :: pending_split_space :: state :: add_region(const hyperdex::region_id& ri,
+                                                          const std::vector<e::slice>& splits)
+{
+    e::slice lower;
+
+    for (size_t i = 0; i < splits.size(); ++i)
+    {
+        m_tokens.push_back(encode_token(ri, lower, splits[i]));
+        lower = splits[i];
+    }
+
+    m_tokens.push_back(encode_token(ri, lower, e::slice()));
+}
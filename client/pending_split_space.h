@@ -0,0 +1,114 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_client_pending_split_space_h_
+#define hyperdex_client_pending_split_space_h_
+
+// STL
+#include <string>
+#include <vector>
+
+// HyperDex
+#include "common/ids.h"
+#include "client/pending.h"
+
+// Each region answers with keys that divide it into ranges of roughly equal
+// size.  Once every region has answered, each range is returned as a separate
+// result, encoded as a token that "search_split" accepts.
+class hyperclient::pending_split_space : public hyperclient::pending
+{
+    public:
+        class state;
+
+    public:
+        pending_split_space(int64_t split_id,
+                            e::intrusive_ptr<state> st,
+                            hyperclient_returncode* status,
+                            char** split,
+                            size_t* split_sz);
+        virtual ~pending_split_space() throw ();
+
+    public:
+        // false if "split" is not a token produced by this class
+        static bool parse(const char* split, size_t split_sz,
+                          hyperdex::region_id* ri,
+                          e::slice* lower,
+                          e::slice* upper);
+
+    public:
+        virtual hyperdex::network_msgtype request_type();
+        virtual int64_t handle_response(hyperclient* cl,
+                                        const server_id& id,
+                                        std::auto_ptr<e::buffer> msg,
+                                        hyperdex::network_msgtype type,
+                                        hyperclient_returncode* status);
+        virtual int64_t return_one(hyperclient* cl,
+                                   hyperclient_returncode* status);
+
+    private:
+        pending_split_space(const pending_split_space& other);
+
+    private:
+        pending_split_space& operator = (const pending_split_space& rhs);
+
+    private:
+        e::intrusive_ptr<state> m_state;
+        char** m_split;
+        size_t* m_split_sz;
+};
+
+class hyperclient::pending_split_space::state
+{
+    public:
+        state();
+        ~state() throw ();
+
+    private:
+        friend class e::intrusive_ptr<hyperclient::pending_split_space::state>;
+        friend class hyperclient::pending_split_space;
+
+    private:
+        state(const state&);
+
+    private:
+        void inc() { ++m_ref; }
+        void dec() { if (--m_ref == 0) delete this; }
+        // append the tokens for the ranges of "ri" delimited by "splits"
+        void add_region(const hyperdex::region_id& ri,
+                        const std::vector<e::slice>& splits);
+
+    private:
+        state& operator = (const state&);
+
+    private:
+        size_t m_ref;
+        std::vector<std::string> m_tokens;
+        size_t m_returned;
+};
+
+#endif // hyperdex_client_pending_split_space_h_
@@ -0,0 +1,367 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// e
+#include <e/endian.h>
+#include <e/guard.h>
+
+// HyperDex
+#include "common/serialization.h"
+#include "common/subscription.h"
+#include "client/constants.h"
+#include "client/complete.h"
+#include "client/pending_subscribe.h"
+#include "client/util.h"
+
+hyperclient :: pending_subscribe :: pending_subscribe(int64_t sub_id,
+                                                      const hyperdex::region_id& region,
+                                                      e::intrusive_ptr<state> st,
+                                                      hyperclient_returncode* status,
+                                                      hyperclient_attribute** attrs,
+                                                      size_t* attrs_sz)
+    : pending(status)
+    , m_sub_id(sub_id)
+    , m_region(region)
+    , m_reqtype(hyperdex::REQ_SUBSCRIBE)
+    , m_state(st)
+    , m_attrs(attrs)
+    , m_attrs_sz(attrs_sz)
+{
+    this->set_client_visible_id(sub_id);
+}
+
+hyperclient :: pending_subscribe :: ~pending_subscribe() throw ()
+{
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_subscribe :: request_type()
+{
+    return m_reqtype;
+}
+
+int64_t
+hyperclient :: pending_subscribe :: handle_response(hyperclient* cl,
+                                                    const hyperdex::server_id& sender,
+                                                    std::auto_ptr<e::buffer> msg,
+                                                    hyperdex::network_msgtype type,
+                                                    hyperclient_returncode* status)
+{
+    *status = HYPERCLIENT_SUCCESS;
+
+    if (type != hyperdex::RESP_SUBSCRIBE_ITEM && type != hyperdex::RESP_SUBSCRIBE_DONE)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    // If it is a SUBSCRIBE_DONE message, this region has been unsubscribed.
+    if (type == hyperdex::RESP_SUBSCRIBE_DONE)
+    {
+        if (m_state->last_reference())
+        {
+            set_status(HYPERCLIENT_SEARCHDONE);
+            return client_visible_id();
+        }
+
+        return 0;
+    }
+
+    uint64_t incarnation;
+    uint64_t seq;
+    uint8_t ev;
+    uint64_t version;
+    e::slice key;
+    std::vector<e::slice> value;
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    up = up >> incarnation >> seq >> ev >> version >> key >> value;
+
+    if (up.error() || ev > hyperdex::SUBSCRIPTION_POSITION)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+
+        if (m_state->last_reference())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+
+        return 0;
+    }
+
+    // The answer crossed paths with an unsubscribe.  Leave the cursor
+    // pointing before the change so that it is not lost to a later resume.
+    if (m_state->stopped())
+    {
+        if (m_state->last_reference())
+        {
+            set_status(HYPERCLIENT_SEARCHDONE);
+            return client_visible_id();
+        }
+
+        return 0;
+    }
+
+    m_state->advance(m_region, incarnation, seq);
+    hyperdex::subscription_event event = static_cast<hyperdex::subscription_event>(ev);
+    bool has_attrs = event == hyperdex::SUBSCRIPTION_MATCH ||
+                     event == hyperdex::SUBSCRIPTION_LEAVE;
+
+    if (has_attrs)
+    {
+        hyperclient_returncode op_status;
+
+        if (!value_to_attributes(*cl->m_config, this->sent_to(), key.data(), key.size(),
+                                 value, status, &op_status, m_attrs, m_attrs_sz))
+        {
+            set_status(op_status);
+
+            if (m_state->last_reference())
+            {
+#ifdef _MSC_VER
+                cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+                cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+            }
+
+            return client_visible_id();
+        }
+    }
+
+    e::guard g = e::makeguard(hyperclient_destroy_attrs, *m_attrs, *m_attrs_sz);
+
+    if (!has_attrs)
+    {
+        g.dismiss();
+    }
+
+    if (poll(cl) < 0)
+    {
+        cl->killall(sender, HYPERCLIENT_RECONFIGURE);
+
+        if (m_state->last_reference())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+
+        return 0;
+    }
+
+    g.dismiss();
+
+    switch (event)
+    {
+        case hyperdex::SUBSCRIPTION_MATCH:
+            set_status(HYPERCLIENT_SUCCESS);
+            return client_visible_id();
+        case hyperdex::SUBSCRIPTION_LEAVE:
+            set_status(HYPERCLIENT_NOTFOUND);
+            return client_visible_id();
+        case hyperdex::SUBSCRIPTION_GAP:
+            set_status(HYPERCLIENT_OVERFLOW);
+            return client_visible_id();
+        case hyperdex::SUBSCRIPTION_POSITION:
+            // nothing to report; the new position is in the cursor
+            return 0;
+        default:
+            abort();
+    }
+}
+
+int64_t
+hyperclient :: pending_subscribe :: poll(hyperclient* cl)
+{
+    uint64_t incarnation;
+    uint64_t seq;
+    m_state->position(m_region, &incarnation, &seq);
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + sizeof(uint64_t)
+              + pack_size(m_state->checks())
+              + sizeof(uint64_t)
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(m_sub_id)
+                                              << m_state->checks()
+                                              << incarnation << seq;
+    set_server_visible_nonce(cl->m_server_nonce);
+    ++cl->m_server_nonce;
+    m_reqtype = hyperdex::REQ_SUBSCRIBE;
+
+    if (cl->send(this, msg) < 0)
+    {
+        return -1;
+    }
+
+    cl->m_incomplete.insert(std::make_pair(server_visible_nonce(), this));
+    return 0;
+}
+
+void
+hyperclient :: pending_subscribe :: stop(hyperclient* cl)
+{
+    m_state->set_stopped();
+    std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint64_t)));
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(m_sub_id);
+    // The server answers the outstanding poll, so the nonce stays the same.
+    m_reqtype = hyperdex::REQ_SUBSCRIBE_STOP;
+    cl->send(this, msg);
+    m_reqtype = hyperdex::REQ_SUBSCRIBE;
+}
+
+///////////////////////////////////// State ////////////////////////////////////
+
+hyperclient :: pending_subscribe :: state :: state(const std::vector<hyperdex::attribute_check>& checks,
+                                                   const char** cursor, size_t* cursor_sz)
+    : m_ref(0)
+    , m_stopped(false)
+    , m_backing(e::buffer::create(pack_size(checks)))
+    , m_checks()
+    , m_positions()
+    , m_cursor()
+    , m_cursor_out(cursor)
+    , m_cursor_sz_out(cursor_sz)
+{
+    // the caller's checks point into memory that is only good for the call
+    m_backing->pack_at(0) << checks;
+    m_backing->unpack_from(0) >> m_checks;
+    encode();
+}
+
+hyperclient :: pending_subscribe :: state :: ~state() throw ()
+{
+}
+
+bool
+hyperclient :: pending_subscribe :: state :: resume(const char* cursor, size_t cursor_sz)
+{
+    if (cursor_sz % (3 * sizeof(uint64_t)) != 0)
+    {
+        return false;
+    }
+
+    const char* ptr = cursor;
+    const char* end = cursor + cursor_sz;
+
+    while (ptr < end)
+    {
+        uint64_t region;
+        uint64_t incarnation;
+        uint64_t seq;
+        ptr = e::unpack64be(ptr, &region);
+        ptr = e::unpack64be(ptr, &incarnation);
+        ptr = e::unpack64be(ptr, &seq);
+        advance(hyperdex::region_id(region), incarnation, seq);
+    }
+
+    return true;
+}
+
+void
+hyperclient :: pending_subscribe :: state :: add_region(const hyperdex::region_id& ri)
+{
+    for (size_t i = 0; i < m_positions.size(); i += 3)
+    {
+        if (m_positions[i] == ri.get())
+        {
+            return;
+        }
+    }
+
+    advance(ri, 0, 0);
+}
+
+void
+hyperclient :: pending_subscribe :: state :: position(const hyperdex::region_id& ri,
+                                                      uint64_t* incarnation,
+                                                      uint64_t* seq) const
+{
+    *incarnation = 0;
+    *seq = 0;
+
+    for (size_t i = 0; i < m_positions.size(); i += 3)
+    {
+        if (m_positions[i] == ri.get())
+        {
+            *incarnation = m_positions[i + 1];
+            *seq = m_positions[i + 2];
+            return;
+        }
+    }
+}
+
+void
+hyperclient :: pending_subscribe :: state :: advance(const hyperdex::region_id& ri,
+                                                     uint64_t incarnation,
+                                                     uint64_t seq)
+{
+    size_t i = 0;
+
+    for (; i < m_positions.size(); i += 3)
+    {
+        if (m_positions[i] == ri.get())
+        {
+            break;
+        }
+    }
+
+    if (i == m_positions.size())
+    {
+        m_positions.push_back(ri.get());
+        m_positions.push_back(0);
+        m_positions.push_back(0);
+    }
+
+    m_positions[i + 1] = incarnation;
+    m_positions[i + 2] = seq;
+    encode();
+}
+
+void
+hyperclient :: pending_subscribe :: state :: encode()
+{
+    m_cursor.resize(m_positions.size() * sizeof(uint64_t));
+    char* ptr = m_positions.empty() ? NULL : &m_cursor[0];
+
+    for (size_t i = 0; i < m_positions.size(); ++i)
+    {
+        ptr = e::pack64be(m_positions[i], ptr);
+    }
+
+    if (m_cursor_out && m_cursor_sz_out)
+    {
+        *m_cursor_out = m_cursor.data();
+        *m_cursor_sz_out = m_cursor.size();
+    }
+}
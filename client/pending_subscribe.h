@@ -0,0 +1,138 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_client_pending_subscribe_h_
+#define hyperdex_client_pending_subscribe_h_
+
+// STL
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+// HyperDex
+#include "common/attribute_check.h"
+#include "client/pending.h"
+
+// One outstanding poll per key-subspace region.  Every answer is followed by
+// the next poll, carrying the position of the last change seen in that region.
+class hyperclient::pending_subscribe : public hyperclient::pending
+{
+    public:
+        class state;
+
+    public:
+        pending_subscribe(int64_t sub_id,
+                          const hyperdex::region_id& region,
+                          e::intrusive_ptr<state> st,
+                          hyperclient_returncode* status,
+                          hyperclient_attribute** attrs,
+                          size_t* attrs_sz);
+        virtual ~pending_subscribe() throw ();
+
+    public:
+        virtual hyperdex::network_msgtype request_type();
+        virtual int64_t handle_response(hyperclient* cl,
+                                        const server_id& id,
+                                        std::auto_ptr<e::buffer> msg,
+                                        hyperdex::network_msgtype type,
+                                        hyperclient_returncode* status);
+
+    public:
+        // send the next poll for this region
+        int64_t poll(hyperclient* cl);
+        // ask the server to cancel the outstanding poll
+        void stop(hyperclient* cl);
+
+    private:
+        pending_subscribe(const pending_subscribe& other);
+
+    private:
+        pending_subscribe& operator = (const pending_subscribe& rhs);
+
+    private:
+        int64_t m_sub_id;
+        hyperdex::region_id m_region;
+        hyperdex::network_msgtype m_reqtype;
+        e::intrusive_ptr<state> m_state;
+        hyperclient_attribute** m_attrs;
+        size_t* m_attrs_sz;
+};
+
+// Shared by every region of a subscription.  It owns a copy of the checks, and
+// the cursor:  the (incarnation, sequence number) of the last change returned
+// from each region, encoded so that it may be handed back to "subscribe".
+class hyperclient::pending_subscribe::state
+{
+    public:
+        state(const std::vector<hyperdex::attribute_check>& checks,
+              const char** cursor, size_t* cursor_sz);
+        ~state() throw ();
+
+    public:
+        const std::vector<hyperdex::attribute_check>& checks() const { return m_checks; }
+        bool stopped() const { return m_stopped; }
+        bool last_reference() const { return m_ref == 1; }
+        void set_stopped() { m_stopped = true; }
+        // false if the cursor does not parse
+        bool resume(const char* cursor, size_t cursor_sz);
+        void add_region(const hyperdex::region_id& ri);
+        void position(const hyperdex::region_id& ri,
+                      uint64_t* incarnation, uint64_t* seq) const;
+        void advance(const hyperdex::region_id& ri,
+                     uint64_t incarnation, uint64_t seq);
+
+    private:
+        friend class e::intrusive_ptr<hyperclient::pending_subscribe::state>;
+
+    private:
+        state(const state&);
+
+    private:
+        void inc() { ++m_ref; }
+        void dec() { if (--m_ref == 0) delete this; }
+        void encode();
+
+    private:
+        state& operator = (const state&);
+
+    private:
+        size_t m_ref;
+        bool m_stopped;
+        std::auto_ptr<e::buffer> m_backing;
+        std::vector<hyperdex::attribute_check> m_checks;
+        // (region, incarnation, seq) triples
+        std::vector<uint64_t> m_positions;
+        std::string m_cursor;
+        const char** m_cursor_out;
+        size_t* m_cursor_sz_out;
+};
+
+#endif // hyperdex_client_pending_subscribe_h_
@@ -82,6 +82,9 @@ cdef extern from "../../hyperdex.h":
         HYPERPREDICATE_EQUALS        = 9729
         HYPERPREDICATE_LESS_EQUAL    = 9730
         HYPERPREDICATE_GREATER_EQUAL = 9731
+        HYPERPREDICATE_PREFIX        = 9733
+        HYPERPREDICATE_REGEX         = 9734
+        HYPERPREDICATE_IN            = 9735
 
 cdef extern from "../hyperclient.h":
 
@@ -134,6 +137,7 @@ cdef extern from "../hyperclient.h":
         HYPERCLIENT_INTERRUPTED  = 8530
         HYPERCLIENT_CLUSTER_JUMP = 8531
         HYPERCLIENT_COORD_LOGGED = 8532
+        HYPERCLIENT_BADSEARCH    = 8533
         HYPERCLIENT_INTERNAL     = 8573
         HYPERCLIENT_EXCEPTION    = 8574
         HYPERCLIENT_GARBAGE      = 8575
@@ -142,6 +146,8 @@ cdef extern from "../hyperclient.h":
     void hyperclient_destroy(hyperclient* client)
     hyperclient_returncode hyperclient_add_space(hyperclient* client, char* space)
     hyperclient_returncode hyperclient_rm_space(hyperclient* client, char* space)
+    hyperclient_returncode hyperclient_add_index(hyperclient* client, char* space, char* description, uint16_t* id)
+    hyperclient_returncode hyperclient_rm_index(hyperclient* client, char* space, uint16_t id)
     int64_t hyperclient_get(hyperclient* client, char* space, char* key, size_t key_sz, hyperclient_returncode* status, hyperclient_attribute** attrs, size_t* attrs_sz)
     int64_t hyperclient_put(hyperclient* client, char* space, char* key, size_t key_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
     int64_t hyperclient_put_if_not_exist(hyperclient* client, char* space, char* key, size_t key_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
@@ -179,12 +185,37 @@ cdef extern from "../hyperclient.h":
     int64_t hyperclient_search_describe(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_returncode* status, char** text)
     int64_t hyperclient_sorted_search(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, char* sort_by, uint64_t limit, int maximize, hyperclient_returncode* status, hyperclient_attribute** attrs, size_t* attrs_sz)
     int64_t hyperclient_group_del(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_put(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_add(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_sub(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_mul(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_div(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_mod(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_and(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_or(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_atomic_xor(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_string_prepend(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_string_append(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_list_lpush(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_list_rpush(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_set_add(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_set_remove(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_set_intersect(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
+    int64_t hyperclient_group_set_union(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
     int64_t hyperclient_count(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_returncode* status, uint64_t* result)
+    int64_t hyperclient_count_approx(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, hyperclient_returncode* status, uint64_t* result, uint64_t* error)
+    int64_t hyperclient_sample(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, uint64_t n, hyperclient_returncode* status, hyperclient_attribute** attrs, size_t* attrs_sz)
+    int64_t hyperclient_split_space(hyperclient* client, char* space, uint64_t n, hyperclient_returncode* status, char** split, size_t* split_sz)
+    int64_t hyperclient_search_split(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, char* split, size_t split_sz, hyperclient_returncode* status, hyperclient_attribute** attrs, size_t* attrs_sz)
+    int64_t hyperclient_export_space(hyperclient* client, char* space, hyperclient_returncode* status, char** batch, size_t* batch_sz)
+    int64_t hyperclient_subscribe(hyperclient* client, char* space, hyperclient_attribute_check* chks, size_t chks_sz, char* resume, size_t resume_sz, hyperclient_returncode* status, hyperclient_attribute** attrs, size_t* attrs_sz, char** cursor, size_t* cursor_sz)
+    hyperclient_returncode hyperclient_unsubscribe(hyperclient* client, int64_t id)
     int64_t hyperclient_loop(hyperclient* client, int timeout, hyperclient_returncode* status)
     void hyperclient_destroy_attrs(hyperclient_attribute* attrs, size_t attrs_sz)
 
 ctypedef int64_t (*hyperclient_simple_op)(hyperclient*, char*, char*, size_t, hyperclient_attribute*, size_t, hyperclient_returncode*)
 ctypedef int64_t (*hyperclient_map_op)(hyperclient*, char*, char*, size_t, hyperclient_map_attribute*, size_t, hyperclient_returncode*)
+ctypedef int64_t (*hyperclient_group_op)(hyperclient*, char*, hyperclient_attribute_check*, size_t, hyperclient_attribute*, size_t, hyperclient_returncode*)
 
 import collections
 import struct
@@ -217,6 +248,7 @@ class HyperClientException(Exception):
                   ,HYPERCLIENT_INTERRUPTED: 'Interrupted by a signal'
                   ,HYPERCLIENT_CLUSTER_JUMP: 'The cluster changed identities'
                   ,HYPERCLIENT_COORD_LOGGED: 'The coordinator has logged an error with details'
+                  ,HYPERCLIENT_BADSEARCH: 'The search predicate is malformed'
                   ,HYPERCLIENT_INTERNAL: 'Internal Error (file a bug)'
                   ,HYPERCLIENT_EXCEPTION: 'Internal Exception (file a bug)'
                   ,HYPERCLIENT_GARBAGE: 'Internal Corruption (file a bug)'
@@ -245,6 +277,7 @@ class HyperClientException(Exception):
                   ,HYPERCLIENT_INTERRUPTED: 'HYPERCLIENT_INTERRUPTED'
                   ,HYPERCLIENT_CLUSTER_JUMP: 'HYPERCLIENT_CLUSTER_JUMP'
                   ,HYPERCLIENT_COORD_LOGGED: 'HYPERCLIENT_COORD_LOGGED'
+                  ,HYPERCLIENT_BADSEARCH: 'HYPERCLIENT_BADSEARCH'
                   ,HYPERCLIENT_INTERNAL: 'HYPERCLIENT_INTERNAL'
                   ,HYPERCLIENT_EXCEPTION: 'HYPERCLIENT_EXCEPTION'
                   ,HYPERCLIENT_GARBAGE: 'HYPERCLIENT_GARBAGE'
@@ -1016,6 +1049,43 @@ cdef class DeferredGroupDel(Deferred):
             raise HyperClientException(self._status)
 
 
+cdef class DeferredGroupOp(Deferred):
+
+    cdef call(self, hyperclient_group_op op, bytes space, dict predicate, dict value):
+        cdef bytes attr
+        cdef hyperclient_attribute_check* chks = NULL
+        cdef size_t chks_sz = 0
+        cdef hyperclient_attribute* attrs = NULL
+        try:
+            backingsc = _predicate_to_c(predicate, &chks, &chks_sz)
+            backingsa = _dict_to_attrs(value.items(), &attrs)
+            self._reqid = op(self._client._client, space,
+                             chks, chks_sz, attrs, len(value),
+                             &self._status)
+            if self._reqid < 0:
+                idx = -1 - self._reqid
+                attr = None
+                if idx >= 0 and idx < chks_sz and chks and chks[idx].attr:
+                    attr = chks[idx].attr
+                idx -= chks_sz
+                if idx >= 0 and idx < len(value) and attrs and attrs[idx].attr:
+                    attr = attrs[idx].attr
+                raise HyperClientException(self._status, attr)
+            self._client._ops[self._reqid] = self
+        finally:
+            if chks:
+                free(chks)
+            if attrs:
+                free(attrs)
+
+    def wait(self):
+        Deferred.wait(self)
+        if self._status == HYPERCLIENT_SUCCESS:
+            return True
+        else:
+            raise HyperClientException(self._status)
+
+
 cdef class DeferredSearchDescribe(Deferred):
 
     cdef char* _text
@@ -1078,6 +1148,38 @@ cdef class DeferredCount(Deferred):
             raise HyperClientException(self._status)
 
 
+cdef class DeferredCountApprox(Deferred):
+
+    cdef uint64_t _result
+    cdef uint64_t _error
+
+    def __cinit__(self, Client client, bytes space, dict predicate):
+        self._client = client
+        self._reqid = 0
+        self._status = HYPERCLIENT_GARBAGE
+        self._result = 0
+        self._error = 0
+        cdef hyperclient_attribute_check* chks = NULL
+        cdef size_t chks_sz = 0
+        try:
+            backings = _predicate_to_c(predicate, &chks, &chks_sz)
+            self._reqid = hyperclient_count_approx(client._client, space,
+                                                   chks, chks_sz,
+                                                   &self._status,
+                                                   &self._result, &self._error)
+            _check_reqid_search(self._reqid, self._status, chks, chks_sz)
+            client._ops[self._reqid] = self
+        finally:
+            if chks: free(chks)
+
+    def wait(self):
+        Deferred.wait(self)
+        if self._status == HYPERCLIENT_SUCCESS:
+            return (self._result, self._error)
+        else:
+            raise HyperClientException(self._status)
+
+
 cdef class SearchBase:
 
     cdef Client _client
@@ -1168,6 +1270,166 @@ cdef class SortedSearch(SearchBase):
             if chks: free(chks)
 
 
+cdef class Sample(SearchBase):
+
+    def __cinit__(self, Client client, bytes space, dict predicate, long n):
+        cdef uint64_t num = n
+        cdef hyperclient_attribute_check* chks = NULL
+        cdef size_t chks_sz = 0
+        try:
+            backings = _predicate_to_c(predicate, &chks, &chks_sz)
+            self._reqid = hyperclient_sample(client._client, space,
+                                             chks, chks_sz,
+                                             num,
+                                             &self._status,
+                                             &self._attrs,
+                                             &self._attrs_sz)
+            _check_reqid_search(self._reqid, self._status, chks, chks_sz)
+            client._ops[self._reqid] = self
+        finally:
+            if chks: free(chks)
+
+
+cdef class SplitSpace(SearchBase):
+
+    cdef char* _split
+    cdef size_t _split_sz
+
+    def __cinit__(self, Client client, bytes space, long n):
+        cdef uint64_t num = n
+        self._split = NULL
+        self._split_sz = 0
+        self._reqid = hyperclient_split_space(client._client, space, num,
+                                              &self._status,
+                                              &self._split,
+                                              &self._split_sz)
+        _check_reqid_search(self._reqid, self._status, NULL, 0)
+        client._ops[self._reqid] = self
+
+    def _callback(self):
+        if self._status == HYPERCLIENT_SEARCHDONE:
+            self._finished = True
+            del self._client._ops[self._reqid]
+        elif self._status == HYPERCLIENT_SUCCESS:
+            try:
+                split = self._split[:self._split_sz]
+            finally:
+                free(self._split)
+                self._split = NULL
+            self._backlogged.append(split)
+        else:
+            self._backlogged.append(HyperClientException(self._status))
+
+
+cdef class SearchSplit(SearchBase):
+
+    def __cinit__(self, Client client, bytes space, dict predicate, bytes split):
+        cdef hyperclient_attribute_check* chks = NULL
+        cdef size_t chks_sz = 0
+        try:
+            backings = _predicate_to_c(predicate, &chks, &chks_sz)
+            self._reqid = hyperclient_search_split(client._client, space,
+                                                   chks, chks_sz,
+                                                   split, len(split),
+                                                   &self._status,
+                                                   &self._attrs,
+                                                   &self._attrs_sz)
+            _check_reqid_search(self._reqid, self._status, chks, chks_sz)
+            client._ops[self._reqid] = self
+        finally:
+            if chks: free(chks)
+
+
+cdef class Export(SearchBase):
+
+    cdef char* _batch
+    cdef size_t _batch_sz
+
+    def __cinit__(self, Client client, bytes space):
+        self._batch = NULL
+        self._batch_sz = 0
+        self._reqid = hyperclient_export_space(client._client, space,
+                                               &self._status,
+                                               &self._batch,
+                                               &self._batch_sz)
+        _check_reqid_search(self._reqid, self._status, NULL, 0)
+        client._ops[self._reqid] = self
+
+    def _callback(self):
+        if self._status == HYPERCLIENT_SEARCHDONE:
+            self._finished = True
+            del self._client._ops[self._reqid]
+        elif self._status == HYPERCLIENT_SUCCESS:
+            try:
+                batch = self._batch[:self._batch_sz]
+            finally:
+                free(self._batch)
+                self._batch = NULL
+            self._backlogged.append(batch)
+        else:
+            self._backlogged.append(HyperClientException(self._status))
+
+
+cdef class Subscription(SearchBase):
+
+    cdef char* _cursor
+    cdef size_t _cursor_sz
+    cdef bytes _position
+
+    def __cinit__(self, Client client, bytes space, dict predicate, bytes resume=None):
+        cdef hyperclient_attribute_check* chks = NULL
+        cdef size_t chks_sz = 0
+        cdef char* res = NULL
+        cdef size_t res_sz = 0
+        self._cursor = NULL
+        self._cursor_sz = 0
+        if resume is not None:
+            res = resume
+            res_sz = len(resume)
+        try:
+            backings = _predicate_to_c(predicate, &chks, &chks_sz)
+            self._reqid = hyperclient_subscribe(client._client, space,
+                                                chks, chks_sz,
+                                                res, res_sz,
+                                                &self._status,
+                                                &self._attrs,
+                                                &self._attrs_sz,
+                                                &self._cursor,
+                                                &self._cursor_sz)
+            _check_reqid_search(self._reqid, self._status, chks, chks_sz)
+            self._position = self._cursor[:self._cursor_sz]
+            client._ops[self._reqid] = self
+        finally:
+            if chks: free(chks)
+
+    def cursor(self):
+        '''The position after the last change returned; pass it as "resume"
+        to a later subscription to pick up where this one left off.'''
+        return self._position
+
+    def stop(self):
+        hyperclient_unsubscribe(self._client._client, self._reqid)
+
+    def _callback(self):
+        if self._status == HYPERCLIENT_SEARCHDONE:
+            self._finished = True
+            del self._client._ops[self._reqid]
+            return
+        self._position = self._cursor[:self._cursor_sz]
+        if self._status in (HYPERCLIENT_SUCCESS, HYPERCLIENT_NOTFOUND):
+            try:
+                attrs = _attrs_to_dict(self._attrs, self._attrs_sz)
+            finally:
+                if self._attrs:
+                    hyperclient_destroy_attrs(self._attrs, self._attrs_sz)
+            event = 'match' if self._status == HYPERCLIENT_SUCCESS else 'leave'
+            self._backlogged.insert(0, (event, attrs))
+        elif self._status == HYPERCLIENT_OVERFLOW:
+            self._backlogged.insert(0, ('gap', None))
+        else:
+            self._backlogged.insert(0, HyperClientException(self._status))
+
+
 cdef class Predicate:
 
     cdef list _raw_check
@@ -1204,6 +1466,30 @@ cdef class GreaterEqual(Predicate):
         Predicate.__init__(self, [(HYPERPREDICATE_GREATER_EQUAL, lower)])
 
 
+cdef class Prefix(Predicate):
+
+    def __init__(self, prefix):
+        if type(prefix) != bytes:
+            raise AttributeError("Prefix must be a byte")
+        Predicate.__init__(self, [(HYPERPREDICATE_PREFIX, prefix)])
+
+
+cdef class Regex(Predicate):
+
+    def __init__(self, regex):
+        if type(regex) != bytes:
+            raise AttributeError("Regex must be a byte")
+        Predicate.__init__(self, [(HYPERPREDICATE_REGEX, regex)])
+
+
+cdef class In(Predicate):
+
+    def __init__(self, values):
+        if not isinstance(values, (list, tuple)) or len(values) == 0:
+            raise AttributeError("In must be a non-empty list")
+        Predicate.__init__(self, [(HYPERPREDICATE_IN, list(values))])
+
+
 cdef class Client:
     cdef hyperclient* _client
     cdef dict _ops
@@ -1226,6 +1512,18 @@ cdef class Client:
         if rc != HYPERCLIENT_SUCCESS:
             raise HyperClientException(rc)
 
+    def add_index(self, bytes space, bytes description):
+        cdef uint16_t id = 0
+        cdef hyperclient_returncode rc = hyperclient_add_index(self._client, space, description, &id)
+        if rc != HYPERCLIENT_SUCCESS:
+            raise HyperClientException(rc)
+        return id
+
+    def rm_index(self, bytes space, int id):
+        cdef hyperclient_returncode rc = hyperclient_rm_index(self._client, space, id)
+        if rc != HYPERCLIENT_SUCCESS:
+            raise HyperClientException(rc)
+
     def get(self, bytes space, key):
         async = self.async_get(space, key)
         return async.wait()
@@ -1366,16 +1664,107 @@ cdef class Client:
         async = self.async_group_del(space, predicate)
         return async.wait()
 
+    def group_put(self, bytes space, dict predicate, dict value):
+        async = self.async_group_put(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_add(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_add(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_sub(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_sub(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_mul(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_mul(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_div(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_div(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_mod(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_mod(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_and(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_and(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_or(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_or(space, predicate, value)
+        return async.wait()
+
+    def group_atomic_xor(self, bytes space, dict predicate, dict value):
+        async = self.async_group_atomic_xor(space, predicate, value)
+        return async.wait()
+
+    def group_string_prepend(self, bytes space, dict predicate, dict value):
+        async = self.async_group_string_prepend(space, predicate, value)
+        return async.wait()
+
+    def group_string_append(self, bytes space, dict predicate, dict value):
+        async = self.async_group_string_append(space, predicate, value)
+        return async.wait()
+
+    def group_list_lpush(self, bytes space, dict predicate, dict value):
+        async = self.async_group_list_lpush(space, predicate, value)
+        return async.wait()
+
+    def group_list_rpush(self, bytes space, dict predicate, dict value):
+        async = self.async_group_list_rpush(space, predicate, value)
+        return async.wait()
+
+    def group_set_add(self, bytes space, dict predicate, dict value):
+        async = self.async_group_set_add(space, predicate, value)
+        return async.wait()
+
+    def group_set_remove(self, bytes space, dict predicate, dict value):
+        async = self.async_group_set_remove(space, predicate, value)
+        return async.wait()
+
+    def group_set_intersect(self, bytes space, dict predicate, dict value):
+        async = self.async_group_set_intersect(space, predicate, value)
+        return async.wait()
+
+    def group_set_union(self, bytes space, dict predicate, dict value):
+        async = self.async_group_set_union(space, predicate, value)
+        return async.wait()
+
     def count(self, bytes space, dict predicate, bool unsafe=False):
         async = self.async_count(space, predicate, unsafe)
         return async.wait()
 
+    def count_approx(self, bytes space, dict predicate):
+        async = self.async_count_approx(space, predicate)
+        return async.wait()
+
     def search(self, bytes space, dict predicate):
         return Search(self, space, predicate)
 
+    def sample(self, bytes space, dict predicate, long n):
+        return Sample(self, space, predicate, n)
+
+    def split_space(self, bytes space, long n):
+        '''Tokens for ranges of roughly equal size that together cover the
+        space; search each with "search_split", e.g. from separate clients.'''
+        return list(SplitSpace(self, space, n))
+
+    def search_split(self, bytes space, dict predicate, bytes split):
+        return SearchSplit(self, space, predicate, split)
+
+    def export_space(self, bytes space):
+        '''An iterator over batches of every object in the space, in the
+        binary format documented with hyperclient_export_space.'''
+        return Export(self, space)
+
     def sorted_search(self, bytes space, dict predicate, bytes sort_by, long limit, bytes compare):
         return SortedSearch(self, space, predicate, sort_by, limit, compare)
 
+    def subscribe(self, bytes space, dict predicate, bytes resume=None):
+        return Subscription(self, space, predicate, resume)
+
     def async_get(self, bytes space, key):
         return DeferredGet(self, space, key)
 
@@ -1542,9 +1931,97 @@ cdef class Client:
     def async_group_del(self, bytes space, dict predicate):
         return DeferredGroupDel(self, space, predicate)
 
+    def async_group_put(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_put, space, predicate, value)
+        return d
+
+    def async_group_atomic_add(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_add, space, predicate, value)
+        return d
+
+    def async_group_atomic_sub(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_sub, space, predicate, value)
+        return d
+
+    def async_group_atomic_mul(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_mul, space, predicate, value)
+        return d
+
+    def async_group_atomic_div(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_div, space, predicate, value)
+        return d
+
+    def async_group_atomic_mod(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_mod, space, predicate, value)
+        return d
+
+    def async_group_atomic_and(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_and, space, predicate, value)
+        return d
+
+    def async_group_atomic_or(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_or, space, predicate, value)
+        return d
+
+    def async_group_atomic_xor(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_atomic_xor, space, predicate, value)
+        return d
+
+    def async_group_string_prepend(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_string_prepend, space, predicate, value)
+        return d
+
+    def async_group_string_append(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_string_append, space, predicate, value)
+        return d
+
+    def async_group_list_lpush(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_list_lpush, space, predicate, value)
+        return d
+
+    def async_group_list_rpush(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_list_rpush, space, predicate, value)
+        return d
+
+    def async_group_set_add(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_set_add, space, predicate, value)
+        return d
+
+    def async_group_set_remove(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_set_remove, space, predicate, value)
+        return d
+
+    def async_group_set_intersect(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_set_intersect, space, predicate, value)
+        return d
+
+    def async_group_set_union(self, bytes space, dict predicate, dict value):
+        d = DeferredGroupOp(self)
+        d.call(<hyperclient_group_op> hyperclient_group_set_union, space, predicate, value)
+        return d
+
     def async_count(self, bytes space, dict predicate, bool unsafe=False):
         return DeferredCount(self, space, predicate, unsafe)
 
+    def async_count_approx(self, bytes space, dict predicate):
+        return DeferredCountApprox(self, space, predicate)
+
     def loop(self):
         cdef hyperclient_returncode rc
         ret = hyperclient_loop(self._client, -1, &rc)
@@ -31,6 +31,7 @@
 #include <po6/threads/mutex.h>
 
 // e
+#include <e/endian.h>
 #include <e/guard.h>
 
 // HyperDex
@@ -46,6 +47,86 @@ extern int yyparse();
 extern struct yy_buffer_state* yy_scan_buffer(char *, size_t);
 } // extern "C"
 
+static bool
+convert_index(const hyperdex::schema& sc,
+              hyperparse_index* parsed,
+              hyperdex::index* idx)
+{
+    for (hyperparse_identifier_list* i = parsed->attrs; i; i = i->next)
+    {
+        uint16_t attr = sc.lookup_attr(i->name);
+
+        if (attr == sc.attrs_sz)
+        {
+            return false;
+        }
+
+        idx->attrs.push_back(attr);
+    }
+
+    for (hyperparse_identifier_list* i = parsed->include; i; i = i->next)
+    {
+        uint16_t attr = sc.lookup_attr(i->name);
+
+        if (attr == sc.attrs_sz)
+        {
+            return false;
+        }
+
+        idx->include.push_back(attr);
+    }
+
+    for (hyperparse_filter_list* f = parsed->filters; f; f = f->next)
+    {
+        hyperdex::index_filter filter;
+        filter.attr = sc.lookup_attr(f->filter->attr);
+        filter.predicate = f->filter->predicate;
+
+        if (filter.attr == sc.attrs_sz)
+        {
+            return false;
+        }
+
+        char buf[sizeof(int64_t)];
+
+        switch (sc.attrs[filter.attr].type)
+        {
+            case HYPERDATATYPE_STRING:
+                if (!f->filter->str)
+                {
+                    return false;
+                }
+
+                filter.value = f->filter->str;
+                break;
+            case HYPERDATATYPE_INT64:
+                if (f->filter->str)
+                {
+                    return false;
+                }
+
+                e::pack64le(f->filter->num, buf);
+                filter.value.assign(buf, sizeof(buf));
+                break;
+            case HYPERDATATYPE_FLOAT:
+                if (f->filter->str)
+                {
+                    return false;
+                }
+
+                e::packdoublele(static_cast<double>(f->filter->num), buf);
+                filter.value.assign(buf, sizeof(buf));
+                break;
+            default:
+                return false;
+        }
+
+        idx->filters.push_back(filter);
+    }
+
+    return true;
+}
+
 bool
 hyperdex :: space_description_to_space(const char* description, space* ret)
 {
@@ -60,7 +141,9 @@ hyperdex :: space_description_to_space(const char* description, space* ret)
         yyparse();
         parsed = hyperparsed_space;
         error = hyperparsed_error != 0;
+        hyperparse_free_index(hyperparsed_index);
         hyperparsed_space = NULL;
+        hyperparsed_index = NULL;
         hyperparsed_error = 0;
     }
 
@@ -110,6 +193,17 @@ hyperdex :: space_description_to_space(const char* description, space* ret)
         }
     }
 
+    for (hyperparse_index_list* l = parsed->indices; l; l = l->next)
+    {
+        sp.indices.push_back(index());
+        sp.indices.back().id = sc.attrs_sz + sp.indices.size() - 1;
+
+        if (!convert_index(sc, l->index, &sp.indices.back()))
+        {
+            return false;
+        }
+    }
+
     sp.fault_tolerance = parsed->fault_tolerance;
 
     if (!sp.validate())
@@ -125,3 +219,49 @@ hyperdex :: space_description_to_space(const char* description, space* ret)
     *ret = sp;
     return true;
 }
+
+bool
+hyperdex :: index_description_to_index(const schema& sc,
+                                       const char* description,
+                                       index* ret)
+{
+    std::vector<char> desc(description, description + strlen(description));
+    hyperparse_index* parsed = NULL;
+    bool error = false;
+
+    {
+        po6::threads::mutex::hold hold(&protect_the_bison);
+        desc.push_back('\0'); desc.push_back('\0');
+        yy_scan_buffer(&desc.front(), desc.size());
+        yyparse();
+        parsed = hyperparsed_index;
+        error = hyperparsed_error != 0 || hyperparsed_space != NULL;
+        hyperparse_free(hyperparsed_space);
+        hyperparsed_space = NULL;
+        hyperparsed_index = NULL;
+        hyperparsed_error = 0;
+    }
+
+    if (!parsed)
+    {
+        return false;
+    }
+
+    e::guard g = e::makeguard(hyperparse_free_index, parsed);
+    g.use_variable();
+
+    if (error)
+    {
+        return false;
+    }
+
+    index idx;
+
+    if (!convert_index(sc, parsed, &idx))
+    {
+        return false;
+    }
+
+    *ret = idx;
+    return true;
+}
@@ -37,6 +37,11 @@ namespace hyperdex
 bool
 space_description_to_space(const char* description, space* s);
 
+// Parse "index ..." as it would appear in a description of a space with
+// schema "sc".  The caller assigns the index's id.
+bool
+index_description_to_index(const schema& sc, const char* description, index* idx);
+
 } // namespace hyperdex
 
 #endif // hyperdex_client_space_description_h_
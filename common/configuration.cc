@@ -42,6 +42,7 @@ using hyperdex::configuration;
 using hyperdex::region_id;
 using hyperdex::schema;
 using hyperdex::server_id;
+using hyperdex::space;
 using hyperdex::subspace;
 using hyperdex::subspace_id;
 using hyperdex::virtual_server_id;
@@ -54,6 +55,7 @@ configuration :: configuration()
     , m_server_ids_by_virtual()
     , m_schemas_by_region()
     , m_subspaces_by_region()
+    , m_spaces_by_region()
     , m_subspace_ids_by_region()
     , m_subspace_ids_for_prev()
     , m_subspace_ids_for_next()
@@ -76,6 +78,7 @@ configuration :: configuration(const configuration& other)
     , m_server_ids_by_virtual(other.m_server_ids_by_virtual)
     , m_schemas_by_region(other.m_schemas_by_region)
     , m_subspaces_by_region(other.m_subspaces_by_region)
+    , m_spaces_by_region(other.m_spaces_by_region)
     , m_subspace_ids_by_region(other.m_subspace_ids_by_region)
     , m_subspace_ids_for_prev(other.m_subspace_ids_for_prev)
     , m_subspace_ids_for_next(other.m_subspace_ids_for_next)
@@ -212,6 +215,22 @@ configuration :: get_subspace(const region_id& ri) const
     return NULL;
 }
 
+const space*
+configuration :: get_space(const region_id& ri) const
+{
+    std::vector<uint64_space_t>::const_iterator it;
+    it = std::lower_bound(m_spaces_by_region.begin(),
+                          m_spaces_by_region.end(),
+                          uint64_space_t(ri.get(), NULL));
+
+    if (it != m_spaces_by_region.end() && it->first == ri.get())
+    {
+        return it->second;
+    }
+
+    return NULL;
+}
+
 virtual_server_id
 configuration :: get_virtual(const region_id& ri, const server_id& si) const
 {
@@ -363,6 +382,30 @@ configuration :: point_leaders(const server_id& si, std::vector<region_id>* serv
     }
 }
 
+void
+configuration :: mapped_regions(const server_id& si, std::vector<region_id>* regions) const
+{
+    for (size_t s = 0; s < m_spaces.size(); ++s)
+    {
+        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
+        {
+            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
+            {
+                const region& reg(m_spaces[s].subspaces[ss].regions[r]);
+
+                for (size_t z = 0; z < reg.replicas.size(); ++z)
+                {
+                    if (reg.replicas[z].si == si)
+                    {
+                        regions->push_back(reg.id);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
 bool
 configuration :: is_point_leader(const virtual_server_id& e) const
 {
@@ -371,6 +414,23 @@ configuration :: is_point_leader(const virtual_server_id& e) const
                               e.get());
 }
 
+void
+configuration :: key_regions(const char* sname, std::vector<region_id>* regions) const
+{
+    for (size_t s = 0; s < m_spaces.size(); ++s)
+    {
+        if (strcmp(sname, m_spaces[s].name) != 0)
+        {
+            continue;
+        }
+
+        for (size_t r = 0; r < m_spaces[s].subspaces[0].regions.size(); ++r)
+        {
+            regions->push_back(m_spaces[s].subspaces[0].regions[r].id);
+        }
+    }
+}
+
 virtual_server_id
 configuration :: point_leader(const char* sname, const e::slice& key)
 {
@@ -661,9 +721,23 @@ configuration :: lookup_search(const char* space_name,
                     return;
                 }
 
+                if (!ranges[k].points.empty())
+                {
+                    bool any = false;
+
+                    for (size_t p = 0; !any && p < ranges[k].points.size(); ++p)
+                    {
+                        uint64_t h = hash(ranges[k].type, ranges[k].points[p]);
+                        any = reg.lower_coord[attr] <= h && h <= reg.upper_coord[attr];
+                    }
+
+                    exclude = !any;
+                    continue;
+                }
+
                 if (ranges[k].type == HYPERDATATYPE_STRING &&
                     ranges[k].has_start && ranges[k].has_end &&
-                    ranges[k].start == ranges[k].end)
+                    !ranges[k].prefix && ranges[k].start == ranges[k].end)
                 {
                     uint64_t h = hash(ranges[k].type, ranges[k].start);
 
@@ -788,6 +862,40 @@ configuration :: debug_dump(std::ostream& out)
                 out << "]" << std::endl;
             }
         }
+
+        for (size_t x = 0; x < s.indices.size(); ++x)
+        {
+            const hyperdex::index& idx(s.indices[x]);
+            out << "  index id=" << idx.id << std::endl;
+            out << "    attributes";
+
+            for (size_t i = 0; i < idx.attrs.size(); ++i)
+            {
+                out << " " << s.sc.attrs[idx.attrs[i]].name;
+            }
+
+            out << std::endl;
+            out << "    include";
+
+            for (size_t i = 0; i < idx.include.size(); ++i)
+            {
+                out << " " << s.sc.attrs[idx.include[i]].name;
+            }
+
+            out << std::endl;
+            out << "    where";
+
+            for (size_t i = 0; i < idx.filters.size(); ++i)
+            {
+                const hyperdex::index_filter& f(idx.filters[i]);
+                out << " " << s.sc.attrs[f.attr].name
+                    << (f.predicate == HYPERPREDICATE_EQUALS ? "=" :
+                        f.predicate == HYPERPREDICATE_LESS_EQUAL ? "<=" : ">=") << "0x"
+                    << e::slice(f.value.data(), f.value.size()).hex();
+            }
+
+            out << std::endl;
+        }
     }
 
     for (size_t i = 0; i < m_captures.size(); ++i)
@@ -816,6 +924,7 @@ configuration :: operator = (const configuration& rhs)
     m_server_ids_by_virtual = rhs.m_server_ids_by_virtual;
     m_schemas_by_region = rhs.m_schemas_by_region;
     m_subspaces_by_region = rhs.m_subspaces_by_region;
+    m_spaces_by_region = rhs.m_spaces_by_region;
     m_subspace_ids_by_region = rhs.m_subspace_ids_by_region;
     m_subspace_ids_for_prev = rhs.m_subspace_ids_for_prev;
     m_subspace_ids_for_next = rhs.m_subspace_ids_for_next;
@@ -837,6 +946,7 @@ configuration :: refill_cache()
     m_server_ids_by_virtual.clear();
     m_schemas_by_region.clear();
     m_subspaces_by_region.clear();
+    m_spaces_by_region.clear();
     m_subspace_ids_by_region.clear();
     m_subspace_ids_for_prev.clear();
     m_subspace_ids_for_next.clear();
@@ -870,6 +980,7 @@ configuration :: refill_cache()
                 region& r(ss.regions[y]);
                 m_schemas_by_region.push_back(std::make_pair(r.id.get(), &s.sc));
                 m_subspaces_by_region.push_back(std::make_pair(r.id.get(), &ss));
+                m_spaces_by_region.push_back(std::make_pair(r.id.get(), &s));
                 m_subspace_ids_by_region.push_back(std::make_pair(r.id.get(), ss.id.get()));
 
                 if (r.replicas.empty())
@@ -916,6 +1027,7 @@ configuration :: refill_cache()
     std::sort(m_server_ids_by_virtual.begin(), m_server_ids_by_virtual.end());
     std::sort(m_schemas_by_region.begin(), m_schemas_by_region.end());
     std::sort(m_subspaces_by_region.begin(), m_subspaces_by_region.end());
+    std::sort(m_spaces_by_region.begin(), m_spaces_by_region.end());
     std::sort(m_subspace_ids_by_region.begin(), m_subspace_ids_by_region.end());
     std::sort(m_subspace_ids_for_prev.begin(), m_subspace_ids_for_prev.end());
     std::sort(m_subspace_ids_for_next.begin(), m_subspace_ids_for_next.end());
@@ -74,6 +74,7 @@ class configuration
         const schema* get_schema(const char* space) const;
         const schema* get_schema(const region_id& ri) const;
         const subspace* get_subspace(const region_id& ri) const;
+        const space* get_space(const region_id& ri) const;
         virtual_server_id get_virtual(const region_id& ri, const server_id& si) const;
         subspace_id subspace_of(const region_id& ri) const;
         subspace_id subspace_prev(const subspace_id& ss) const;
@@ -82,7 +83,11 @@ class configuration
         virtual_server_id tail_of_region(const region_id& ri) const;
         virtual_server_id next_in_region(const virtual_server_id& vsi) const;
         void point_leaders(const server_id& s, std::vector<region_id>* servers) const;
+        // every region for which s is a replica
+        void mapped_regions(const server_id& s, std::vector<region_id>* regions) const;
         bool is_point_leader(const virtual_server_id& e) const;
+        // every region of the space's key subspace
+        void key_regions(const char* space, std::vector<region_id>* regions) const;
         virtual_server_id point_leader(const char* space, const e::slice& key);
         // point leader for this key in the same space as ri
         virtual_server_id point_leader(const region_id& ri, const e::slice& key);
@@ -128,6 +133,7 @@ class configuration
         typedef std::pair<uint64_t, uint64_t> pair_uint64_t;
         typedef std::pair<uint64_t, schema*> uint64_schema_t;
         typedef std::pair<uint64_t, subspace*> uint64_subspace_t;
+        typedef std::pair<uint64_t, space*> uint64_space_t;
         typedef std::pair<uint64_t, po6::net::location> uint64_location_t;
 
     private:
@@ -138,6 +144,7 @@ class configuration
         std::vector<pair_uint64_t> m_server_ids_by_virtual;
         std::vector<uint64_schema_t> m_schemas_by_region;
         std::vector<uint64_subspace_t> m_subspaces_by_region;
+        std::vector<uint64_space_t> m_spaces_by_region;
         std::vector<pair_uint64_t> m_subspace_ids_by_region;
         std::vector<pair_uint64_t> m_subspace_ids_for_prev;
         std::vector<pair_uint64_t> m_subspace_ids_for_next;
@@ -103,6 +103,23 @@ counter_map :: lookup(const region_id& ri, uint64_t* count)
     return true;
 }
 
+bool
+counter_map :: current(const region_id& ri, uint64_t* count)
+{
+    std::vector<std::pair<region_id, uint64_t> >::iterator it;
+    it = std::lower_bound(m_counters.begin(),
+                          m_counters.end(),
+                          std::make_pair(ri, static_cast<uint64_t>(0)));
+
+    if (it == m_counters.end() || ri != it->first)
+    {
+        return false;
+    }
+
+    *count = __sync_fetch_and_add(&it->second, 0);
+    return true;
+}
+
 bool
 counter_map :: take_max(const region_id& ri, uint64_t count)
 {
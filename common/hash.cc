@@ -113,3 +113,18 @@ hyperdex :: hash(const hyperdex::schema& sc,
         hs[i] = hash(sc.attrs[i].type, value[i - 1]);
     }
 }
+
+void
+hyperdex :: hash(const hyperdex::schema& sc,
+                 const e::slice& key,
+                 const std::vector<e::slice>& value,
+                 const std::vector<bool>& attrs,
+                 uint64_t* hs)
+{
+    hs[0] = hash(sc.attrs[0].type, key);
+
+    for (size_t i = 1; i < sc.attrs_sz; ++i)
+    {
+        hs[i] = attrs[i] ? hash(sc.attrs[i].type, value[i - 1]) : 0;
+    }
+}
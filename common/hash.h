@@ -54,6 +54,14 @@ hash(const schema& sc,
      const std::vector<e::slice>& value,
      uint64_t* hs);
 
+// Hash only the attributes set in "attrs"; the others hash to 0
+void
+hash(const schema& sc,
+     const e::slice& key,
+     const std::vector<e::slice>& value,
+     const std::vector<bool>& attrs,
+     uint64_t* hs);
+
 } // namespace hyperdex
 
 #endif // hyperdex_common_hash_h_
@@ -78,6 +78,9 @@ operator << (std::ostream& lhs, hyperpredicate rhs)
         STRINGIFY(HYPERPREDICATE_LESS_EQUAL);
         STRINGIFY(HYPERPREDICATE_GREATER_EQUAL);
         STRINGIFY(HYPERPREDICATE_CONTAINS_LESS_THAN);
+        STRINGIFY(HYPERPREDICATE_PREFIX);
+        STRINGIFY(HYPERPREDICATE_REGEX);
+        STRINGIFY(HYPERPREDICATE_IN);
         default:
             lhs << "unknown hyperpredicate";
             break;
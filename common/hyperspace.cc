@@ -27,9 +27,12 @@
 
 // HyperDex
 #include "common/hyperspace.h"
+#include "common/serialization.h"
 
 using hyperdex::space;
 using hyperdex::subspace;
+using hyperdex::index;
+using hyperdex::index_filter;
 using hyperdex::region;
 using hyperdex::replica;
 
@@ -39,6 +42,7 @@ space :: space()
     , fault_tolerance()
     , sc()
     , subspaces()
+    , indices()
     , m_c_strs()
     , m_attrs()
 {
@@ -50,6 +54,7 @@ space :: space(const char* new_name, const hyperdex::schema& _sc)
     , fault_tolerance()
     , sc(_sc)
     , subspaces()
+    , indices()
     , m_c_strs()
     , m_attrs()
 {
@@ -62,6 +67,7 @@ space :: space(const space& other)
     , fault_tolerance(other.fault_tolerance)
     , sc(other.sc)
     , subspaces(other.subspaces)
+    , indices(other.indices)
     , m_c_strs()
     , m_attrs()
 {
@@ -116,6 +122,84 @@ space :: validate() const
         }
     }
 
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        const index& idx(indices[i]);
+
+        if (idx.id < sc.attrs_sz || idx.attrs.empty())
+        {
+            return false;
+        }
+
+        for (size_t j = 0; j < idx.attrs.size(); ++j)
+        {
+            if (idx.attrs[j] == 0 || idx.attrs[j] >= sc.attrs_sz)
+            {
+                return false;
+            }
+
+            if (sc.attrs[idx.attrs[j]].type != HYPERDATATYPE_STRING &&
+                sc.attrs[idx.attrs[j]].type != HYPERDATATYPE_INT64 &&
+                sc.attrs[idx.attrs[j]].type != HYPERDATATYPE_FLOAT)
+            {
+                return false;
+            }
+
+            for (size_t k = j + 1; k < idx.attrs.size(); ++k)
+            {
+                if (idx.attrs[j] == idx.attrs[k])
+                {
+                    return false;
+                }
+            }
+        }
+
+        for (size_t j = 0; j < idx.include.size(); ++j)
+        {
+            if (idx.include[j] == 0 || idx.include[j] >= sc.attrs_sz)
+            {
+                return false;
+            }
+        }
+
+        for (size_t j = 0; j < idx.filters.size(); ++j)
+        {
+            const index_filter& f(idx.filters[j]);
+
+            if (f.attr == 0 || f.attr >= sc.attrs_sz)
+            {
+                return false;
+            }
+
+            if (f.predicate != HYPERPREDICATE_EQUALS &&
+                f.predicate != HYPERPREDICATE_LESS_EQUAL &&
+                f.predicate != HYPERPREDICATE_GREATER_EQUAL)
+            {
+                return false;
+            }
+
+            if (sc.attrs[f.attr].type == HYPERDATATYPE_STRING)
+            {
+                continue;
+            }
+
+            if ((sc.attrs[f.attr].type != HYPERDATATYPE_INT64 &&
+                 sc.attrs[f.attr].type != HYPERDATATYPE_FLOAT) ||
+                f.value.size() != sizeof(uint64_t))
+            {
+                return false;
+            }
+        }
+
+        for (size_t j = i + 1; j < indices.size(); ++j)
+        {
+            if (idx.id == indices[j].id)
+            {
+                return false;
+            }
+        }
+    }
+
     return true;
 }
 
@@ -127,6 +211,7 @@ space :: operator = (const space& rhs)
     fault_tolerance = rhs.fault_tolerance;
     sc = rhs.sc;
     subspaces = rhs.subspaces;
+    indices = rhs.indices;
     reestablish_backing();
     return *this;
 }
@@ -168,6 +253,7 @@ hyperdex :: operator << (e::buffer::packer pa, const space& s)
 {
     e::slice name;
     uint16_t num_subspaces = s.subspaces.size();
+    uint16_t num_indices = s.indices.size();
     name = e::slice(s.name, strlen(s.name));
     pa = pa << s.id.get() << name << s.fault_tolerance << s.sc.attrs_sz << num_subspaces;
 
@@ -182,6 +268,13 @@ hyperdex :: operator << (e::buffer::packer pa, const space& s)
         pa = pa << s.subspaces[i];
     }
 
+    pa = pa << num_indices;
+
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        pa = pa << s.indices[i];
+    }
+
     return pa;
 }
 
@@ -235,6 +328,16 @@ hyperdex :: operator >> (e::unpacker up, space& s)
         up = up >> s.subspaces[i];
     }
 
+    // Unpack indices
+    uint16_t num_indices = 0;
+    up = up >> num_indices;
+    s.indices.resize(num_indices);
+
+    for (size_t i = 0; !up.error() && i < num_indices; ++i)
+    {
+        up = up >> s.indices[i];
+    }
+
     return up;
 }
 
@@ -245,7 +348,8 @@ hyperdex :: pack_size(const space& s)
               + sizeof(uint32_t) + strlen(s.name) /* name */
               + sizeof(uint64_t) /* fault_tolerance */
               + sizeof(uint16_t) /* sc.attrs_sz */
-              + sizeof(uint16_t); /* num subspaces */
+              + sizeof(uint16_t) /* num subspaces */
+              + sizeof(uint16_t); /* num indices */
 
     for (size_t i = 0; i < s.sc.attrs_sz; ++i)
     {
@@ -258,6 +362,11 @@ hyperdex :: pack_size(const space& s)
         sz += pack_size(s.subspaces[i]);
     }
 
+    for (size_t i = 0; i < s.indices.size(); ++i)
+    {
+        sz += pack_size(s.indices[i]);
+    }
+
     return sz;
 }
 
@@ -350,6 +459,165 @@ hyperdex :: pack_size(const subspace& s)
     return sz;
 }
 
+index :: index()
+    : id()
+    , attrs()
+    , include()
+    , filters()
+{
+}
+
+index :: index(const index& other)
+    : id(other.id)
+    , attrs(other.attrs)
+    , include(other.include)
+    , filters(other.filters)
+{
+}
+
+index :: ~index() throw ()
+{
+}
+
+hyperdex::index&
+index :: operator = (const index& rhs)
+{
+    id = rhs.id;
+    attrs = rhs.attrs;
+    include = rhs.include;
+    filters = rhs.filters;
+    return *this;
+}
+
+e::buffer::packer
+hyperdex :: operator << (e::buffer::packer pa, const index& i)
+{
+    uint16_t num_attrs = i.attrs.size();
+    uint16_t num_include = i.include.size();
+    uint16_t num_filters = i.filters.size();
+    pa = pa << i.id << num_attrs << num_include << num_filters;
+
+    for (size_t j = 0; j < num_attrs; ++j)
+    {
+        pa = pa << i.attrs[j];
+    }
+
+    for (size_t j = 0; j < num_include; ++j)
+    {
+        pa = pa << i.include[j];
+    }
+
+    for (size_t j = 0; j < num_filters; ++j)
+    {
+        pa = pa << i.filters[j];
+    }
+
+    return pa;
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker up, index& i)
+{
+    uint16_t num_attrs;
+    uint16_t num_include;
+    uint16_t num_filters;
+    up = up >> i.id >> num_attrs >> num_include >> num_filters;
+    i.attrs.clear();
+    i.include.clear();
+    i.filters.clear();
+
+    for (size_t j = 0; !up.error() && j < num_attrs; ++j)
+    {
+        uint16_t attr;
+        up = up >> attr;
+        i.attrs.push_back(attr);
+    }
+
+    for (size_t j = 0; !up.error() && j < num_include; ++j)
+    {
+        uint16_t attr;
+        up = up >> attr;
+        i.include.push_back(attr);
+    }
+
+    for (size_t j = 0; !up.error() && j < num_filters; ++j)
+    {
+        index_filter f;
+        up = up >> f;
+        i.filters.push_back(f);
+    }
+
+    return up;
+}
+
+size_t
+hyperdex :: pack_size(const index& i)
+{
+    size_t sz = sizeof(uint16_t) /* id */
+              + sizeof(uint16_t) /* num_attrs */
+              + sizeof(uint16_t) /* num_include */
+              + sizeof(uint16_t) /* num_filters */
+              + sizeof(uint16_t) * i.attrs.size()
+              + sizeof(uint16_t) * i.include.size();
+
+    for (size_t j = 0; j < i.filters.size(); ++j)
+    {
+        sz += pack_size(i.filters[j]);
+    }
+
+    return sz;
+}
+
+index_filter :: index_filter()
+    : attr()
+    , predicate(HYPERPREDICATE_FAIL)
+    , value()
+{
+}
+
+index_filter :: index_filter(const index_filter& other)
+    : attr(other.attr)
+    , predicate(other.predicate)
+    , value(other.value)
+{
+}
+
+index_filter :: ~index_filter() throw ()
+{
+}
+
+index_filter&
+index_filter :: operator = (const index_filter& rhs)
+{
+    attr = rhs.attr;
+    predicate = rhs.predicate;
+    value = rhs.value;
+    return *this;
+}
+
+e::buffer::packer
+hyperdex :: operator << (e::buffer::packer pa, const index_filter& f)
+{
+    return pa << f.attr << f.predicate << e::slice(f.value.data(), f.value.size());
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker up, index_filter& f)
+{
+    e::slice value;
+    up = up >> f.attr >> f.predicate >> value;
+    f.value.assign(reinterpret_cast<const char*>(value.data()), value.size());
+    return up;
+}
+
+size_t
+hyperdex :: pack_size(const index_filter& f)
+{
+    return sizeof(uint16_t) /* attr */
+         + pack_size(f.predicate)
+         + sizeof(uint32_t) + f.value.size();
+}
+
 region :: region()
     : id()
     , lower_coord()
@@ -29,6 +29,7 @@
 #define hyperdex_common_hyperspace_h_
 
 // STL
+#include <string>
 #include <vector>
 
 // e
@@ -43,6 +44,8 @@ namespace hyperdex
 {
 class space;
 class subspace;
+class index;
+class index_filter;
 class region;
 class replica;
 
@@ -66,6 +69,7 @@ class space
         uint64_t fault_tolerance;
         hyperdex::schema sc;
         std::vector<subspace> subspaces;
+        std::vector<index> indices;
 
     private:
         friend e::buffer::packer operator << (e::buffer::packer, const space& s);
@@ -111,6 +115,64 @@ operator >> (e::unpacker, subspace& s);
 size_t
 pack_size(const subspace& s);
 
+// A secondary index declared in the space description, in addition to the
+// implicit index on each attribute of a region's subspace.  Entries are
+// ordered by the attributes in turn, so a search may use any prefix of them
+// constrained to single values, followed by one range.
+class index
+{
+    public:
+        index();
+        index(const index&);
+        ~index() throw ();
+
+    public:
+        index& operator = (const index&);
+
+    public:
+        // entries are stored under this number rather than the attribute's,
+        // so it is never less than the number of attributes in the schema
+        uint16_t id;
+        std::vector<uint16_t> attrs;
+        // attributes whose values are copied into every entry, so that
+        // searches over them need not retrieve the object
+        std::vector<uint16_t> include;
+        // only the objects that pass every filter have entries
+        std::vector<index_filter> filters;
+};
+
+e::buffer::packer
+operator << (e::buffer::packer, const index& i);
+e::unpacker
+operator >> (e::unpacker, index& i);
+size_t
+pack_size(const index& i);
+
+// A predicate on one attribute, with its value encoded as for an
+// attribute_check on that attribute
+class index_filter
+{
+    public:
+        index_filter();
+        index_filter(const index_filter&);
+        ~index_filter() throw ();
+
+    public:
+        index_filter& operator = (const index_filter&);
+
+    public:
+        uint16_t attr;
+        hyperpredicate predicate;
+        std::string value;
+};
+
+e::buffer::packer
+operator << (e::buffer::packer, const index_filter& f);
+e::unpacker
+operator >> (e::unpacker, index_filter& f);
+size_t
+pack_size(const index_filter& f);
+
 class region
 {
     public:
@@ -38,23 +38,43 @@ hyperdex :: operator << (std::ostream& lhs, const network_msgtype& rhs)
         STRINGIFY(RESP_GET);
         STRINGIFY(REQ_ATOMIC);
         STRINGIFY(RESP_ATOMIC);
+        STRINGIFY(REQ_ATOMIC_BATCH);
+        STRINGIFY(REQ_MULTI_ATOMIC);
         STRINGIFY(REQ_SEARCH_START);
         STRINGIFY(REQ_SEARCH_NEXT);
         STRINGIFY(REQ_SEARCH_STOP);
         STRINGIFY(RESP_SEARCH_ITEM);
         STRINGIFY(RESP_SEARCH_DONE);
+        STRINGIFY(REQ_SEARCH_SPLITS);
+        STRINGIFY(RESP_SEARCH_SPLITS);
         STRINGIFY(REQ_SORTED_SEARCH);
         STRINGIFY(RESP_SORTED_SEARCH);
+        STRINGIFY(REQ_SORTED_SEARCH_NEXT);
+        STRINGIFY(REQ_SORTED_SEARCH_STOP);
+        STRINGIFY(REQ_EXPORT_START);
+        STRINGIFY(REQ_EXPORT_NEXT);
+        STRINGIFY(RESP_EXPORT_BATCH);
         STRINGIFY(REQ_GROUP_DEL);
         STRINGIFY(RESP_GROUP_DEL);
         STRINGIFY(REQ_COUNT);
         STRINGIFY(RESP_COUNT);
         STRINGIFY(REQ_SEARCH_DESCRIBE);
         STRINGIFY(RESP_SEARCH_DESCRIBE);
+        STRINGIFY(REQ_COUNT_APPROX);
+        STRINGIFY(RESP_COUNT_APPROX);
+        STRINGIFY(REQ_SAMPLE);
+        STRINGIFY(RESP_SAMPLE);
+        STRINGIFY(REQ_SUBSCRIBE);
+        STRINGIFY(REQ_SUBSCRIBE_STOP);
+        STRINGIFY(RESP_SUBSCRIBE_ITEM);
+        STRINGIFY(RESP_SUBSCRIBE_DONE);
+        STRINGIFY(REQ_GROUP_ATOMIC);
+        STRINGIFY(RESP_GROUP_ATOMIC);
         STRINGIFY(CHAIN_OP);
         STRINGIFY(CHAIN_SUBSPACE);
         STRINGIFY(CHAIN_ACK);
         STRINGIFY(CHAIN_GC);
+        STRINGIFY(CHAIN_BATCH);
         STRINGIFY(XFER_OP);
         STRINGIFY(XFER_ACK);
         STRINGIFY(CONFIGMISMATCH);
@@ -41,15 +41,25 @@ enum network_msgtype
 
     REQ_ATOMIC      = 16,
     RESP_ATOMIC     = 17,
+    REQ_ATOMIC_BATCH = 18,
+    REQ_MULTI_ATOMIC = 19,
 
     REQ_SEARCH_START    = 32,
     REQ_SEARCH_NEXT     = 33,
     REQ_SEARCH_STOP     = 34,
     RESP_SEARCH_ITEM    = 35,
     RESP_SEARCH_DONE    = 36,
+    REQ_SEARCH_SPLITS   = 37,
+    RESP_SEARCH_SPLITS  = 38,
 
-    REQ_SORTED_SEARCH   = 40,
-    RESP_SORTED_SEARCH  = 41,
+    REQ_SORTED_SEARCH       = 40,
+    RESP_SORTED_SEARCH      = 41,
+    REQ_SORTED_SEARCH_NEXT  = 42,
+    REQ_SORTED_SEARCH_STOP  = 43,
+
+    REQ_EXPORT_START    = 44,
+    REQ_EXPORT_NEXT     = 45,
+    RESP_EXPORT_BATCH   = 46,
 
     REQ_GROUP_DEL   = 48,
     RESP_GROUP_DEL  = 49,
@@ -60,10 +70,25 @@ enum network_msgtype
     REQ_SEARCH_DESCRIBE  = 52,
     RESP_SEARCH_DESCRIBE = 53,
 
+    REQ_COUNT_APPROX    = 54,
+    RESP_COUNT_APPROX   = 55,
+
+    REQ_SAMPLE      = 56,
+    RESP_SAMPLE     = 57,
+
+    REQ_SUBSCRIBE       = 58,
+    REQ_SUBSCRIBE_STOP  = 59,
+    RESP_SUBSCRIBE_ITEM = 60,
+    RESP_SUBSCRIBE_DONE = 61,
+
+    REQ_GROUP_ATOMIC    = 62,
+    RESP_GROUP_ATOMIC   = 63,
+
     CHAIN_OP        = 64,
     CHAIN_SUBSPACE  = 65,
     CHAIN_ACK       = 66,
     CHAIN_GC        = 67,
+    CHAIN_BATCH     = 68,
 
     XFER_OP  = 80,
     XFER_ACK = 81,
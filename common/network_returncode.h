@@ -42,7 +42,9 @@ enum network_returncode
     NET_CMPFAIL     = 8325,
     NET_BADMICROS   = 8326,
     NET_READONLY    = 8327,
-    NET_OVERFLOW    = 8328
+    NET_OVERFLOW    = 8328,
+    NET_STALE       = 8329,
+    NET_BADSEARCH   = 8330
 };
 
 } // namespace hyperdex
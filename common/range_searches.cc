@@ -27,9 +27,16 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <string.h>
+
+// STL
+#include <algorithm>
+
 // HyperDex
 #include "common/range_searches.h"
 #include "datatypes/compare.h"
+#include "datatypes/step.h"
 
 using hyperdex::attribute_check;
 using hyperdex::range;
@@ -41,6 +48,8 @@ range :: range()
     , end()
     , has_start(false)
     , has_end(false)
+    , prefix(false)
+    , points()
     , invalid(true)
 {
 }
@@ -52,6 +61,8 @@ range :: range(const range& other)
     , end(other.end)
     , has_start(other.has_start)
     , has_end(other.has_end)
+    , prefix(other.prefix)
+    , points(other.points)
     , invalid(other.invalid)
 {
 }
@@ -69,56 +80,277 @@ range :: operator = (const range& rhs)
     end = rhs.end;
     has_start = rhs.has_start;
     has_end = rhs.has_end;
+    prefix = rhs.prefix;
+    points = rhs.points;
     invalid = rhs.invalid;
     return *this;
 }
 
+bool
+range :: is_point() const
+{
+    return !invalid && has_start && has_end && !prefix &&
+           compare_as_type(start, end, type) == 0;
+}
+
+static bool
+is_prefix(const e::slice& prefix, const e::slice& value)
+{
+    return prefix.size() <= value.size() &&
+           memcmp(prefix.data(), value.data(), prefix.size()) == 0;
+}
+
+// Extract the literal prefix every match of an anchored regex must begin
+// with.  Unanchored patterns and patterns with alternation have no usable
+// prefix and get an empty slice.
+static e::slice
+regex_prefix(const e::slice& regex)
+{
+    const uint8_t* ptr = regex.data();
+    const uint8_t* end = ptr + regex.size();
+
+    if (ptr == end || *ptr != '^' ||
+        memchr(ptr, '|', regex.size()) != NULL)
+    {
+        return e::slice();
+    }
+
+    ++ptr;
+    const uint8_t* start = ptr;
+
+    while (ptr < end && strchr(".[]()*+?{}\\$^", *ptr) == NULL)
+    {
+        ++ptr;
+    }
+
+    // a quantifier makes the char before it optional
+    if (ptr < end && ptr > start && strchr("*?{", *ptr) != NULL)
+    {
+        --ptr;
+    }
+
+    return e::slice(start, ptr - start);
+}
+
+// the type of the attribute a check applies to
+static hyperdatatype
+check_type(const attribute_check& check)
+{
+    if (check.predicate == HYPERPREDICATE_IN)
+    {
+        return static_cast<hyperdatatype>(CONTAINER_ELEM(check.datatype));
+    }
+
+    return check.datatype;
+}
+
+class compare_slices
+{
+    public:
+        compare_slices(hyperdatatype t)
+            : m_type(t)
+        {
+        }
+
+    public:
+        bool operator () (const e::slice& lhs, const e::slice& rhs) const
+        {
+            return compare_as_type(lhs, rhs, m_type) < 0;
+        }
+
+    private:
+        hyperdatatype m_type;
+};
+
+// Parse an IN-list into sorted, distinct points
+static bool
+parse_points(const attribute_check& check, std::vector<e::slice>* points)
+{
+    hyperdatatype type = check_type(check);
+    const uint8_t* ptr = check.value.data();
+    const uint8_t* end = ptr + check.value.size();
+    points->clear();
+
+    if (CONTAINER_TYPE(check.datatype) != HYPERDATATYPE_LIST_GENERIC)
+    {
+        return false;
+    }
+
+    while (ptr < end)
+    {
+        e::slice elem;
+
+        if (!step_as_type(type, &ptr, end, &elem))
+        {
+            return false;
+        }
+
+        points->push_back(elem);
+    }
+
+    compare_slices cmp(type);
+    std::sort(points->begin(), points->end(), cmp);
+    std::vector<e::slice>::iterator it = points->begin();
+
+    for (size_t i = 0; i < points->size(); ++i)
+    {
+        if (it == points->begin() ||
+            compare_as_type(*(it - 1), (*points)[i], type) != 0)
+        {
+            *it = (*points)[i];
+            ++it;
+        }
+    }
+
+    points->resize(it - points->begin());
+    return true;
+}
+
+// The tightest bounds seen so far on one attribute.  When "upper_prefix" is
+// set, "upper" admits every value that begins with it.
+struct bounds
+{
+    bounds(hyperdatatype t)
+        : type(t)
+        , lower()
+        , upper()
+        , has_lower(false)
+        , has_upper(false)
+        , upper_prefix(false)
+    {
+    }
+    bool below_lower(const e::slice& v) const
+    {
+        return has_lower && compare_as_type(v, lower, type) < 0;
+    }
+    bool above_upper(const e::slice& v) const
+    {
+        return has_upper && compare_as_type(v, upper, type) > 0 &&
+               !(upper_prefix && is_prefix(upper, v));
+    }
+    hyperdatatype type;
+    e::slice lower;
+    e::slice upper;
+    bool has_lower;
+    bool has_upper;
+    bool upper_prefix;
+};
+
 static void
 range_search(const attribute_check* ptr,
              const attribute_check* end,
              range* r)
 {
     assert(ptr < end);
-    const attribute_check* lower = NULL;
-    const attribute_check* upper = NULL;
     *r = range();
     r->attr = ptr->attr;
-    r->type = ptr->datatype;
+    r->type = check_type(*ptr);
     r->has_start = false;
     r->has_end = false;
     r->invalid = true;
+    bounds b(r->type);
+    e::slice prefix;
+    std::vector<e::slice> in;
+    std::vector<e::slice> points;
+    bool has_points = false;
 
     while (ptr < end)
     {
         switch (ptr->predicate)
         {
             case HYPERPREDICATE_EQUALS:
-                if ((lower && compare_as_type(ptr->value, lower->value, ptr->datatype) < 0) ||
-                    (upper && compare_as_type(ptr->value, upper->value, ptr->datatype) > 0))
+                if (b.below_lower(ptr->value) || b.above_upper(ptr->value))
                 {
                     return;
                 }
-                lower = ptr;
-                upper = ptr;
+                b.lower = ptr->value;
+                b.upper = ptr->value;
+                b.has_lower = true;
+                b.has_upper = true;
+                b.upper_prefix = false;
                 break;
             case HYPERPREDICATE_LESS_EQUAL:
-                if (lower && compare_as_type(ptr->value, lower->value, ptr->datatype) < 0)
+                if (b.below_lower(ptr->value))
                 {
                     return;
                 }
-                if (!upper || compare_as_type(ptr->value, upper->value, ptr->datatype) < 0)
+                if (!b.has_upper ||
+                    (b.upper_prefix ? !b.above_upper(ptr->value)
+                                    : compare_as_type(ptr->value, b.upper, b.type) < 0))
                 {
-                    upper = ptr;
+                    b.upper = ptr->value;
+                    b.has_upper = true;
+                    b.upper_prefix = false;
                 }
                 break;
             case HYPERPREDICATE_GREATER_EQUAL:
-                if (upper && compare_as_type(ptr->value, upper->value, ptr->datatype) > 0)
+                if (b.above_upper(ptr->value))
+                {
+                    return;
+                }
+                if (!b.below_lower(ptr->value))
+                {
+                    b.lower = ptr->value;
+                    b.has_lower = true;
+                }
+                break;
+            case HYPERPREDICATE_PREFIX:
+            case HYPERPREDICATE_REGEX:
+                if (ptr->datatype != HYPERDATATYPE_STRING)
+                {
+                    return;
+                }
+                prefix = ptr->predicate == HYPERPREDICATE_PREFIX
+                       ? ptr->value : regex_prefix(ptr->value);
+                if (prefix.empty())
+                {
+                    break;
+                }
+                if (b.above_upper(prefix))
                 {
                     return;
                 }
-                if (!lower || compare_as_type(ptr->value, lower->value, ptr->datatype) > 0)
+                if (!b.below_lower(prefix))
+                {
+                    b.lower = prefix;
+                    b.has_lower = true;
+                }
+                if (!b.has_upper || (b.upper_prefix && is_prefix(b.upper, prefix)))
+                {
+                    b.upper = prefix;
+                    b.has_upper = true;
+                    b.upper_prefix = true;
+                }
+                else if (b.upper_prefix && !is_prefix(prefix, b.upper))
+                {
+                    return;
+                }
+                else if (!b.upper_prefix && !is_prefix(prefix, b.upper))
+                {
+                    // upper > prefix, else above_upper would have failed
+                    b.upper = prefix;
+                    b.upper_prefix = true;
+                }
+                break;
+            case HYPERPREDICATE_IN:
+                if (!parse_points(*ptr, &in))
+                {
+                    return;
+                }
+                if (has_points)
+                {
+                    std::vector<e::slice> both(std::min(in.size(), points.size()));
+                    both.resize(std::set_intersection(points.begin(), points.end(),
+                                                      in.begin(), in.end(),
+                                                      both.begin(),
+                                                      compare_slices(r->type))
+                                - both.begin());
+                    points.swap(both);
+                }
+                else
                 {
-                    lower = ptr;
+                    points.swap(in);
+                    has_points = true;
                 }
                 break;
             case HYPERPREDICATE_CONTAINS_LESS_THAN:
@@ -132,24 +364,52 @@ range_search(const attribute_check* ptr,
     }
 
     // ensure we have found a valid range
-    if (lower && upper &&
-        compare_as_type(lower->value, upper->value, ptr->datatype) > 0)
+    if (b.has_lower && b.above_upper(b.lower))
     {
         return;
     }
 
+    if (has_points)
+    {
+        std::vector<e::slice>::iterator it = points.begin();
+
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            if (!b.below_lower(points[i]) && !b.above_upper(points[i]))
+            {
+                *it = points[i];
+                ++it;
+            }
+        }
+
+        points.resize(it - points.begin());
+
+        if (points.empty())
+        {
+            return;
+        }
+
+        b.lower = points.front();
+        b.upper = points.back();
+        b.has_lower = true;
+        b.has_upper = true;
+        b.upper_prefix = false;
+        r->points.swap(points);
+    }
+
     r->invalid = false;
 
-    if (lower)
+    if (b.has_lower)
     {
         r->has_start = true;
-        r->start = lower->value;
+        r->start = b.lower;
     }
 
-    if (upper)
+    if (b.has_upper)
     {
         r->has_end = true;
-        r->end = upper->value;
+        r->end = b.upper;
+        r->prefix = b.upper_prefix;
     }
 }
 
@@ -167,7 +427,7 @@ hyperdex :: range_searches(const std::vector<attribute_check>& checks,
 
         while (tmp < check_end && check_ptr->attr == tmp->attr)
         {
-            if (check_ptr->datatype != tmp->datatype)
+            if (check_type(*check_ptr) != check_type(*tmp))
             {
                 return false;
             }
@@ -184,3 +444,36 @@ hyperdex :: range_searches(const std::vector<attribute_check>& checks,
 
     return true;
 }
+
+void
+hyperdex :: range_prefix(const std::vector<range>& ranges,
+                         const std::vector<uint16_t>& attrs,
+                         std::vector<const range*>* prefix)
+{
+    prefix->clear();
+
+    for (size_t i = 0; i < attrs.size(); ++i)
+    {
+        const range* r = NULL;
+
+        for (size_t j = 0; !r && j < ranges.size(); ++j)
+        {
+            if (ranges[j].attr == attrs[i] && !ranges[j].invalid)
+            {
+                r = &ranges[j];
+            }
+        }
+
+        if (!r)
+        {
+            return;
+        }
+
+        prefix->push_back(r);
+
+        if (!r->is_point())
+        {
+            return;
+        }
+    }
+}
@@ -28,6 +28,9 @@
 #ifndef hyperdex_common_range_searches_h_
 #define hyperdex_common_range_searches_h_
 
+// STL
+#include <vector>
+
 // e
 #include <e/slice.h>
 
@@ -37,7 +40,9 @@
 namespace hyperdex
 {
 
-// a range is inclusive
+// a range is inclusive; when "prefix" is set, "end" admits every value that
+// begins with it.  When "points" is non-empty, the range is the union of the
+// (sorted, distinct) values in it, and start/end are its first/last point.
 class range
 {
     public:
@@ -47,6 +52,8 @@ class range
 
     public:
         range& operator = (const range& rhs);
+        // the range admits exactly one value
+        bool is_point() const;
 
     public:
         uint16_t attr;
@@ -55,6 +62,8 @@ class range
         e::slice end;
         bool has_start;
         bool has_end;
+        bool prefix;
+        std::vector<e::slice> points;
         bool invalid;
 };
 
@@ -62,6 +71,14 @@ bool
 range_searches(const std::vector<attribute_check>& checks,
                std::vector<range>* ranges);
 
+// The ranges that an index ordered by "attrs" can scan as one run of entries:
+// a range on each of the first attributes in turn, each but the last of which
+// admits a single value.  Empty when the first attribute is unconstrained.
+void
+range_prefix(const std::vector<range>& ranges,
+             const std::vector<uint16_t>& attrs,
+             std::vector<const range*>* prefix);
+
 }
 
 #endif // hyperdex_common_range_searches_h_
@@ -228,6 +228,36 @@ hyperdex_coordinator_rm_space(struct replicant_state_machine_context* ctx,
     c->rm_space(ctx, data);
 }
 
+void
+hyperdex_coordinator_add_index(struct replicant_state_machine_context* ctx,
+                               void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    coordinator* c = static_cast<coordinator*>(obj);
+    e::slice name;
+    hyperdex::index idx;
+    e::unpacker up(data, data_sz);
+    up = up >> name >> idx;
+    CHECK_UNPACK(add_index);
+    c->add_index(ctx, std::string(reinterpret_cast<const char*>(name.data()), name.size()), idx);
+}
+
+void
+hyperdex_coordinator_rm_index(struct replicant_state_machine_context* ctx,
+                              void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    coordinator* c = static_cast<coordinator*>(obj);
+    e::slice name;
+    uint16_t id;
+    e::unpacker up(data, data_sz);
+    up = up >> name >> id;
+    CHECK_UNPACK(rm_index);
+    c->rm_index(ctx, std::string(reinterpret_cast<const char*>(name.data()), name.size()), id);
+}
+
 void
 hyperdex_coordinator_get_config(struct replicant_state_machine_context* ctx,
                                 void* obj, const char* data, size_t data_sz)
@@ -392,6 +422,7 @@ coordinator :: coordinator()
     , m_acked(0)
     , m_servers()
     , m_spaces()
+    , m_index_ids()
     , m_captures()
     , m_transfers()
     , m_missing_acks()
@@ -474,7 +505,15 @@ coordinator :: add_space(replicant_state_machine_context* ctx, const space& _s)
         }
     }
 
+    uint16_t next_index = s->sc.attrs_sz;
+
+    for (size_t i = 0; i < s->indices.size(); ++i)
+    {
+        next_index = std::max(next_index, static_cast<uint16_t>(s->indices[i].id + 1));
+    }
+
     m_spaces.insert(std::make_pair(std::string(s->name), s));
+    m_index_ids[std::string(s->name)] = next_index;
     initial_layout(ctx, s.get());
     fprintf(log, "successfully added space \"%s\" with space_id(%lu)\n", s->name, s->id.get());
     issue_new_config(ctx);
@@ -497,11 +536,86 @@ coordinator :: rm_space(replicant_state_machine_context* ctx, const char* name)
     {
         fprintf(log, "successfully removed space \"%s\"/space_id(%lu)\n", name, it->second->id.get());
         m_spaces.erase(it);
+        m_index_ids.erase(std::string(name));
         issue_new_config(ctx);
         return generate_response(ctx, COORD_SUCCESS);
     }
 }
 
+void
+coordinator :: add_index(replicant_state_machine_context* ctx,
+                         const std::string& name, const index& _idx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    std::map<std::string, std::tr1::shared_ptr<space> >::iterator it;
+    it = m_spaces.find(name);
+
+    if (it == m_spaces.end())
+    {
+        fprintf(log, "could not add index to space \"%s\" because it doesn't exist\n", name.c_str());
+        return generate_response(ctx, COORD_NOT_FOUND);
+    }
+
+    uint16_t id = m_index_ids[name];
+
+    if (id == UINT16_MAX)
+    {
+        fprintf(log, "could not add index to space \"%s\" because it has run out of index ids\n", name.c_str());
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    space s(*it->second);
+    s.indices.push_back(_idx);
+    s.indices.back().id = id;
+
+    if (!s.validate())
+    {
+        fprintf(log, "could not add index to space \"%s\" because the index does not validate\n", name.c_str());
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    // Daemons maintain the index from this configuration on, and backfill it
+    // for the objects they already hold before searches use it.
+    *it->second = s;
+    m_index_ids[name] = id + 1;
+    fprintf(log, "successfully added index %u to space \"%s\"\n", id, name.c_str());
+    issue_new_config(ctx);
+    m_resp.reset(e::buffer::create(sizeof(uint16_t) + sizeof(uint16_t)));
+    *m_resp << static_cast<uint16_t>(COORD_SUCCESS) << id;
+    replicant_state_machine_set_response(ctx, reinterpret_cast<const char*>(m_resp->data()), m_resp->size());
+}
+
+void
+coordinator :: rm_index(replicant_state_machine_context* ctx,
+                        const std::string& name, uint16_t id)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    std::map<std::string, std::tr1::shared_ptr<space> >::iterator it;
+    it = m_spaces.find(name);
+
+    if (it == m_spaces.end())
+    {
+        fprintf(log, "could not remove index from space \"%s\" because it doesn't exist\n", name.c_str());
+        return generate_response(ctx, COORD_NOT_FOUND);
+    }
+
+    std::vector<index>& indices(it->second->indices);
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i].id == id)
+        {
+            indices.erase(indices.begin() + i);
+            fprintf(log, "successfully removed index %u from space \"%s\"\n", id, name.c_str());
+            issue_new_config(ctx);
+            return generate_response(ctx, COORD_SUCCESS);
+        }
+    }
+
+    fprintf(log, "could not remove index %u from space \"%s\" because it doesn't exist\n", id, name.c_str());
+    return generate_response(ctx, COORD_NOT_FOUND);
+}
+
 void
 coordinator :: get_config(replicant_state_machine_context* ctx)
 {
@@ -35,6 +35,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -70,6 +71,11 @@ class coordinator
         // Manage spaces
         void add_space(replicant_state_machine_context* ctx, const space& s);
         void rm_space(replicant_state_machine_context* ctx, const char* name);
+        // Manage the explicit indices of an existing space
+        void add_index(replicant_state_machine_context* ctx,
+                       const std::string& name, const index& idx);
+        void rm_index(replicant_state_machine_context* ctx,
+                      const std::string& name, uint16_t id);
         // Issue configs
         void get_config(replicant_state_machine_context* ctx);
         void ack_config(replicant_state_machine_context* ctx, const server_id&, uint64_t version);
@@ -138,6 +144,9 @@ class coordinator
         uint64_t m_acked;
         std::vector<server_state> m_servers;
         std::map<std::string, std::tr1::shared_ptr<space> > m_spaces;
+        // the id for the next index of each space; ids are never reused so
+        // that a daemon never confuses a new index with a dropped one
+        std::map<std::string, uint16_t> m_index_ids;
         std::vector<capture> m_captures;
         std::vector<transfer> m_transfers;
         std::list<missing_acks> m_missing_acks;
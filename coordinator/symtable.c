@@ -51,6 +51,8 @@ struct replicant_state_machine rsm = {
 
      {"add-space", hyperdex_coordinator_add_space},
      {"rm-space", hyperdex_coordinator_rm_space},
+     {"add-index", hyperdex_coordinator_add_index},
+     {"rm-index", hyperdex_coordinator_rm_index},
 
      {"initialize", hyperdex_coordinator_initialize},
      {NULL, NULL}}
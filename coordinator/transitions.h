@@ -59,6 +59,8 @@ TRANSITION(initialize);
 
 TRANSITION(add_space);
 TRANSITION(rm_space);
+TRANSITION(add_index);
+TRANSITION(rm_index);
 
 TRANSITION(get_config);
 TRANSITION(ack_config);
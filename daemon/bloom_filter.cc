@@ -0,0 +1,88 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// CityHash
+#include <city.h>
+
+// HyperDex
+#include "daemon/bloom_filter.h"
+
+using hyperdex::bloom_filter;
+
+bloom_filter :: bloom_filter(uint64_t bits, unsigned hashes)
+    : m_bits((bits + 63) & ~63ULL)
+    , m_hashes(hashes)
+    , m_words(m_bits / 64, 0)
+    , m_inserted(0)
+{
+}
+
+bloom_filter :: ~bloom_filter() throw ()
+{
+}
+
+void
+bloom_filter :: insert(const e::slice& key)
+{
+    uint64_t hash = CityHash64(reinterpret_cast<const char*>(key.data()), key.size());
+
+    for (unsigned i = 0; i < m_hashes; ++i)
+    {
+        uint64_t b = bit(hash, i);
+        __sync_fetch_and_or(&m_words[b / 64], 1ULL << (b % 64));
+    }
+
+    __sync_fetch_and_add(&m_inserted, 1);
+}
+
+bool
+bloom_filter :: may_contain(const e::slice& key) const
+{
+    uint64_t hash = CityHash64(reinterpret_cast<const char*>(key.data()), key.size());
+
+    for (unsigned i = 0; i < m_hashes; ++i)
+    {
+        uint64_t b = bit(hash, i);
+
+        if (!(m_words[b / 64] & (1ULL << (b % 64))))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint64_t
+bloom_filter :: bit(uint64_t hash, unsigned i) const
+{
+    // derive the i-th hash from the two halves of one 64-bit hash
+    uint64_t h1 = hash & 0xffffffffULL;
+    uint64_t h2 = hash >> 32;
+    return (h1 + i * h2) % m_bits;
+}
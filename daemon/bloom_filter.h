@@ -0,0 +1,77 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_bloom_filter_h_
+#define hyperdex_daemon_bloom_filter_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+namespace hyperdex
+{
+
+// A fixed-size Bloom filter over byte strings.  Inserts and lookups may run
+// concurrently:  bits are only ever set, and they are set atomically.
+class bloom_filter
+{
+    public:
+        // bits is rounded up to a multiple of 64
+        bloom_filter(uint64_t bits, unsigned hashes);
+        ~bloom_filter() throw ();
+
+    public:
+        void insert(const e::slice& key);
+        // false means the key was never inserted
+        bool may_contain(const e::slice& key) const;
+        uint64_t bits() const { return m_bits; }
+        // calls to insert so far, counting repeats of the same key
+        uint64_t inserted() const { return m_inserted; }
+
+    private:
+        uint64_t bit(uint64_t hash, unsigned i) const;
+
+    private:
+        uint64_t m_bits;
+        unsigned m_hashes;
+        std::vector<uint64_t> m_words;
+        uint64_t m_inserted;
+
+    private:
+        bloom_filter(const bloom_filter&);
+        bloom_filter& operator = (const bloom_filter&);
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_bloom_filter_h_
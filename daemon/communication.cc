@@ -31,13 +31,33 @@
 #include "config.h"
 #endif
 
+// POSIX
+#include <signal.h>
+
+// C
+#include <string.h>
+
+// STL
+#include <utility>
+#include <tr1/functional>
+
 // Google Log
 #include <glog/logging.h>
 
+// e
+#include <e/endian.h>
+#include <e/time.h>
+
 // HyperDex
 #include "daemon/communication.h"
 #include "daemon/daemon.h"
 
+// Flush a batch once it holds this many bytes of messages
+#define BATCH_FLUSH_BYTES 65536
+// or once its oldest message has waited this many nanoseconds.  A message to a
+// server nothing has been sent to for this long goes out at once.
+#define BATCH_FLUSH_DELAY 100000ULL
+
 using hyperdex::communication;
 using hyperdex::reconfigure_returncode;
 
@@ -77,6 +97,34 @@ communication :: early_message :: ~early_message() throw ()
 {
 }
 
+//////////////////////////////////// Batches ///////////////////////////////////
+
+class communication::batch
+{
+    public:
+        batch();
+        ~batch() throw ();
+
+    public:
+        uint64_t deadline;
+        uint64_t last_sent;
+        // a batch sent by the flusher was lost; reported by the next enqueue
+        bool failed;
+        std::vector<char> frames;
+};
+
+communication :: batch :: batch()
+    : deadline(0)
+    , last_sent(0)
+    , failed(false)
+    , frames()
+{
+}
+
+communication :: batch :: ~batch() throw ()
+{
+}
+
 ///////////////////////////////// Public Class /////////////////////////////////
 
 communication :: communication(daemon* d)
@@ -84,6 +132,13 @@ communication :: communication(daemon* d)
     , m_busybee_mapper(&m_daemon->m_config)
     , m_busybee()
     , m_early_messages()
+    , m_unbatched()
+    , m_unbatched_count(0)
+    , m_batch_lock()
+    , m_wakeup_flusher(&m_batch_lock)
+    , m_batches()
+    , m_shutdown(true)
+    , m_flusher(std::tr1::bind(&communication::flusher, this))
 {
 }
 
@@ -91,18 +146,43 @@ communication :: ~communication() throw ()
 {
 }
 
+void
+communication :: pause()
+{
+    // Messages queued in the old configuration should not be held across the
+    // reconfiguration.
+    flush_batches(true);
+    m_busybee->pause();
+}
+
+void
+communication :: shutdown()
+{
+    {
+        po6::threads::mutex::hold hold(&m_batch_lock);
+        m_wakeup_flusher.broadcast();
+        m_shutdown = true;
+    }
+
+    m_busybee->shutdown();
+}
+
 bool
 communication :: setup(const po6::net::location& bind_to,
                        unsigned threads)
 {
     m_busybee.reset(new busybee_mta(&m_busybee_mapper, bind_to, m_daemon->m_us.get(), threads));
     m_busybee->set_ignore_signals();
+    po6::threads::mutex::hold hold(&m_batch_lock);
+    m_shutdown = false;
+    m_flusher.start();
     return true;
 }
 
 void
 communication :: teardown()
 {
+    m_flusher.join();
 }
 
 void
@@ -373,6 +453,12 @@ communication :: send_exact(const virtual_server_id& from,
     LOG(INFO) << "SEND " << from << "->" << vto << " " << msg_type << " " << msg->hex();
 #endif
 
+    if (to != m_daemon->m_us &&
+        (msg_type == CHAIN_OP || msg_type == CHAIN_SUBSPACE || msg_type == CHAIN_ACK))
+    {
+        return enqueue_batched(to, msg);
+    }
+
     if (to == m_daemon->m_us)
     {
         m_busybee->deliver(to.get(), msg);
@@ -420,26 +506,45 @@ communication :: recv(server_id* from,
     while (true)
     {
         uint64_t id;
-        busybee_returncode rc = m_busybee->recv(&id, msg);
+        early_message em;
 
-        switch (rc)
+        // Messages split out of a CHAIN_BATCH take priority over the network
+        if (m_unbatched.pop(&em))
         {
-            case BUSYBEE_SUCCESS:
-                break;
-            case BUSYBEE_SHUTDOWN:
-                return false;
-            case BUSYBEE_DISRUPTED:
-                handle_disruption(id);
-                continue;
-            case BUSYBEE_INTERRUPTED:
-                continue;
-            case BUSYBEE_POLLFAILED:
-            case BUSYBEE_ADDFDFAIL:
-            case BUSYBEE_TIMEOUT:
-            case BUSYBEE_EXTERNAL:
-            default:
-                LOG(ERROR) << "busybee unexpectedly returned " << rc;
-                continue;
+            __sync_sub_and_fetch(&m_unbatched_count, 1);
+            id = em.id;
+            *msg = em.msg;
+        }
+        else
+        {
+            busybee_returncode rc = m_busybee->recv(&id, msg);
+
+            switch (rc)
+            {
+                case BUSYBEE_SUCCESS:
+                    break;
+                case BUSYBEE_SHUTDOWN:
+                    return false;
+                case BUSYBEE_DISRUPTED:
+                    handle_disruption(id);
+                    continue;
+                case BUSYBEE_INTERRUPTED:
+                    continue;
+                case BUSYBEE_POLLFAILED:
+                case BUSYBEE_ADDFDFAIL:
+                case BUSYBEE_TIMEOUT:
+                case BUSYBEE_EXTERNAL:
+                default:
+                    LOG(ERROR) << "busybee unexpectedly returned " << rc;
+                    continue;
+            }
+        }
+
+        if ((*msg)->size() > BUSYBEE_HEADER_SIZE &&
+            (*msg)->data()[BUSYBEE_HEADER_SIZE] == static_cast<uint8_t>(CHAIN_BATCH))
+        {
+            unpack_batch(id, *msg);
+            continue;
         }
 
         uint8_t mt;
@@ -522,3 +627,264 @@ communication :: handle_disruption(uint64_t id)
         // m_daemon->m_stm.retransmit(server_id(id));
     }
 }
+
+bool
+communication :: enqueue_batched(const server_id& to, std::auto_ptr<e::buffer> msg)
+{
+    const size_t sz = msg->size() - BUSYBEE_HEADER_SIZE;
+    std::vector<char> ready;
+    bool immediate = false;
+    bool failed = false;
+
+    {
+        po6::threads::mutex::hold hold(&m_batch_lock);
+        batch& b(m_batches[to.get()]);
+        uint64_t now = e::time();
+        failed = b.failed;
+        b.failed = false;
+
+        if (b.frames.empty() && b.last_sent + BATCH_FLUSH_DELAY <= now)
+        {
+            // the link is idle, so there is nothing to wait for
+            b.last_sent = now;
+            immediate = true;
+        }
+        else
+        {
+            if (b.frames.empty())
+            {
+                b.deadline = now + BATCH_FLUSH_DELAY;
+                m_wakeup_flusher.signal();
+            }
+
+            size_t off = b.frames.size();
+            b.frames.resize(off + sizeof(uint32_t) + sz);
+            e::pack32be(static_cast<uint32_t>(sz), &b.frames[off]);
+            memmove(&b.frames[off + sizeof(uint32_t)], msg->data() + BUSYBEE_HEADER_SIZE, sz);
+
+            if (b.frames.size() >= BATCH_FLUSH_BYTES)
+            {
+                ready.swap(b.frames);
+                b.last_sent = now;
+            }
+        }
+    }
+
+    if (failed)
+    {
+        LOG(WARNING) << "an earlier batch of chain messages to " << to << " was not sent";
+    }
+
+    if (immediate)
+    {
+        return send_busybee(to.get(), msg) && !failed;
+    }
+
+    if (!ready.empty())
+    {
+        return send_batch(to.get(), ready) && !failed;
+    }
+
+    return !failed;
+}
+
+bool
+communication :: send_batch(uint64_t id, const std::vector<char>& frames)
+{
+    const size_t sz = BUSYBEE_HEADER_SIZE + sizeof(uint8_t) + frames.size();
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->resize(sz);
+    msg->data()[BUSYBEE_HEADER_SIZE] = static_cast<uint8_t>(CHAIN_BATCH);
+    memmove(msg->data() + BUSYBEE_HEADER_SIZE + sizeof(uint8_t), &frames.front(), frames.size());
+    return send_busybee(id, msg);
+}
+
+bool
+communication :: send_busybee(uint64_t id, std::auto_ptr<e::buffer> msg)
+{
+    busybee_returncode rc = m_busybee->send(id, msg);
+
+    switch (rc)
+    {
+        case BUSYBEE_SUCCESS:
+            break;
+        case BUSYBEE_DISRUPTED:
+            handle_disruption(id);
+            return false;
+        case BUSYBEE_SHUTDOWN:
+        case BUSYBEE_POLLFAILED:
+        case BUSYBEE_ADDFDFAIL:
+        case BUSYBEE_TIMEOUT:
+        case BUSYBEE_EXTERNAL:
+        case BUSYBEE_INTERRUPTED:
+        default:
+            LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
+            return false;
+    }
+
+    return true;
+}
+
+bool
+communication :: unpack_batch(uint64_t id, std::auto_ptr<e::buffer> msg)
+{
+    const char* ptr = reinterpret_cast<const char*>(msg->data()) + BUSYBEE_HEADER_SIZE + sizeof(uint8_t);
+    const char* end = reinterpret_cast<const char*>(msg->data()) + msg->size();
+    size_t count = 0;
+
+    while (ptr < end)
+    {
+        uint32_t sz;
+
+        if (static_cast<size_t>(end - ptr) < sizeof(uint32_t))
+        {
+            break;
+        }
+
+        ptr = e::unpack32be(ptr, &sz);
+
+        if (static_cast<size_t>(end - ptr) < sz)
+        {
+            break;
+        }
+
+        std::auto_ptr<e::buffer> m(e::buffer::create(BUSYBEE_HEADER_SIZE + sz));
+        m->resize(BUSYBEE_HEADER_SIZE + sz);
+        memmove(m->data() + BUSYBEE_HEADER_SIZE, ptr, sz);
+        ptr += sz;
+        early_message em(0, id, m);
+        __sync_add_and_fetch(&m_unbatched_count, 1);
+        m_unbatched.push(em);
+        ++count;
+    }
+
+    // The first message will be picked up by this thread; get other threads
+    // working on the rest.
+    for (size_t i = 1; i < count; ++i)
+    {
+        m_busybee->wake_one();
+    }
+
+    if (ptr != end)
+    {
+        LOG(WARNING) << "dropping the tail of a malformed CHAIN_BATCH; here's some hex: " << msg->hex();
+        return false;
+    }
+
+    return true;
+}
+
+void
+communication :: flush_batches(bool force)
+{
+    std::vector<std::pair<uint64_t, std::vector<char> > > ready;
+
+    {
+        po6::threads::mutex::hold hold(&m_batch_lock);
+        uint64_t now = e::time();
+
+        for (batch_map_t::iterator it = m_batches.begin();
+                it != m_batches.end(); ++it)
+        {
+            if (!it->second.frames.empty() &&
+                (force || it->second.deadline <= now))
+            {
+                ready.push_back(std::make_pair(it->first, std::vector<char>()));
+                ready.back().second.swap(it->second.frames);
+                it->second.last_sent = now;
+            }
+        }
+    }
+
+    std::vector<uint64_t> failed;
+
+    for (size_t i = 0; i < ready.size(); ++i)
+    {
+        if (!send_batch(ready[i].first, ready[i].second))
+        {
+            LOG(WARNING) << "could not send " << ready[i].second.size()
+                         << " bytes of batched chain messages to server "
+                         << ready[i].first;
+            failed.push_back(ready[i].first);
+        }
+    }
+
+    if (!failed.empty())
+    {
+        po6::threads::mutex::hold hold(&m_batch_lock);
+
+        for (size_t i = 0; i < failed.size(); ++i)
+        {
+            m_batches[failed[i]].failed = true;
+        }
+    }
+}
+
+void
+communication :: flusher()
+{
+    LOG(INFO) << "batch flusher thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        uint64_t deadline = 0;
+
+        {
+            po6::threads::mutex::hold hold(&m_batch_lock);
+
+            while (!m_shutdown)
+            {
+                deadline = 0;
+
+                for (batch_map_t::iterator it = m_batches.begin();
+                        it != m_batches.end(); ++it)
+                {
+                    if (!it->second.frames.empty() &&
+                        (deadline == 0 || it->second.deadline < deadline))
+                    {
+                        deadline = it->second.deadline;
+                    }
+                }
+
+                if (deadline != 0)
+                {
+                    break;
+                }
+
+                m_wakeup_flusher.wait();
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+        }
+
+        uint64_t now = e::time();
+
+        if (deadline > now)
+        {
+            timespec ts;
+            ts.tv_sec = (deadline - now) / 1000000000ULL;
+            ts.tv_nsec = (deadline - now) % 1000000000ULL;
+            nanosleep(&ts, NULL);
+        }
+
+        flush_batches(false);
+    }
+
+    LOG(INFO) << "batch flusher thread shutting down";
+}
@@ -29,7 +29,14 @@
 #define hyperdex_daemon_communication_h_
 
 // STL
+#include <map>
 #include <memory>
+#include <vector>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
 
 // BusyBee
 #include <busybee_constants.h>
@@ -72,10 +79,12 @@ class communication
         ~communication() throw ();
 
     public:
-        void pause() { m_busybee->pause(); }
+        void pause();
         void unpause() { m_busybee->unpause(); }
-        void shutdown() { m_busybee->shutdown(); }
+        void shutdown();
         void wake_one() { m_busybee->wake_one(); }
+        // true if messages from a CHAIN_BATCH are waiting to be received
+        bool has_queued_messages() const { return m_unbatched_count > 0; }
 
     public:
         bool setup(const po6::net::location& bind_to,
@@ -114,9 +123,21 @@ class communication
 
     private:
         class early_message;
+        class batch;
+        typedef std::map<uint64_t, batch> batch_map_t;
 
     private:
         void handle_disruption(uint64_t id);
+        // Chain messages to other servers are appended to a per-server batch
+        // that goes out as a single CHAIN_BATCH frame once it is large enough
+        // or old enough.  Returns false if this message, or a batch flushed
+        // since the last call for this server, could not be sent.
+        bool enqueue_batched(const server_id& to, std::auto_ptr<e::buffer> msg);
+        bool send_batch(uint64_t id, const std::vector<char>& frames);
+        bool send_busybee(uint64_t id, std::auto_ptr<e::buffer> msg);
+        bool unpack_batch(uint64_t id, std::auto_ptr<e::buffer> msg);
+        void flush_batches(bool force);
+        void flusher();
 
     private:
         communication(const communication&);
@@ -127,6 +148,13 @@ class communication
         mapper m_busybee_mapper;
         std::auto_ptr<busybee_mta> m_busybee;
         e::lockfree_fifo<early_message> m_early_messages;
+        e::lockfree_fifo<early_message> m_unbatched;
+        uint64_t m_unbatched_count;
+        po6::threads::mutex m_batch_lock;
+        po6::threads::cond m_wakeup_flusher;
+        batch_map_t m_batches;
+        bool m_shutdown;
+        po6::threads::thread m_flusher;
 };
 
 } // namespace hyperdex
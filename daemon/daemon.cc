@@ -29,6 +29,7 @@
 #include <signal.h>
 
 // STL
+#include <algorithm>
 #include <sstream>
 
 // Google Log
@@ -42,6 +43,7 @@
 #include "common/coordinator_returncode.h"
 #include "common/serialization.h"
 #include "daemon/daemon.h"
+#include "daemon/daemon_worker.h"
 
 using hyperdex::daemon;
 
@@ -74,15 +76,66 @@ dummy(int /*signum*/)
 {
 }
 
+// Pin the calling thread to "core" and block the signals the main thread
+// handles
+static bool
+prepare_thread(size_t core)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    pthread_t cur = pthread_self();
+    int x = pthread_setaffinity_np(cur, sizeof(cpu_set_t), &cpuset);
+    assert(x == 0);
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return false;
+    }
+
+    sigdelset(&ss, SIGPROF);
+
+    if (pthread_sigmask(SIG_SETMASK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return false;
+    }
+
+    return true;
+}
+
+// Region workers each get a core of their own at the top of the range, and
+// network threads share the cores below them.  With too few cores to go
+// around, everything shares.
+static size_t
+network_core(size_t thread, size_t workers)
+{
+    size_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t shared = workers < cores ? cores - workers : cores;
+    return thread % shared;
+}
+
+static size_t
+worker_core(size_t worker, size_t workers)
+{
+    size_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return workers < cores ? cores - workers + worker : worker % cores;
+}
+
 daemon :: daemon()
     : m_us()
     , m_threads()
+    , m_workers()
+    , m_worker_threads()
     , m_coord(this)
     , m_data(this)
     , m_comm(this)
     , m_repl(this)
     , m_stm(this)
     , m_sm(this)
+    , m_subs(this)
     , m_config()
 {
 }
@@ -126,7 +179,10 @@ daemon :: run(bool daemonize,
               po6::net::location bind_to,
               bool set_coordinator,
               po6::net::hostname coordinator,
-              unsigned threads)
+              unsigned threads,
+              unsigned workers,
+              size_t query_cache,
+              size_t profile_searches)
 {
     if (!install_signal_handler(SIGHUP, exit_on_signal))
     {
@@ -270,15 +326,45 @@ daemon :: run(bool daemonize,
     }
 
     m_comm.setup(bind_to, threads);
-    m_repl.setup();
+    // without workers, network threads share the partitions, so give them
+    // as many as there are threads to spread the ack bookkeeping
+    m_repl.setup(workers > 0 ? workers : std::max(threads, 1U));
     m_stm.setup();
-    m_sm.setup();
+    m_sm.setup(query_cache, profile_searches);
+    m_subs.setup();
+
+    for (size_t i = 0; i < workers; ++i)
+    {
+        m_workers.push_back(std::tr1::shared_ptr<worker>(new worker()));
+    }
+
+    if (workers > 0 && static_cast<long>(workers) >= sysconf(_SC_NPROCESSORS_ONLN))
+    {
+        LOG(WARNING) << "there are too few cores for each of the " << workers
+                     << " region workers to have its own; they will share with"
+                     << " the network threads";
+    }
 
     for (size_t i = 0; i < threads; ++i)
     {
         std::tr1::shared_ptr<po6::threads::thread> t(new po6::threads::thread(std::tr1::bind(&daemon::loop, this, i)));
         m_threads.push_back(t);
-        t->start();
+    }
+
+    for (size_t i = 0; i < workers; ++i)
+    {
+        std::tr1::shared_ptr<po6::threads::thread> t(new po6::threads::thread(std::tr1::bind(&daemon::worker_loop, this, i)));
+        m_worker_threads.push_back(t);
+    }
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i]->start();
+    }
+
+    for (size_t i = 0; i < m_worker_threads.size(); ++i)
+    {
+        m_worker_threads[i]->start();
     }
 
     while (!m_coord.exit_wait_loop())
@@ -305,11 +391,20 @@ daemon :: run(bool daemonize,
         m_repl.pause();
         m_data.pause();
         m_comm.pause();
+
+        // messages handed to region workers were checked against the old
+        // configuration, so they must be processed before it changes
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            m_workers[i]->drain();
+        }
+
         m_data.reconfigure(old_config, new_config, m_us);
         m_comm.reconfigure(old_config, new_config, m_us);
         m_repl.reconfigure(old_config, new_config, m_us);
         m_stm.reconfigure(old_config, new_config, m_us);
         m_sm.reconfigure(old_config, new_config, m_us);
+        m_subs.reconfigure(old_config, new_config, m_us);
         m_config = new_config;
         m_comm.unpause();
         m_data.unpause();
@@ -328,6 +423,12 @@ daemon :: run(bool daemonize,
         m_threads[i]->join();
     }
 
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        m_workers[i]->shutdown();
+        m_worker_threads[i]->join();
+    }
+
     m_coord.shutdown();
 
     if (m_coord.is_clean_shutdown())
@@ -335,6 +436,7 @@ daemon :: run(bool daemonize,
         LOG(INFO) << "hyperdex-daemon is gracefully shutting down";
     }
 
+    m_subs.teardown();
     m_sm.teardown();
     m_stm.teardown();
     m_repl.teardown();
@@ -358,32 +460,53 @@ daemon :: run(bool daemonize,
 void
 daemon :: loop(size_t thread)
 {
-    sigset_t ss;
+    size_t core = network_core(thread, m_workers.size());
 
-    size_t core = thread % sysconf(_SC_NPROCESSORS_ONLN);
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core, &cpuset);
-    pthread_t cur = pthread_self();
-    int x = pthread_setaffinity_np(cur, sizeof(cpu_set_t), &cpuset);
-    assert(x == 0);
+    if (!prepare_thread(core))
+    {
+        return;
+    }
 
     LOG(INFO) << "network thread " << thread << " started on core " << core;
+    server_id from;
+    virtual_server_id vfrom;
+    virtual_server_id vto;
+    network_msgtype type;
+    std::auto_ptr<e::buffer> msg;
+    e::unpacker up;
 
-    if (sigfillset(&ss) < 0)
+    while (m_comm.recv(&from, &vfrom, &vto, &type, &msg, &up))
     {
-        PLOG(ERROR) << "sigfillset";
-        return;
+        assert(from != server_id());
+        assert(vto != virtual_server_id());
+
+        if (!steer(from, vfrom, vto, type, &msg, up))
+        {
+            process_message(from, vfrom, vto, type, msg, up);
+        }
+
+        // with workers, only they queue acks
+        if (m_workers.empty())
+        {
+            m_repl.flush_acks(!m_comm.has_queued_messages());
+        }
     }
 
-    sigdelset(&ss, SIGPROF);
+    LOG(INFO) << "network thread shutting down";
+}
 
-    if (pthread_sigmask(SIG_SETMASK, &ss, NULL) < 0)
+void
+daemon :: worker_loop(size_t w)
+{
+    size_t core = worker_core(w, m_workers.size());
+
+    if (!prepare_thread(core))
     {
-        PLOG(ERROR) << "could not block signals";
         return;
     }
 
+    LOG(INFO) << "region worker " << w << " started on core " << core;
+    worker* wk = m_workers[w].get();
     server_id from;
     virtual_server_id vfrom;
     virtual_server_id vto;
@@ -391,75 +514,168 @@ daemon :: loop(size_t thread)
     std::auto_ptr<e::buffer> msg;
     e::unpacker up;
 
-    while (m_comm.recv(&from, &vfrom, &vto, &type, &msg, &up))
+    while (wk->dequeue(&from, &vfrom, &vto, &type, &msg, &up))
     {
-        assert(from != server_id());
-        assert(vto != virtual_server_id());
+        process_message(from, vfrom, vto, type, msg, up);
+        m_repl.flush_acks(w, wk->empty() && !m_comm.has_queued_messages());
+    }
 
-        switch (type)
-        {
-            case REQ_GET:
-                process_req_get(from, vfrom, vto, msg, up);
-                break;
-            case REQ_ATOMIC:
-                process_req_atomic(from, vfrom, vto, msg, up);
-                break;
-            case REQ_SEARCH_START:
-                process_req_search_start(from, vfrom, vto, msg, up);
-                break;
-            case REQ_SEARCH_NEXT:
-                process_req_search_next(from, vfrom, vto, msg, up);
-                break;
-            case REQ_SEARCH_STOP:
-                process_req_search_stop(from, vfrom, vto, msg, up);
-                break;
-            case REQ_SORTED_SEARCH:
-                process_req_sorted_search(from, vfrom, vto, msg, up);
-                break;
-            case REQ_GROUP_DEL:
-                process_req_group_del(from, vfrom, vto, msg, up);
-                break;
-            case REQ_COUNT:
-                process_req_count(from, vfrom, vto, msg, up);
-                break;
-            case REQ_SEARCH_DESCRIBE:
-                process_req_search_describe(from, vfrom, vto, msg, up);
-                break;
-            case CHAIN_OP:
-                process_chain_op(from, vfrom, vto, msg, up);
-                break;
-            case CHAIN_SUBSPACE:
-                process_chain_subspace(from, vfrom, vto, msg, up);
-                break;
-            case CHAIN_ACK:
-                process_chain_ack(from, vfrom, vto, msg, up);
-                break;
-            case CHAIN_GC:
-                process_chain_gc(from, vfrom, vto, msg, up);
-                break;
-            case XFER_OP:
-                process_xfer_op(from, vfrom, vto, msg, up);
-                break;
-            case XFER_ACK:
-                process_xfer_ack(from, vfrom, vto, msg, up);
-                break;
-            case RESP_GET:
-            case RESP_ATOMIC:
-            case RESP_SEARCH_ITEM:
-            case RESP_SEARCH_DONE:
-            case RESP_SORTED_SEARCH:
-            case RESP_GROUP_DEL:
-            case RESP_COUNT:
-            case RESP_SEARCH_DESCRIBE:
-            case CONFIGMISMATCH:
-            case PACKET_NOP:
-            default:
-                LOG(INFO) << "received " << type << " message which servers do not process";
-                break;
-        }
+    LOG(INFO) << "region worker shutting down";
+}
+
+bool
+daemon :: steer(server_id from,
+                virtual_server_id vfrom,
+                virtual_server_id vto,
+                network_msgtype type,
+                std::auto_ptr<e::buffer>* msg,
+                const e::unpacker& up)
+{
+    if (m_workers.empty())
+    {
+        return false;
     }
 
-    LOG(INFO) << "network thread shutting down";
+    // only the messages that work on a region's keyholders move; everything
+    // else, reads included, is cheaper to handle on the thread that received
+    // it
+    switch (type)
+    {
+        case REQ_ATOMIC:
+        case REQ_ATOMIC_BATCH:
+        case REQ_MULTI_ATOMIC:
+        case CHAIN_OP:
+        case CHAIN_SUBSPACE:
+        case CHAIN_ACK:
+            break;
+        default:
+            return false;
+    }
+
+    region_id ri = m_config.get_region_id(vto);
+
+    if (ri == region_id())
+    {
+        return false;
+    }
+
+    m_workers[m_repl.partition_of(ri)]->enqueue(from, vfrom, vto, type, *msg, up);
+    return true;
+}
+
+void
+daemon :: process_message(server_id from,
+                          virtual_server_id vfrom,
+                          virtual_server_id vto,
+                          network_msgtype type,
+                          std::auto_ptr<e::buffer> msg,
+                          e::unpacker up)
+{
+    switch (type)
+    {
+        case REQ_GET:
+            process_req_get(from, vfrom, vto, msg, up);
+            break;
+        case REQ_ATOMIC:
+            process_req_atomic(from, vfrom, vto, msg, up);
+            break;
+        case REQ_ATOMIC_BATCH:
+            process_req_atomic_batch(from, vfrom, vto, msg, up);
+            break;
+        case REQ_MULTI_ATOMIC:
+            process_req_multi_atomic(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SEARCH_START:
+            process_req_search_start(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SEARCH_NEXT:
+            process_req_search_next(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SEARCH_STOP:
+            process_req_search_stop(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SORTED_SEARCH:
+            process_req_sorted_search(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SORTED_SEARCH_NEXT:
+            process_req_sorted_search_next(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SORTED_SEARCH_STOP:
+            process_req_sorted_search_stop(from, vfrom, vto, msg, up);
+            break;
+        case REQ_EXPORT_START:
+            process_req_export_start(from, vfrom, vto, msg, up);
+            break;
+        case REQ_EXPORT_NEXT:
+            process_req_export_next(from, vfrom, vto, msg, up);
+            break;
+        case REQ_GROUP_DEL:
+            process_req_group_del(from, vfrom, vto, msg, up);
+            break;
+        case REQ_GROUP_ATOMIC:
+            process_req_group_atomic(from, vfrom, vto, msg, up);
+            break;
+        case REQ_COUNT:
+            process_req_count(from, vfrom, vto, msg, up);
+            break;
+        case REQ_COUNT_APPROX:
+            process_req_count_approx(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SAMPLE:
+            process_req_sample(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SEARCH_DESCRIBE:
+            process_req_search_describe(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SEARCH_SPLITS:
+            process_req_search_splits(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SUBSCRIBE:
+            process_req_subscribe(from, vfrom, vto, msg, up);
+            break;
+        case REQ_SUBSCRIBE_STOP:
+            process_req_subscribe_stop(from, vfrom, vto, msg, up);
+            break;
+        case CHAIN_OP:
+            process_chain_op(from, vfrom, vto, msg, up);
+            break;
+        case CHAIN_SUBSPACE:
+            process_chain_subspace(from, vfrom, vto, msg, up);
+            break;
+        case CHAIN_ACK:
+            process_chain_ack(from, vfrom, vto, msg, up);
+            break;
+        case CHAIN_GC:
+            process_chain_gc(from, vfrom, vto, msg, up);
+            break;
+        case XFER_OP:
+            process_xfer_op(from, vfrom, vto, msg, up);
+            break;
+        case XFER_ACK:
+            process_xfer_ack(from, vfrom, vto, msg, up);
+            break;
+        case RESP_GET:
+        case RESP_ATOMIC:
+        case RESP_SEARCH_ITEM:
+        case RESP_SEARCH_DONE:
+        case RESP_SORTED_SEARCH:
+        case RESP_EXPORT_BATCH:
+        case RESP_GROUP_DEL:
+        case RESP_GROUP_ATOMIC:
+        case RESP_COUNT:
+        case RESP_SEARCH_DESCRIBE:
+        case RESP_SEARCH_SPLITS:
+        case RESP_COUNT_APPROX:
+        case RESP_SAMPLE:
+        case RESP_SUBSCRIBE_ITEM:
+        case RESP_SUBSCRIBE_DONE:
+        case CHAIN_BATCH:
+        case CONFIGMISMATCH:
+        case PACKET_NOP:
+        default:
+            LOG(INFO) << "received " << type << " message which servers do not process";
+            break;
+    }
 }
 
 void
@@ -472,25 +688,37 @@ daemon :: process_req_get(server_id from,
     static uint64_t cnt = 0;
     uint64_t nonce;
     e::slice key;
+    // the client has already seen this version of the key
+    uint64_t min_version = 0;
+
+    up = up >> nonce >> key;
+
+    if (!up.error() && up.remain() > 0)
+    {
+        up = up >> min_version;
+    }
 
-    if ((up >> nonce >> key).error())
+    if (up.error())
     {
         LOG(WARNING) << "unpack of REQ_GET failed; here's some hex:  " << msg->hex();
         return;
     }
 
     std::vector<e::slice> value;
-    uint64_t version;
+    uint64_t version = 0;
     datalayer::reference ref;
     network_returncode result;
 
+    // Only committed writes reach the datalayer, so any replica may answer;
+    // one that has yet to commit min_version sends the client to the tail.
     switch (m_data.get(m_config.get_region_id(vto), key, &value, &version, &ref))
     {
         case datalayer::SUCCESS:
-            result = NET_SUCCESS;
+            result = version < min_version ? NET_STALE : NET_SUCCESS;
             break;
         case datalayer::NOT_FOUND:
-            result = NET_NOTFOUND;
+            version = 0;
+            result = min_version > 0 ? NET_STALE : NET_NOTFOUND;
             break;
         case datalayer::BAD_ENCODING:
         case datalayer::BAD_SEARCH:
@@ -506,13 +734,19 @@ daemon :: process_req_get(server_id from,
     cnt++;
     LOG(INFO) << "MORAZ: GET operations " << cnt;
 
+    if (result == NET_STALE)
+    {
+        value.clear();
+    }
+
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint16_t)
-              + pack_size(value);
+              + pack_size(value)
+              + sizeof(uint64_t);
     msg.reset(e::buffer::create(sz));
     e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
-    pa = pa << nonce << static_cast<uint16_t>(result) << value;
+    pa = pa << nonce << static_cast<uint16_t>(result) << value << version;
     m_comm.send_client(vto, from, RESP_GET, msg);
 }
 
@@ -542,6 +776,88 @@ daemon :: process_req_atomic(server_id from,
     m_repl.client_atomic(from, vto, nonce, fail_if_not_found, fail_if_found, !has_funcalls, key, &checks, &funcs);
 }
 
+void
+daemon :: process_req_atomic_batch(server_id from,
+                                   virtual_server_id,
+                                   virtual_server_id vto,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up)
+{
+    // Batches are never acked, so only a daemon carrying out a group op may
+    // send one; clients go through REQ_GROUP_DEL and REQ_GROUP_ATOMIC.
+    if (m_config.get_address(from) == po6::net::location())
+    {
+        LOG(WARNING) << "dropping REQ_ATOMIC_BATCH from " << from
+                     << ", which is not a server in the current configuration";
+        return;
+    }
+
+    uint64_t nonce;
+    uint8_t flags;
+    std::vector<attribute_check> checks;
+    std::vector<funcall> funcs;
+    std::vector<e::slice> keys;
+    up = up >> nonce >> flags >> checks >> funcs >> keys;
+
+    if (up.error())
+    {
+        LOG(WARNING) << "unpack of REQ_ATOMIC_BATCH failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    bool fail_if_not_found = flags & 1;
+    bool fail_if_found = flags & 2;
+    bool has_funcalls = flags & 128;
+    m_repl.group_atomic(vto, fail_if_not_found, fail_if_found, !has_funcalls, keys, &checks, &funcs);
+}
+
+void
+daemon :: process_req_multi_atomic(server_id from,
+                                   virtual_server_id,
+                                   virtual_server_id vto,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up)
+{
+    uint64_t nonce;
+    uint32_t count;
+    up = up >> nonce >> count;
+    std::vector<uint64_t> nonces;
+    std::vector<uint8_t> flags;
+    std::vector<e::slice> keys;
+    std::vector<std::vector<attribute_check> > checks;
+    std::vector<std::vector<funcall> > funcs;
+
+    // each op is a REQ_ATOMIC body prefixed by the nonce to answer it under
+    for (uint32_t i = 0; !up.error() && i < count; ++i)
+    {
+        uint64_t op_nonce;
+        uint8_t op_flags;
+        e::slice key;
+        checks.push_back(std::vector<attribute_check>());
+        funcs.push_back(std::vector<funcall>());
+        up = up >> op_nonce >> key >> op_flags >> checks.back() >> funcs.back();
+
+        if (up.error())
+        {
+            checks.pop_back();
+            funcs.pop_back();
+            break;
+        }
+
+        nonces.push_back(op_nonce);
+        flags.push_back(op_flags);
+        keys.push_back(key);
+    }
+
+    // the ops that unpacked are still answered
+    m_repl.client_multi_atomic(from, vto, nonces, flags, keys, &checks, &funcs);
+
+    if (up.error())
+    {
+        LOG(WARNING) << "unpack of REQ_MULTI_ATOMIC failed; here's some hex:  " << msg->hex();
+    }
+}
+
 void
 daemon :: process_req_search_start(server_id from,
                                    virtual_server_id,
@@ -552,14 +868,24 @@ daemon :: process_req_search_start(server_id from,
     uint64_t nonce;
     uint64_t search_id;
     std::vector<attribute_check> checks;
+    e::slice lower;
+    e::slice upper;
+
+    up = up >> nonce >> search_id >> checks;
 
-    if ((up >> nonce >> search_id >> checks).error())
+    // searches over part of a region carry the bounds of its key range
+    if (!up.error() && up.remain() > 0)
+    {
+        up = up >> lower >> upper;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of REQ_SEARCH_START failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_sm.start(from, vto, msg, nonce, search_id, &checks);
+    m_sm.start(from, vto, msg, nonce, search_id, &checks, lower, upper);
 }
 
 void
@@ -608,18 +934,95 @@ daemon :: process_req_sorted_search(server_id from,
                                     e::unpacker up)
 {
     uint64_t nonce;
+    uint64_t search_id;
     std::vector<attribute_check> checks;
     uint64_t limit;
     uint16_t sort_by;
     uint8_t flags;
 
-    if ((up >> nonce >> checks >> limit >> sort_by >> flags).error())
+    if ((up >> nonce >> search_id >> checks >> limit >> sort_by >> flags).error())
     {
         LOG(WARNING) << "unpack of REQ_SORTED_SEARCH failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_sm.sorted_search(from, vto, nonce, &checks, limit, sort_by, flags & 0x1);
+    m_sm.sorted_search(from, vto, nonce, search_id, &checks, limit, sort_by, flags & 0x1);
+}
+
+void
+daemon :: process_req_sorted_search_next(server_id from,
+                                         virtual_server_id,
+                                         virtual_server_id vto,
+                                         std::auto_ptr<e::buffer> msg,
+                                         e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t search_id;
+
+    if ((up >> nonce >> search_id).error())
+    {
+        LOG(WARNING) << "unpack of REQ_SORTED_SEARCH_NEXT failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.sorted_search_next(from, vto, nonce, search_id);
+}
+
+void
+daemon :: process_req_sorted_search_stop(server_id from,
+                                         virtual_server_id,
+                                         virtual_server_id vto,
+                                         std::auto_ptr<e::buffer> msg,
+                                         e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t search_id;
+
+    if ((up >> nonce >> search_id).error())
+    {
+        LOG(WARNING) << "unpack of REQ_SORTED_SEARCH_STOP failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.sorted_search_stop(from, vto, search_id);
+}
+
+void
+daemon :: process_req_export_start(server_id from,
+                                   virtual_server_id,
+                                   virtual_server_id vto,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t export_id;
+
+    if ((up >> nonce >> export_id).error())
+    {
+        LOG(WARNING) << "unpack of REQ_EXPORT_START failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.export_start(from, vto, nonce, export_id);
+}
+
+void
+daemon :: process_req_export_next(server_id from,
+                                  virtual_server_id,
+                                  virtual_server_id vto,
+                                  std::auto_ptr<e::buffer> msg,
+                                  e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t export_id;
+
+    if ((up >> nonce >> export_id).error())
+    {
+        LOG(WARNING) << "unpack of REQ_EXPORT_NEXT failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.export_next(from, vto, nonce, export_id);
 }
 
 void
@@ -638,8 +1041,31 @@ daemon :: process_req_group_del(server_id from,
         return;
     }
 
-    e::slice sl("\x01\x00\x00\x00\x00\x00\x00\x00\x00", 9);
-    m_sm.group_keyop(from, vto, nonce, &checks, REQ_ATOMIC, sl, RESP_GROUP_DEL);
+    m_sm.group_keyop(from, vto, nonce, &checks, 1, std::vector<funcall>(), RESP_GROUP_DEL);
+}
+
+void
+daemon :: process_req_group_atomic(server_id from,
+                                   virtual_server_id,
+                                   virtual_server_id vto,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up)
+{
+    uint64_t nonce;
+    std::vector<attribute_check> checks;
+    uint8_t flags;
+    std::vector<funcall> funcs;
+
+    if ((up >> nonce >> checks >> flags >> funcs).error())
+    {
+        LOG(WARNING) << "unpack of REQ_GROUP_ATOMIC failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    // only update objects that exist; creating them would make no sense for
+    // objects found by a search
+    flags = static_cast<uint8_t>((flags & ~2) | 1 | 128);
+    m_sm.group_keyop(from, vto, nonce, &checks, flags, funcs, RESP_GROUP_ATOMIC);
 }
 
 void
@@ -661,6 +1087,45 @@ daemon :: process_req_count(server_id from,
     m_sm.count(from, vto, nonce, &checks);
 }
 
+void
+daemon :: process_req_count_approx(server_id from,
+                                   virtual_server_id,
+                                   virtual_server_id vto,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up)
+{
+    uint64_t nonce;
+    std::vector<attribute_check> checks;
+
+    if ((up >> nonce >> checks).error())
+    {
+        LOG(WARNING) << "unpack of REQ_COUNT_APPROX failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.count_approx(from, vto, nonce, &checks);
+}
+
+void
+daemon :: process_req_sample(server_id from,
+                             virtual_server_id,
+                             virtual_server_id vto,
+                             std::auto_ptr<e::buffer> msg,
+                             e::unpacker up)
+{
+    uint64_t nonce;
+    std::vector<attribute_check> checks;
+    uint64_t n;
+
+    if ((up >> nonce >> checks >> n).error())
+    {
+        LOG(WARNING) << "unpack of REQ_SAMPLE failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.sample(from, vto, nonce, &checks, n);
+}
+
 void
 daemon :: process_req_search_describe(server_id from,
                                       virtual_server_id,
@@ -680,6 +1145,66 @@ daemon :: process_req_search_describe(server_id from,
     m_sm.search_describe(from, vto, nonce, &checks);
 }
 
+void
+daemon :: process_req_search_splits(server_id from,
+                                    virtual_server_id,
+                                    virtual_server_id vto,
+                                    std::auto_ptr<e::buffer> msg,
+                                    e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t n;
+
+    if ((up >> nonce >> n).error())
+    {
+        LOG(WARNING) << "unpack of REQ_SEARCH_SPLITS failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.search_splits(from, vto, nonce, n);
+}
+
+void
+daemon :: process_req_subscribe(server_id from,
+                                virtual_server_id,
+                                virtual_server_id vto,
+                                std::auto_ptr<e::buffer> msg,
+                                e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t sub_id;
+    std::vector<attribute_check> checks;
+    uint64_t incarnation;
+    uint64_t after;
+
+    if ((up >> nonce >> sub_id >> checks >> incarnation >> after).error())
+    {
+        LOG(WARNING) << "unpack of REQ_SUBSCRIBE failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_subs.poll(from, vto, msg, nonce, sub_id, &checks, incarnation, after);
+}
+
+void
+daemon :: process_req_subscribe_stop(server_id from,
+                                     virtual_server_id,
+                                     virtual_server_id vto,
+                                     std::auto_ptr<e::buffer> msg,
+                                     e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t sub_id;
+
+    if ((up >> nonce >> sub_id).error())
+    {
+        LOG(WARNING) << "unpack of REQ_SUBSCRIBE_STOP failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_subs.stop(from, vto, sub_id);
+}
+
 void
 daemon :: process_chain_op(server_id,
                            virtual_server_id vfrom,
@@ -693,8 +1218,20 @@ daemon :: process_chain_op(server_id,
     uint64_t version;
     e::slice key;
     std::vector<e::slice> value;
+    std::vector<funcall> funcs;
+    up = up >> flags >> reg_id >> seq_id >> version >> key;
+
+    // updates may carry the funcalls that produce the value instead
+    if (!up.error() && (flags & 4))
+    {
+        up = up >> funcs;
+    }
+    else
+    {
+        up = up >> value;
+    }
 
-    if ((up >> flags >> reg_id >> seq_id >> version >> key >> value).error())
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_OP failed; here's some hex:  " << msg->hex();
         return;
@@ -703,7 +1240,7 @@ daemon :: process_chain_op(server_id,
     bool fresh = flags & 1;
     bool has_value = flags & 2;
     bool retransmission = flags & 128;
-    m_repl.chain_op(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, fresh, has_value, msg, key, value);
+    m_repl.chain_op(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, fresh, has_value, msg, key, value, funcs);
 }
 
 void
@@ -733,21 +1270,30 @@ daemon :: process_chain_subspace(server_id,
 
 void
 daemon :: process_chain_gc(server_id,
-                           virtual_server_id vfrom,
+                           virtual_server_id,
                            virtual_server_id,
                            std::auto_ptr<e::buffer> msg,
                            e::unpacker up)
 {
-    uint64_t seq_id;
+    uint32_t num_bounds;
+    std::vector<std::pair<region_id, uint64_t> > lower_bounds;
+    up = up >> num_bounds;
 
-    if ((up >> seq_id).error())
+    for (uint32_t i = 0; !up.error() && i < num_bounds; ++i)
+    {
+        region_id reg_id;
+        uint64_t seq_id;
+        up = up >> reg_id >> seq_id;
+        lower_bounds.push_back(std::make_pair(reg_id, seq_id));
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_GC failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    region_id ri = m_config.get_region_id(vfrom);
-    m_repl.chain_gc(ri, seq_id);
+    m_repl.chain_gc(lower_bounds);
 }
 
 void
@@ -759,18 +1305,26 @@ daemon :: process_chain_ack(server_id,
 {
     uint8_t flags;
     uint64_t reg_id;
-    uint64_t seq_id;
-    uint64_t version;
-    e::slice key;
+    uint32_t num_ranges;
+    std::vector<std::pair<uint64_t, uint64_t> > ranges;
+    up = up >> flags >> reg_id >> num_ranges;
 
-    if ((up >> flags >> reg_id >> seq_id >> version >> key).error())
+    for (uint32_t i = 0; !up.error() && i < num_ranges; ++i)
+    {
+        uint64_t lower;
+        uint64_t upper;
+        up = up >> lower >> upper;
+        ranges.push_back(std::make_pair(lower, upper));
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_ACK failed; here's some hex:  " << msg->hex();
         return;
     }
 
     bool retransmission = flags & 128;
-    m_repl.chain_ack(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, key);
+    m_repl.chain_ack(vfrom, vto, retransmission, region_id(reg_id), ranges);
 }
 
 void
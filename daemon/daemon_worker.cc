@@ -0,0 +1,146 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "daemon/daemon_worker.h"
+
+using hyperdex::daemon;
+
+daemon :: worker :: worker()
+    : m_mtx()
+    , m_avail(&m_mtx)
+    , m_idle(&m_mtx)
+    , m_queue()
+    , m_busy(false)
+    , m_shutdown(false)
+{
+}
+
+daemon :: worker :: ~worker() throw ()
+{
+    while (!m_queue.empty())
+    {
+        delete m_queue.front().msg;
+        m_queue.pop();
+    }
+}
+
+void
+daemon :: worker :: enqueue(const server_id& from,
+                            const virtual_server_id& vfrom,
+                            const virtual_server_id& vto,
+                            network_msgtype type,
+                            std::auto_ptr<e::buffer> msg,
+                            const e::unpacker& up)
+{
+    message m;
+    m.from = from;
+    m.vfrom = vfrom;
+    m.vto = vto;
+    m.type = type;
+    m.up = up;
+    po6::threads::mutex::hold hold(&m_mtx);
+    m.msg = msg.release();
+    m_queue.push(m);
+    m_avail.signal();
+}
+
+bool
+daemon :: worker :: dequeue(server_id* from,
+                            virtual_server_id* vfrom,
+                            virtual_server_id* vto,
+                            network_msgtype* type,
+                            std::auto_ptr<e::buffer>* msg,
+                            e::unpacker* up)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_busy = false;
+
+    while (m_queue.empty() && !m_shutdown)
+    {
+        m_idle.broadcast();
+        m_avail.wait();
+    }
+
+    if (m_shutdown)
+    {
+        m_idle.broadcast();
+        return false;
+    }
+
+    message& m(m_queue.front());
+    *from = m.from;
+    *vfrom = m.vfrom;
+    *vto = m.vto;
+    *type = m.type;
+    msg->reset(m.msg);
+    *up = m.up;
+    m_queue.pop();
+    m_busy = true;
+    return true;
+}
+
+bool
+daemon :: worker :: empty()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_queue.empty();
+}
+
+void
+daemon :: worker :: drain()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    while ((!m_queue.empty() || m_busy) && !m_shutdown)
+    {
+        m_idle.wait();
+    }
+}
+
+void
+daemon :: worker :: shutdown()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_shutdown = true;
+    m_avail.broadcast();
+    m_idle.broadcast();
+}
+
+daemon :: worker :: message :: message()
+    : from()
+    , vfrom()
+    , vto()
+    , type()
+    , msg(NULL)
+    , up()
+{
+}
+
+daemon :: worker :: message :: ~message() throw ()
+{
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_daemon_worker_h_
+#define hyperdex_daemon_daemon_worker_h_
+
+// STL
+#include <memory>
+#include <queue>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "common/ids.h"
+#include "common/network_msgtype.h"
+#include "daemon/daemon.h"
+
+// The queue of messages for the regions one worker thread owns.  Network
+// threads hand messages to it, and only its worker takes them off.
+class hyperdex::daemon::worker
+{
+    public:
+        worker();
+        ~worker() throw ();
+
+    public:
+        void enqueue(const server_id& from,
+                     const virtual_server_id& vfrom,
+                     const virtual_server_id& vto,
+                     network_msgtype type,
+                     std::auto_ptr<e::buffer> msg,
+                     const e::unpacker& up);
+        // Block until a message is queued, returning false once shut down.
+        // Calling this again marks the previous message as finished.
+        bool dequeue(server_id* from,
+                     virtual_server_id* vfrom,
+                     virtual_server_id* vto,
+                     network_msgtype* type,
+                     std::auto_ptr<e::buffer>* msg,
+                     e::unpacker* up);
+        bool empty();
+        // Block until every queued message has been processed
+        void drain();
+        void shutdown();
+
+    private:
+        class message
+        {
+            public:
+                message();
+                ~message() throw ();
+
+            public:
+                server_id from;
+                virtual_server_id vfrom;
+                virtual_server_id vto;
+                network_msgtype type;
+                e::buffer* msg;
+                e::unpacker up;
+        };
+
+    private:
+        worker(const worker&);
+        worker& operator = (const worker&);
+
+    private:
+        po6::threads::mutex m_mtx;
+        po6::threads::cond m_avail;
+        po6::threads::cond m_idle;
+        std::queue<message> m_queue;
+        bool m_busy;
+        bool m_shutdown;
+};
+
+#endif // hyperdex_daemon_daemon_worker_h_
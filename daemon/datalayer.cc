@@ -33,20 +33,27 @@
 
 // POSIX
 #include <signal.h>
+#include <time.h>
 
 // STL
+#include <algorithm>
+#include <map>
 #include <sstream>
 #include <string>
 
 // Google Log
 #include <glog/logging.h>
 
+// CityHash
+#include <city.h>
+
 // LevelDB
 #include <leveldb/write_batch.h>
 #include <leveldb/filter_policy.h>
 
 // e
 #include <e/endian.h>
+#include <e/time.h>
 
 // HyperDex
 #include "common/macros.h"
@@ -55,20 +62,119 @@
 #include "daemon/daemon.h"
 #include "daemon/datalayer.h"
 #include "daemon/datalayer_encodings.h"
+#include "daemon/index_encode.h"
 #include "datatypes/apply.h"
+#include "datatypes/compare.h"
 #include "datatypes/microerror.h"
 
 // ASSUME:  all keys put into leveldb have a first byte without the high bit set
 
+// Indices added to existing spaces are built by this many threads, which
+// together index at most BACKFILL_RATE objects per second, BACKFILL_BATCH at
+// a time.
+#define BACKFILL_THREADS 4
+#define BACKFILL_RATE 20000
+#define BACKFILL_BATCH 64
+
+// Acks cleared by garbage collection are deleted in write batches of this size
+#define CLEAR_ACKED_BATCH 1024
+
+// Writers and backfillers serialize on this many index locks
+#define INDEX_LOCK_STRIPES 1024
+
+// Each mapped region keeps a Bloom filter of its keys so that writes to new
+// keys need not read the old value.  A filter starts at 8KB and is rebuilt at
+// twice its load whenever it holds more than one byte per key, at which point
+// it sees about 2.4% false positives.  It therefore costs between one and two
+// bytes of RAM per key in the region (a million-key region uses 1-2MB).
+// Deleted keys are not subtracted, so a filter never shrinks until its region
+// is remapped or the daemon restarts.
+#define KEY_FILTER_MIN_BITS (1ULL << 16)
+#define KEY_FILTER_BITS_PER_KEY 8
+#define KEY_FILTER_HASHES 4
+
 using std::tr1::placeholders::_1;
 using hyperdex::datalayer;
+using hyperdex::index;
 using hyperdex::leveldb_snapshot_ptr;
 using hyperdex::reconfigure_returncode;
 
+// Build (or, when "drop" is set, remove) one explicit index within one
+// region.  The job carries its own copy of the space, so backfillers never
+// look at the configuration, which changes beneath them.
+class datalayer::index_job
+{
+    public:
+        index_job(const region_id& ri, const hyperdex::space& sp,
+                  const index& idx, bool drop);
+        ~index_job() throw ();
+
+    public:
+        region_id ri;
+        hyperdex::space sp;
+        index idx;
+        bool drop;
+        // set (under m_block_cleaner) when a newer configuration no longer
+        // wants the job's work, or on shutdown
+        bool cancelled;
+
+    private:
+        index_job(const index_job&);
+        index_job& operator = (const index_job&);
+};
+
+datalayer :: index_job :: index_job(const region_id& r, const hyperdex::space& s,
+                                    const index& i, bool d)
+    : ri(r)
+    , sp(s)
+    , idx(i)
+    , drop(d)
+    , cancelled(false)
+{
+}
+
+datalayer :: index_job :: ~index_job() throw ()
+{
+}
+
+// Copies the writes of one WriteBatch into another
+class batch_appender : public leveldb::WriteBatch::Handler
+{
+    public:
+        batch_appender(leveldb::WriteBatch* to) : m_to(to) {}
+        virtual ~batch_appender() throw () {}
+
+    public:
+        virtual void Put(const leveldb::Slice& k, const leveldb::Slice& v) { m_to->Put(k, v); }
+        virtual void Delete(const leveldb::Slice& k) { m_to->Delete(k); }
+
+    private:
+        leveldb::WriteBatch* m_to;
+
+    private:
+        batch_appender(const batch_appender&);
+        batch_appender& operator = (const batch_appender&);
+};
+
+// CPU time consumed by the calling thread, in nanoseconds
+static uint64_t
+thread_cpu_time()
+{
+    timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+    {
+        return 0;
+    }
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 datalayer :: datalayer(daemon* d)
     : m_daemon(d)
     , m_db()
     , m_counters()
+    , m_epochs()
     , m_cleaner(std::tr1::bind(&datalayer::cleaner, this))
     , m_block_cleaner()
     , m_wakeup_cleaner(&m_block_cleaner)
@@ -78,7 +184,26 @@ datalayer :: datalayer(daemon* d)
     , m_need_pause(false)
     , m_paused(false)
     , m_state_transfer_captures()
+    , m_index_locks(INDEX_LOCK_STRIPES)
+    , m_backfillers()
+    , m_wakeup_backfillers(&m_block_cleaner)
+    , m_built()
+    , m_index_jobs()
+    , m_index_running()
+    , m_backfill_next(0)
+    , m_filter_lock()
+    , m_filters()
+    , m_filters_built()
+    , m_filter_logs()
+    , m_filter_jobs()
+    , m_filter_builder(std::tr1::bind(&datalayer::filter_builder, this))
+    , m_wakeup_filter_builder(&m_block_cleaner)
 {
+    for (size_t i = 0; i < BACKFILL_THREADS; ++i)
+    {
+        std::tr1::shared_ptr<po6::threads::thread> t(new po6::threads::thread(std::tr1::bind(&datalayer::backfiller, this)));
+        m_backfillers.push_back(t);
+    }
 }
 
 datalayer :: ~datalayer() throw ()
@@ -199,9 +324,35 @@ datalayer :: setup(const po6::pathname& path,
         return false;
     }
 
+    std::set<std::pair<region_id, uint16_t> > built;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(ropts));
+    it->Seek(leveldb::Slice("b", 1));
+
+    for (; it->Valid(); it->Next())
+    {
+        region_id ri;
+        uint16_t id;
+        e::slice k(it->key().data(), it->key().size());
+
+        if (decode_index_built(k, &ri, &id) != SUCCESS)
+        {
+            break;
+        }
+
+        built.insert(std::make_pair(ri, id));
+    }
+
     {
         po6::threads::mutex::hold hold(&m_block_cleaner);
+        m_built.swap(built);
         m_cleaner.start();
+
+        for (size_t i = 0; i < m_backfillers.size(); ++i)
+        {
+            m_backfillers[i]->start();
+        }
+
+        m_filter_builder.start();
         m_shutdown = false;
     }
 
@@ -436,6 +587,12 @@ datalayer :: reconfigure(const configuration&,
 
     std::sort(regions.begin(), regions.end());
     m_counters.adopt(regions);
+    std::vector<region_id> mapped;
+    new_config.mapped_regions(us, &mapped);
+    std::sort(mapped.begin(), mapped.end());
+    m_epochs.adopt(mapped);
+    schedule_index_jobs(new_config, us);
+    schedule_filter_jobs(new_config, us);
 }
 
 datalayer::returncode
@@ -488,51 +645,15 @@ datalayer :: del(const region_id& ri,
                  const e::slice& key,
                  const std::vector<e::slice>& old_value)
 {
+    e::striped_lock<po6::threads::mutex>::hold hold(&m_index_locks, index_lock_num(ri, key));
     leveldb::WriteBatch updates;
-    std::vector<char> backing1;
-    std::vector<char> backing2;
-
-    // peform the "del" of the object we want to store
-    leveldb::Slice lkey;
-    encode_key(ri, key, &backing1, &lkey);
-    updates.Delete(lkey);
-
-    // apply the index operations
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    const subspace* su = m_daemon->m_config.get_subspace(ri);
-    returncode rc = create_index_changes(sc, su, ri, key, &old_value, NULL, &updates);
+    returncode rc = stage_del(ri, reg_id, seq_id, key, old_value, &updates);
 
     if (rc != SUCCESS)
     {
         return rc;
     }
 
-    // Mark acked as part of this batch write
-    if (seq_id != 0)
-    {
-        char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
-        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-        leveldb::Slice aval("", 0);
-        updates.Put(akey, aval);
-    }
-
-    uint64_t count;
-
-    // If this is a captured region, then we must log this transfer
-    if (m_counters.lookup(ri, &count))
-    {
-        char tbacking[TRANSFER_BUF_SIZE];
-        capture_id cid = m_daemon->m_config.capture_for(ri);
-        assert(cid != capture_id());
-        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
-        leveldb::Slice tval;
-        encode_transfer(cid, count, tbacking);
-        encode_key_value(key, NULL, 0, &backing2, &tval);
-        updates.Put(tkey, tval);
-    }
-
     // Perform the write
     leveldb::WriteOptions opts;
     opts.sync = false;
@@ -540,6 +661,7 @@ datalayer :: del(const region_id& ri,
 
     if (st.ok())
     {
+        bump_epoch(ri);
         return SUCCESS;
     }
     else if (st.IsNotFound())
@@ -573,51 +695,69 @@ datalayer :: put(const region_id& ri,
                  const std::vector<e::slice>& new_value,
                  uint64_t version)
 {
+    e::striped_lock<po6::threads::mutex>::hold hold(&m_index_locks, index_lock_num(ri, key));
     leveldb::WriteBatch updates;
-    std::vector<char> backing1;
-    std::vector<char> backing2;
-
-    // peform the "put" of the object we want to store
-    leveldb::Slice lkey;
-    leveldb::Slice lval;
-    encode_key(ri, key, &backing1, &lkey);
-    encode_value(new_value, version, &backing2, &lval);
-    updates.Put(lkey, lval);
-
-    // apply the index operations
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    const subspace* su = m_daemon->m_config.get_subspace(ri);
-    returncode rc = create_index_changes(sc, su, ri, key, NULL, &new_value, &updates);
+    returncode rc = stage_put(ri, reg_id, seq_id, key, new_value, version, &updates);
 
     if (rc != SUCCESS)
     {
         return rc;
     }
 
-    // Mark acked as part of this batch write
-    if (seq_id != 0)
+    // Perform the write
+    leveldb::WriteOptions opts;
+    opts.sync = false;
+    leveldb::Status st = m_db->Write(opts, &updates);
+
+    if (st.ok())
     {
-        char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
-        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-        leveldb::Slice aval("", 0);
-        updates.Put(akey, aval);
+        // only now can a filter rebuild's snapshot see the key, so only now
+        // may it go into the filter
+        insert_filter(ri, key);
+        bump_epoch(ri);
+        return SUCCESS;
     }
+    else if (st.IsNotFound())
+    {
+        LOG(ERROR) << "put returned NOT_FOUND at the disk layer: region=" << ri
+                   << " key=0x" << key.hex() << " desc=" << st.ToString();
+        return NOT_FOUND;
+    }
+    else if (st.IsCorruption())
+    {
+        LOG(ERROR) << "corruption at the disk layer: region=" << ri
+                   << " key=0x" << key.hex() << " desc=" << st.ToString();
+        return CORRUPTION;
+    }
+    else if (st.IsIOError())
+    {
+        LOG(ERROR) << "IO error at the disk layer: region=" << ri
+                   << " key=0x" << key.hex() << " desc=" << st.ToString();
+        return IO_ERROR;
+    }
+    else
+    {
+        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+        return LEVELDB_ERROR;
+    }
+}
 
-    uint64_t count;
+datalayer::returncode
+datalayer :: overput(const region_id& ri,
+                     const region_id& reg_id,
+                     uint64_t seq_id,
+                     const e::slice& key,
+                     const std::vector<e::slice>& old_value,
+                     const std::vector<e::slice>& new_value,
+                     uint64_t version)
+{
+    e::striped_lock<po6::threads::mutex>::hold hold(&m_index_locks, index_lock_num(ri, key));
+    leveldb::WriteBatch updates;
+    returncode rc = stage_overput(ri, reg_id, seq_id, key, old_value, new_value, version, &updates);
 
-    // If this is a captured region, then we must log this transfer
-    if (m_counters.lookup(ri, &count))
+    if (rc != SUCCESS)
     {
-        char tbacking[TRANSFER_BUF_SIZE];
-        capture_id cid = m_daemon->m_config.capture_for(ri);
-        assert(cid != capture_id());
-        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
-        leveldb::Slice tval;
-        encode_transfer(cid, count, tbacking);
-        encode_key_value(key, &new_value, version, &backing2, &tval);
-        updates.Put(tkey, tval);
+        return rc;
     }
 
     // Perform the write
@@ -627,11 +767,12 @@ datalayer :: put(const region_id& ri,
 
     if (st.ok())
     {
+        bump_epoch(ri);
         return SUCCESS;
     }
     else if (st.IsNotFound())
     {
-        LOG(ERROR) << "put returned NOT_FOUND at the disk layer: region=" << ri
+        LOG(ERROR) << "overput returned NOT_FOUND at the disk layer: region=" << ri
                    << " key=0x" << key.hex() << " desc=" << st.ToString();
         return NOT_FOUND;
     }
@@ -654,6 +795,48 @@ datalayer :: put(const region_id& ri,
     }
 }
 
+datalayer::returncode
+datalayer :: del(const region_id& ri,
+                 const region_id& reg_id,
+                 uint64_t seq_id,
+                 const e::slice& key,
+                 const std::vector<e::slice>& old_value,
+                 batch* b)
+{
+    leveldb::WriteBatch updates;
+    returncode rc = stage_del(ri, reg_id, seq_id, key, old_value, &updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    add_to_batch(ri, key, updates, b);
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: put(const region_id& ri,
+                 const region_id& reg_id,
+                 uint64_t seq_id,
+                 const e::slice& key,
+                 const std::vector<e::slice>& new_value,
+                 uint64_t version,
+                 batch* b)
+{
+    leveldb::WriteBatch updates;
+    returncode rc = stage_put(ri, reg_id, seq_id, key, new_value, version, &updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    add_to_batch(ri, key, updates, b);
+    b->m_filter_keys.push_back(std::make_pair(ri, std::string(reinterpret_cast<const char*>(key.data()), key.size())));
+    return SUCCESS;
+}
+
 datalayer::returncode
 datalayer :: overput(const region_id& ri,
                      const region_id& reg_id,
@@ -661,80 +844,87 @@ datalayer :: overput(const region_id& ri,
                      const e::slice& key,
                      const std::vector<e::slice>& old_value,
                      const std::vector<e::slice>& new_value,
-                     uint64_t version)
+                     uint64_t version,
+                     batch* b)
 {
     leveldb::WriteBatch updates;
-    std::vector<char> backing1;
-    std::vector<char> backing2;
-
-    // peform the "put" of the object we want to store
-    leveldb::Slice lkey;
-    leveldb::Slice lval;
-    encode_key(ri, key, &backing1, &lkey);
-    encode_value(new_value, version, &backing2, &lval);
-    updates.Put(lkey, lval);
-
-    // apply the index operations
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    const subspace* su = m_daemon->m_config.get_subspace(ri);
-    returncode rc = create_index_changes(sc, su, ri, key, &old_value, &new_value, &updates);
+    returncode rc = stage_overput(ri, reg_id, seq_id, key, old_value, new_value, version, &updates);
 
     if (rc != SUCCESS)
     {
         return rc;
     }
 
-    // Mark acked as part of this batch write
-    if (seq_id != 0)
+    add_to_batch(ri, key, updates, b);
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: write(batch* b)
+{
+    if (b->m_writes == 0)
     {
-        char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
-        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-        leveldb::Slice aval("", 0);
-        updates.Put(akey, aval);
+        return SUCCESS;
     }
 
-    uint64_t count;
+    // Hold the index locks of every staged object across the write, taking
+    // them in order so that two batches sharing stripes cannot deadlock.
+    typedef e::striped_lock<po6::threads::mutex>::hold index_hold;
+    std::sort(b->m_locks.begin(), b->m_locks.end());
+    b->m_locks.erase(std::unique(b->m_locks.begin(), b->m_locks.end()), b->m_locks.end());
+    std::vector<std::tr1::shared_ptr<index_hold> > holds;
 
-    // If this is a captured region, then we must log this transfer
-    if (m_counters.lookup(ri, &count))
+    for (size_t i = 0; i < b->m_locks.size(); ++i)
     {
-        char tbacking[TRANSFER_BUF_SIZE];
-        capture_id cid = m_daemon->m_config.capture_for(ri);
-        assert(cid != capture_id());
-        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
-        leveldb::Slice tval;
-        encode_transfer(cid, count, tbacking);
-        encode_key_value(key, &new_value, version, &backing2, &tval);
-        updates.Put(tkey, tval);
+        holds.push_back(std::tr1::shared_ptr<index_hold>(new index_hold(&m_index_locks, b->m_locks[i])));
     }
 
-    // Perform the write
     leveldb::WriteOptions opts;
     opts.sync = false;
-    leveldb::Status st = m_db->Write(opts, &updates);
+    leveldb::Status st = m_db->Write(opts, &b->m_updates);
+    holds.clear();
+    std::vector<region_id> regions;
+    regions.swap(b->m_regions);
+    std::vector<std::pair<region_id, std::string> > filter_keys;
+    filter_keys.swap(b->m_filter_keys);
+    size_t writes = b->m_writes;
+    b->m_updates.Clear();
+    b->m_locks.clear();
+    b->m_writes = 0;
 
     if (st.ok())
     {
+        for (size_t i = 0; i < filter_keys.size(); ++i)
+        {
+            insert_filter(filter_keys[i].first, e::slice(filter_keys[i].second));
+        }
+
+        std::sort(regions.begin(), regions.end());
+        regions.erase(std::unique(regions.begin(), regions.end()), regions.end());
+
+        for (size_t i = 0; i < regions.size(); ++i)
+        {
+            bump_epoch(regions[i]);
+        }
+
         return SUCCESS;
     }
     else if (st.IsNotFound())
     {
-        LOG(ERROR) << "overput returned NOT_FOUND at the disk layer: region=" << ri
-                   << " key=0x" << key.hex() << " desc=" << st.ToString();
+        LOG(ERROR) << "batch write returned NOT_FOUND at the disk layer: writes=" << writes
+                   << " desc=" << st.ToString();
         return NOT_FOUND;
     }
     else if (st.IsCorruption())
     {
-        LOG(ERROR) << "corruption at the disk layer: region=" << ri
-                   << " key=0x" << key.hex() << " desc=" << st.ToString();
+        LOG(ERROR) << "corruption at the disk layer: writes=" << writes
+                   << " desc=" << st.ToString();
         return CORRUPTION;
     }
     else if (st.IsIOError())
     {
-        LOG(ERROR) << "IO error at the disk layer: region=" << ri
-                   << " key=0x" << key.hex() << " desc=" << st.ToString();
+        LOG(ERROR) << "IO error at the disk layer: writes=" << writes
+                   << " desc=" << st.ToString();
         return IO_ERROR;
     }
     else
@@ -744,6 +934,27 @@ datalayer :: overput(const region_id& ri,
     }
 }
 
+bool
+datalayer :: may_exist(const region_id& ri, const e::slice& key)
+{
+    std::tr1::shared_ptr<bloom_filter> filter;
+
+    {
+        po6::threads::mutex::hold hold(&m_filter_lock);
+
+        if (m_filters_built.find(ri) == m_filters_built.end())
+        {
+            return true;
+        }
+
+        std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.find(ri);
+        assert(it != m_filters.end());
+        filter = it->second;
+    }
+
+    return filter->may_contain(key);
+}
+
 datalayer::returncode
 datalayer :: uncertain_del(const region_id& ri,
                            const e::slice& key)
@@ -858,39 +1069,158 @@ datalayer :: uncertain_put(const region_id& ri,
     }
 }
 
-datalayer::returncode
-datalayer :: make_snapshot(const region_id& ri,
-                           const schema& sc,
-                           const std::vector<attribute_check>* checks,
-                           snapshot* snap,
-                           std::ostringstream* ostr)
+// True if the entries of "idx" hold every attribute that "checks" examine
+// and, unless only keys are wanted, every attribute of the object.
+static bool
+index_covers(const hyperdex::index& idx,
+             const hyperdex::schema& sc,
+             const std::vector<hyperdex::attribute_check>& checks,
+             bool keys_only)
 {
-    snap->m_dl = this;
-    snap->m_snap.reset(m_db, m_db->GetSnapshot());
-    snap->m_checks = checks;
-    snap->m_ri = ri;
-    snap->m_ostr = ostr;
-    std::vector<range> ranges;
+    std::vector<bool> held(sc.attrs_sz, false);
+    held[0] = true;
 
-    if (!range_searches(*checks, &ranges))
+    for (size_t i = 0; i < idx.attrs.size(); ++i)
     {
-        return BAD_SEARCH;
+        held[idx.attrs[i]] = true;
     }
 
-    if (ostr) *ostr << " converted " << checks->size() << " checks to " << ranges.size() << " ranges\n";
+    for (size_t i = 0; i < idx.include.size(); ++i)
+    {
+        held[idx.include[i]] = true;
+    }
 
-    char* ptr;
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        if (checks[i].attr >= sc.attrs_sz || !held[checks[i].attr])
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; !keys_only && i < sc.attrs_sz; ++i)
+    {
+        if (!held[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// True if every object that falls within "ranges" passes the filters of
+// "idx", so that the (partial) index holds all objects the search may return.
+static bool
+index_implied(const hyperdex::index& idx,
+              const std::vector<hyperdex::range>& ranges)
+{
+    for (size_t i = 0; i < idx.filters.size(); ++i)
+    {
+        const hyperdex::index_filter& f(idx.filters[i]);
+        e::slice v(f.value.data(), f.value.size());
+        const hyperdex::range* r = NULL;
+
+        for (size_t j = 0; j < ranges.size(); ++j)
+        {
+            if (ranges[j].attr == f.attr)
+            {
+                r = &ranges[j];
+            }
+        }
+
+        if (!r || r->invalid)
+        {
+            return false;
+        }
+
+        switch (f.predicate)
+        {
+            case HYPERPREDICATE_EQUALS:
+                if (!r->is_point() || compare_as_type(r->start, v, r->type) != 0)
+                {
+                    return false;
+                }
+                break;
+            case HYPERPREDICATE_LESS_EQUAL:
+                if (!r->has_end || r->prefix || compare_as_type(r->end, v, r->type) > 0)
+                {
+                    return false;
+                }
+                break;
+            case HYPERPREDICATE_GREATER_EQUAL:
+                if (!r->has_start || compare_as_type(r->start, v, r->type) < 0)
+                {
+                    return false;
+                }
+                break;
+            case HYPERPREDICATE_FAIL:
+            case HYPERPREDICATE_CONTAINS_LESS_THAN:
+            case HYPERPREDICATE_PREFIX:
+            case HYPERPREDICATE_REGEX:
+            case HYPERPREDICATE_IN:
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+datalayer::returncode
+datalayer :: make_snapshot(const region_id& ri,
+                           const schema& sc,
+                           const std::vector<attribute_check>* checks,
+                           snapshot* snap,
+                           profile* prof)
+{
+    return make_snapshot(ri, sc, checks, e::slice(), e::slice(), snap, prof);
+}
+
+datalayer::returncode
+datalayer :: make_snapshot(const region_id& ri,
+                           const schema& sc,
+                           const std::vector<attribute_check>* checks,
+                           const e::slice& lower,
+                           const e::slice& upper,
+                           snapshot* snap,
+                           profile* prof)
+{
+    uint64_t wall_start = prof ? e::time() : 0;
+    uint64_t cpu_start = prof ? thread_cpu_time() : 0;
+    snap->m_dl = this;
+    snap->m_snap.reset(m_db, m_db->GetSnapshot());
+    snap->m_checks = checks;
+    snap->m_ri = ri;
+    snap->m_prof = prof;
+    std::vector<range> ranges;
+
+    if (!range_searches(*checks, &ranges) ||
+        !compile_regexes(*checks, &snap->m_regexes))
+    {
+        return BAD_SEARCH;
+    }
+
+    if (prof)
+    {
+        prof->passed.resize(checks->size(), 0);
+    }
+
+    char* ptr;
     std::vector<leveldb::Range> level_ranges;
+    std::vector<size_t> level_owners;
     std::vector<bool (*)(const leveldb::Slice& in, e::slice* out)> parsers;
-
-    // For each range, setup a leveldb range using encoded values
+    std::vector<uint16_t> attrs;
+    // the number each candidate's entries are stored under, and the explicit
+    // index it scans (NULL for the implicit index on a subspace attribute)
+    std::vector<uint16_t> ids;
+    std::vector<const index*> explicits;
+    const space* sp = m_daemon->m_config.get_space(ri);
+    snap->m_covered.clear();
+
+    // For each range, setup one or more leveldb ranges using encoded values
     for (size_t i = 0; i < ranges.size(); ++i)
     {
-        if (ostr) *ostr << " considering attr " << ranges[i].attr << " Range("
-                        << ranges[i].start.hex() << ", " << ranges[i].end.hex() << " " << ranges[i].type << " "
-                        << (ranges[i].has_start ? "[" : "<") << "-" << (ranges[i].has_end ? "]" : ">")
-                        << " " << (ranges[i].invalid ? "invalid" : "valid") << "\n";
-
         if (ranges[i].attr >= sc.attrs_sz ||
             sc.attrs[ranges[i].attr].type != ranges[i].type)
         {
@@ -923,6 +1253,45 @@ datalayer :: make_snapshot(const region_id& ri,
             continue;
         }
 
+        // An IN-list scans one index range per point.  The points are sorted,
+        // so overlapping ranges (string ranges admit any value extending the
+        // point) are adjacent and get coalesced, which guarantees that no
+        // index entry, and thus no key, is visited twice.
+        if (!ranges[i].points.empty())
+        {
+            size_t first = level_ranges.size();
+
+            for (size_t p = 0; p < ranges[i].points.size(); ++p)
+            {
+                snap->m_backing.push_back(std::vector<char>());
+                encode_index(ri, ranges[i].attr, ranges[i].type, ranges[i].points[p], &snap->m_backing.back());
+                leveldb::Slice start(&snap->m_backing.back()[0], snap->m_backing.back().size());
+                snap->m_backing.push_back(snap->m_backing.back());
+                bump_index(&snap->m_backing.back());
+                leveldb::Slice limit(&snap->m_backing.back()[0], snap->m_backing.back().size());
+
+                if (level_ranges.size() > first &&
+                    start.compare(level_ranges.back().limit) <= 0)
+                {
+                    if (limit.compare(level_ranges.back().limit) > 0)
+                    {
+                        level_ranges.back().limit = limit;
+                    }
+                }
+                else
+                {
+                    level_ranges.push_back(leveldb::Range(start, limit));
+                    level_owners.push_back(parsers.size());
+                }
+            }
+
+            parsers.push_back(parse);
+            attrs.push_back(ranges[i].attr);
+            ids.push_back(ranges[i].attr);
+            explicits.push_back(NULL);
+            continue;
+        }
+
         if (ranges[i].has_start)
         {
             snap->m_backing.push_back(std::vector<char>());
@@ -957,7 +1326,60 @@ datalayer :: make_snapshot(const region_id& ri,
 
         leveldb::Slice limit(&snap->m_backing.back()[0], snap->m_backing.back().size());
         level_ranges.push_back(leveldb::Range(start, limit));
+        level_owners.push_back(parsers.size());
         parsers.push_back(parse);
+        attrs.push_back(ranges[i].attr);
+        ids.push_back(ranges[i].attr);
+        explicits.push_back(NULL);
+    }
+
+    // Each explicit index scans one run of entries:  those matching the
+    // single values on a prefix of its attributes, narrowed by the range on
+    // the attribute after them.
+    for (size_t i = 0; sp && i < sp->indices.size(); ++i)
+    {
+        const index& idx(sp->indices[i]);
+        std::vector<const range*> prefix;
+        range_prefix(ranges, idx.attrs, &prefix);
+
+        // a partial index may omit objects the search should find, and so
+        // may one that is still being built
+        if (prefix.empty() || !index_implied(idx, ranges) || !index_built(ri, idx.id))
+        {
+            continue;
+        }
+
+        snap->m_backing.push_back(std::vector<char>());
+        std::vector<char>* start = &snap->m_backing.back();
+        encode_index(ri, idx.id, start);
+
+        for (size_t j = 0; j + 1 < prefix.size(); ++j)
+        {
+            index_encode_attr(prefix[j]->type, prefix[j]->start, true, start);
+        }
+
+        snap->m_backing.push_back(*start);
+        std::vector<char>* limit = &snap->m_backing.back();
+        const range* last = prefix.back();
+
+        if (last->has_start)
+        {
+            index_encode_attr(last->type, last->start, false, start);
+        }
+
+        if (last->has_end)
+        {
+            index_encode_attr(last->type, last->end, !last->prefix, limit);
+        }
+
+        bump_index(limit);
+        level_ranges.push_back(leveldb::Range(leveldb::Slice(&start->front(), start->size()),
+                                              leveldb::Slice(&limit->front(), limit->size())));
+        level_owners.push_back(parsers.size());
+        parsers.push_back(&parse_index_string);
+        attrs.push_back(idx.attrs[0]);
+        ids.push_back(idx.id);
+        explicits.push_back(&idx);
     }
 
     // Add to level_ranges the size of the object range for the region itself
@@ -976,34 +1398,88 @@ datalayer :: make_snapshot(const region_id& ri,
                                                snap->m_backing.back().size());
 
     // Fetch from leveldb the approximate space usage of each computed range
-    std::vector<uint64_t> sizes(level_ranges.size());
-    m_db->GetApproximateSizes(&level_ranges.front(), level_ranges.size(), &sizes.front());
+    std::vector<uint64_t> level_sizes(level_ranges.size());
+    m_db->GetApproximateSizes(&level_ranges.front(), level_ranges.size(), &level_sizes.front());
+
+    // the size of all objects in the region of the search
+    uint64_t object_disk_space = level_sizes.back();
+    leveldb::Range object_range = level_ranges.back();
+    level_ranges.pop_back();
+    level_sizes.pop_back();
+    bool bounded = !lower.empty() || !upper.empty();
 
-    if (ostr)
+    if (!lower.empty())
     {
-        for (size_t i = 0; i < level_ranges.size(); ++i)
+        leveldb::Slice tmp;
+        snap->m_backing.push_back(std::vector<char>());
+        encode_key(ri, lower, &snap->m_backing.back(), &tmp);
+        object_range.start = tmp;
+    }
+
+    if (!upper.empty())
+    {
+        leveldb::Slice tmp;
+        snap->m_backing.push_back(std::vector<char>());
+        encode_key(ri, upper, &snap->m_backing.back(), &tmp);
+        object_range.limit = tmp;
+    }
+
+    assert(level_owners.size() == level_ranges.size());
+
+    // the size of each index is the sum of the ranges it scans
+    std::vector<uint64_t> sizes(parsers.size(), 0);
+
+    for (size_t i = 0; i < level_ranges.size(); ++i)
+    {
+        sizes[level_owners[i]] += level_sizes[i];
+    }
+
+    // An explicit index covers the search when its entries hold every
+    // attribute that the checks (and the caller) need
+    std::vector<bool> covering(parsers.size(), false);
+
+    for (size_t i = 0; i < parsers.size(); ++i)
+    {
+        covering[i] = explicits[i] && index_covers(*explicits[i], sc, *checks, snap->m_keys_only);
+    }
+
+    if (prof)
+    {
+        prof->object_bytes = object_disk_space;
+        prof->candidates.resize(parsers.size());
+
+        for (size_t i = 0; i < parsers.size(); ++i)
         {
-            *ostr << " index Range(" << e::slice(level_ranges[i].start.data(), level_ranges[i].start.size()).hex()
-                  << ", " << e::slice(level_ranges[i].limit.data(), level_ranges[i].limit.size()).hex()
-                  << " occupies " << sizes[i] << " bytes\n";
+            prof->candidates[i].attr = attrs[i];
+            prof->candidates[i].index = ids[i];
+            prof->candidates[i].covering = covering[i];
+            prof->candidates[i].estimated_bytes = sizes[i];
         }
-    }
 
-    // the size of all objects in the region of the search
-    uint64_t object_disk_space = sizes.back();
-    if (ostr) *ostr << " objects for " << ri << " occupies " << object_disk_space << " bytes\n";
-    leveldb::Range object_range = level_ranges.back();
-    level_ranges.pop_back();
-    sizes.pop_back();
-    assert(parsers.size() == sizes.size());
-    assert(parsers.size() == level_ranges.size());
+        for (size_t i = 0; i < level_owners.size(); ++i)
+        {
+            ++prof->candidates[level_owners[i]].ranges;
+        }
+    }
 
-    // Figure out the smallest indices
+    // Figure out the smallest indices.  A covering index visits the same
+    // entries as any other index on its attribute without retrieving the
+    // objects, so it supersedes them even though its entries are larger.
     std::vector<std::pair<uint64_t, size_t> > size_idxs;
 
     for (size_t i = 0; i < sizes.size(); ++i)
     {
-        size_idxs.push_back(std::make_pair(sizes[i], i));
+        bool superseded = false;
+
+        for (size_t j = 0; !covering[i] && j < sizes.size(); ++j)
+        {
+            superseded = superseded || (covering[j] && attrs[j] == attrs[i]);
+        }
+
+        if (!superseded)
+        {
+            size_idxs.push_back(std::make_pair(sizes[i], i));
+        }
     }
 
     std::sort(size_idxs.begin(), size_idxs.end());
@@ -1013,38 +1489,75 @@ datalayer :: make_snapshot(const region_id& ri,
     // 2.  Use the least costly index (idx = 1)
     // 3.  Use the least costly index plus bloom filters pulled from other
     //     low-cost indices. (idx > 1)
+    // A search bounded by key must scan objects, because the indices are
+    // ordered by value rather than key.
     size_t idx = 0;
     size_t sum = 0;
 
-    while (idx < size_idxs.size())
+    while (!bounded && idx < size_idxs.size())
     {
         if (sum + size_idxs[idx].first < object_disk_space / 4. &&
             (idx == 0 || size_idxs[idx - 1].first * 10 > size_idxs[idx].first))
 
         {
-            if (ostr) *ostr << " next smallest index is " << size_idxs[idx].second << ":  small enough\n";
             sum += size_idxs[idx].first;
             ++idx;
         }
         else
         {
-            if (ostr) *ostr << " next smallest index is " << size_idxs[idx].second << ":  too big\n";
             break;
         }
     }
 
+    snap->m_ranges.clear();
+    snap->m_range_idx = 0;
+
     if (idx == 0)
     {
-        if (ostr) *ostr << " choosing to just enumerate all objects\n";
-        snap->m_range = object_range;
+        snap->m_ranges.push_back(object_range);
         snap->m_parse = &parse_object_key;
+
+        if (prof)
+        {
+            prof->used_index = false;
+            prof->estimated_bytes = object_disk_space;
+
+            if (bounded)
+            {
+                m_db->GetApproximateSizes(&object_range, 1, &prof->estimated_bytes);
+            }
+        }
     }
     else
     {
         size_t tidx = size_idxs[0].second;
-        if (ostr) *ostr << " choosing to use index " << tidx << " as the primary\n";
-        snap->m_range = level_ranges[tidx];
+
+        for (size_t i = 0; i < level_ranges.size(); ++i)
+        {
+            if (level_owners[i] == tidx)
+            {
+                snap->m_ranges.push_back(level_ranges[i]);
+            }
+        }
+
         snap->m_parse = parsers[tidx];
+
+        if (covering[tidx])
+        {
+            snap->m_covered = explicits[tidx]->attrs;
+            snap->m_covered.insert(snap->m_covered.end(),
+                                   explicits[tidx]->include.begin(),
+                                   explicits[tidx]->include.end());
+        }
+
+        if (prof)
+        {
+            prof->used_index = true;
+            prof->index_attr = attrs[tidx];
+            prof->index_id = ids[tidx];
+            prof->covering = covering[tidx];
+            prof->estimated_bytes = sizes[tidx];
+        }
     }
 
     // Create iterator
@@ -1053,10 +1566,163 @@ datalayer :: make_snapshot(const region_id& ri,
     opts.verify_checksums = false;
     opts.snapshot = snap->m_snap.get();
     snap->m_iter.reset(snap->m_snap, m_db->NewIterator(opts));
-    snap->m_iter->Seek(snap->m_range.start);
+    snap->m_iter->Seek(snap->m_ranges[0].start);
+
+    if (prof)
+    {
+        prof->plan_wall += e::time() - wall_start;
+        prof->plan_cpu += thread_cpu_time() - cpu_start;
+    }
+
     return SUCCESS;
 }
 
+// The first eight bytes following "skip" bytes of "key", as a big-endian
+// integer padded with zeros
+static uint64_t
+key_position(const std::string& key, size_t skip)
+{
+    char buf[sizeof(uint64_t)];
+    memset(buf, 0, sizeof(buf));
+
+    if (key.size() > skip)
+    {
+        memmove(buf, key.data() + skip, std::min(key.size() - skip, sizeof(buf)));
+    }
+
+    uint64_t pos;
+    e::unpack64be(buf, &pos);
+    return pos;
+}
+
+static std::string
+key_at_position(const std::string& prefix, uint64_t pos)
+{
+    char buf[sizeof(uint64_t)];
+    e::pack64be(pos, buf);
+    return prefix + std::string(buf, sizeof(buf));
+}
+
+void
+datalayer :: split_points(const region_id& ri,
+                          uint64_t n,
+                          std::vector<std::string>* splits)
+{
+    splits->clear();
+    char lbacking[sizeof(uint8_t) + sizeof(uint64_t)];
+    char ubacking[sizeof(uint8_t) + sizeof(uint64_t)];
+    e::pack64be(ri.get(), e::pack8be('o', lbacking));
+    e::pack64be(ri.get() + 1, e::pack8be('o', ubacking));
+    leveldb::Range region(leveldb::Slice(lbacking, sizeof(lbacking)),
+                          leveldb::Slice(ubacking, sizeof(ubacking)));
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = false;
+    opts.snapshot = NULL;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    it->Seek(region.start);
+
+    if (n < 2 || !it->Valid() || it->key().compare(region.limit) >= 0)
+    {
+        return;
+    }
+
+    std::string first(it->key().data() + sizeof(lbacking), it->key().size() - sizeof(lbacking));
+    it->Seek(region.limit);
+
+    if (it->Valid())
+    {
+        it->Prev();
+    }
+    else
+    {
+        it->SeekToLast();
+    }
+
+    assert(it->Valid());
+    std::string last(it->key().data() + sizeof(lbacking), it->key().size() - sizeof(lbacking));
+
+    // Every key lies between first and last, so only the bytes after their
+    // common prefix distinguish keys.  Split points are that prefix followed
+    // by eight bytes chosen to divide the region's size evenly.
+    size_t common = 0;
+
+    while (common < first.size() && common < last.size() &&
+           first[common] == last[common])
+    {
+        ++common;
+    }
+
+    std::string prefix(first.data(), common);
+    uint64_t lo = key_position(first, common);
+    uint64_t hi = key_position(last, common);
+
+    if (lo >= hi)
+    {
+        return;
+    }
+
+    uint64_t total = 0;
+    m_db->GetApproximateSizes(&region, 1, &total);
+
+    for (uint64_t k = 1; k < n; ++k)
+    {
+        uint64_t pos;
+
+        if (total == 0)
+        {
+            // LevelDB has no estimate (e.g., everything is still in the
+            // memtable), so split the key space evenly instead.
+            pos = lo + (hi - lo) / n * k;
+        }
+        else
+        {
+            // smallest position whose prefix of the region holds k/n of it
+            uint64_t target = total / n * k;
+            uint64_t l = lo;
+            uint64_t h = hi;
+
+            while (l < h)
+            {
+                uint64_t mid = l + (h - l) / 2;
+                std::string key(key_at_position(prefix, mid));
+                std::vector<char> kbacking;
+                leveldb::Slice lkey;
+                encode_key(ri, e::slice(key.data(), key.size()), &kbacking, &lkey);
+                leveldb::Range r(region.start, lkey);
+                uint64_t sz = 0;
+                m_db->GetApproximateSizes(&r, 1, &sz);
+
+                if (sz < target)
+                {
+                    l = mid + 1;
+                }
+                else
+                {
+                    h = mid;
+                }
+            }
+
+            pos = l;
+        }
+
+        // splits must be strictly increasing and leave the first range
+        // non-empty
+        std::string split(key_at_position(prefix, pos));
+
+        if (pos > lo && (splits->empty() || splits->back() < split))
+        {
+            splits->push_back(split);
+        }
+    }
+}
+
+bool
+datalayer :: epoch(const region_id& ri, uint64_t* e)
+{
+    return m_epochs.current(ri, e);
+}
+
 leveldb_snapshot_ptr
 datalayer :: make_raw_snapshot()
 {
@@ -1213,6 +1879,19 @@ datalayer :: mark_acked(const region_id& ri,
     }
 }
 
+void
+datalayer :: mark_acked(const region_id& ri,
+                        const region_id& reg_id,
+                        uint64_t seq_id,
+                        batch* b)
+{
+    // make it so that increasing seq_ids are ordered in reverse in the KVS
+    char abacking[ACKED_BUF_SIZE];
+    encode_acked(ri, reg_id, UINT64_MAX - seq_id, abacking);
+    b->m_updates.Put(leveldb::Slice(abacking, ACKED_BUF_SIZE), leveldb::Slice("", 0));
+    ++b->m_writes;
+}
+
 void
 datalayer :: max_seq_id(const region_id& reg_id,
                         uint64_t* seq_id)
@@ -1250,59 +1929,84 @@ datalayer :: max_seq_id(const region_id& reg_id,
 }
 
 void
-datalayer :: clear_acked(const region_id& reg_id,
-                         uint64_t seq_id)
+datalayer :: clear_acked(const std::vector<std::pair<region_id, uint64_t> >& lower_bounds)
 {
     leveldb::ReadOptions opts;
     opts.fill_cache = false;
     opts.verify_checksums = true;
     opts.snapshot = NULL;
     std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(region_id(0), reg_id, 0, abacking);
-    it->Seek(leveldb::Slice(abacking, ACKED_BUF_SIZE));
-    encode_acked(region_id(0), region_id(reg_id.get() + 1), 0, abacking);
-    leveldb::Slice upper_bound(abacking, ACKED_BUF_SIZE);
-
-    while (it->Valid() &&
-           it->key().compare(upper_bound) < 0)
-    {
-        region_id tmp_ri;
-        region_id tmp_reg_id;
-        uint64_t tmp_seq_id;
-        datalayer::returncode rc = decode_acked(e::slice(it->key().data(), it->key().size()),
-                                                &tmp_ri, &tmp_reg_id, &tmp_seq_id);
-        tmp_seq_id = UINT64_MAX - tmp_seq_id;
-
-        if (rc == SUCCESS &&
-            tmp_reg_id == reg_id &&
-            tmp_seq_id < seq_id)
-        {
-            leveldb::WriteOptions wopts;
-            wopts.sync = false;
-            leveldb::Status st = m_db->Delete(wopts, it->key());
-
-            if (st.ok() || st.IsNotFound())
-            {
-                // WOOT!
-            }
-            else if (st.IsCorruption())
+    leveldb::WriteOptions wopts;
+    wopts.sync = false;
+    leveldb::WriteBatch updates;
+    size_t batched = 0;
+
+    for (size_t i = 0; i < lower_bounds.size(); ++i)
+    {
+        const region_id& reg_id(lower_bounds[i].first);
+        uint64_t seq_id = lower_bounds[i].second;
+        char abacking[ACKED_BUF_SIZE];
+        encode_acked(region_id(0), reg_id, 0, abacking);
+        it->Seek(leveldb::Slice(abacking, ACKED_BUF_SIZE));
+        encode_acked(region_id(0), region_id(reg_id.get() + 1), 0, abacking);
+        leveldb::Slice upper_bound(abacking, ACKED_BUF_SIZE);
+
+        while (it->Valid() &&
+               it->key().compare(upper_bound) < 0)
+        {
+            region_id tmp_ri;
+            region_id tmp_reg_id;
+            uint64_t tmp_seq_id;
+            datalayer::returncode rc = decode_acked(e::slice(it->key().data(), it->key().size()),
+                                                    &tmp_ri, &tmp_reg_id, &tmp_seq_id);
+            tmp_seq_id = UINT64_MAX - tmp_seq_id;
+
+            if (rc == SUCCESS &&
+                tmp_reg_id == reg_id &&
+                tmp_seq_id < seq_id)
             {
-                LOG(ERROR) << "corruption at the disk layer: could not delete "
-                           << reg_id << " " << seq_id << ": desc=" << st.ToString();
+                updates.Delete(it->key());
+                ++batched;
             }
-            else if (st.IsIOError())
+
+            it->Next();
+
+            if (batched >= CLEAR_ACKED_BATCH)
             {
-                LOG(ERROR) << "IO error at the disk layer: could not delete "
-                           << reg_id << " " << seq_id << ": desc=" << st.ToString();
-            }
-            else
-            {
-                LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+                write_cleared_acks(wopts, &updates);
+                batched = 0;
             }
         }
+    }
+
+    if (batched > 0)
+    {
+        write_cleared_acks(wopts, &updates);
+    }
+}
+
+void
+datalayer :: write_cleared_acks(const leveldb::WriteOptions& wopts,
+                                leveldb::WriteBatch* updates)
+{
+    leveldb::Status st = m_db->Write(wopts, updates);
+    updates->Clear();
 
-        it->Next();
+    if (st.ok() || st.IsNotFound())
+    {
+        // WOOT!
+    }
+    else if (st.IsCorruption())
+    {
+        LOG(ERROR) << "corruption at the disk layer: could not clear acks: desc=" << st.ToString();
+    }
+    else if (st.IsIOError())
+    {
+        LOG(ERROR) << "IO error at the disk layer: could not clear acks: desc=" << st.ToString();
+    }
+    else
+    {
+        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
     }
 }
 
@@ -1314,6 +2018,208 @@ datalayer :: request_wipe(const capture_id& cid)
     m_wakeup_cleaner.broadcast();
 }
 
+bool
+datalayer :: index_built(const region_id& ri, uint16_t id)
+{
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    return m_built.find(std::make_pair(ri, id)) != m_built.end();
+}
+
+datalayer::returncode
+datalayer :: stage_del(const region_id& ri,
+                       const region_id& reg_id,
+                       uint64_t seq_id,
+                       const e::slice& key,
+                       const std::vector<e::slice>& old_value,
+                       leveldb::WriteBatch* updates)
+{
+    std::vector<char> backing1;
+    std::vector<char> backing2;
+
+    // peform the "del" of the object we want to store
+    leveldb::Slice lkey;
+    encode_key(ri, key, &backing1, &lkey);
+    updates->Delete(lkey);
+
+    // apply the index operations
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const subspace* su = m_daemon->m_config.get_subspace(ri);
+    const space* sp = m_daemon->m_config.get_space(ri);
+    returncode rc = create_index_changes(sc, su, sp->indices, ri, key, &old_value, NULL, 0, updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    // Mark acked as part of this batch write
+    if (seq_id != 0)
+    {
+        char abacking[ACKED_BUF_SIZE];
+        seq_id = UINT64_MAX - seq_id;
+        encode_acked(ri, reg_id, seq_id, abacking);
+        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
+        leveldb::Slice aval("", 0);
+        updates->Put(akey, aval);
+    }
+
+    uint64_t count;
+
+    // If this is a captured region, then we must log this transfer
+    if (m_counters.lookup(ri, &count))
+    {
+        char tbacking[TRANSFER_BUF_SIZE];
+        capture_id cid = m_daemon->m_config.capture_for(ri);
+        assert(cid != capture_id());
+        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
+        leveldb::Slice tval;
+        encode_transfer(cid, count, tbacking);
+        encode_key_value(key, NULL, 0, &backing2, &tval);
+        updates->Put(tkey, tval);
+    }
+
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: stage_put(const region_id& ri,
+                       const region_id& reg_id,
+                       uint64_t seq_id,
+                       const e::slice& key,
+                       const std::vector<e::slice>& new_value,
+                       uint64_t version,
+                       leveldb::WriteBatch* updates)
+{
+    std::vector<char> backing1;
+    std::vector<char> backing2;
+
+    // peform the "put" of the object we want to store
+    leveldb::Slice lkey;
+    leveldb::Slice lval;
+    encode_key(ri, key, &backing1, &lkey);
+    encode_value(new_value, version, &backing2, &lval);
+    updates->Put(lkey, lval);
+
+    // apply the index operations
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const subspace* su = m_daemon->m_config.get_subspace(ri);
+    const space* sp = m_daemon->m_config.get_space(ri);
+    returncode rc = create_index_changes(sc, su, sp->indices, ri, key, NULL, &new_value, version, updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    // Mark acked as part of this batch write
+    if (seq_id != 0)
+    {
+        char abacking[ACKED_BUF_SIZE];
+        seq_id = UINT64_MAX - seq_id;
+        encode_acked(ri, reg_id, seq_id, abacking);
+        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
+        leveldb::Slice aval("", 0);
+        updates->Put(akey, aval);
+    }
+
+    uint64_t count;
+
+    // If this is a captured region, then we must log this transfer
+    if (m_counters.lookup(ri, &count))
+    {
+        char tbacking[TRANSFER_BUF_SIZE];
+        capture_id cid = m_daemon->m_config.capture_for(ri);
+        assert(cid != capture_id());
+        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
+        leveldb::Slice tval;
+        encode_transfer(cid, count, tbacking);
+        encode_key_value(key, &new_value, version, &backing2, &tval);
+        updates->Put(tkey, tval);
+    }
+
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: stage_overput(const region_id& ri,
+                           const region_id& reg_id,
+                           uint64_t seq_id,
+                           const e::slice& key,
+                           const std::vector<e::slice>& old_value,
+                           const std::vector<e::slice>& new_value,
+                           uint64_t version,
+                           leveldb::WriteBatch* updates)
+{
+    std::vector<char> backing1;
+    std::vector<char> backing2;
+
+    // peform the "put" of the object we want to store
+    leveldb::Slice lkey;
+    leveldb::Slice lval;
+    encode_key(ri, key, &backing1, &lkey);
+    encode_value(new_value, version, &backing2, &lval);
+    updates->Put(lkey, lval);
+
+    // apply the index operations
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const subspace* su = m_daemon->m_config.get_subspace(ri);
+    const space* sp = m_daemon->m_config.get_space(ri);
+    returncode rc = create_index_changes(sc, su, sp->indices, ri, key, &old_value, &new_value, version, updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    // Mark acked as part of this batch write
+    if (seq_id != 0)
+    {
+        char abacking[ACKED_BUF_SIZE];
+        seq_id = UINT64_MAX - seq_id;
+        encode_acked(ri, reg_id, seq_id, abacking);
+        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
+        leveldb::Slice aval("", 0);
+        updates->Put(akey, aval);
+    }
+
+    uint64_t count;
+
+    // If this is a captured region, then we must log this transfer
+    if (m_counters.lookup(ri, &count))
+    {
+        char tbacking[TRANSFER_BUF_SIZE];
+        capture_id cid = m_daemon->m_config.capture_for(ri);
+        assert(cid != capture_id());
+        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
+        leveldb::Slice tval;
+        encode_transfer(cid, count, tbacking);
+        encode_key_value(key, &new_value, version, &backing2, &tval);
+        updates->Put(tkey, tval);
+    }
+
+    return SUCCESS;
+}
+
+void
+datalayer :: add_to_batch(const region_id& ri,
+                          const e::slice& key,
+                          const leveldb::WriteBatch& updates,
+                          batch* b)
+{
+    batch_appender append(&b->m_updates);
+    updates.Iterate(&append);
+    b->m_locks.push_back(index_lock_num(ri, key));
+    b->m_regions.push_back(ri);
+    ++b->m_writes;
+}
+
+void
+datalayer :: bump_epoch(const region_id& ri)
+{
+    uint64_t e;
+    m_epochs.lookup(ri, &e);
+}
+
 void
 datalayer :: cleaner()
 {
@@ -1343,105 +2249,698 @@ datalayer :: cleaner()
                     m_state_transfer_captures.empty() &&
                     !m_shutdown) || m_need_pause)
             {
-                m_paused = true;
+                m_paused = true;
+
+                if (m_need_pause)
+                {
+                    m_wakeup_reconfigurer.signal();
+                }
+
+                m_wakeup_cleaner.wait();
+                m_paused = false;
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+
+            m_state_transfer_captures.swap(state_transfer_captures);
+            m_need_cleaning = false;
+        }
+
+        leveldb::ReadOptions opts;
+        opts.fill_cache = true;
+        opts.verify_checksums = true;
+        std::auto_ptr<leveldb::Iterator> it;
+        it.reset(m_db->NewIterator(opts));
+        it->Seek(leveldb::Slice("t", 1));
+        capture_id cached_cid;
+
+        while (it->Valid())
+        {
+            uint8_t prefix;
+            uint64_t cid;
+            uint64_t seq_no;
+            e::unpacker up(it->key().data(), it->key().size());
+            up = up >> prefix >> cid >> seq_no;
+
+            if (up.error() || prefix != 't')
+            {
+                break;
+            }
+
+            if (cid == cached_cid.get())
+            {
+                leveldb::WriteOptions wopts;
+                wopts.sync = false;
+                leveldb::Status st = m_db->Delete(wopts, it->key());
+
+                if (st.ok() || st.IsNotFound())
+                {
+                    // pass
+                }
+                else if (st.IsCorruption())
+                {
+                    LOG(ERROR) << "corruption at the disk layer: could not cleanup old transfers:"
+                               << " desc=" << st.ToString();
+                }
+                else if (st.IsIOError())
+                {
+                    LOG(ERROR) << "IO error at the disk layer: could not cleanup old transfers:"
+                               << " desc=" << st.ToString();
+                }
+                else
+                {
+                    LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+                }
+
+                it->Next();
+                continue;
+            }
+
+            m_daemon->m_stm.report_wiped(cached_cid);
+
+            if (!m_daemon->m_config.is_captured_region(capture_id(cid)))
+            {
+                cached_cid = capture_id(cid);
+                continue;
+            }
+
+            if (state_transfer_captures.find(capture_id(cid)) != state_transfer_captures.end())
+            {
+                cached_cid = capture_id(cid);
+                state_transfer_captures.erase(cached_cid);
+                continue;
+            }
+
+            char tbacking[TRANSFER_BUF_SIZE];
+            leveldb::Slice slice(tbacking, TRANSFER_BUF_SIZE);
+            encode_transfer(capture_id(cid + 1), 0, tbacking);
+            it->Seek(slice);
+        }
+
+        while (!state_transfer_captures.empty())
+        {
+            m_daemon->m_stm.report_wiped(*state_transfer_captures.begin());
+            state_transfer_captures.erase(state_transfer_captures.begin());
+        }
+    }
+
+    LOG(INFO) << "cleanup thread shutting down";
+}
+
+// Reconcile the indices that are built (or being built) for the regions of
+// this server with the indices the configuration declares:  schedule a
+// backfill for each index a region lacks, and a drop for each index that the
+// configuration no longer declares.  Jobs for one region run in the order they
+// are scheduled.
+void
+datalayer :: schedule_index_jobs(const configuration& config, const server_id& us)
+{
+    typedef std::pair<region_id, uint16_t> region_index;
+    typedef std::list<std::tr1::shared_ptr<index_job> > job_list;
+    std::vector<region_id> mapped;
+    config.mapped_regions(us, &mapped);
+    std::map<region_index, std::pair<const hyperdex::space*, const index*> > wanted;
+
+    for (size_t i = 0; i < mapped.size(); ++i)
+    {
+        const hyperdex::space* sp = config.get_space(mapped[i]);
+
+        for (size_t j = 0; sp && j < sp->indices.size(); ++j)
+        {
+            const index* idx = &sp->indices[j];
+            wanted[std::make_pair(mapped[i], idx->id)] = std::make_pair(sp, idx);
+        }
+    }
+
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    // what the built indices, the queued jobs, and the running jobs will have
+    // in place once every job completes
+    std::set<region_index> present(m_built);
+    std::set<region_index> dropped;
+
+    for (job_list::iterator it = m_index_running.begin();
+            it != m_index_running.end(); ++it)
+    {
+        region_index ri_id((*it)->ri, (*it)->idx.id);
+
+        if ((*it)->drop)
+        {
+            present.erase(ri_id);
+        }
+        else if ((*it)->cancelled)
+        {
+            // a drop is already queued behind it
+        }
+        else if (wanted.find(ri_id) == wanted.end())
+        {
+            (*it)->cancelled = true;
+            dropped.insert(ri_id);
+        }
+        else
+        {
+            present.insert(ri_id);
+        }
+    }
+
+    job_list::iterator it = m_index_jobs.begin();
+
+    while (it != m_index_jobs.end())
+    {
+        region_index ri_id((*it)->ri, (*it)->idx.id);
+
+        if ((*it)->drop)
+        {
+            present.erase(ri_id);
+            ++it;
+        }
+        else if (wanted.find(ri_id) == wanted.end())
+        {
+            it = m_index_jobs.erase(it);
+        }
+        else
+        {
+            present.insert(ri_id);
+            ++it;
+        }
+    }
+
+    for (std::set<region_index>::iterator p = present.begin(); p != present.end(); ++p)
+    {
+        if (wanted.find(*p) == wanted.end())
+        {
+            dropped.insert(*p);
+        }
+    }
+
+    for (std::set<region_index>::iterator d = dropped.begin(); d != dropped.end(); ++d)
+    {
+        index idx;
+        idx.id = d->second;
+        m_built.erase(*d);
+        m_index_jobs.push_back(std::tr1::shared_ptr<index_job>(new index_job(d->first, hyperdex::space(), idx, true)));
+    }
+
+    for (std::map<region_index, std::pair<const hyperdex::space*, const index*> >::iterator w = wanted.begin();
+            w != wanted.end(); ++w)
+    {
+        if (present.find(w->first) == present.end())
+        {
+            m_index_jobs.push_back(std::tr1::shared_ptr<index_job>(new index_job(w->first.first, *w->second.first, *w->second.second, false)));
+        }
+    }
+
+    m_wakeup_backfillers.broadcast();
+}
+
+void
+datalayer :: backfiller()
+{
+    LOG(INFO) << "index backfill thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        std::tr1::shared_ptr<index_job> job;
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
+            while (!m_shutdown && !job)
+            {
+                // take the first job whose region no other thread is working on
+                for (std::list<std::tr1::shared_ptr<index_job> >::iterator it = m_index_jobs.begin();
+                        !job && it != m_index_jobs.end(); ++it)
+                {
+                    bool busy = false;
+
+                    for (std::list<std::tr1::shared_ptr<index_job> >::iterator r = m_index_running.begin();
+                            r != m_index_running.end(); ++r)
+                    {
+                        busy = busy || (*r)->ri == (*it)->ri;
+                    }
+
+                    for (std::list<std::tr1::shared_ptr<index_job> >::iterator q = m_index_jobs.begin();
+                            !busy && q != it; ++q)
+                    {
+                        busy = (*q)->ri == (*it)->ri;
+                    }
+
+                    if (!busy)
+                    {
+                        job = *it;
+                        m_index_jobs.erase(it);
+                        m_index_running.push_back(job);
+                        break;
+                    }
+                }
+
+                if (!job)
+                {
+                    m_wakeup_backfillers.wait();
+                }
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+        }
+
+        bool done = job->drop ? drop_index(job.get()) : backfill(job.get());
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+            m_index_running.remove(job);
+
+            if (done && !job->drop && !job->cancelled)
+            {
+                m_built.insert(std::make_pair(job->ri, job->idx.id));
+            }
+
+            m_wakeup_backfillers.broadcast();
+        }
+
+        if (done && !job->drop && !job->cancelled)
+        {
+            LOG(INFO) << "built index " << job->idx.id << " for " << job->ri;
+        }
+    }
+
+    LOG(INFO) << "index backfill thread shutting down";
+}
+
+// Index every object of the region as of a snapshot.  Each object is indexed
+// at its current value, read while holding the lock on its key, so that the
+// entry is either the one a concurrent write would create or is replaced by
+// that write.
+bool
+datalayer :: backfill(index_job* job)
+{
+    const schema* sc = &job->sp.sc;
+    leveldb_snapshot_ptr snap = make_raw_snapshot();
+    region_iterator riter;
+    make_region_iterator(&riter, snap, job->ri);
+    std::vector<std::string> keys;
+
+    while (riter.valid() || !keys.empty())
+    {
+        if (riter.valid() && keys.size() < BACKFILL_BATCH)
+        {
+            e::slice k = riter.key();
+            keys.push_back(std::string(reinterpret_cast<const char*>(k.data()), k.size()));
+            riter.next();
+            continue;
+        }
+
+        throttle_backfill(keys.size());
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
+            if (job->cancelled)
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            e::slice key(keys[i].data(), keys[i].size());
+            e::striped_lock<po6::threads::mutex>::hold hold(&m_index_locks, index_lock_num(job->ri, key));
+            std::vector<e::slice> value;
+            uint64_t version;
+            reference ref;
+            returncode rc = get(job->ri, key, &value, &version, &ref);
+
+            if (rc == NOT_FOUND)
+            {
+                continue;
+            }
+            else if (rc != SUCCESS || value.size() + 1 != sc->attrs_sz)
+            {
+                LOG(ERROR) << "could not build index " << job->idx.id << " for " << job->ri
+                           << ": could not read key 0x" << key.hex() << ": " << rc;
+                return false;
+            }
+
+            leveldb::WriteBatch updates;
+            create_index_entry(sc, job->idx, job->ri, key, value, version, &updates);
+            leveldb::WriteOptions opts;
+            opts.sync = false;
+            leveldb::Status st = m_db->Write(opts, &updates);
+
+            if (!st.ok())
+            {
+                LOG(ERROR) << "could not build index " << job->idx.id << " for " << job->ri
+                           << ": " << st.ToString();
+                return false;
+            }
+        }
+
+        keys.clear();
+    }
+
+    char bbacking[INDEX_BUILT_BUF_SIZE];
+    encode_index_built(job->ri, job->idx.id, bbacking);
+    leveldb::WriteOptions opts;
+    opts.sync = true;
+    leveldb::Status st = m_db->Put(opts, leveldb::Slice(bbacking, INDEX_BUILT_BUF_SIZE), leveldb::Slice("", 0));
+
+    if (!st.ok())
+    {
+        LOG(ERROR) << "could not record that index " << job->idx.id << " is built for "
+                   << job->ri << ": " << st.ToString();
+        return false;
+    }
+
+    return true;
+}
+
+// Remove the record that the index is built, then every one of its entries
+bool
+datalayer :: drop_index(index_job* job)
+{
+    char bbacking[INDEX_BUILT_BUF_SIZE];
+    encode_index_built(job->ri, job->idx.id, bbacking);
+    leveldb::WriteOptions wopts;
+    wopts.sync = true;
+    leveldb::Status st = m_db->Delete(wopts, leveldb::Slice(bbacking, INDEX_BUILT_BUF_SIZE));
+
+    if (!st.ok() && !st.IsNotFound())
+    {
+        LOG(ERROR) << "could not drop index " << job->idx.id << " for " << job->ri
+                   << ": " << st.ToString();
+        return false;
+    }
+
+    std::vector<char> lower;
+    std::vector<char> upper;
+    encode_index(job->ri, job->idx.id, &lower);
+    encode_index(job->ri, job->idx.id + 1, &upper);
+    leveldb::Slice limit(&upper.front(), upper.size());
+    leveldb::ReadOptions ropts;
+    ropts.fill_cache = false;
+    ropts.verify_checksums = true;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(ropts));
+    it->Seek(leveldb::Slice(&lower.front(), lower.size()));
+    wopts.sync = false;
+
+    while (it->Valid() && it->key().compare(limit) < 0)
+    {
+        leveldb::WriteBatch updates;
+        size_t batched = 0;
+
+        for (; batched < BACKFILL_BATCH && it->Valid() && it->key().compare(limit) < 0; ++batched)
+        {
+            updates.Delete(it->key());
+            it->Next();
+        }
+
+        throttle_backfill(batched);
+        st = m_db->Write(wopts, &updates);
+
+        if (!st.ok())
+        {
+            LOG(ERROR) << "could not drop index " << job->idx.id << " for " << job->ri
+                       << ": " << st.ToString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+datalayer :: throttle_backfill(uint64_t objects)
+{
+    uint64_t now = e::time();
+    uint64_t start;
+
+    {
+        po6::threads::mutex::hold hold(&m_block_cleaner);
+        start = std::max(m_backfill_next, now);
+        m_backfill_next = start + objects * 1000000000ULL / BACKFILL_RATE;
+    }
+
+    if (start > now)
+    {
+        timespec ts;
+        ts.tv_sec = (start - now) / 1000000000ULL;
+        ts.tv_nsec = (start - now) % 1000000000ULL;
+        nanosleep(&ts, NULL);
+    }
+}
+
+uint64_t
+datalayer :: index_lock_num(const region_id& ri, const e::slice& key)
+{
+    return CityHash64WithSeed(reinterpret_cast<const char*>(key.data()),
+                              key.size(), ri.get()) % INDEX_LOCK_STRIPES;
+}
+
+void
+datalayer :: schedule_filter_jobs(const configuration& config, const server_id& us)
+{
+    std::vector<region_id> mapped;
+    config.mapped_regions(us, &mapped);
+    std::sort(mapped.begin(), mapped.end());
+    std::vector<region_id> added;
+
+    {
+        po6::threads::mutex::hold hold(&m_filter_lock);
+        std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.begin();
+
+        while (it != m_filters.end())
+        {
+            if (!std::binary_search(mapped.begin(), mapped.end(), it->first))
+            {
+                m_filters_built.erase(it->first);
+                m_filter_logs.erase(it->first);
+                m_filters.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (size_t i = 0; i < mapped.size(); ++i)
+        {
+            if (m_filters.find(mapped[i]) == m_filters.end())
+            {
+                std::tr1::shared_ptr<bloom_filter> filter(new bloom_filter(KEY_FILTER_MIN_BITS, KEY_FILTER_HASHES));
+                m_filters.insert(std::make_pair(mapped[i], filter));
+                m_filter_logs[mapped[i]];
+                added.push_back(mapped[i]);
+            }
+        }
+    }
+
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    m_filter_jobs.insert(m_filter_jobs.end(), added.begin(), added.end());
+    m_wakeup_filter_builder.broadcast();
+}
+
+void
+datalayer :: filter_builder()
+{
+    LOG(INFO) << "key filter thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        region_id ri;
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
+            while (!m_shutdown && m_filter_jobs.empty())
+            {
+                m_wakeup_filter_builder.wait();
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+
+            ri = m_filter_jobs.front();
+            m_filter_jobs.pop_front();
+        }
+
+        std::tr1::shared_ptr<bloom_filter> filter;
+
+        {
+            po6::threads::mutex::hold hold(&m_filter_lock);
+            std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.find(ri);
+
+            if (it == m_filters.end() ||
+                m_filters_built.find(ri) != m_filters_built.end())
+            {
+                continue;
+            }
+
+            filter = it->second;
+        }
+
+        build_filter(ri, filter);
+    }
+
+    LOG(INFO) << "key filter thread shutting down";
+}
+
+void
+datalayer :: build_filter(const region_id& ri, std::tr1::shared_ptr<bloom_filter> filter)
+{
+    // The filter was installed before this snapshot was taken, so any key
+    // the snapshot misses was put after, and went through insert_filter,
+    // which logged it until the filter is built.
+    leveldb_snapshot_ptr snap = make_raw_snapshot();
+    region_iterator riter;
+    make_region_iterator(&riter, snap, ri);
+    uint64_t count = 0;
+
+    while (riter.valid())
+    {
+        filter->insert(riter.key());
+        riter.next();
+        ++count;
+
+        // give up if the region moved away or we are shutting down
+        if (count % 4096 == 0)
+        {
+            {
+                po6::threads::mutex::hold hold(&m_filter_lock);
+                std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.find(ri);
 
-                if (m_need_pause)
+                if (it == m_filters.end() || it->second != filter)
                 {
-                    m_wakeup_reconfigurer.signal();
+                    return;
                 }
-
-                m_wakeup_cleaner.wait();
-                m_paused = false;
             }
 
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
             if (m_shutdown)
             {
-                break;
+                return;
             }
-
-            m_state_transfer_captures.swap(state_transfer_captures);
-            m_need_cleaning = false;
         }
+    }
 
-        leveldb::ReadOptions opts;
-        opts.fill_cache = true;
-        opts.verify_checksums = true;
-        std::auto_ptr<leveldb::Iterator> it;
-        it.reset(m_db->NewIterator(opts));
-        it->Seek(leveldb::Slice("t", 1));
-        capture_id cached_cid;
+    if (filter_overloaded(*filter))
+    {
+        resize_filter(ri, filter);
+        return;
+    }
 
-        while (it->Valid())
+    po6::threads::mutex::hold hold(&m_filter_lock);
+    std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.find(ri);
+
+    if (it != m_filters.end() && it->second == filter)
+    {
+        // keys put while the snapshot was scanned may have gone into a
+        // filter this one replaced
+        std::vector<std::string>& log(m_filter_logs[ri]);
+
+        for (size_t i = 0; i < log.size(); ++i)
         {
-            uint8_t prefix;
-            uint64_t cid;
-            uint64_t seq_no;
-            e::unpacker up(it->key().data(), it->key().size());
-            up = up >> prefix >> cid >> seq_no;
+            filter->insert(e::slice(log[i]));
+        }
 
-            if (up.error() || prefix != 't')
-            {
-                break;
-            }
+        m_filter_logs.erase(ri);
+        m_filters_built.insert(ri);
+        LOG(INFO) << "key filter for " << ri << " covers " << count << " keys in "
+                  << filter->bits() / 8 << " bytes";
+    }
+}
 
-            if (cid == cached_cid.get())
-            {
-                leveldb::WriteOptions wopts;
-                wopts.sync = false;
-                leveldb::Status st = m_db->Delete(wopts, it->key());
+bool
+datalayer :: filter_overloaded(const bloom_filter& filter)
+{
+    return filter.inserted() > filter.bits() / KEY_FILTER_BITS_PER_KEY;
+}
 
-                if (st.ok() || st.IsNotFound())
-                {
-                    // pass
-                }
-                else if (st.IsCorruption())
-                {
-                    LOG(ERROR) << "corruption at the disk layer: could not cleanup old transfers:"
-                               << " desc=" << st.ToString();
-                }
-                else if (st.IsIOError())
-                {
-                    LOG(ERROR) << "IO error at the disk layer: could not cleanup old transfers:"
-                               << " desc=" << st.ToString();
-                }
-                else
-                {
-                    LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
-                }
+void
+datalayer :: resize_filter(const region_id& ri, std::tr1::shared_ptr<bloom_filter> filter)
+{
+    {
+        po6::threads::mutex::hold hold(&m_filter_lock);
+        std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.find(ri);
 
-                it->Next();
-                continue;
-            }
+        // someone else already replaced it, or the region went away
+        if (it == m_filters.end() || it->second != filter)
+        {
+            return;
+        }
 
-            m_daemon->m_stm.report_wiped(cached_cid);
+        uint64_t bits = std::max<uint64_t>(KEY_FILTER_MIN_BITS, 2 * filter->inserted() * KEY_FILTER_BITS_PER_KEY);
+        it->second.reset(new bloom_filter(bits, KEY_FILTER_HASHES));
+        m_filters_built.erase(ri);
+        m_filter_logs[ri];
+    }
 
-            if (!m_daemon->m_config.is_captured_region(capture_id(cid)))
-            {
-                cached_cid = capture_id(cid);
-                continue;
-            }
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    m_filter_jobs.push_back(ri);
+    m_wakeup_filter_builder.broadcast();
+}
 
-            if (state_transfer_captures.find(capture_id(cid)) != state_transfer_captures.end())
-            {
-                cached_cid = capture_id(cid);
-                state_transfer_captures.erase(cached_cid);
-                continue;
-            }
+void
+datalayer :: insert_filter(const region_id& ri, const e::slice& key)
+{
+    std::tr1::shared_ptr<bloom_filter> filter;
 
-            char tbacking[TRANSFER_BUF_SIZE];
-            leveldb::Slice slice(tbacking, TRANSFER_BUF_SIZE);
-            encode_transfer(capture_id(cid + 1), 0, tbacking);
-            it->Seek(slice);
+    {
+        po6::threads::mutex::hold hold(&m_filter_lock);
+        std::map<region_id, std::tr1::shared_ptr<bloom_filter> >::iterator it = m_filters.find(ri);
+
+        if (it == m_filters.end())
+        {
+            return;
         }
 
-        while (!state_transfer_captures.empty())
+        filter = it->second;
+        std::map<region_id, std::vector<std::string> >::iterator log = m_filter_logs.find(ri);
+
+        if (log != m_filter_logs.end())
         {
-            m_daemon->m_stm.report_wiped(*state_transfer_captures.begin());
-            state_transfer_captures.erase(state_transfer_captures.begin());
+            log->second.push_back(std::string(reinterpret_cast<const char*>(key.data()), key.size()));
         }
     }
 
-    LOG(INFO) << "cleanup thread shutting down";
+    filter->insert(key);
+
+    if (filter_overloaded(*filter))
+    {
+        resize_filter(ri, filter);
+    }
 }
 
 void
@@ -1452,16 +2951,82 @@ datalayer :: shutdown()
     {
         po6::threads::mutex::hold hold(&m_block_cleaner);
         m_wakeup_cleaner.broadcast();
+        m_wakeup_backfillers.broadcast();
+        m_wakeup_filter_builder.broadcast();
         is_shutdown = m_shutdown;
         m_shutdown = true;
+
+        for (std::list<std::tr1::shared_ptr<index_job> >::iterator it = m_index_running.begin();
+                it != m_index_running.end(); ++it)
+        {
+            (*it)->cancelled = true;
+        }
     }
 
     if (!is_shutdown)
     {
         m_cleaner.join();
+
+        for (size_t i = 0; i < m_backfillers.size(); ++i)
+        {
+            m_backfillers[i]->join();
+        }
+
+        m_filter_builder.join();
     }
 }
 
+datalayer :: profile :: candidate :: candidate()
+    : attr(0)
+    , index(0)
+    , covering(false)
+    , ranges(0)
+    , estimated_bytes(0)
+{
+}
+
+datalayer :: profile :: candidate :: ~candidate() throw ()
+{
+}
+
+datalayer :: batch :: batch()
+    : m_updates()
+    , m_writes(0)
+    , m_locks()
+    , m_regions()
+    , m_filter_keys()
+{
+}
+
+datalayer :: batch :: ~batch() throw ()
+{
+}
+
+datalayer :: profile :: profile()
+    : candidates()
+    , object_bytes(0)
+    , used_index(false)
+    , index_attr(0)
+    , index_id(0)
+    , covering(false)
+    , estimated_bytes(0)
+    , plan_wall(0)
+    , plan_cpu(0)
+    , entries(0)
+    , scanned_bytes(0)
+    , gets(0)
+    , bytes_read(0)
+    , passed()
+    , rows(0)
+    , scan_wall(0)
+    , scan_cpu(0)
+{
+}
+
+datalayer :: profile :: ~profile() throw ()
+{
+}
+
 datalayer :: reference :: reference()
     : m_backing()
 {
@@ -1496,6 +3061,48 @@ hyperdex :: operator << (std::ostream& lhs, datalayer::returncode rhs)
     return lhs;
 }
 
+std::ostream&
+hyperdex :: operator << (std::ostream& lhs, const datalayer::profile& rhs)
+{
+    lhs << "plan " << (rhs.used_index ? "index" : "enumerate");
+
+    if (rhs.used_index)
+    {
+        lhs << " attr=" << rhs.index_attr
+            << " index=" << rhs.index_id
+            << " covering=" << (rhs.covering ? 1 : 0);
+    }
+
+    lhs << " estimated_bytes=" << rhs.estimated_bytes
+        << " object_bytes=" << rhs.object_bytes
+        << " wall_ns=" << rhs.plan_wall
+        << " cpu_ns=" << rhs.plan_cpu << "\n";
+
+    for (size_t i = 0; i < rhs.candidates.size(); ++i)
+    {
+        lhs << "candidate attr=" << rhs.candidates[i].attr
+            << " index=" << rhs.candidates[i].index
+            << " covering=" << (rhs.candidates[i].covering ? 1 : 0)
+            << " ranges=" << rhs.candidates[i].ranges
+            << " estimated_bytes=" << rhs.candidates[i].estimated_bytes << "\n";
+    }
+
+    lhs << "scan entries=" << rhs.entries
+        << " scanned_bytes=" << rhs.scanned_bytes
+        << " gets=" << rhs.gets
+        << " bytes_read=" << rhs.bytes_read
+        << " rows=" << rhs.rows
+        << " wall_ns=" << rhs.scan_wall
+        << " cpu_ns=" << rhs.scan_cpu << "\n";
+
+    for (size_t i = 0; i < rhs.passed.size(); ++i)
+    {
+        lhs << "check " << i << " passed=" << rhs.passed[i] << "\n";
+    }
+
+    return lhs;
+}
+
 datalayer :: region_iterator :: region_iterator()
     : m_dl()
     , m_snap()
@@ -1576,21 +3183,36 @@ datalayer :: region_iterator :: key()
     return e::slice(m_iter->key().data(), m_iter->key().size());
 }
 
+void
+datalayer :: region_iterator :: raw(e::slice* k, e::slice* v)
+{
+    region_id ri;
+    // valid() checked the prefix, so the key decodes
+    decode_key(e::slice(m_iter->key().data(), m_iter->key().size()), &ri, k);
+    *v = e::slice(m_iter->value().data(), m_iter->value().size());
+}
+
 datalayer :: snapshot :: snapshot()
     : m_dl()
     , m_snap()
     , m_checks()
+    , m_regexes()
     , m_ri()
     , m_backing()
-    , m_range()
+    , m_ranges()
+    , m_range_idx(0)
     , m_parse()
+    , m_keys_only(false)
+    , m_covered()
     , m_iter()
     , m_error(SUCCESS)
     , m_version()
     , m_key()
     , m_value()
-    , m_ostr()
+    , m_prof()
     , m_num_gets(0)
+    , m_budget(0)
+    , m_over_budget(false)
     , m_ref()
 {
 }
@@ -1601,6 +3223,22 @@ datalayer :: snapshot :: ~snapshot() throw ()
 
 bool
 datalayer :: snapshot :: valid()
+{
+    if (!m_prof)
+    {
+        return scan();
+    }
+
+    uint64_t wall_start = e::time();
+    uint64_t cpu_start = thread_cpu_time();
+    bool ret = scan();
+    m_prof->scan_wall += e::time() - wall_start;
+    m_prof->scan_cpu += thread_cpu_time() - cpu_start;
+    return ret;
+}
+
+bool
+datalayer :: snapshot :: scan()
 {
     if (m_error != SUCCESS || !m_iter.get() || !m_parse)
     {
@@ -1611,30 +3249,51 @@ datalayer :: snapshot :: valid()
     // won't persist across reconfigurations
     const schema* sc = m_dl->m_daemon->m_config.get_schema(m_ri);
     assert(sc);
+    m_over_budget = false;
 
     // while the most selective iterator is valid and not past the end
     while (m_iter->Valid())
     {
-        if (m_iter->key().compare(m_range.limit) >= 0)
+        if (m_iter->key().compare(m_ranges[m_range_idx].limit) >= 0)
         {
-            if (m_ostr) *m_ostr << " iterator retrieved " << m_num_gets << " objects from disk\n";
+            // the ranges are sorted and disjoint, so seeking forward to the
+            // next one never revisits a key
+            if (m_range_idx + 1 < m_ranges.size())
+            {
+                ++m_range_idx;
+                m_iter->Seek(m_ranges[m_range_idx].start);
+                continue;
+            }
+
             return false;
         }
 
-        (*m_parse)(m_iter->key(), &m_key);
-        leveldb::ReadOptions opts;
-        opts.fill_cache = true;
-        opts.verify_checksums = true;
-        std::vector<char> kbacking;
-        leveldb::Slice lkey;
-        encode_key(m_ri, m_key, &kbacking, &lkey);
+        if (m_budget > 0 && m_num_gets >= m_budget)
+        {
+            m_over_budget = true;
+            return false;
+        }
+
+        if (m_prof)
+        {
+            ++m_prof->entries;
+            m_prof->scanned_bytes += m_iter->key().size() + m_iter->value().size();
+        }
 
-        leveldb::Status st = m_dl->m_db->Get(opts, lkey, &m_ref.m_backing);
+        (*m_parse)(m_iter->key(), &m_key);
 
-        if (st.ok())
+        if (!m_covered.empty())
         {
+            // the index entry holds every attribute we need
+            m_ref.m_backing.assign(m_iter->value().data(), m_iter->value().size());
             e::slice v(m_ref.m_backing.data(), m_ref.m_backing.size());
-            datalayer::returncode rc = decode_value(v, &m_value, &m_version);
+            std::vector<e::slice> covered;
+            datalayer::returncode rc = decode_value(v, &covered, &m_version);
+
+            if (rc == SUCCESS && covered.size() != m_covered.size())
+            {
+                rc = BAD_ENCODING;
+            }
 
             if (rc != SUCCESS)
             {
@@ -1642,33 +3301,71 @@ datalayer :: snapshot :: valid()
                 return false;
             }
 
+            m_value.assign(sc->attrs_sz - 1, e::slice());
+
+            for (size_t i = 0; i < m_covered.size(); ++i)
+            {
+                m_value[m_covered[i] - 1] = covered[i];
+            }
+
             ++m_num_gets;
         }
-        else if (st.IsNotFound())
-        {
-            LOG(ERROR) << "snapshot points to items (" << m_key.hex() << ") not found in the snapshot";
-            m_error = CORRUPTION;
-            return false;
-        }
-        else if (st.IsCorruption())
-        {
-            LOG(ERROR) << "corruption at the disk layer: region=" << m_ri
-                       << " key=0x" << m_key.hex() << " desc=" << st.ToString();
-            m_error = CORRUPTION;
-            return false;
-        }
-        else if (st.IsIOError())
-        {
-            LOG(ERROR) << "IO error at the disk layer: region=" << m_ri
-                       << " key=0x" << m_key.hex() << " desc=" << st.ToString();
-            m_error = IO_ERROR;
-            return false;
-        }
         else
         {
-            LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
-            m_error = LEVELDB_ERROR;
-            return false;
+            leveldb::ReadOptions opts;
+            opts.fill_cache = true;
+            opts.verify_checksums = true;
+            std::vector<char> kbacking;
+            leveldb::Slice lkey;
+            encode_key(m_ri, m_key, &kbacking, &lkey);
+
+            leveldb::Status st = m_dl->m_db->Get(opts, lkey, &m_ref.m_backing);
+
+            if (st.ok())
+            {
+                e::slice v(m_ref.m_backing.data(), m_ref.m_backing.size());
+                datalayer::returncode rc = decode_value(v, &m_value, &m_version);
+
+                if (rc != SUCCESS)
+                {
+                    m_error = rc;
+                    return false;
+                }
+
+                ++m_num_gets;
+
+                if (m_prof)
+                {
+                    ++m_prof->gets;
+                    m_prof->bytes_read += m_ref.m_backing.size();
+                }
+            }
+            else if (st.IsNotFound())
+            {
+                LOG(ERROR) << "snapshot points to items (" << m_key.hex() << ") not found in the snapshot";
+                m_error = CORRUPTION;
+                return false;
+            }
+            else if (st.IsCorruption())
+            {
+                LOG(ERROR) << "corruption at the disk layer: region=" << m_ri
+                           << " key=0x" << m_key.hex() << " desc=" << st.ToString();
+                m_error = CORRUPTION;
+                return false;
+            }
+            else if (st.IsIOError())
+            {
+                LOG(ERROR) << "IO error at the disk layer: region=" << m_ri
+                           << " key=0x" << m_key.hex() << " desc=" << st.ToString();
+                m_error = IO_ERROR;
+                return false;
+            }
+            else
+            {
+                LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+                m_error = LEVELDB_ERROR;
+                return false;
+            }
         }
 
         bool passes_checks = true;
@@ -1682,18 +3379,28 @@ datalayer :: snapshot :: valid()
             else if ((*m_checks)[i].attr == 0)
             {
                 microerror e;
-                passes_checks = passes_attribute_check(sc->attrs[0].type, (*m_checks)[i], m_key, &e);
+                passes_checks = passes_attribute_check(sc->attrs[0].type, (*m_checks)[i], m_key, m_regexes[i].get(), &e);
             }
             else
             {
                 hyperdatatype type = sc->attrs[(*m_checks)[i].attr].type;
                 microerror e;
-                passes_checks = passes_attribute_check(type, (*m_checks)[i], m_value[(*m_checks)[i].attr - 1], &e);
+                passes_checks = passes_attribute_check(type, (*m_checks)[i], m_value[(*m_checks)[i].attr - 1], m_regexes[i].get(), &e);
+            }
+
+            if (passes_checks && m_prof)
+            {
+                ++m_prof->passed[i];
             }
         }
 
         if (passes_checks)
         {
+            if (m_prof)
+            {
+                ++m_prof->rows;
+            }
+
             return true;
         }
         else
@@ -1712,6 +3419,53 @@ datalayer :: snapshot :: next()
     m_iter->Next();
 }
 
+void
+datalayer :: snapshot :: set_budget(uint64_t gets)
+{
+    m_budget = gets;
+}
+
+bool
+datalayer :: snapshot :: progress(double* frac)
+{
+    if (m_error != SUCCESS || !m_iter.get() || m_ranges.empty())
+    {
+        return false;
+    }
+
+    // the last range covers the part of the current range already scanned
+    std::string current(m_iter->Valid() ? m_iter->key().ToString() : std::string());
+    std::vector<leveldb::Range> ranges(m_ranges);
+    ranges.push_back(leveldb::Range(m_ranges[m_range_idx].start, current));
+    std::vector<uint64_t> sizes(ranges.size());
+    m_dl->m_db->GetApproximateSizes(&ranges.front(), ranges.size(), &sizes.front());
+    uint64_t total = 0;
+    uint64_t behind = 0;
+
+    for (size_t i = 0; i < m_ranges.size(); ++i)
+    {
+        total += sizes[i];
+        behind += i < m_range_idx ? sizes[i] : 0;
+    }
+
+    if (!m_iter->Valid())
+    {
+        behind = total;
+    }
+    else
+    {
+        behind += std::min(sizes.back(), sizes[m_range_idx]);
+    }
+
+    if (total == 0)
+    {
+        return false;
+    }
+
+    *frac = static_cast<double>(behind) / total;
+    return true;
+}
+
 void
 datalayer :: snapshot :: unpack(e::slice* key, std::vector<e::slice>* val, uint64_t* ver)
 {
@@ -28,16 +28,25 @@
 #ifndef hyperdex_daemon_datalayer_h_
 #define hyperdex_daemon_datalayer_h_
 
+// C
+#include <regex.h>
+
 // STL
 #include <list>
+#include <map>
 #include <set>
 #include <sstream>
 #include <string>
 #include <tr1/memory>
+#include <utility>
 #include <vector>
 
 // LevelDB
 #include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+// e
+#include <e/striped_lock.h>
 
 // po6
 #include <po6/net/hostname.h>
@@ -53,6 +62,7 @@
 #include "common/counter_map.h"
 #include "common/ids.h"
 #include "common/schema.h"
+#include "daemon/bloom_filter.h"
 #include "daemon/leveldb.h"
 #include "daemon/reconfigure_returncode.h"
 
@@ -74,9 +84,12 @@ class datalayer
             IO_ERROR,
             LEVELDB_ERROR
         };
+        class batch;
+        class profile;
         class reference;
         class region_iterator;
         class snapshot;
+        class index_job;
 
     public:
         datalayer(daemon*);
@@ -130,6 +143,34 @@ class datalayer
                            const std::vector<e::slice>& old_value,
                            const std::vector<e::slice>& new_value,
                            uint64_t version);
+        // as above, but staged in "b" rather than written
+        returncode del(const region_id& ri,
+                       const region_id& reg_id,
+                       uint64_t seq_id,
+                       const e::slice& key,
+                       const std::vector<e::slice>& old_value,
+                       batch* b);
+        returncode put(const region_id& ri,
+                       const region_id& reg_id,
+                       uint64_t seq_id,
+                       const e::slice& key,
+                       const std::vector<e::slice>& new_value,
+                       uint64_t version,
+                       batch* b);
+        returncode overput(const region_id& ri,
+                           const region_id& reg_id,
+                           uint64_t seq_id,
+                           const e::slice& key,
+                           const std::vector<e::slice>& old_value,
+                           const std::vector<e::slice>& new_value,
+                           uint64_t version,
+                           batch* b);
+        // apply everything staged in "b" with one write, and empty it
+        returncode write(batch* b);
+        // False only if "key" has never been put into region "ri" since this
+        // daemon started.  Until a region's key filter has been built from
+        // disk, every key may exist.
+        bool may_exist(const region_id& ri, const e::slice& key);
         // put or delete where the previous value is unknown
         returncode uncertain_del(const region_id& ri,
                                  const e::slice& key);
@@ -137,12 +178,33 @@ class datalayer
                                  const e::slice& key,
                                  const std::vector<e::slice>& new_value,
                                  uint64_t version);
-        // create a snapshot for search
+        // create a snapshot for search.  If "prof" is non-NULL, the plan
+        // is recorded in it, and iterating the snapshot records the cost of
+        // the scan.  It must outlive the snapshot.
+        returncode make_snapshot(const region_id& ri,
+                                 const schema& sc,
+                                 const std::vector<attribute_check>* checks,
+                                 snapshot* snap,
+                                 profile* prof);
+        // as above, but scan only the objects whose keys lie in [lower,
+        // upper).  An empty bound is unbounded.
         returncode make_snapshot(const region_id& ri,
                                  const schema& sc,
                                  const std::vector<attribute_check>* checks,
+                                 const e::slice& lower,
+                                 const e::slice& upper,
                                  snapshot* snap,
-                                 std::ostringstream* ostr);
+                                 profile* prof);
+        // up to n - 1 keys that divide the region into n ranges of roughly
+        // equal size, according to LevelDB's size estimates
+        void split_points(const region_id& ri,
+                          uint64_t n,
+                          std::vector<std::string>* splits);
+        // The write epoch of a region advances after every successful put,
+        // overput, or del.  A result computed from a snapshot taken after
+        // reading the epoch is current for as long as the epoch is unchanged.
+        // Returns false for regions not mapped to this server.
+        bool epoch(const region_id& ri, uint64_t* e);
         // leveldb provides no failure mechanism for this, neither do we
         leveldb_snapshot_ptr make_raw_snapshot();
         void make_region_iterator(region_iterator* riter,
@@ -162,28 +224,84 @@ class datalayer
         void mark_acked(const region_id& ri,
                         const region_id& reg_id,
                         uint64_t seq_id);
+        void mark_acked(const region_id& ri,
+                        const region_id& reg_id,
+                        uint64_t seq_id,
+                        batch* b);
         void max_seq_id(const region_id& reg_id,
                         uint64_t* seq_id);
-        // Clear less than seq_id
-        void clear_acked(const region_id& reg_id,
-                         uint64_t seq_id);
+        // For each (reg_id, seq_id), sorted by reg_id, clear the acks of
+        // that region's ops less than seq_id
+        void clear_acked(const std::vector<std::pair<region_id, uint64_t> >& lower_bounds);
         // Request that a particular capture_id be wiped.  This is requested by
         // the state_transfer_manager.  The state_transfer_manger will get a
         // call back on report_wiped after it is done.
         void request_wipe(const capture_id& cid);
+        // True once every object of the region has its entry in the explicit
+        // index "id".  Indices added to an existing space are built in the
+        // background, and searches must not use them until then.
+        bool index_built(const region_id& ri, uint16_t id);
 
     private:
         datalayer(const datalayer&);
         datalayer& operator = (const datalayer&);
 
     private:
+        // add the writes of a put, overput, or del to "updates"
+        returncode stage_del(const region_id& ri,
+                             const region_id& reg_id,
+                             uint64_t seq_id,
+                             const e::slice& key,
+                             const std::vector<e::slice>& old_value,
+                             leveldb::WriteBatch* updates);
+        returncode stage_put(const region_id& ri,
+                             const region_id& reg_id,
+                             uint64_t seq_id,
+                             const e::slice& key,
+                             const std::vector<e::slice>& new_value,
+                             uint64_t version,
+                             leveldb::WriteBatch* updates);
+        returncode stage_overput(const region_id& ri,
+                                 const region_id& reg_id,
+                                 uint64_t seq_id,
+                                 const e::slice& key,
+                                 const std::vector<e::slice>& old_value,
+                                 const std::vector<e::slice>& new_value,
+                                 uint64_t version,
+                                 leveldb::WriteBatch* updates);
+        void add_to_batch(const region_id& ri,
+                          const e::slice& key,
+                          const leveldb::WriteBatch& updates,
+                          batch* b);
+        void bump_epoch(const region_id& ri);
         void cleaner();
         void shutdown();
+        // index building
+        void schedule_index_jobs(const configuration& config, const server_id& us);
+        void backfiller();
+        bool backfill(index_job* job);
+        bool drop_index(index_job* job);
+        // wait until "objects" more objects may be indexed without exceeding
+        // the rate limit shared by all backfillers
+        void throttle_backfill(uint64_t objects);
+        void write_cleared_acks(const leveldb::WriteOptions& wopts,
+                                leveldb::WriteBatch* updates);
+        uint64_t index_lock_num(const region_id& ri, const e::slice& key);
+        // key filters
+        void schedule_filter_jobs(const configuration& config, const server_id& us);
+        void filter_builder();
+        void build_filter(const region_id& ri, std::tr1::shared_ptr<bloom_filter> filter);
+        void insert_filter(const region_id& ri, const e::slice& key);
+        static bool filter_overloaded(const bloom_filter& filter);
+        // replace an overloaded filter with an empty one sized for its load
+        // and schedule a rebuild; lookups bypass it until the rebuild is done
+        void resize_filter(const region_id& ri, std::tr1::shared_ptr<bloom_filter> filter);
 
     private:
         daemon* m_daemon;
         leveldb_db_ptr m_db;
         counter_map m_counters;
+        counter_map m_epochs;
         po6::threads::thread m_cleaner;
         po6::threads::mutex m_block_cleaner;
         po6::threads::cond m_wakeup_cleaner;
@@ -193,6 +311,101 @@ class datalayer
         bool m_need_pause;
         bool m_paused;
         std::set<capture_id> m_state_transfer_captures;
+        // writers and backfillers serialize on the key so that a backfill
+        // never indexes a value that a concurrent write has replaced
+        e::striped_lock<po6::threads::mutex> m_index_locks;
+        // protected by m_block_cleaner
+        std::vector<std::tr1::shared_ptr<po6::threads::thread> > m_backfillers;
+        po6::threads::cond m_wakeup_backfillers;
+        std::set<std::pair<region_id, uint16_t> > m_built;
+        std::list<std::tr1::shared_ptr<index_job> > m_index_jobs;
+        std::list<std::tr1::shared_ptr<index_job> > m_index_running;
+        uint64_t m_backfill_next;
+        // a Bloom filter of the keys in each mapped region; m_filter_jobs and
+        // m_filter_builder are protected by m_block_cleaner
+        po6::threads::mutex m_filter_lock;
+        std::map<region_id, std::tr1::shared_ptr<bloom_filter> > m_filters;
+        std::set<region_id> m_filters_built;
+        // keys put into a region while its filter is being built; the
+        // builder inserts them again before it marks the filter built
+        std::map<region_id, std::vector<std::string> > m_filter_logs;
+        std::list<region_id> m_filter_jobs;
+        po6::threads::thread m_filter_builder;
+        po6::threads::cond m_wakeup_filter_builder;
+};
+
+// Writes to many objects, staged by put, overput, del, and mark_acked, that
+// "write" applies to LevelDB at once.  A put or delete that fails to stage
+// leaves the batch as it was.
+class datalayer::batch
+{
+    public:
+        batch();
+        ~batch() throw ();
+
+    private:
+        friend class datalayer;
+        batch(const batch&);
+        batch& operator = (const batch&);
+
+    private:
+        leveldb::WriteBatch m_updates;
+        size_t m_writes;
+        // the index locks of the staged objects
+        std::vector<uint64_t> m_locks;
+        // the regions whose epochs the write advances
+        std::vector<region_id> m_regions;
+        // the keys put, for the key filters once the write succeeds
+        std::vector<std::pair<region_id, std::string> > m_filter_keys;
+};
+
+// The plan chosen by make_snapshot and what executing it cost.  Sizes are in
+// bytes and times in nanoseconds.
+class datalayer::profile
+{
+    public:
+        // an index the planner considered
+        class candidate
+        {
+            public:
+                candidate();
+                ~candidate() throw ();
+
+            public:
+                uint16_t attr;
+                // the number under which the entries are stored:  the
+                // attribute itself, or an explicit index's id
+                uint16_t index;
+                // entries alone answer the search
+                bool covering;
+                size_t ranges;
+                uint64_t estimated_bytes;
+        };
+
+    public:
+        profile();
+        ~profile() throw ();
+
+    public:
+        // planning
+        std::vector<candidate> candidates;
+        uint64_t object_bytes;
+        bool used_index;
+        uint16_t index_attr;
+        uint16_t index_id;
+        bool covering;
+        uint64_t estimated_bytes;
+        uint64_t plan_wall;
+        uint64_t plan_cpu;
+        // scanning; passed[i] counts the objects passing checks 0 through i
+        uint64_t entries;
+        uint64_t scanned_bytes;
+        uint64_t gets;
+        uint64_t bytes_read;
+        std::vector<uint64_t> passed;
+        uint64_t rows;
+        uint64_t scan_wall;
+        uint64_t scan_cpu;
 };
 
 class datalayer::reference
@@ -222,6 +435,9 @@ class datalayer::region_iterator
         void next();
         void unpack(e::slice* key, std::vector<e::slice>* val, uint64_t* ver, reference* ref);
         e::slice key();
+        // the object's key and its value exactly as stored, without decoding
+        // or copying; valid until the next call to "next"
+        void raw(e::slice* key, e::slice* value);
 
     private:
         friend class datalayer;
@@ -246,32 +462,64 @@ class datalayer::snapshot
         void next();
         void unpack(e::slice* key, std::vector<e::slice>* val, uint64_t* ver);
         void unpack(e::slice* key, std::vector<e::slice>* val, uint64_t* ver, reference* ref);
+        // the caller uses only the keys of the objects (and "unpack" returns
+        // only the attributes named by the checks), so that a covering index
+        // may answer without retrieving the objects.  Call before
+        // "make_snapshot".
+        void set_keys_only() { m_keys_only = true; }
+        // stop (without error) after "gets" candidates have been retrieved
+        // from disk; zero means no limit
+        void set_budget(uint64_t gets);
+        uint64_t budget() const { return m_budget; }
+        // true if the last call to "valid" stopped because of the budget
+        bool over_budget() const { return m_over_budget; }
+        uint64_t num_gets() const { return m_num_gets; }
+        // the fraction of the scanned ranges that lies behind the iterator,
+        // according to LevelDB's size estimates.  Returns false when LevelDB
+        // has no estimate (e.g., everything is still in the memtable).
+        bool progress(double* frac);
 
     private:
         friend class datalayer;
         snapshot(const snapshot&);
         snapshot& operator = (const snapshot&);
 
+    private:
+        // the body of "valid", without profiling
+        bool scan();
+
     private:
         datalayer* m_dl;
         leveldb_snapshot_ptr m_snap;
         const std::vector<attribute_check>* m_checks;
+        // the compiled pattern of each REGEX check in m_checks
+        std::vector<std::tr1::shared_ptr<regex_t> > m_regexes;
         region_id m_ri;
         std::list<std::vector<char> > m_backing;
-        leveldb::Range m_range;
+        // sorted, disjoint ranges whose union is scanned
+        std::vector<leveldb::Range> m_ranges;
+        size_t m_range_idx;
         bool (*m_parse)(const leveldb::Slice& in, e::slice* out);
+        bool m_keys_only;
+        // when non-empty, the attributes whose values the index entries hold;
+        // objects are decoded from the entries instead of retrieved
+        std::vector<uint16_t> m_covered;
         leveldb_iterator_ptr m_iter;
         returncode m_error;
         uint64_t m_version;
         e::slice m_key;
         std::vector<e::slice> m_value;
-        std::ostringstream* m_ostr;
+        profile* m_prof;
         uint64_t m_num_gets;
+        uint64_t m_budget;
+        bool m_over_budget;
         reference m_ref;
 };
 
 std::ostream&
 operator << (std::ostream& lhs, datalayer::returncode rhs);
+std::ostream&
+operator << (std::ostream& lhs, const datalayer::profile& rhs);
 
 } // namespace hyperdex
 
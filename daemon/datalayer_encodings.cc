@@ -34,6 +34,7 @@
 // HyperDex
 #include "daemon/datalayer_encodings.h"
 #include "daemon/index_encode.h"
+#include "datatypes/apply.h"
 
 using hyperdex::datalayer;
 
@@ -205,6 +206,37 @@ hyperdex :: decode_acked(const e::slice& in,
     return _p == 'a' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
 }
 
+void
+hyperdex :: encode_index_built(const region_id& ri,
+                               uint16_t id,
+                               char* out)
+{
+    char* ptr = out;
+    ptr = e::pack8be('b', ptr);
+    ptr = e::pack64be(ri.get(), ptr);
+    ptr = e::pack16be(id, ptr);
+}
+
+datalayer::returncode
+hyperdex :: decode_index_built(const e::slice& in,
+                               region_id* ri,
+                               uint16_t* id)
+{
+    if (in.size() != INDEX_BUILT_BUF_SIZE)
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    uint8_t _p;
+    uint64_t _ri;
+    const uint8_t* ptr = in.data();
+    ptr = e::unpack8be(ptr, &_p);
+    ptr = e::unpack64be(ptr, &_ri);
+    ptr = e::unpack16be(ptr, id);
+    *ri = region_id(_ri);
+    return _p == 'b' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
+}
+
 void
 hyperdex :: encode_transfer(const capture_id& ci,
                             uint64_t count,
@@ -512,6 +544,30 @@ hyperdex :: encode_index(const region_id& ri,
     }
 }
 
+void
+hyperdex :: encode_index(const region_id& ri,
+                         const schema& sc,
+                         const index& idx,
+                         const std::vector<e::slice>& value,
+                         const e::slice& key,
+                         std::vector<char>* backing)
+{
+    encode_index(ri, idx.id, backing);
+
+    for (size_t i = 0; i < idx.attrs.size(); ++i)
+    {
+        uint16_t attr = idx.attrs[i];
+        index_encode_attr(sc.attrs[attr].type, value[attr - 1], true, backing);
+    }
+
+    size_t sz = backing->size();
+    backing->resize(sz + key.size() + sizeof(uint32_t));
+    char* ptr = &backing->front() + sz;
+    memmove(ptr, key.data(), key.size());
+    ptr += key.size();
+    ptr = e::pack32be(key.size(), ptr);
+}
+
 void
 hyperdex :: bump_index(std::vector<char>* backing)
 {
@@ -581,13 +637,62 @@ generate_index(const hyperdex::region_id& ri,
     }
 }
 
+void
+hyperdex :: encode_index_entry(const index& idx,
+                               const std::vector<e::slice>& value,
+                               uint64_t version,
+                               std::vector<char>* backing,
+                               leveldb::Slice* out)
+{
+    std::vector<e::slice> covered;
+    covered.reserve(idx.attrs.size() + idx.include.size());
+
+    for (size_t i = 0; i < idx.attrs.size(); ++i)
+    {
+        covered.push_back(value[idx.attrs[i] - 1]);
+    }
+
+    for (size_t i = 0; i < idx.include.size(); ++i)
+    {
+        covered.push_back(value[idx.include[i] - 1]);
+    }
+
+    encode_value(covered, version, backing, out);
+}
+
+static bool
+passes_filters(const hyperdex::schema& sc,
+               const hyperdex::index& idx,
+               const std::vector<e::slice>& value)
+{
+    for (size_t i = 0; i < idx.filters.size(); ++i)
+    {
+        const hyperdex::index_filter& f(idx.filters[i]);
+        hyperdex::attribute_check check;
+        check.attr = f.attr;
+        check.value = e::slice(f.value.data(), f.value.size());
+        check.datatype = sc.attrs[f.attr].type;
+        check.predicate = f.predicate;
+        microerror e;
+
+        if (!passes_attribute_check(sc.attrs[f.attr].type, check, value[f.attr - 1], &e))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 datalayer::returncode
 hyperdex :: create_index_changes(const schema* sc,
                                  const subspace* su,
+                                 const std::vector<index>& indices,
                                  const region_id& ri,
                                  const e::slice& key,
                                  const std::vector<e::slice>* old_value,
                                  const std::vector<e::slice>* new_value,
+                                 uint64_t version,
                                  leveldb::WriteBatch* updates)
 {
     std::vector<char> backing;
@@ -646,5 +751,60 @@ hyperdex :: create_index_changes(const schema* sc,
         }
     }
 
+    // Explicit indices are rewritten on every update because their entries
+    // carry the version along with the included attributes.
+    std::vector<char> vbacking;
+    leveldb::Slice value;
+
+    for (size_t j = 0; j < indices.size(); ++j)
+    {
+        const index& idx(indices[j]);
+        bool old_in = old_value && passes_filters(*sc, idx, *old_value);
+        bool new_in = new_value && passes_filters(*sc, idx, *new_value);
+        bool moved = !new_in;
+
+        for (size_t k = 0; old_in && !moved && k < idx.attrs.size(); ++k)
+        {
+            uint16_t attr = idx.attrs[k];
+            assert(attr > 0 && attr < sc->attrs_sz);
+            moved = (*old_value)[attr - 1] != (*new_value)[attr - 1];
+        }
+
+        if (old_in && moved)
+        {
+            encode_index(ri, *sc, idx, *old_value, key, &backing);
+            updates->Delete(leveldb::Slice(&backing.front(), backing.size()));
+        }
+
+        if (new_in)
+        {
+            encode_index(ri, *sc, idx, *new_value, key, &backing);
+            encode_index_entry(idx, *new_value, version, &vbacking, &value);
+            updates->Put(leveldb::Slice(&backing.front(), backing.size()), value);
+        }
+    }
+
     return datalayer::SUCCESS;
 }
+
+void
+hyperdex :: create_index_entry(const schema* sc,
+                               const index& idx,
+                               const region_id& ri,
+                               const e::slice& key,
+                               const std::vector<e::slice>& value,
+                               uint64_t version,
+                               leveldb::WriteBatch* updates)
+{
+    if (!passes_filters(*sc, idx, value))
+    {
+        return;
+    }
+
+    std::vector<char> backing;
+    std::vector<char> vbacking;
+    leveldb::Slice entry;
+    encode_index(ri, *sc, idx, value, key, &backing);
+    encode_index_entry(idx, value, version, &vbacking, &entry);
+    updates->Put(leveldb::Slice(&backing.front(), backing.size()), entry);
+}
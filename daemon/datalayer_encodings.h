@@ -74,6 +74,18 @@ decode_acked(const e::slice& in,
              region_id* reg_id, /*region of the point leader*/
              uint64_t* seq_id);
 
+// Encode the record that every object of a region has an entry in an
+// explicit index
+#define INDEX_BUILT_BUF_SIZE (sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint16_t))
+void
+encode_index_built(const region_id& ri,
+                   uint16_t id,
+                   char* out);
+datalayer::returncode
+decode_index_built(const e::slice& in,
+                   region_id* ri,
+                   uint16_t* id);
+
 // Encode the transfer
 #define TRANSFER_BUF_SIZE (sizeof(uint8_t) + 2 * sizeof(uint64_t))
 void
@@ -112,6 +124,16 @@ encode_index(const region_id& ri,
              const e::slice& value,
              const e::slice& key,
              std::vector<char>* backing);
+// Encode the key of an explicit index's entry:  each of the index's
+// attributes encoded with "index_encode_attr", followed by the object's key
+// and its size, as for strings
+void
+encode_index(const region_id& ri,
+             const schema& sc,
+             const index& idx,
+             const std::vector<e::slice>& value,
+             const e::slice& key,
+             std::vector<char>* backing);
 void
 bump_index(std::vector<char>* backing);
 bool
@@ -121,14 +143,37 @@ parse_index_sizeof8(const leveldb::Slice& s, e::slice* k);
 bool
 parse_object_key(const leveldb::Slice& s, e::slice* k);
 
+// The entries of an explicit index carry the values of the indexed and then
+// the included attributes, and the object's version, encoded as with
+// "encode_value"
+void
+encode_index_entry(const index& idx,
+                   const std::vector<e::slice>& value,
+                   uint64_t version,
+                   std::vector<char>* backing,
+                   leveldb::Slice* out);
+
 datalayer::returncode
 create_index_changes(const schema* sc,
                      const subspace* su,
+                     const std::vector<index>& indices,
                      const region_id& ri,
                      const e::slice& key,
                      const std::vector<e::slice>* old_value,
                      const std::vector<e::slice>* new_value,
+                     uint64_t version,
                      leveldb::WriteBatch* updates);
+// Add the entry for an object to one explicit index, as when the index is
+// built for objects that predate it.  Adds nothing when the object does not
+// pass the index's filters.
+void
+create_index_entry(const schema* sc,
+                   const index& idx,
+                   const region_id& ri,
+                   const e::slice& key,
+                   const std::vector<e::slice>& value,
+                   uint64_t version,
+                   leveldb::WriteBatch* updates);
 
 }
 
@@ -31,6 +31,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 
 // Linux
 #ifdef __APPLE__
@@ -40,6 +41,7 @@
 #endif
 
 // C++
+#include <algorithm>
 #include <iostream>
 
 // e
@@ -88,3 +90,83 @@ hyperdex :: index_encode_bump(char* _ptr, char* _end)
 
     abort();
 }
+
+void
+hyperdex :: index_encode_attr(hyperdatatype type,
+                              const e::slice& value,
+                              bool terminate,
+                              std::vector<char>* backing)
+{
+    size_t sz = backing->size();
+    char* ptr = NULL;
+    char buf_i[sizeof(int64_t)];
+    char buf_d[sizeof(double)];
+    int64_t tmp_i;
+    double tmp_d;
+
+    switch (type)
+    {
+        case HYPERDATATYPE_STRING:
+            // 0x00 becomes 0x00 0xff, and 0x00 0x01 terminates
+            backing->reserve(sz + value.size() + 2);
+
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                backing->push_back(value.data()[i]);
+
+                if (value.data()[i] == 0)
+                {
+                    backing->push_back('\xff');
+                }
+            }
+
+            if (terminate)
+            {
+                backing->push_back('\0');
+                backing->push_back('\x01');
+            }
+
+            break;
+        case HYPERDATATYPE_INT64:
+            backing->resize(sz + sizeof(uint64_t));
+            ptr = &backing->front() + sz;
+            memset(buf_i, 0, sizeof(int64_t));
+            memmove(buf_i, value.data(), std::min(value.size(), sizeof(int64_t)));
+            e::unpack64le(buf_i, &tmp_i);
+            ptr = index_encode_int64(tmp_i, ptr);
+            break;
+        case HYPERDATATYPE_FLOAT:
+            backing->resize(sz + sizeof(double));
+            ptr = &backing->front() + sz;
+            memset(buf_d, 0, sizeof(double));
+            memmove(buf_d, value.data(), std::min(value.size(), sizeof(double)));
+            e::unpackdoublele(buf_d, &tmp_d);
+            ptr = index_encode_double(tmp_d, ptr);
+            break;
+        case HYPERDATATYPE_GENERIC:
+        case HYPERDATATYPE_LIST_GENERIC:
+        case HYPERDATATYPE_LIST_STRING:
+        case HYPERDATATYPE_LIST_INT64:
+        case HYPERDATATYPE_LIST_FLOAT:
+        case HYPERDATATYPE_SET_GENERIC:
+        case HYPERDATATYPE_SET_STRING:
+        case HYPERDATATYPE_SET_INT64:
+        case HYPERDATATYPE_SET_FLOAT:
+        case HYPERDATATYPE_MAP_GENERIC:
+        case HYPERDATATYPE_MAP_STRING_KEYONLY:
+        case HYPERDATATYPE_MAP_STRING_STRING:
+        case HYPERDATATYPE_MAP_STRING_INT64:
+        case HYPERDATATYPE_MAP_STRING_FLOAT:
+        case HYPERDATATYPE_MAP_INT64_KEYONLY:
+        case HYPERDATATYPE_MAP_INT64_STRING:
+        case HYPERDATATYPE_MAP_INT64_INT64:
+        case HYPERDATATYPE_MAP_INT64_FLOAT:
+        case HYPERDATATYPE_MAP_FLOAT_KEYONLY:
+        case HYPERDATATYPE_MAP_FLOAT_STRING:
+        case HYPERDATATYPE_MAP_FLOAT_INT64:
+        case HYPERDATATYPE_MAP_FLOAT_FLOAT:
+        case HYPERDATATYPE_GARBAGE:
+        default:
+            abort();
+    }
+}
@@ -36,6 +36,15 @@
 // C
 #include <stdint.h>
 
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+// HyperDex
+#include "hyperdex.h"
+
 namespace hyperdex
 {
 
@@ -48,6 +57,16 @@ index_encode_double(double x, char* ptr);
 void
 index_encode_bump(char* ptr, char* end);
 
+// Append one attribute of an explicit index's entry.  Strings are escaped and
+// terminated so that they delimit themselves without changing the order;
+// without the terminator the result is a prefix of the encoding of every
+// string that extends "value".
+void
+index_encode_attr(hyperdatatype type,
+                  const e::slice& value,
+                  bool terminate,
+                  std::vector<char>* backing);
+
 } // namespace hyperdex
 
 #endif // hyperdex_daemon_indexing_h_
@@ -54,6 +54,9 @@ static const char* _coordinator_host = "127.0.0.1";
 static unsigned long _coordinator_port = 1982;
 static bool _coordinator = false;
 static long _threads = 0;
+static long _workers = 0;
+static long _query_cache = 0;
+static long _profile_searches = 0;
 
 extern "C"
 {
@@ -82,6 +85,15 @@ static struct poptOption popts[] = {
     {"threads", 't', POPT_ARG_LONG, &_threads, 't',
      "the number of threads which will handle network traffic",
      "N"},
+    {"region-workers", 'w', POPT_ARG_LONG, &_workers, 'w',
+     "give each region to one of N pinned worker threads (default: 0, disabled)",
+     "N"},
+    {"query-cache", 'q', POPT_ARG_LONG, &_query_cache, 'q',
+     "cache the results of up to N searches per region (default: 0, disabled)",
+     "N"},
+    {"profile-searches", 0, POPT_ARG_LONG, &_profile_searches, 'S',
+     "log the plan and cost of one in every N searches (default: 0, disabled)",
+     "N"},
     POPT_TABLEEND
 };
 
@@ -160,6 +172,35 @@ main(int argc, const char* argv[])
                 _coordinator = true;
                 break;
             case 't':
+                break;
+            case 'w':
+                if (_workers < 0)
+                {
+                    std::cerr << "cannot create a negative number of region workers" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                else if (_workers > 512)
+                {
+                    std::cerr << "refusing to create more than 512 region workers" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                break;
+            case 'q':
+                if (_query_cache < 0)
+                {
+                    std::cerr << "cannot cache a negative number of searches" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                break;
+            case 'S':
+                if (_profile_searches < 0)
+                {
+                    std::cerr << "cannot profile one in a negative number of searches" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
                 break;
             case POPT_ERROR_NOARG:
             case POPT_ERROR_BADOPT:
@@ -213,7 +254,7 @@ main(int argc, const char* argv[])
             return EXIT_FAILURE;
         }
 
-        return d.run(_daemonize, data, _listen, bind_to, _coordinator, coord, _threads);
+        return d.run(_daemonize, data, _listen, bind_to, _coordinator, coord, _threads, _workers, _query_cache, _profile_searches);
     }
     catch (po6::error& e)
     {
@@ -28,6 +28,11 @@
 // POSIX
 #include <signal.h>
 
+// STL
+#include <algorithm>
+#include <set>
+#include <string>
+
 // Google CityHash
 #include <city.h>
 
@@ -46,7 +51,32 @@
 #include "daemon/replication_manager.h"
 #include "daemon/replication_manager_keyholder.h"
 #include "daemon/replication_manager_keypair.h"
+#include "daemon/replication_manager_partition.h"
 #include "daemon/replication_manager_pending.h"
+#include "daemon/replication_manager_timer_wheel.h"
+
+// An op not acked within this many nanoseconds is sent again, with the timeout
+// doubling each time up to the maximum
+#define RETRANSMIT_TIMEOUT 1000000000ULL
+#define RETRANSMIT_MAX_TIMEOUT 32000000000ULL
+// The retransmitter sleeps until the next timeout may expire, but never
+// longer than this so that it notices a pause promptly
+#define RETRANSMIT_MAX_SLEEP 100000000ULL
+// Timeouts for this version revisit a key's blocked and deferred ops; real
+// versions start at 1
+#define REVISIT_VERSION 0
+
+// Send queued CHAIN_ACKs once this many are waiting
+#define ACK_FLUSH_COUNT 256
+// or once the oldest has waited this many nanoseconds
+#define ACK_FLUSH_DELAY 100000ULL
+
+// An update travels down the chain as its funcalls, rather than as the new
+// value, when the funcalls are less than 1/DELTA_RATIO the size of the value
+#define DELTA_RATIO 2
+
+// Lock stripes shared out among the keyholder partitions
+#define KEYHOLDER_STRIPES 1024
 
 using hyperdex::reconfigure_returncode;
 using hyperdex::replication_manager;
@@ -65,11 +95,30 @@ using hyperdex::replication_manager;
         erase_keyholder(ri, key); \
     }
 
+// Mark the attributes some subspace of "sp" is partitioned on.  Only their
+// hashes are ever used to route a write; the others are left 0.
+static void
+compute_hashed_attrs(const hyperdex::space& sp, std::vector<bool>* attrs)
+{
+    attrs->assign(sp.sc.attrs_sz, false);
+    (*attrs)[0] = true;
+
+    for (size_t i = 0; i < sp.subspaces.size(); ++i)
+    {
+        for (size_t j = 0; j < sp.subspaces[i].attrs.size(); ++j)
+        {
+            (*attrs)[sp.subspaces[i].attrs[j]] = true;
+        }
+    }
+}
+
 replication_manager :: replication_manager(daemon* d)
     : m_daemon(d)
-    , m_keyholder_locks(1024)
-    , m_keyholders(16)
+    , m_keyholder_locks(KEYHOLDER_STRIPES)
+    , m_partitions(1, std::tr1::shared_ptr<partition>(new partition()))
+    , m_flush_next(0)
     , m_counters()
+    , m_hashed_attrs()
     , m_shutdown(true)
     , m_retransmitter(std::tr1::bind(&replication_manager::retransmitter, this))
     , m_garbage_collector(std::tr1::bind(&replication_manager::garbage_collector, this))
@@ -78,10 +127,12 @@ replication_manager :: replication_manager(daemon* d)
     , m_wakeup_garbage_collector(&m_block_both)
     , m_wakeup_reconfigurer(&m_block_both)
     , m_need_retransmit(false)
+    , m_need_gc(false)
     , m_lower_bounds()
     , m_need_pause(false)
     , m_paused_retransmitter(false)
     , m_paused_garbage_collector(false)
+    , m_timeouts(new timer_wheel())
 {
 }
 
@@ -91,8 +142,16 @@ replication_manager :: ~replication_manager() throw ()
 }
 
 bool
-replication_manager :: setup()
+replication_manager :: setup(size_t partitions)
 {
+    assert(partitions > 0 && partitions <= KEYHOLDER_STRIPES);
+    m_partitions.clear();
+
+    for (size_t i = 0; i < partitions; ++i)
+    {
+        m_partitions.push_back(std::tr1::shared_ptr<partition>(new partition()));
+    }
+
     po6::threads::mutex::hold holdr(&m_block_both);
     m_retransmitter.start();
     m_garbage_collector.start();
@@ -140,6 +199,19 @@ replication_manager :: reconfigure(const configuration&,
         }
     }
 
+    // Acks in flight were sent or owed in the old configuration; retransmission
+    // will rebuild what is still needed.
+    for (size_t p = 0; p < m_partitions.size(); ++p)
+    {
+        partition* part = m_partitions[p].get();
+        po6::threads::mutex::hold hold(&part->mtx);
+        part->unacked.clear();
+        part->acks.clear();
+        part->acks_queued = 0;
+    }
+
+    m_timeouts->clear();
+
     std::map<uint64_t, uint64_t> seq_ids;
     std::vector<transfer> transfers_in;
     new_config.transfer_in_regions(m_daemon->m_us, &transfers_in);
@@ -153,20 +225,41 @@ replication_manager :: reconfigure(const configuration&,
 
     std::sort(transfer_in_regions.begin(), transfer_in_regions.end());
 
-    for (keyholder_map_t::iterator it = m_keyholders.begin();
-            it != m_keyholders.end(); it.next())
+    for (size_t p = 0; p < m_partitions.size(); ++p)
     {
-        region_id ri(it.key().region);
-        e::slice key(it.key().key.data(), it.key().key.size());
-        HOLD_LOCK_FOR_KEY(ri, key);
-        e::intrusive_ptr<keyholder> kh = it.value();
-        kh->clear_deferred();
-        uint64_t max_seq_id = kh->max_seq_id();
-        seq_ids[ri.get()] = std::max(seq_ids[ri.get()], max_seq_id);
+        keyholder_map_t* khs = &m_partitions[p]->keyholders;
 
-        if (std::binary_search(transfer_in_regions.begin(), transfer_in_regions.end(), ri))
+        for (keyholder_map_t::iterator it = khs->begin();
+                it != khs->end(); it.next())
         {
-            m_keyholders.remove(it.key());
+            region_id ri(it.key().region);
+            e::slice key(it.key().key.data(), it.key().key.size());
+            HOLD_LOCK_FOR_KEY(ri, key);
+            e::intrusive_ptr<keyholder> kh = it.value();
+            kh->clear_deferred();
+            // the timeouts are gone; retransmit_all schedules new ones
+            kh->get_revisit_pending() = false;
+            uint64_t max_seq_id = kh->max_seq_id();
+            seq_ids[ri.get()] = std::max(seq_ids[ri.get()], max_seq_id);
+
+            if (std::binary_search(transfer_in_regions.begin(), transfer_in_regions.end(), ri))
+            {
+                khs->remove(it.key());
+            }
+        }
+    }
+
+    std::vector<region_id> mapped;
+    new_config.mapped_regions(m_daemon->m_us, &mapped);
+    m_hashed_attrs.clear();
+
+    for (size_t i = 0; i < mapped.size(); ++i)
+    {
+        const space* sp = new_config.get_space(mapped[i]);
+
+        if (sp && m_hashed_attrs.find(sp->id.get()) == m_hashed_attrs.end())
+        {
+            compute_hashed_attrs(*sp, &m_hashed_attrs[sp->id.get()]);
         }
     }
 
@@ -195,6 +288,104 @@ replication_manager :: reconfigure(const configuration&,
     }
 }
 
+// Updates built solely from these funcalls may be folded together on the point
+// leader; the merged value is the same as applying each one in order.
+static bool
+coalescible_funcs(const std::vector<hyperdex::funcall>& funcs)
+{
+    for (size_t i = 0; i < funcs.size(); ++i)
+    {
+        switch (funcs[i].name)
+        {
+            case hyperdex::FUNC_NUM_ADD:
+            case hyperdex::FUNC_NUM_SUB:
+            case hyperdex::FUNC_STRING_APPEND:
+            case hyperdex::FUNC_LIST_RPUSH:
+            case hyperdex::FUNC_SET_ADD:
+            case hyperdex::FUNC_SET_UNION:
+                break;
+            case hyperdex::FUNC_FAIL:
+            case hyperdex::FUNC_SET:
+            case hyperdex::FUNC_STRING_PREPEND:
+            case hyperdex::FUNC_NUM_MUL:
+            case hyperdex::FUNC_NUM_DIV:
+            case hyperdex::FUNC_NUM_MOD:
+            case hyperdex::FUNC_NUM_AND:
+            case hyperdex::FUNC_NUM_OR:
+            case hyperdex::FUNC_NUM_XOR:
+            case hyperdex::FUNC_LIST_LPUSH:
+            case hyperdex::FUNC_SET_REMOVE:
+            case hyperdex::FUNC_SET_INTERSECT:
+            case hyperdex::FUNC_MAP_ADD:
+            case hyperdex::FUNC_MAP_REMOVE:
+            default:
+                return false;
+        }
+    }
+
+    return !funcs.empty();
+}
+
+// Order (seq_id, ...) pairs by seq_id alone
+template <typename T>
+static bool
+seq_id_less(const T& lhs, const T& rhs)
+{
+    return lhs.first < rhs.first;
+}
+
+// Hash "old_value" using the hashes already computed for "new_value" for
+// every attribute that did not change.
+static void
+hash_old_value(const hyperdex::schema& sc,
+               const std::vector<bool>& attrs,
+               const std::vector<e::slice>& new_value,
+               const std::vector<uint64_t>& new_hashes,
+               const std::vector<e::slice>& old_value,
+               std::vector<uint64_t>* old_hashes)
+{
+    (*old_hashes)[0] = new_hashes[0];
+
+    for (size_t i = 1; i < sc.attrs_sz; ++i)
+    {
+        if (!attrs[i])
+        {
+            (*old_hashes)[i] = 0;
+        }
+        else if (old_value[i - 1] == new_value[i - 1])
+        {
+            (*old_hashes)[i] = new_hashes[i];
+        }
+        else
+        {
+            (*old_hashes)[i] = hyperdex::hash(sc.attrs[i].type, old_value[i - 1]);
+        }
+    }
+}
+
+// True if both sets of hashes agree on every attribute of "ss", and so fall
+// within the same region of it.
+static bool
+same_subspace_hashes(const hyperdex::subspace* ss,
+                     const std::vector<uint64_t>& lhs,
+                     const std::vector<uint64_t>& rhs)
+{
+    if (!ss)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < ss->attrs.size(); ++i)
+    {
+        if (lhs[ss->attrs[i]] != rhs[ss->attrs[i]])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void
 replication_manager :: client_atomic(const server_id& from,
                                      const virtual_server_id& to,
@@ -223,6 +414,78 @@ replication_manager :: client_atomic(const server_id& from,
     }
 
     HOLD_LOCK_FOR_KEY(ri, key);
+    client_atomic_locked(from, to, nonce, fail_if_not_found, fail_if_found,
+                         erase, key, checks, funcs);
+}
+
+void
+replication_manager :: client_multi_atomic(const server_id& from,
+                                           const virtual_server_id& to,
+                                           const std::vector<uint64_t>& nonces,
+                                           const std::vector<uint8_t>& flags,
+                                           const std::vector<e::slice>& keys,
+                                           std::vector<std::vector<attribute_check> >* checks,
+                                           std::vector<std::vector<funcall> >* funcs)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+
+    if (!m_daemon->m_config.is_point_leader(to))
+    {
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            respond_to_client(to, from, nonces[i], NET_NOTUS);
+        }
+
+        return;
+    }
+
+    // Hold the stripes of every key, taken in order, for the whole request so
+    // that its ops go down the chain back to back.  Each hop then acks them
+    // in one CHAIN_ACK and commits them in one write (see chain_ack).
+    typedef e::striped_lock<po6::threads::mutex>::hold keyholder_hold;
+    std::vector<uint64_t> stripes;
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        stripes.push_back(get_lock_num(ri, keys[i]));
+    }
+
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    std::vector<std::tr1::shared_ptr<keyholder_hold> > holds;
+
+    for (size_t i = 0; i < stripes.size(); ++i)
+    {
+        holds.push_back(std::tr1::shared_ptr<keyholder_hold>(new keyholder_hold(&m_keyholder_locks, stripes[i])));
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (!validate_as_type(keys[i], sc->attrs[0].type))
+        {
+            respond_to_client(to, from, nonces[i], NET_BADDIMSPEC);
+            continue;
+        }
+
+        client_atomic_locked(from, to, nonces[i], flags[i] & 1, flags[i] & 2,
+                             !(flags[i] & 128), keys[i], &(*checks)[i], &(*funcs)[i]);
+    }
+}
+
+void
+replication_manager :: client_atomic_locked(const server_id& from,
+                                            const virtual_server_id& to,
+                                            uint64_t nonce,
+                                            bool fail_if_not_found,
+                                            bool fail_if_found,
+                                            bool erase,
+                                            const e::slice& key,
+                                            std::vector<attribute_check>* checks,
+                                            std::vector<funcall>* funcs)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    const schema* sc = m_daemon->m_config.get_schema(ri);
     e::intrusive_ptr<keyholder> kh = get_or_create_keyholder(ri, key);
     bool has_old_value = false;
     uint64_t old_version = 0;
@@ -282,12 +545,38 @@ replication_manager :: client_atomic(const server_id& from,
         return;
     }
 
+    bool coalescible = has_old_value && !erase && !fail_if_found &&
+                       checks->empty() && coalescible_funcs(*funcs);
+
+    if (coalescible &&
+        coalesce_blocked(ri, *sc, key, kh, backing, new_value, from, nonce))
+    {
+        CLEANUP_KEYHOLDER(ri, key, kh);
+        return;
+    }
+
     bool has_new_value = !erase;
     uint64_t seq_id;
     bool found = m_counters.lookup(ri, &seq_id);
     assert(found);
 
     e::intrusive_ptr<pending> new_pend(new pending(backing, ri, seq_id, !has_old_value && has_new_value, has_new_value, new_value, from, nonce));
+    new_pend->coalescible = coalescible;
+
+    // Keep our own copy of the funcalls; the client's message is not kept.
+    if (has_old_value && has_new_value && !funcs->empty() &&
+        pack_size(*funcs) * DELTA_RATIO < pack_size(new_value))
+    {
+        new_pend->funcs_backing.reset(e::buffer::create(pack_size(*funcs)));
+        new_pend->funcs_backing->pack_at(0) << *funcs;
+
+        if ((new_pend->funcs_backing->unpack_from(0) >> new_pend->funcs).error())
+        {
+            new_pend->funcs_backing.reset();
+            new_pend->funcs.clear();
+        }
+    }
+
     hash_objects(ri, *sc, key, has_new_value, new_value, has_old_value, *old_value, new_pend);
 
     if (new_pend->this_old_region != ri && new_pend->this_new_region != ri)
@@ -304,6 +593,23 @@ replication_manager :: client_atomic(const server_id& from,
     CLEANUP_KEYHOLDER(ri, key, kh);
 }
 
+void
+replication_manager :: group_atomic(const virtual_server_id& to,
+                                    bool fail_if_not_found,
+                                    bool fail_if_found,
+                                    bool erase,
+                                    const std::vector<e::slice>& keys,
+                                    std::vector<attribute_check>* checks,
+                                    std::vector<funcall>* funcs)
+{
+    // server_id() as the client suppresses responses (see respond_to_client)
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        client_atomic(server_id(), to, 0, fail_if_not_found, fail_if_found,
+                      erase, keys[i], checks, funcs);
+    }
+}
+
 void
 replication_manager :: chain_op(const virtual_server_id& from,
                                 const virtual_server_id& to,
@@ -315,14 +621,15 @@ replication_manager :: chain_op(const virtual_server_id& from,
                                 bool has_value,
                                 std::auto_ptr<e::buffer> backing,
                                 const e::slice& key,
-                                const std::vector<e::slice>& value)
+                                const std::vector<e::slice>& value,
+                                const std::vector<funcall>& funcs)
 {
     region_id ri(m_daemon->m_config.get_region_id(to));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
         LOG(INFO) << "acking duplicate CHAIN_*";
-        send_ack(to, from, true, reg_id, seq_id, version, key);
+        send_ack(to, from, true, reg_id, seq_id);
         return;
     }
 
@@ -331,13 +638,21 @@ replication_manager :: chain_op(const virtual_server_id& from,
     e::intrusive_ptr<keyholder> kh = get_or_create_keyholder(ri, key);
 
     // Check that a chain's put matches the dimensions of the space.
-    if (has_value && sc->attrs_sz != value.size() + 1)
+    if (has_value && funcs.empty() && sc->attrs_sz != value.size() + 1)
     {
         LOG(INFO) << "dropping CHAIN_OP because the dimensions are incorrect";
         CLEANUP_KEYHOLDER(ri, key, kh);
         return;
     }
 
+    // Funcalls only make sense when there is a previous version to apply them to.
+    if (!funcs.empty() && (fresh || !has_value))
+    {
+        LOG(INFO) << "dropping CHAIN_OP with funcalls that does not update an object";
+        CLEANUP_KEYHOLDER(ri, key, kh);
+        return;
+    }
+
     e::intrusive_ptr<pending> new_op = kh->get_by_version(version);
 
     if (new_op)
@@ -347,7 +662,7 @@ replication_manager :: chain_op(const virtual_server_id& from,
 
         if (new_op->acked)
         {
-            send_ack(to, from, false, reg_id, seq_id, version, key);
+            send_ack(to, from, false, reg_id, seq_id);
         }
 
         CLEANUP_KEYHOLDER(ri, key, kh);
@@ -356,13 +671,21 @@ replication_manager :: chain_op(const virtual_server_id& from,
 
     if (version <= kh->version_on_disk())
     {
-        send_ack(to, from, false, reg_id, seq_id, version, key);
+        send_ack(to, from, false, reg_id, seq_id);
         CLEANUP_KEYHOLDER(ri, key, kh);
         return;
     }
 
     std::tr1::shared_ptr<e::buffer> new_backing(backing.release());
     e::intrusive_ptr<pending> new_defer(new pending(new_backing, reg_id, seq_id, fresh, has_value, value, m_daemon->m_config.version(), from));
+
+    if (!funcs.empty())
+    {
+        new_defer->funcs_backing = new_backing;
+        new_defer->funcs = funcs;
+        new_defer->delta = true;
+    }
+
     kh->insert_deferred(version, new_defer);
     move_operations_between_queues(to, ri, *sc, key, kh);
     CLEANUP_KEYHOLDER(ri, key, kh);
@@ -385,7 +708,7 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
         LOG(INFO) << "acking duplicate CHAIN_SUBSPACE";
-        send_ack(to, from, true, reg_id, seq_id, version, key);
+        send_ack(to, from, true, reg_id, seq_id);
         return;
     }
 
@@ -412,7 +735,9 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
     subspace_id subspace_this = m_daemon->m_config.subspace_of(ri);
     subspace_id subspace_prev = m_daemon->m_config.subspace_prev(subspace_this);
     subspace_id subspace_next = m_daemon->m_config.subspace_next(subspace_this);
-    hyperdex::hash(*sc, key, value, &new_pend->new_hashes.front());
+    std::vector<bool> scratch;
+    const std::vector<bool>& attrs(hashed_attrs(ri, sc->attrs_sz, &scratch));
+    hyperdex::hash(*sc, key, value, attrs, &new_pend->new_hashes.front());
     new_pend->old_hashes = hashes;
 
     if (subspace_prev != subspace_id())
@@ -421,7 +746,15 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
     }
 
     m_daemon->m_config.lookup_region(subspace_this, new_pend->old_hashes, &new_pend->this_old_region);
-    m_daemon->m_config.lookup_region(subspace_this, new_pend->new_hashes, &new_pend->this_new_region);
+
+    if (same_subspace_hashes(m_daemon->m_config.get_subspace(ri), new_pend->old_hashes, new_pend->new_hashes))
+    {
+        new_pend->this_new_region = new_pend->this_old_region;
+    }
+    else
+    {
+        m_daemon->m_config.lookup_region(subspace_this, new_pend->new_hashes, &new_pend->this_new_region);
+    }
 
     if (subspace_next != subspace_id())
     {
@@ -443,14 +776,15 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
     CLEANUP_KEYHOLDER(ri, key, kh);
 }
 
-void
-replication_manager :: chain_ack(const virtual_server_id& from,
+e::intrusive_ptr<replication_manager::pending>
+replication_manager :: stage_ack(const virtual_server_id& from,
                                  const virtual_server_id& to,
                                  bool retransmission,
                                  const region_id& reg_id,
                                  uint64_t seq_id,
                                  uint64_t version,
-                                 const e::slice& key)
+                                 const e::slice& key,
+                                 datalayer::batch* updates)
 {
     static uint64_t cnt = 0;
     region_id ri(m_daemon->m_config.get_region_id(to));
@@ -458,17 +792,15 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
         LOG(INFO) << "dropping duplicate CHAIN_ACK";
-        return;
+        return NULL;
     }
 
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    HOLD_LOCK_FOR_KEY(ri, key);
     e::intrusive_ptr<keyholder> kh = get_keyholder(ri, key);
 
     if (!kh)
     {
         LOG(INFO) << "dropping CHAIN_ACK for update we haven't seen";
-        return;
+        return NULL;
     }
 
     e::intrusive_ptr<pending> pend = kh->get_by_version(version);
@@ -477,35 +809,35 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     {
         LOG(INFO) << "dropping CHAIN_ACK for update we haven't seen";
         CLEANUP_KEYHOLDER(ri, key, kh);
-        return;
+        return NULL;
     }
 
     if (pend->sent == virtual_server_id())
     {
         LOG(INFO) << "dropping CHAIN_ACK for update we haven't sent";
         CLEANUP_KEYHOLDER(ri, key, kh);
-        return;
+        return NULL;
     }
 
     if (from != pend->sent)
     {
         LOG(INFO) << "dropping CHAIN_ACK that came from the wrong host";
         CLEANUP_KEYHOLDER(ri, key, kh);
-        return;
+        return NULL;
     }
 
     if (m_daemon->m_config.version() != pend->sent_config_version)
     {
         LOG(INFO) << "dropping CHAIN_ACK that was sent in a previous version and hasn't been retransmitted";
         CLEANUP_KEYHOLDER(ri, key, kh);
-        return;
+        return NULL;
     }
 
     if (pend->reg_id != reg_id || pend->seq_id != seq_id)
     {
         LOG(INFO) << "dropping CHAIN_ACK that was sent with mismatching reg/seq ids";
         CLEANUP_KEYHOLDER(ri, key, kh);
-        return;
+        return NULL;
     }
 
     pend->acked = true;
@@ -513,7 +845,7 @@ replication_manager :: chain_ack(const virtual_server_id& from,
 
     if (!is_head && m_daemon->m_config.version() == pend->recv_config_version)
     {
-        send_ack(to, pend->recv, false, reg_id, seq_id, version, key);
+        send_ack(to, pend->recv, false, reg_id, seq_id);
     }
 
     if (kh->version_on_disk() < version)
@@ -522,17 +854,19 @@ replication_manager :: chain_ack(const virtual_server_id& from,
         assert(op);
 
         datalayer::returncode rc;
+        bool has_new_value = op->has_value &&
+                             !(op->this_old_region != op->this_new_region && ri == op->this_old_region);
 
         // if this is a case where we are to remove the object from disk
-        if (!op->has_value || (op->this_old_region != op->this_new_region && ri == op->this_old_region))
+        if (!has_new_value)
         {
             if (kh->exists_on_disk())
             {
-                rc = m_daemon->m_data.del(ri, reg_id, seq_id, key, kh->value_on_disk());
+                rc = m_daemon->m_data.del(ri, reg_id, seq_id, key, kh->value_on_disk(), updates);
             }
             else
             {
-                m_daemon->m_data.mark_acked(ri, reg_id, seq_id);
+                m_daemon->m_data.mark_acked(ri, reg_id, seq_id, updates);
                 rc = datalayer::SUCCESS;
             }
         }
@@ -541,11 +875,11 @@ replication_manager :: chain_ack(const virtual_server_id& from,
         {
             if (kh->exists_on_disk())
             {
-                rc = m_daemon->m_data.overput(ri, reg_id, seq_id, key, kh->value_on_disk(), op->value, version);
+                rc = m_daemon->m_data.overput(ri, reg_id, seq_id, key, kh->value_on_disk(), op->value, version, updates);
             }
             else
             {
-                rc = m_daemon->m_data.put(ri, reg_id, seq_id, key, op->value, version);
+                rc = m_daemon->m_data.put(ri, reg_id, seq_id, key, op->value, version, updates);
                 cnt++;
                 LOG(INFO) << "MORAZ: PUT operation" << cnt << "-"<<key.data();
             }
@@ -568,43 +902,297 @@ replication_manager :: chain_ack(const virtual_server_id& from,
                 break;
         }
 
+        // the tail of the point leader's region sees each write to the key
+        // once it has committed everywhere; finish_ack tells the subscribers
+        // if the batch is written
+        if (rc == datalayer::SUCCESS && ri == reg_id &&
+            m_daemon->m_config.tail_of_region(ri) == to)
+        {
+            const std::vector<e::slice>& old_value(kh->value_on_disk());
+            size_t sz = 0;
+
+            for (size_t i = 0; i < old_value.size(); ++i)
+            {
+                sz += old_value[i].size();
+            }
+
+            op->notify = true;
+            op->notify_has_old_value = kh->exists_on_disk();
+            op->notify_backing.resize(sz);
+            op->notify_old_value.resize(old_value.size());
+            char* ptr = op->notify_backing.empty() ? NULL : &op->notify_backing.front();
+
+            for (size_t i = 0; i < old_value.size(); ++i)
+            {
+                memmove(ptr, old_value[i].data(), old_value[i].size());
+                op->notify_old_value[i] = e::slice(ptr, old_value[i].size());
+                ptr += old_value[i].size();
+            }
+        }
+
         kh->set_version_on_disk(version);
     }
     else
     {
-        m_daemon->m_data.mark_acked(ri, reg_id, seq_id);
+        m_daemon->m_data.mark_acked(ri, reg_id, seq_id, updates);
     }
 
-    kh->clear_committable_acked();
-    move_operations_between_queues(to, ri, *sc, key, kh);
+    return pend;
+}
+
+void
+replication_manager :: finish_ack(const virtual_server_id& to,
+                                  const region_id& reg_id,
+                                  uint64_t seq_id,
+                                  uint64_t version,
+                                  const e::slice& key,
+                                  e::intrusive_ptr<pending> pend,
+                                  bool written)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+    bool is_head = m_daemon->m_config.head_of_region(ri) == to;
+
+    if (written && pend->notify)
+    {
+        bool has_new_value = pend->has_value &&
+                             !(pend->this_old_region != pend->this_new_region && ri == pend->this_old_region);
+        m_daemon->m_subs.committed(ri, key, pend->notify_has_old_value, pend->notify_old_value,
+                                   has_new_value, pend->value, version);
+    }
+
+    pend->notify = false;
+    pend->notify_old_value.clear();
+    pend->notify_backing.clear();
+    // an earlier op of the same batch may have emptied and erased it
+    e::intrusive_ptr<keyholder> kh = get_keyholder(ri, key);
+
+    if (kh)
+    {
+        kh->clear_committable_acked();
+        move_operations_between_queues(to, ri, *sc, key, kh);
+    }
 
     if (m_daemon->m_config.is_point_leader(to))
     {
         respond_to_client(to, pend->client, pend->nonce, NET_SUCCESS);
+
+        for (size_t i = 0; i < pend->coalesced.size(); ++i)
+        {
+            respond_to_client(to, pend->coalesced[i].first, pend->coalesced[i].second, NET_SUCCESS);
+        }
+    }
+
+    if (is_head && m_daemon->m_config.version() == pend->recv_config_version)
+    {
+        send_ack(to, pend->recv, false, reg_id, seq_id);
+    }
+
+    if (kh)
+    {
+        CLEANUP_KEYHOLDER(ri, key, kh);
+    }
+}
+
+void
+replication_manager :: chain_ack(const virtual_server_id& from,
+                                 const virtual_server_id& to,
+                                 bool retransmission,
+                                 const region_id& reg_id,
+                                 const std::vector<std::pair<uint64_t, uint64_t> >& ranges)
+{
+    typedef std::pair<uint64_t, partition::unacked_map_t::mapped_type> acked_t;
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    partition* part = partition_for(ri);
+    std::vector<acked_t> acked;
+
+    {
+        po6::threads::mutex::hold hold(&part->mtx);
+
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            if (ranges[i].first > ranges[i].second)
+            {
+                continue;
+            }
+
+            uint64_t width = ranges[i].second - ranges[i].first;
+
+            // a range wider than what is outstanding is cheaper to match
+            // against every entry than one seq_id at a time
+            if (width >= part->unacked.size())
+            {
+                partition::unacked_map_t::iterator it = part->unacked.begin();
+
+                while (it != part->unacked.end())
+                {
+                    if (it->first.first == std::make_pair(ri, reg_id) &&
+                        it->first.second >= ranges[i].first &&
+                        it->first.second <= ranges[i].second)
+                    {
+                        acked.push_back(std::make_pair(it->first.second, it->second));
+                        part->unacked.erase(it++);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+
+                continue;
+            }
+
+            for (uint64_t n = 0; n <= width; ++n)
+            {
+                partition::unacked_key_t uk(std::make_pair(ri, reg_id), ranges[i].first + n);
+                partition::unacked_map_t::iterator it = part->unacked.find(uk);
+
+                if (it != part->unacked.end())
+                {
+                    acked.push_back(std::make_pair(uk.second, it->second));
+                    part->unacked.erase(it);
+                }
+            }
+        }
+    }
+
+    std::sort(acked.begin(), acked.end(), seq_id_less<acked_t>);
+
+    // Every op acked here commits with one write.  The stripes of all the
+    // keys are held until it is done, taken in order so that two batches
+    // cannot deadlock, and so that no other commit to these keys can land
+    // between staging and writing.
+    typedef e::striped_lock<po6::threads::mutex>::hold keyholder_hold;
+    std::vector<uint64_t> stripes;
+
+    for (size_t i = 0; i < acked.size(); ++i)
+    {
+        stripes.push_back(get_lock_num(ri, acked[i].second.first->key()));
+    }
+
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    std::vector<std::tr1::shared_ptr<keyholder_hold> > holds;
+
+    for (size_t i = 0; i < stripes.size(); ++i)
+    {
+        holds.push_back(std::tr1::shared_ptr<keyholder_hold>(new keyholder_hold(&m_keyholder_locks, stripes[i])));
+    }
+
+    // An op whose ack is dropped by stage_ack stays committable and will be
+    // retransmitted, which records it as unacked again.  The clients and the
+    // previous hop hear of the rest only once the batch is on disk.
+    datalayer::batch updates;
+    std::vector<e::intrusive_ptr<pending> > pends;
+
+    for (size_t i = 0; i < acked.size(); ++i)
+    {
+        pends.push_back(stage_ack(from, to, retransmission, reg_id, acked[i].first,
+                                  acked[i].second.second, acked[i].second.first->key(), &updates));
+    }
+
+    datalayer::returncode rc = m_daemon->m_data.write(&updates);
+
+    if (rc != datalayer::SUCCESS)
+    {
+        LOG(ERROR) << "commit caused error " << rc;
     }
 
-    if (is_head && m_daemon->m_config.version() == pend->recv_config_version)
-    {
-        send_ack(to, pend->recv, false, reg_id, seq_id, version, key);
+    for (size_t i = 0; i < acked.size(); ++i)
+    {
+        if (pends[i])
+        {
+            finish_ack(to, reg_id, acked[i].first, acked[i].second.second,
+                       acked[i].second.first->key(), pends[i], rc == datalayer::SUCCESS);
+        }
+    }
+}
+
+void
+replication_manager :: flush_acks(size_t p, bool idle)
+{
+    flush_partition_acks(m_partitions[p].get(), idle);
+}
+
+void
+replication_manager :: flush_acks(bool idle)
+{
+    if (idle)
+    {
+        for (size_t p = 0; p < m_partitions.size(); ++p)
+        {
+            flush_partition_acks(m_partitions[p].get(), true);
+        }
+    }
+    else
+    {
+        uint64_t p = __sync_fetch_and_add(&m_flush_next, 1);
+        flush_partition_acks(m_partitions[p % m_partitions.size()].get(), false);
+    }
+}
+
+void
+replication_manager :: flush_partition_acks(partition* p, bool idle)
+{
+    partition::ack_map_t acks;
+
+    {
+        po6::threads::mutex::hold hold(&p->mtx);
+
+        if (p->acks_queued == 0 ||
+            (!idle && p->acks_queued < ACK_FLUSH_COUNT && e::time() < p->acks_deadline))
+        {
+            return;
+        }
+
+        acks.swap(p->acks);
+        p->acks_queued = 0;
+    }
+
+    for (partition::ack_map_t::iterator l = acks.begin(); l != acks.end(); ++l)
+    {
+        for (std::map<region_id, std::vector<uint64_t> >::iterator r = l->second.begin();
+                r != l->second.end(); ++r)
+        {
+            std::vector<uint64_t>& seq_ids(r->second);
+            std::sort(seq_ids.begin(), seq_ids.end());
+            std::vector<std::pair<uint64_t, uint64_t> > ranges;
+
+            for (size_t i = 0; i < seq_ids.size(); ++i)
+            {
+                if (!ranges.empty() && ranges.back().second + 1 >= seq_ids[i])
+                {
+                    ranges.back().second = std::max(ranges.back().second, seq_ids[i]);
+                }
+                else
+                {
+                    ranges.push_back(std::make_pair(seq_ids[i], seq_ids[i]));
+                }
+            }
+
+            send_acks(l->first.first, l->first.second, false, r->first, ranges);
+        }
     }
-
-    CLEANUP_KEYHOLDER(ri, key, kh);
 }
 
 void
-replication_manager :: chain_gc(const region_id& reg_id, uint64_t seq_id)
+replication_manager :: chain_gc(const std::vector<std::pair<region_id, uint64_t> >& lower_bounds)
 {
     po6::threads::mutex::hold hold(&m_block_both);
     m_wakeup_garbage_collector.broadcast();
-    m_lower_bounds.push_back(std::make_pair(reg_id, seq_id));
+    m_lower_bounds.insert(m_lower_bounds.end(), lower_bounds.begin(), lower_bounds.end());
 }
 
 void
 replication_manager :: trip_periodic()
 {
-    po6::threads::mutex::hold hold(&m_block_both);
-    m_wakeup_retransmitter.broadcast();
-    m_need_retransmit = true;
+    {
+        po6::threads::mutex::hold hold(&m_block_both);
+        m_wakeup_retransmitter.broadcast();
+        m_need_gc = true;
+    }
+
+    flush_acks(true);
 }
 
 uint64_t
@@ -615,13 +1203,35 @@ replication_manager :: hash(const keypair& kp)
                               kp.region.get());
 }
 
+size_t
+replication_manager :: partition_of(const region_id& ri) const
+{
+    return ri.get() % m_partitions.size();
+}
+
 uint64_t
 replication_manager :: get_lock_num(const region_id& reg,
                                     const e::slice& key)
 {
-    return CityHash64WithSeed(reinterpret_cast<const char*>(key.data()),
-                              key.size(),
-                              reg.get());
+    uint64_t h = CityHash64WithSeed(reinterpret_cast<const char*>(key.data()),
+                                    key.size(),
+                                    reg.get());
+    // each partition gets its own range of stripes so that no two partitions
+    // ever contend for (or share cache lines with) the same lock
+    uint64_t stripes = KEYHOLDER_STRIPES / m_partitions.size();
+    return partition_of(reg) * stripes + h % stripes;
+}
+
+replication_manager::partition*
+replication_manager :: partition_for(const region_id& reg)
+{
+    return m_partitions[partition_of(reg)].get();
+}
+
+replication_manager::keyholder_map_t*
+replication_manager :: keyholders_for(const region_id& reg)
+{
+    return &partition_for(reg)->keyholders;
 }
 
 e::intrusive_ptr<replication_manager::keyholder>
@@ -630,7 +1240,7 @@ replication_manager :: get_keyholder(const region_id& reg, const e::slice& key)
     keypair kp(reg, std::string(reinterpret_cast<const char*>(key.data()), key.size()));
     e::intrusive_ptr<keyholder> kh;
 
-    if (!m_keyholders.lookup(kp, &kh))
+    if (!keyholders_for(reg)->lookup(kp, &kh))
     {
         return NULL;
     }
@@ -644,15 +1254,25 @@ replication_manager :: get_or_create_keyholder(const region_id& reg, const e::sl
     keypair kp(reg, std::string(reinterpret_cast<const char*>(key.data()), key.size()));
     e::intrusive_ptr<keyholder> kh;
 
-    if (!m_keyholders.lookup(kp, &kh))
+    keyholder_map_t* khs = keyholders_for(reg);
+
+    if (!khs->lookup(kp, &kh))
     {
-        kh = new keyholder();
+        kh = new keyholder(kp);
 
-        if (!m_keyholders.insert(kp, kh))
+        if (!khs->insert(kp, kh))
         {
             abort();
         }
 
+        // A key the region's filter has never seen cannot be on disk.
+        if (!m_daemon->m_data.may_exist(reg, key))
+        {
+            kh->get_has_old_value() = false;
+            kh->get_old_version() = 0;
+            return kh;
+        }
+
         switch (m_daemon->m_data.get(reg, key,
                                      &kh->get_old_value(),
                                      &kh->get_old_version(),
@@ -684,7 +1304,25 @@ replication_manager :: erase_keyholder(const region_id& reg,
                                        const e::slice& key)
 {
     keypair kp(reg, std::string(reinterpret_cast<const char*>(key.data()), key.size()));
-    m_keyholders.remove(kp);
+    keyholders_for(reg)->remove(kp);
+}
+
+const std::vector<bool>&
+replication_manager :: hashed_attrs(const region_id& ri,
+                                    size_t attrs_sz,
+                                    std::vector<bool>* scratch)
+{
+    const space* sp = m_daemon->m_config.get_space(ri);
+    hashed_attrs_map_t::const_iterator it;
+
+    if (sp && (it = m_hashed_attrs.find(sp->id.get())) != m_hashed_attrs.end())
+    {
+        return it->second;
+    }
+
+    // not a space we serve; hash everything
+    scratch->assign(attrs_sz, true);
+    return *scratch;
 }
 
 void
@@ -706,11 +1344,13 @@ replication_manager :: hash_objects(const region_id& reg,
     subspace_id subspace_this = m_daemon->m_config.subspace_of(reg);
     subspace_id subspace_prev = m_daemon->m_config.subspace_prev(subspace_this);
     subspace_id subspace_next = m_daemon->m_config.subspace_next(subspace_this);
+    std::vector<bool> scratch;
+    const std::vector<bool>& attrs(hashed_attrs(reg, sc.attrs_sz, &scratch));
 
     if (has_old_value && has_new_value)
     {
-        hyperdex::hash(sc, key, new_value, &pend->new_hashes.front());
-        hyperdex::hash(sc, key, old_value, &pend->old_hashes.front());
+        hyperdex::hash(sc, key, new_value, attrs, &pend->new_hashes.front());
+        hash_old_value(sc, attrs, new_value, pend->new_hashes, old_value, &pend->old_hashes);
 
         if (subspace_prev != subspace_id())
         {
@@ -718,7 +1358,15 @@ replication_manager :: hash_objects(const region_id& reg,
         }
 
         m_daemon->m_config.lookup_region(subspace_this, pend->old_hashes, &pend->this_old_region);
-        m_daemon->m_config.lookup_region(subspace_this, pend->new_hashes, &pend->this_new_region);
+
+        if (same_subspace_hashes(m_daemon->m_config.get_subspace(reg), pend->old_hashes, pend->new_hashes))
+        {
+            pend->this_new_region = pend->this_old_region;
+        }
+        else
+        {
+            m_daemon->m_config.lookup_region(subspace_this, pend->new_hashes, &pend->this_new_region);
+        }
 
         if (subspace_next != subspace_id())
         {
@@ -727,7 +1375,7 @@ replication_manager :: hash_objects(const region_id& reg,
     }
     else if (has_old_value)
     {
-        hyperdex::hash(sc, key, old_value, &pend->old_hashes.front());
+        hyperdex::hash(sc, key, old_value, attrs, &pend->old_hashes.front());
 
         for (size_t i = 0; i < sc.attrs_sz; ++i)
         {
@@ -749,7 +1397,7 @@ replication_manager :: hash_objects(const region_id& reg,
     }
     else if (has_new_value)
     {
-        hyperdex::hash(sc, key, new_value, &pend->new_hashes.front());
+        hyperdex::hash(sc, key, new_value, attrs, &pend->new_hashes.front());
 
         for (size_t i = 0; i < sc.attrs_sz; ++i)
         {
@@ -775,6 +1423,65 @@ replication_manager :: hash_objects(const region_id& reg,
     }
 }
 
+bool
+replication_manager :: coalesce_blocked(const region_id& ri,
+                                        const schema& sc,
+                                        const e::slice& key,
+                                        e::intrusive_ptr<keyholder> kh,
+                                        std::tr1::shared_ptr<e::buffer> backing,
+                                        const std::vector<e::slice>& new_value,
+                                        const server_id& client,
+                                        uint64_t nonce)
+{
+    if (!kh->has_blocked_ops() || kh->has_deferred_ops())
+    {
+        return false;
+    }
+
+    uint64_t version = kh->most_recent_blocked_version();
+    e::intrusive_ptr<pending> op = kh->most_recent_blocked_op();
+
+    if (!op->coalescible || op->fresh || !op->has_value)
+    {
+        return false;
+    }
+
+    // Find the value the blocked op replaces so that its hashes reflect the
+    // transition from that value to the merged one.
+    bool has_prev_value = false;
+    const std::vector<e::slice>* prev_value = NULL;
+    e::intrusive_ptr<pending> prev = kh->get_by_version(version - 1);
+
+    if (prev)
+    {
+        has_prev_value = prev->has_value;
+        prev_value = &prev->value;
+    }
+    else if (kh->version_on_disk() == version - 1)
+    {
+        has_prev_value = kh->exists_on_disk();
+        prev_value = &kh->value_on_disk();
+    }
+    else
+    {
+        return false;
+    }
+
+    if (!has_prev_value)
+    {
+        return false;
+    }
+
+    op->backing = backing;
+    op->value = new_value;
+    op->funcs_backing.reset();
+    op->funcs.clear();
+    op->coalesced.push_back(std::make_pair(client, nonce));
+    hash_objects(ri, sc, key, true, op->value, true, *prev_value, op);
+    assert(op->this_old_region == ri || op->this_new_region == ri);
+    return true;
+}
+
 void
 replication_manager :: move_operations_between_queues(const virtual_server_id& us,
                                                       const region_id& ri,
@@ -807,6 +1514,15 @@ replication_manager :: move_operations_between_queues(const virtual_server_id& u
         if (new_pend->this_old_region == new_pend->this_new_region ||
             new_pend->this_old_region == ri)
         {
+            // Rebuild the value of an update that arrived as funcalls.  If we
+            // cannot, drop it; the retransmission carries the whole value.
+            if (new_pend->delta && !apply_delta(sc, key, has_old_value, old_value, new_pend))
+            {
+                LOG(INFO) << "dropping deferred CHAIN_OP whose funcalls do not apply to the previous version";
+                kh->pop_oldest_deferred();
+                continue;
+            }
+
             hash_objects(ri, sc, key, new_pend->has_value, new_pend->value, has_old_value, old_value ? *old_value : new_pend->value, new_pend);
 
             if (new_pend->this_old_region != ri && new_pend->this_new_region != ri)
@@ -842,22 +1558,71 @@ replication_manager :: move_operations_between_queues(const virtual_server_id& u
             break;
         }
 
+        // If the op may absorb later updates and the key already has a
+        // coalescible op in flight, hold it back so that updates arriving
+        // before the ack share one version
+        if (op->coalescible && kh->has_committable_ops() &&
+            kh->most_recent_committable_op()->coalescible)
+        {
+            break;
+        }
+
         kh->shift_one_blocked_to_committable();
-        send_message(us, false, version, key, op);
+        send_message(us, false, version, kh, op);
+    }
+
+    // Whatever the remaining ops wait on may never come (e.g., a dropped
+    // message), so look at them again once a timeout passes.
+    if ((kh->has_blocked_ops() || kh->has_deferred_ops()) &&
+        !kh->get_revisit_pending())
+    {
+        kh->get_revisit_pending() = true;
+        schedule_timeout(e::time() + RETRANSMIT_TIMEOUT, ri, key, REVISIT_VERSION);
+    }
+}
+
+bool
+replication_manager :: apply_delta(const schema& sc,
+                                   const e::slice& key,
+                                   bool has_old_value,
+                                   const std::vector<e::slice>* old_value,
+                                   e::intrusive_ptr<pending> op)
+{
+    if (!has_old_value || !old_value || old_value->size() + 1 != sc.attrs_sz)
+    {
+        return false;
+    }
+
+    std::vector<attribute_check> checks;
+    std::tr1::shared_ptr<e::buffer> backing;
+    std::vector<e::slice> value;
+    microerror error;
+    size_t passed = perform_checks_and_apply_funcs(&sc, checks, op->funcs, key, *old_value,
+                                                   &backing, &value, &error);
+
+    if (passed != op->funcs.size())
+    {
+        return false;
     }
+
+    op->backing = backing;
+    op->value = value;
+    op->delta = false;
+    return true;
 }
 
 void
 replication_manager :: send_message(const virtual_server_id& us,
                                     bool retransmission,
                                     uint64_t version,
-                                    const e::slice& key,
+                                    e::intrusive_ptr<keyholder> kh,
                                     e::intrusive_ptr<pending> op)
 {
     // If we've sent it somewhere, we shouldn't resend.  If the sender intends a
     // resend, they should clear "sent" first.
     assert(op->sent == virtual_server_id());
     region_id ri(m_daemon->m_config.get_region_id(us));
+    const e::slice key(kh->key());
 
     // facts we use to decide what to do
     assert(ri == op->this_old_region || ri == op->this_new_region);
@@ -934,8 +1699,12 @@ replication_manager :: send_message(const virtual_server_id& us,
 
     if (type == CHAIN_OP)
     {
+        // retransmissions carry the whole value in case the funcalls could
+        // not be applied downstream
+        bool delta = !op->funcs.empty() && !retransmission;
         uint8_t flags = (op->fresh ? 1 : 0)
                       | (op->has_value ? 2 : 0)
+                      | (delta ? 4 : 0)
                       | (retransmission ? 128 : 0);
         size_t sz = HYPERDEX_HEADER_SIZE_VV
                   + sizeof(uint8_t)
@@ -944,22 +1713,31 @@ replication_manager :: send_message(const virtual_server_id& us,
                   + sizeof(uint64_t)
                   + sizeof(uint32_t)
                   + key.size()
-                  + pack_size(op->value);
+                  + (delta ? pack_size(op->funcs) : pack_size(op->value));
         msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << op->reg_id.get() << op->seq_id << version << key << op->value;
+        e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+        pa = pa << flags << op->reg_id.get() << op->seq_id << version << key;
+
+        if (delta)
+        {
+            pa = pa << op->funcs;
+        }
+        else
+        {
+            pa = pa << op->value;
+        }
     }
     else if (type == CHAIN_ACK)
     {
         uint8_t flags = (retransmission ? 128 : 0);
+        uint32_t num_ranges = 1;
         size_t sz = HYPERDEX_HEADER_SIZE_VV
                   + sizeof(uint8_t)
                   + sizeof(uint64_t)
-                  + sizeof(uint64_t)
-                  + sizeof(uint64_t)
                   + sizeof(uint32_t)
-                  + key.size();
+                  + 2 * sizeof(uint64_t);
         msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << op->reg_id.get() << op->seq_id << version << key;
+        msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << op->reg_id.get() << num_ranges << op->seq_id << op->seq_id;
     }
     else if (type == CHAIN_SUBSPACE)
     {
@@ -981,30 +1759,98 @@ replication_manager :: send_message(const virtual_server_id& us,
         abort();
     }
 
+    {
+        partition* part = partition_for(ri);
+        po6::threads::mutex::hold hold(&part->mtx);
+        partition::unacked_key_t uk(std::make_pair(ri, op->reg_id), op->seq_id);
+        part->unacked[uk] = std::make_pair(kh, version);
+    }
+
+    if (op->retransmit_timeout == 0)
+    {
+        op->retransmit_timeout = RETRANSMIT_TIMEOUT;
+    }
+
+    schedule_timeout(e::time() + op->retransmit_timeout, ri, key, version);
+
     op->sent_config_version = m_daemon->m_config.version();
     op->sent = dest;
     m_daemon->m_comm.send_exact(us, dest, type, msg);
 }
 
-bool
+void
+replication_manager :: schedule_timeout(uint64_t when,
+                                        const region_id& ri,
+                                        const e::slice& key,
+                                        uint64_t version)
+{
+    if (m_timeouts->insert(when, ri, key, version))
+    {
+        po6::threads::mutex::hold hold(&m_block_both);
+        m_wakeup_retransmitter.broadcast();
+    }
+}
+
+void
 replication_manager :: send_ack(const virtual_server_id& us,
                                 const virtual_server_id& to,
                                 bool retransmission,
                                 const region_id& reg_id,
-                                uint64_t seq_id,
-                                uint64_t version,
-                                const e::slice& key)
+                                uint64_t seq_id)
+{
+    if (retransmission)
+    {
+        std::vector<std::pair<uint64_t, uint64_t> > ranges;
+        ranges.push_back(std::make_pair(seq_id, seq_id));
+        send_acks(us, to, true, reg_id, ranges);
+        return;
+    }
+
+    partition* part = partition_for(m_daemon->m_config.get_region_id(us));
+    bool flush = false;
+
+    {
+        po6::threads::mutex::hold hold(&part->mtx);
+
+        if (part->acks_queued == 0)
+        {
+            part->acks_deadline = e::time() + ACK_FLUSH_DELAY;
+        }
+
+        part->acks[std::make_pair(us, to)][reg_id].push_back(seq_id);
+        ++part->acks_queued;
+        flush = part->acks_queued >= ACK_FLUSH_COUNT;
+    }
+
+    if (flush)
+    {
+        flush_partition_acks(part, true);
+    }
+}
+
+bool
+replication_manager :: send_acks(const virtual_server_id& us,
+                                 const virtual_server_id& to,
+                                 bool retransmission,
+                                 const region_id& reg_id,
+                                 const std::vector<std::pair<uint64_t, uint64_t> >& ranges)
 {
     uint8_t flags = (retransmission ? 128 : 0);
+    uint32_t num_ranges = ranges.size();
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint8_t)
               + sizeof(uint64_t)
-              + sizeof(uint64_t)
-              + sizeof(uint64_t)
               + sizeof(uint32_t)
-              + key.size();
+              + ranges.size() * 2 * sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << reg_id.get() << seq_id << version << key;
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+    pa = pa << flags << reg_id.get() << num_ranges;
+
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        pa = pa << ranges[i].first << ranges[i].second;
+    }
+
     return m_daemon->m_comm.send_exact(us, to, CHAIN_ACK, msg);
 }
 
@@ -1014,6 +1860,12 @@ replication_manager :: respond_to_client(const virtual_server_id& us,
                                          uint64_t nonce,
                                          network_returncode ret)
 {
+    // operations issued by group_atomic have nobody waiting on them
+    if (client == server_id())
+    {
+        return;
+    }
+
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint16_t);
@@ -1041,14 +1893,16 @@ replication_manager :: retransmitter()
         return;
     }
 
-    uint64_t then = e::time();
-
     while (true)
     {
+        bool sweep = false;
+        bool gc = false;
+
         {
             po6::threads::mutex::hold hold(&m_block_both);
 
-            while ((!m_need_retransmit && !m_shutdown) || m_need_pause)
+            while ((!m_need_retransmit && !m_need_gc && !m_shutdown && m_timeouts->empty()) ||
+                   m_need_pause)
             {
                 m_paused_retransmitter = true;
 
@@ -1066,18 +1920,54 @@ replication_manager :: retransmitter()
                 break;
             }
 
+            sweep = m_need_retransmit;
+            gc = m_need_gc;
             m_need_retransmit = false;
+            m_need_gc = false;
+        }
+
+        // After a reconfiguration every keyholder is visited to resend what
+        // was sent in the old configuration.
+        if (sweep)
+        {
+            retransmit_all();
+        }
+        else if (!gc)
+        {
+            uint64_t now = e::time();
+            uint64_t next = m_timeouts->next_expiry();
+
+            if (next > now)
+            {
+                timespec ts;
+                ts.tv_sec = 0;
+                ts.tv_nsec = std::min<uint64_t>(next - now, RETRANSMIT_MAX_SLEEP);
+                nanosleep(&ts, NULL);
+            }
         }
 
-        std::set<region_id> region_cache;
-        std::map<region_id, uint64_t> seq_id_lower_bounds;
+        retransmit_expired();
 
+        if (gc)
         {
-            m_counters.peek(&seq_id_lower_bounds);
+            send_gc();
         }
+    }
+
+    LOG(INFO) << "retransmitter thread shutting down";
+}
+
+void
+replication_manager :: retransmit_all()
+{
+    std::set<region_id> region_cache;
+
+    for (size_t p = 0; p < m_partitions.size(); ++p)
+    {
+        keyholder_map_t* khs = &m_partitions[p]->keyholders;
 
-        for (keyholder_map_t::iterator it = m_keyholders.begin();
-                it != m_keyholders.end(); it.next())
+        for (keyholder_map_t::iterator it = khs->begin();
+                it != khs->end(); it.next())
         {
             region_id ri(it.key().region);
 
@@ -1101,7 +1991,7 @@ replication_manager :: retransmitter()
 
             if (us == virtual_server_id())
             {
-                m_keyholders.remove(it.key());
+                khs->remove(it.key());
                 continue;
             }
 
@@ -1111,66 +2001,169 @@ replication_manager :: retransmitter()
             if (kh->empty())
             {
                 LOG(WARNING) << "leaking keyholders (this is harmless if you reconfigure enough)";
-                m_keyholders.remove(it.key());
+                khs->remove(it.key());
                 continue;
             }
 
-            kh->resend_committable(this, us, key);
+            kh->resend_committable(this, us);
             move_operations_between_queues(us, ri, *sc, key, kh);
+        }
+    }
 
-            if (m_daemon->m_config.is_point_leader(us))
-            {
-                uint64_t min_id = kh->min_seq_id();
-                std::map<region_id, uint64_t>::iterator lb = seq_id_lower_bounds.find(ri);
+    m_daemon->m_comm.wake_one();
+}
 
-                if (lb == seq_id_lower_bounds.end())
-                {
-                    seq_id_lower_bounds.insert(std::make_pair(ri, min_id));
-                }
-                else
-                {
-                    lb->second = std::min(lb->second, min_id);
-                }
-            }
+void
+replication_manager :: retransmit_expired()
+{
+    std::list<timer_wheel::timeout> expired;
+    uint64_t now = e::time();
+    m_timeouts->expire(now, &expired);
+
+    for (std::list<timer_wheel::timeout>::iterator t = expired.begin();
+            t != expired.end(); ++t)
+    {
+        region_id ri(t->first.region);
+        e::slice key(t->first.key.data(), t->first.key.size());
+        uint64_t version = t->second;
+        virtual_server_id us = m_daemon->m_config.get_virtual(ri, m_daemon->m_us);
+
+        if (us == virtual_server_id())
+        {
+            continue;
         }
 
-        m_daemon->m_comm.wake_one();
-        uint64_t now = e::time();
+        if (m_daemon->m_config.is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
+        {
+            m_timeouts->insert(now + RETRANSMIT_TIMEOUT, ri, key, version);
+            continue;
+        }
+
+        HOLD_LOCK_FOR_KEY(ri, key);
+        e::intrusive_ptr<keyholder> kh = get_keyholder(ri, key);
+
+        if (!kh)
+        {
+            continue;
+        }
 
-        // Rate limit CHAIN_GC sending
-        if (((now - then) / 1000 / 1000 / 1000) < 30)
+        if (version == REVISIT_VERSION)
         {
+            const schema* sc = m_daemon->m_config.get_schema(ri);
+            assert(sc);
+            kh->get_revisit_pending() = false;
+            move_operations_between_queues(us, ri, *sc, key, kh);
+            CLEANUP_KEYHOLDER(ri, key, kh);
             continue;
         }
 
-        then = now;
-        std::vector<std::pair<server_id, po6::net::location> > cluster_members;
-        m_daemon->m_config.get_all_addresses(&cluster_members);
+        e::intrusive_ptr<pending> op = kh->get_by_version(version);
 
-        for (std::map<region_id, uint64_t>::iterator it = seq_id_lower_bounds.begin();
-                it != seq_id_lower_bounds.end(); ++it)
+        // acked or not yet sent; either way nothing is outstanding
+        if (!op || op->acked || op->sent == virtual_server_id())
         {
-            // lookup and check again since we lost/acquired the lock
-            virtual_server_id us = m_daemon->m_config.get_virtual(it->first, m_daemon->m_us);
+            continue;
+        }
+
+        op->retransmit_timeout = std::min<uint64_t>(op->retransmit_timeout * 2, RETRANSMIT_MAX_TIMEOUT);
+        op->sent = virtual_server_id();
+        op->sent_config_version = 0;
+        send_message(us, true, version, kh, op);
+    }
+}
+
+void
+replication_manager :: send_gc()
+{
+    // The lowest seq_id a point leader may still need acked is the lowest one
+    // it has in flight, or the next one it will issue.
+    std::map<region_id, uint64_t> seq_id_lower_bounds;
+    m_counters.peek(&seq_id_lower_bounds);
+
+    for (size_t p = 0; p < m_partitions.size(); ++p)
+    {
+        partition* part = m_partitions[p].get();
+        po6::threads::mutex::hold hold(&part->mtx);
 
-            if (us == virtual_server_id() || !m_daemon->m_config.is_point_leader(us))
+        for (partition::unacked_map_t::iterator u = part->unacked.begin();
+                u != part->unacked.end(); ++u)
+        {
+            // only the point leader's own ops bound its region
+            if (u->first.first.first != u->first.first.second)
             {
                 continue;
             }
 
-            size_t sz = HYPERDEX_HEADER_SIZE_VV
-                      + sizeof(uint64_t);
+            std::map<region_id, uint64_t>::iterator it;
+            it = seq_id_lower_bounds.find(u->first.first.first);
 
-            for (size_t i = 0; i < cluster_members.size(); ++i)
+            if (it != seq_id_lower_bounds.end())
             {
-                std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-                msg->pack_at(HYPERDEX_HEADER_SIZE_VS) << it->second;
-                m_daemon->m_comm.send(us, cluster_members[i].first, CHAIN_GC, msg);
+                it->second = std::min(it->second, u->first.second);
             }
         }
     }
 
-    LOG(INFO) << "retransmitter thread shutting down";
+    // Acks for a point leader's ops are recorded by every replica of every
+    // region in its space, so only those servers hear about its bound.  Each
+    // server gets one message holding the bounds for all of our regions.
+    typedef std::map<server_id, std::vector<std::pair<region_id, uint64_t> > > gc_map_t;
+    gc_map_t bounds_by_server;
+    virtual_server_id us;
+
+    for (std::map<region_id, uint64_t>::iterator it = seq_id_lower_bounds.begin();
+            it != seq_id_lower_bounds.end(); ++it)
+    {
+        // lookup and check again since we lost/acquired the lock
+        virtual_server_id vsi = m_daemon->m_config.get_virtual(it->first, m_daemon->m_us);
+        const space* sp = m_daemon->m_config.get_space(it->first);
+
+        if (vsi == virtual_server_id() || !m_daemon->m_config.is_point_leader(vsi) || !sp)
+        {
+            continue;
+        }
+
+        us = vsi;
+        std::set<server_id> hosts;
+
+        for (size_t ss = 0; ss < sp->subspaces.size(); ++ss)
+        {
+            for (size_t r = 0; r < sp->subspaces[ss].regions.size(); ++r)
+            {
+                const region& reg(sp->subspaces[ss].regions[r]);
+
+                for (size_t z = 0; z < reg.replicas.size(); ++z)
+                {
+                    hosts.insert(reg.replicas[z].si);
+                }
+            }
+        }
+
+        for (std::set<server_id>::iterator h = hosts.begin(); h != hosts.end(); ++h)
+        {
+            bounds_by_server[*h].push_back(*it);
+        }
+    }
+
+    for (gc_map_t::iterator it = bounds_by_server.begin();
+            it != bounds_by_server.end(); ++it)
+    {
+        const std::vector<std::pair<region_id, uint64_t> >& bounds(it->second);
+        uint32_t num_bounds = bounds.size();
+        size_t sz = HYPERDEX_HEADER_SIZE_VS
+                  + sizeof(uint32_t)
+                  + num_bounds * 2 * sizeof(uint64_t);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VS);
+        pa = pa << num_bounds;
+
+        for (size_t i = 0; i < bounds.size(); ++i)
+        {
+            pa = pa << bounds[i].first << bounds[i].second;
+        }
+
+        m_daemon->m_comm.send(us, it->first, CHAIN_GC, msg);
+    }
 }
 
 void
@@ -1219,29 +2212,67 @@ replication_manager :: garbage_collector()
             lower_bounds.swap(m_lower_bounds);
         }
 
-        // sort so that we scan disk sequentially
-        lower_bounds.sort();
+        // keep the highest bound for each region, in order so that we scan
+        // disk sequentially
+        std::map<region_id, uint64_t> highest;
 
-        while (!lower_bounds.empty())
+        for (std::list<std::pair<region_id, uint64_t> >::iterator it = lower_bounds.begin();
+                it != lower_bounds.end(); ++it)
         {
-            region_id reg_id = lower_bounds.front().first;
-            uint64_t seq_id = lower_bounds.front().second;
+            uint64_t& seq_id(highest[it->first]);
+            seq_id = std::max(seq_id, it->second);
+        }
+
+        std::vector<std::pair<region_id, uint64_t> > clear;
+        clear.reserve(highest.size());
 
+        for (std::map<region_id, uint64_t>::iterator it = highest.begin();
+                it != highest.end(); ++it)
+        {
             // I chose to use seq_id - 1 for clearing because i'm too tired to check for
             // an off by one.  At worst it'll leave a little extra state laying around,
             // and is guaranteed to be as correct as garbage collecting seq_id.
-            if (seq_id > 0)
+            if (it->second > 0)
             {
-                m_daemon->m_data.clear_acked(reg_id, seq_id - 1);
+                clear.push_back(std::make_pair(it->first, it->second - 1));
             }
-
-            lower_bounds.pop_front();
         }
+
+        m_daemon->m_data.clear_acked(clear);
+        prune_unacked(highest);
     }
 
     LOG(INFO) << "garbage collector thread shutting down";
 }
 
+void
+replication_manager :: prune_unacked(const std::map<region_id, uint64_t>& lower_bounds)
+{
+    // Every replica has acked a point leader's ops below its bound, so an
+    // entry for one of them is left from an ack that never made it back.
+    for (size_t p = 0; p < m_partitions.size(); ++p)
+    {
+        partition* part = m_partitions[p].get();
+        po6::threads::mutex::hold hold(&part->mtx);
+        partition::unacked_map_t::iterator u = part->unacked.begin();
+
+        while (u != part->unacked.end())
+        {
+            std::map<region_id, uint64_t>::const_iterator lb;
+            lb = lower_bounds.find(u->first.first.second);
+
+            if (lb != lower_bounds.end() && u->first.second < lb->second)
+            {
+                part->unacked.erase(u++);
+            }
+            else
+            {
+                ++u;
+            }
+        }
+    }
+}
+
 void
 replication_manager :: shutdown()
 {
@@ -30,7 +30,11 @@
 
 // STL
 #include <list>
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
+#include <tr1/memory>
 #include <tr1/unordered_map>
 
 // po6
@@ -51,6 +55,7 @@
 #include "common/funcall.h"
 #include "common/ids.h"
 #include "common/network_returncode.h"
+#include "daemon/datalayer.h"
 #include "daemon/reconfigure_returncode.h"
 
 namespace hyperdex
@@ -66,7 +71,15 @@ class replication_manager
 
     // Reconfigure this layer.
     public:
-        bool setup();
+        // Keyholders are split into "partitions" groups by region, each with
+        // its own map, lock stripes, and record of acks sent and owed.  A
+        // region worker is the only thread to process its partition's
+        // messages, but the map stays lockfree and keys still take their
+        // stripe, because the retransmitter resends and revisits keys from
+        // its own thread, and without workers every network thread shares
+        // every partition.  A worker's stripes and lock are never taken by
+        // another worker, so they stay uncontended and in its cache.
+        bool setup(size_t partitions);
         void teardown();
         void pause();
         void unpause();
@@ -87,6 +100,25 @@ class replication_manager
                            const e::slice& key,
                            std::vector<attribute_check>* checks,
                            std::vector<funcall>* funcs);
+        // As client_atomic, for all the ops of one REQ_MULTI_ATOMIC.  Op i
+        // is keys[i] with nonces[i], checks[i], and funcs[i]; flags[i] is as
+        // in REQ_ATOMIC.
+        void client_multi_atomic(const server_id& from,
+                                 const virtual_server_id& to,
+                                 const std::vector<uint64_t>& nonces,
+                                 const std::vector<uint8_t>& flags,
+                                 const std::vector<e::slice>& keys,
+                                 std::vector<std::vector<attribute_check> >* checks,
+                                 std::vector<std::vector<funcall> >* funcs);
+        // Apply the same operation to many keys on behalf of a group
+        // operation.  No per-key responses are sent.
+        void group_atomic(const virtual_server_id& to,
+                          bool fail_if_not_found,
+                          bool fail_if_found,
+                          bool erase,
+                          const std::vector<e::slice>& keys,
+                          std::vector<attribute_check>* checks,
+                          std::vector<funcall>* funcs);
         // These are called in response to messages from other hosts.
         void chain_op(const virtual_server_id& from,
                       const virtual_server_id& to,
@@ -98,7 +130,8 @@ class replication_manager
                       bool has_value,
                       std::auto_ptr<e::buffer> backing,
                       const e::slice& key,
-                      const std::vector<e::slice>& value);
+                      const std::vector<e::slice>& value,
+                      const std::vector<funcall>& funcs);
         void chain_subspace(const virtual_server_id& from,
                             const virtual_server_id& to,
                             bool retransmission,
@@ -109,22 +142,38 @@ class replication_manager
                             const e::slice& key,
                             const std::vector<e::slice>& value,
                             const std::vector<uint64_t>& hashes);
+        // A CHAIN_ACK acknowledges every op for reg_id that we sent to "from"
+        // whose seq_id falls in one of the inclusive ranges.
         void chain_ack(const virtual_server_id& from,
                        const virtual_server_id& to,
                        bool retransmission,
                        const region_id& reg_id,
-                       uint64_t seq_id,
-                       uint64_t version,
-                       const e::slice& key);
-        void chain_gc(const region_id& reg_id, uint64_t seq_id);
+                       const std::vector<std::pair<uint64_t, uint64_t> >& ranges);
+        void chain_gc(const std::vector<std::pair<region_id, uint64_t> >& lower_bounds);
         void trip_periodic();
+        // Send the acks queued in partition "p" since its last flush.  The
+        // worker owning the partition calls this after each message; "idle"
+        // says there are no more messages queued locally, otherwise acks are
+        // held until there are enough of them or the oldest has waited long
+        // enough.
+        void flush_acks(size_t p, bool idle);
+        // Without workers any thread may queue acks in any partition, so each
+        // call flushes every partition when idle, and otherwise the next one
+        // in turn.
+        void flush_acks(bool idle);
+        // The partition whose keyholders hold the keys of region "ri"
+        size_t partition_of(const region_id& ri) const;
 
     private:
         class pending;
         class keyholder;
         class keypair;
+        class partition;
+        class timer_wheel;
         static uint64_t hash(const keypair&);
         typedef e::lockfree_hash_map<keypair, e::intrusive_ptr<keyholder>, hash> keyholder_map_t;
+        // space id to the attributes some subspace of it is partitioned on
+        typedef std::map<uint64_t, std::vector<bool> > hashed_attrs_map_t;
 
     private:
         replication_manager(const replication_manager&);
@@ -134,9 +183,26 @@ class replication_manager
 
     private:
         uint64_t get_lock_num(const region_id& reg, const e::slice& key);
+        // the body of client_atomic, once the key's lock is held
+        void client_atomic_locked(const server_id& from,
+                                  const virtual_server_id& to,
+                                  uint64_t nonce,
+                                  bool fail_if_not_found,
+                                  bool fail_if_found,
+                                  bool erase,
+                                  const e::slice& key,
+                                  std::vector<attribute_check>* checks,
+                                  std::vector<funcall>* funcs);
+        partition* partition_for(const region_id& reg);
+        keyholder_map_t* keyholders_for(const region_id& reg);
         e::intrusive_ptr<keyholder> get_keyholder(const region_id& reg, const e::slice& key);
         e::intrusive_ptr<keyholder> get_or_create_keyholder(const region_id& reg, const e::slice& key);
         void erase_keyholder(const region_id& reg, const e::slice& key);
+        // The attributes whose hashes route writes in ri's space; filled in
+        // "scratch" (every attribute) when the space is not one we serve.
+        const std::vector<bool>& hashed_attrs(const region_id& ri,
+                                              size_t attrs_sz,
+                                              std::vector<bool>* scratch);
         void hash_objects(const region_id& reg,
                           const schema& sc,
                           const e::slice& key,
@@ -149,6 +215,24 @@ class replication_manager
                            bool has_new_value, const std::vector<e::slice>& new_value,
                            bool has_old_value, const std::vector<e::slice>& old_value,
                            e::intrusive_ptr<pending> pend);
+        // Fold a new value for the key into the most recent blocked op if
+        // both it and the new update are coalescible.  Returns true if the
+        // update was absorbed, in which case the client will be acked when
+        // the blocked op commits.
+        bool coalesce_blocked(const region_id& ri,
+                              const schema& sc,
+                              const e::slice& key,
+                              e::intrusive_ptr<keyholder> kh,
+                              std::tr1::shared_ptr<e::buffer> backing,
+                              const std::vector<e::slice>& new_value,
+                              const server_id& client,
+                              uint64_t nonce);
+        // rebuild the value of an op that arrived as funcalls
+        bool apply_delta(const schema& sc,
+                         const e::slice& key,
+                         bool has_old_value,
+                         const std::vector<e::slice>* old_value,
+                         e::intrusive_ptr<pending> op);
         // Move operations between the queues in the keyholder.  Blocked
         // operations will have their blocking criteria checked.  Deferred
         // operations will be checked for continuity with the blocked
@@ -158,32 +242,77 @@ class replication_manager
                                             const schema& sc,
                                             const e::slice& key,
                                             e::intrusive_ptr<keyholder> kh);
+        // Add a timeout to the wheel, waking the retransmitter if it was idle
+        void schedule_timeout(uint64_t when,
+                              const region_id& ri,
+                              const e::slice& key,
+                              uint64_t version);
         void send_message(const virtual_server_id& us,
                           bool retransmission,
                           uint64_t version,
-                          const e::slice& key,
+                          e::intrusive_ptr<keyholder> kh,
                           e::intrusive_ptr<pending> op);
-        bool send_ack(const virtual_server_id& us,
+        // Check the ack of one op against the op we sent, and stage its
+        // commit in "updates".  Returns the op, or NULL if the ack was
+        // dropped.  The caller holds the key's lock.
+        e::intrusive_ptr<pending> stage_ack(const virtual_server_id& from,
+                                            const virtual_server_id& to,
+                                            bool retransmission,
+                                            const region_id& reg_id,
+                                            uint64_t seq_id,
+                                            uint64_t version,
+                                            const e::slice& key,
+                                            datalayer::batch* updates);
+        // Once the staged commit is written:  tell the subscribers if
+        // "written" says it succeeded, unblock the key's queued ops, and
+        // answer the client and the previous hop.  The caller holds the
+        // key's lock.
+        void finish_ack(const virtual_server_id& to,
+                        const region_id& reg_id,
+                        uint64_t seq_id,
+                        uint64_t version,
+                        const e::slice& key,
+                        e::intrusive_ptr<pending> pend,
+                        bool written);
+        // Send the acks queued in "p"
+        void flush_partition_acks(partition* p, bool idle);
+        // Acks are queued and sent in bulk by flush_acks, except those for
+        // retransmissions, which go out immediately.
+        void send_ack(const virtual_server_id& us,
                       const virtual_server_id& to,
                       bool retransmission,
                       const region_id& reg_id,
-                      uint64_t seq_id,
-                      uint64_t version,
-                      const e::slice& key);
+                      uint64_t seq_id);
+        bool send_acks(const virtual_server_id& us,
+                       const virtual_server_id& to,
+                       bool retransmission,
+                       const region_id& reg_id,
+                       const std::vector<std::pair<uint64_t, uint64_t> >& ranges);
         void respond_to_client(const virtual_server_id& us,
                                const server_id& client,
                                uint64_t nonce,
                                network_returncode ret);
         // thread functions
         void retransmitter();
+        // resend everything sent in an earlier configuration
+        void retransmit_all();
+        // resend only the ops whose timeouts have expired
+        void retransmit_expired();
+        void send_gc();
         void garbage_collector();
+        // Forget the unacked ops whose seq_ids every replica has acked
+        void prune_unacked(const std::map<region_id, uint64_t>& lower_bounds);
         void shutdown();
 
     private:
         daemon* m_daemon;
         e::striped_lock<po6::threads::mutex> m_keyholder_locks;
-        keyholder_map_t m_keyholders;
+        std::vector<std::tr1::shared_ptr<partition> > m_partitions;
+        // the next partition flush_acks visits when not idle
+        uint64_t m_flush_next;
         counter_map m_counters;
+        // rebuilt by reconfigure, which runs while no writes are in flight
+        hashed_attrs_map_t m_hashed_attrs;
         bool m_shutdown;
         po6::threads::thread m_retransmitter;
         po6::threads::thread m_garbage_collector;
@@ -192,10 +321,12 @@ class replication_manager
         po6::threads::cond m_wakeup_garbage_collector;
         po6::threads::cond m_wakeup_reconfigurer;
         bool m_need_retransmit;
+        bool m_need_gc;
         std::list<std::pair<region_id, uint64_t> > m_lower_bounds;
         bool m_need_pause;
         bool m_paused_retransmitter;
         bool m_paused_garbage_collector;
+        const std::auto_ptr<timer_wheel> m_timeouts;
 };
 
 } // namespace hyperdex
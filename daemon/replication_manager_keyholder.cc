@@ -28,12 +28,14 @@
 // HyperDex
 #include "daemon/daemon.h"
 #include "daemon/replication_manager_keyholder.h"
+#include "daemon/replication_manager_keypair.h"
 #include "daemon/replication_manager_pending.h"
 
 using hyperdex::replication_manager;
 
-replication_manager :: keyholder :: keyholder()
+replication_manager :: keyholder :: keyholder(const keypair& kp)
     : m_ref(0)
+    , m_kp(kp)
     , m_committable()
     , m_blocked()
     , m_deferred()
@@ -42,6 +44,7 @@ replication_manager :: keyholder :: keyholder()
     , m_old_value()
     , m_old_disk_ref()
     , m_old_backing()
+    , m_revisit_pending(false)
 {
 }
 
@@ -49,6 +52,12 @@ replication_manager :: keyholder :: ~keyholder() throw ()
 {
 }
 
+e::slice
+replication_manager :: keyholder :: key() const
+{
+    return e::slice(m_kp.key.data(), m_kp.key.size());
+}
+
 bool
 replication_manager :: keyholder :: empty() const
 {
@@ -326,8 +335,7 @@ replication_manager :: keyholder :: shift_one_deferred_to_blocked()
 
 void
 replication_manager :: keyholder :: resend_committable(replication_manager* rm,
-                                                       const virtual_server_id& us,
-                                                       const e::slice& key)
+                                                       const virtual_server_id& us)
 {
     for (committable_list_t::iterator it = m_committable.begin();
             it != m_committable.end(); ++it)
@@ -340,6 +348,6 @@ replication_manager :: keyholder :: resend_committable(replication_manager* rm,
 
         it->second->sent = virtual_server_id();
         it->second->sent_config_version = 0;
-        rm->send_message(us, true, it->first, key, it->second);
+        rm->send_message(us, true, it->first, this, it->second);
     }
 }
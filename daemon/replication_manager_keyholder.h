@@ -34,14 +34,18 @@
 // HyperDex
 #include "daemon/datalayer.h"
 #include "daemon/replication_manager.h"
+#include "daemon/replication_manager_keypair.h"
 
 class hyperdex::replication_manager::keyholder
 {
     public:
-        keyholder();
+        keyholder(const keypair& kp);
         ~keyholder() throw ();
 
     public:
+        // the key this keyholder holds, so that it can be found again from
+        // a seq_id without a copy of the key for every op
+        e::slice key() const;
         bool empty() const;
         void get_latest_version(bool* has_old_value,
                                 uint64_t* old_version,
@@ -79,14 +83,15 @@ class hyperdex::replication_manager::keyholder
         void shift_one_blocked_to_committable();
         void shift_one_deferred_to_blocked();
         void resend_committable(replication_manager* rm,
-                                const virtual_server_id& us,
-                                const e::slice& key);
+                                const virtual_server_id& us);
 
     public:
         bool& get_has_old_value() { return m_has_old_value; }
         uint64_t& get_old_version() { return m_old_version; }
         std::vector<e::slice>& get_old_value() { return m_old_value; }
         datalayer::reference& get_old_disk_ref() { return m_old_disk_ref; }
+        // set while a timeout is due to revisit the blocked and deferred ops
+        bool& get_revisit_pending() { return m_revisit_pending; }
 
     private:
         typedef std::list<std::pair<uint64_t, e::intrusive_ptr<pending> > >
@@ -103,6 +108,7 @@ class hyperdex::replication_manager::keyholder
 
     private:
         size_t m_ref;
+        const keypair m_kp;
         committable_list_t m_committable;
         blocked_list_t m_blocked;
         deferred_list_t m_deferred;
@@ -111,6 +117,7 @@ class hyperdex::replication_manager::keyholder
         std::vector<e::slice> m_old_value;
         datalayer::reference m_old_disk_ref;
         std::tr1::shared_ptr<e::buffer> m_old_backing;
+        bool m_revisit_pending;
 };
 
 #endif // hyperdex_daemon_replication_manager_keyholder_h_
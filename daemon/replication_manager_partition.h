@@ -0,0 +1,86 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_replication_manager_partition_h_
+#define hyperdex_daemon_replication_manager_partition_h_
+
+// STL
+#include <map>
+#include <utility>
+#include <vector>
+#include <tr1/unordered_map>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// HyperDex
+#include "daemon/replication_manager.h"
+#include "daemon/replication_manager_keyholder.h"
+
+// The keyholders of the regions that hash to one partition, along with the
+// chain messages sent and owed on their behalf.  Besides the threads that
+// process the partition's messages, only the retransmitter and the periodic GC
+// and ack flush take "mtx", so partitions never contend with one another.
+class hyperdex::replication_manager::partition
+{
+    public:
+        // (our region, point leader region, seq_id)
+        typedef std::pair<std::pair<region_id, region_id>, uint64_t> unacked_key_t;
+        class unacked_hash
+        {
+            public:
+                size_t operator () (const unacked_key_t& uk) const;
+        };
+        // ops sent downstream and not yet acked, mapping to the keyholder and
+        // version they were sent for
+        typedef std::tr1::unordered_map<unacked_key_t,
+                                        std::pair<e::intrusive_ptr<keyholder>, uint64_t>,
+                                        unacked_hash> unacked_map_t;
+        // acks owed upstream, keyed by (us, upstream) and point leader region
+        typedef std::pair<virtual_server_id, virtual_server_id> ack_link_t;
+        typedef std::map<ack_link_t, std::map<region_id, std::vector<uint64_t> > > ack_map_t;
+
+    public:
+        partition();
+        ~partition() throw ();
+
+    public:
+        keyholder_map_t keyholders;
+        // protects everything below
+        po6::threads::mutex mtx;
+        unacked_map_t unacked;
+        ack_map_t acks;
+        size_t acks_queued;
+        uint64_t acks_deadline;
+
+    private:
+        partition(const partition&);
+        partition& operator = (const partition&);
+};
+
+#endif // hyperdex_daemon_replication_manager_partition_h_
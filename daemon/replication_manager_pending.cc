@@ -47,16 +47,26 @@ replication_manager :: pending :: pending(std::tr1::shared_ptr<e::buffer> _backi
     , recv(_recv)
     , sent_config_version(0)
     , sent()
+    , retransmit_timeout(0)
     , fresh(_fresh)
     , acked(false)
     , client()
     , nonce()
+    , coalescible(false)
+    , coalesced()
+    , funcs_backing()
+    , funcs()
+    , delta(false)
     , old_hashes()
     , new_hashes()
     , this_old_region()
     , this_new_region()
     , prev_region()
     , next_region()
+    , notify(false)
+    , notify_has_old_value(false)
+    , notify_old_value()
+    , notify_backing()
     , m_ref(0)
 {
 }
@@ -78,16 +88,26 @@ replication_manager :: pending :: pending(std::tr1::shared_ptr<e::buffer> _backi
     , recv()
     , sent_config_version(0)
     , sent()
+    , retransmit_timeout(0)
     , fresh(_fresh)
     , acked(false)
     , client(_client)
     , nonce(_nonce)
+    , coalescible(false)
+    , coalesced()
+    , funcs_backing()
+    , funcs()
+    , delta(false)
     , old_hashes()
     , new_hashes()
     , this_old_region()
     , this_new_region()
     , prev_region()
     , next_region()
+    , notify(false)
+    , notify_has_old_value(false)
+    , notify_old_value()
+    , notify_backing()
     , m_ref(0)
 {
 }
@@ -30,6 +30,7 @@
 
 // STL
 #include <tr1/memory>
+#include <utility>
 
 // HyperDex
 #include "daemon/replication_manager.h"
@@ -65,16 +66,31 @@ class hyperdex::replication_manager::pending
         virtual_server_id recv; // we recv from here
         uint64_t sent_config_version;
         virtual_server_id sent; // we sent to here
+        uint64_t retransmit_timeout; // doubles each time the send times out
         bool fresh;
         bool acked;
         server_id client;
         uint64_t nonce;
+        bool coalescible; // point leader may fold later updates into this op
+        std::vector<std::pair<server_id, uint64_t> > coalesced; // (client, nonce) to ack
+        // The funcalls that turn the previous version into this one.  When
+        // set, CHAIN_OPs carry these rather than the value; "delta" means
+        // that value must still be rebuilt from the previous version.
+        std::tr1::shared_ptr<e::buffer> funcs_backing;
+        std::vector<funcall> funcs;
+        bool delta;
         std::vector<uint64_t> old_hashes;
         std::vector<uint64_t> new_hashes;
         region_id this_old_region;
         region_id this_new_region;
         region_id prev_region;
         region_id next_region;
+        // Set by stage_ack when the subscribers are to hear of this commit
+        // once it is written, with a copy of the value it replaces
+        bool notify;
+        bool notify_has_old_value;
+        std::vector<e::slice> notify_old_value;
+        std::vector<char> notify_backing;
 
     private:
         friend class e::intrusive_ptr<pending>;
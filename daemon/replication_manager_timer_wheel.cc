@@ -0,0 +1,239 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/time.h>
+
+// HyperDex
+#include "daemon/replication_manager_timer_wheel.h"
+
+// Width of one slot in the innermost wheel, in nanoseconds
+#define TIMER_WHEEL_TICK 10000000ULL
+
+using hyperdex::replication_manager;
+
+replication_manager :: timer_wheel :: timer_wheel()
+    : m_mtx()
+    , m_tick(0)
+    , m_size(0)
+    , m_due()
+{
+}
+
+replication_manager :: timer_wheel :: ~timer_wheel() throw ()
+{
+}
+
+bool
+replication_manager :: timer_wheel :: empty()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_size == 0;
+}
+
+bool
+replication_manager :: timer_wheel :: insert(uint64_t when,
+                                             const region_id& ri,
+                                             const e::slice& key,
+                                             uint64_t version)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    // an idle wheel has not turned since its last entry expired; start it
+    // at the present so that neither this entry nor the next expire walks
+    // the idle span
+    if (m_size == 0)
+    {
+        m_tick = std::max<uint64_t>(m_tick, e::time() / TIMER_WHEEL_TICK);
+    }
+
+    slot_t tmp;
+    tmp.push_back(std::make_pair(when / TIMER_WHEEL_TICK, timeout(keypair(ri, key), version)));
+    place(&tmp);
+    ++m_size;
+    return m_size == 1;
+}
+
+void
+replication_manager :: timer_wheel :: expire(uint64_t now,
+                                             std::list<timeout>* expired)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    uint64_t target = now / TIMER_WHEEL_TICK;
+
+    // nothing to walk past
+    if (m_size == 0)
+    {
+        m_tick = std::max(m_tick, target);
+        return;
+    }
+
+    while (m_tick < target)
+    {
+        // skip the ticks at which no slot holds anything
+        uint64_t next = next_event();
+
+        if (next > target)
+        {
+            m_tick = target;
+            break;
+        }
+
+        m_tick = next;
+
+        for (unsigned level = 1; level < LEVELS; ++level)
+        {
+            if ((m_tick & ((1ULL << (level * SLOT_BITS)) - 1)) != 0)
+            {
+                break;
+            }
+
+            cascade(level);
+        }
+
+        slot_t* slot = &m_slots[0][m_tick & (SLOTS - 1)];
+        m_due.splice(m_due.end(), *slot);
+    }
+
+    while (!m_due.empty())
+    {
+        expired->push_back(m_due.front().second);
+        m_due.pop_front();
+        --m_size;
+    }
+}
+
+uint64_t
+replication_manager :: timer_wheel :: next_expiry()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (!m_due.empty())
+    {
+        return m_tick * TIMER_WHEEL_TICK;
+    }
+
+    return next_event() * TIMER_WHEEL_TICK;
+}
+
+void
+replication_manager :: timer_wheel :: clear()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_due.clear();
+
+    for (unsigned level = 0; level < LEVELS; ++level)
+    {
+        for (unsigned slot = 0; slot < SLOTS; ++slot)
+        {
+            m_slots[level][slot].clear();
+        }
+    }
+
+    m_size = 0;
+}
+
+void
+replication_manager :: timer_wheel :: place(slot_t* from)
+{
+    while (!from->empty())
+    {
+        uint64_t tick = from->front().first;
+        slot_t* to = &m_due;
+
+        if (tick > m_tick)
+        {
+            uint64_t delta = tick - m_tick;
+            unsigned level = 0;
+
+            while (level + 1 < LEVELS && delta >= (1ULL << ((level + 1) * SLOT_BITS)))
+            {
+                ++level;
+            }
+
+            // anything beyond the outermost wheel waits in its last slot and
+            // gets placed again as the wheel turns
+            uint64_t horizon = 1ULL << (LEVELS * SLOT_BITS);
+
+            if (delta >= horizon)
+            {
+                tick = m_tick + horizon - 1;
+            }
+
+            to = &m_slots[level][(tick >> (level * SLOT_BITS)) & (SLOTS - 1)];
+        }
+
+        to->splice(to->end(), *from, from->begin());
+    }
+}
+
+uint64_t
+replication_manager :: timer_wheel :: next_event()
+{
+    // a wheel with nothing in it turns a full revolution of the outermost
+    // wheel before anything could happen
+    uint64_t next = m_tick + (1ULL << (LEVELS * SLOT_BITS));
+
+    // The slots of level L are visited at ticks that are multiples of
+    // SLOTS^L:  the innermost ones move to m_due and the outer ones cascade.
+    // Look one revolution ahead at each level for the first slot in use.
+    for (unsigned level = 0; level < LEVELS; ++level)
+    {
+        unsigned shift = level * SLOT_BITS;
+
+        for (uint64_t turn = 1; turn <= SLOTS; ++turn)
+        {
+            uint64_t tick = ((m_tick >> shift) + turn) << shift;
+
+            if (tick >= next)
+            {
+                break;
+            }
+
+            if (!m_slots[level][(tick >> shift) & (SLOTS - 1)].empty())
+            {
+                next = tick;
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+void
+replication_manager :: timer_wheel :: cascade(unsigned level)
+{
+    slot_t* slot = &m_slots[level][(m_tick >> (level * SLOT_BITS)) & (SLOTS - 1)];
+    slot_t tmp;
+    tmp.splice(tmp.end(), *slot);
+    place(&tmp);
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_replication_manager_timer_wheel_h_
+#define hyperdex_daemon_replication_manager_timer_wheel_h_
+
+// STL
+#include <list>
+#include <utility>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// HyperDex
+#include "daemon/replication_manager.h"
+#include "daemon/replication_manager_keypair.h"
+
+// A hierarchical timer wheel of retransmission deadlines.  Each entry names
+// the version of a key that was sent; entries for ops that have since been
+// acked are discarded by the caller when they expire.
+class hyperdex::replication_manager::timer_wheel
+{
+    public:
+        typedef std::pair<keypair, uint64_t> timeout;
+
+    public:
+        timer_wheel();
+        ~timer_wheel() throw ();
+
+    public:
+        bool empty();
+        // Returns true if the wheel was empty before this insert.
+        bool insert(uint64_t when, const region_id& ri,
+                    const e::slice& key, uint64_t version);
+        // Move everything due at or before "now" into "expired".
+        void expire(uint64_t now, std::list<timeout>* expired);
+        // The earliest time at which an entry may be due.  Entries in the
+        // outer wheels count as due when they next cascade inward.
+        uint64_t next_expiry();
+        void clear();
+
+    private:
+        static const unsigned LEVELS = 4;
+        static const unsigned SLOT_BITS = 6;
+        static const unsigned SLOTS = 1U << SLOT_BITS;
+        // (tick at which it is due, timeout)
+        typedef std::list<std::pair<uint64_t, timeout> > slot_t;
+
+    private:
+        // Move the entries of "from" into the slot their tick calls for.
+        void place(slot_t* from);
+        // The first tick after m_tick at which some slot must be visited
+        uint64_t next_event();
+        void cascade(unsigned level);
+
+    private:
+        po6::threads::mutex m_mtx;
+        uint64_t m_tick;
+        size_t m_size;
+        slot_t m_due;
+        slot_t m_slots[LEVELS][SLOTS];
+
+    private:
+        timer_wheel(const timer_wheel&);
+        timer_wheel& operator = (const timer_wheel&);
+};
+
+#endif // hyperdex_daemon_replication_manager_timer_wheel_h_
@@ -27,20 +27,35 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
 // STL
+#include <algorithm>
+#include <map>
 #include <sstream>
+#include <tr1/functional>
+#include <vector>
 
 // Google Log
 #include <glog/logging.h>
 
+// Snappy
+#include <snappy.h>
+
 // e
+#include <e/endian.h>
 #include <e/time.h>
 
 // HyperDex
 #include "common/attribute_check.h"
+#include "common/network_returncode.h"
 #include "common/serialization.h"
 #include "daemon/daemon.h"
 #include "daemon/search_manager.h"
+#include "daemon/search_manager_cache.h"
 #include "datatypes/compare.h"
 
 using hyperdex::search_manager;
@@ -103,6 +118,9 @@ search_manager :: id :: operator == (const id& rhs) const
 
 ///////////////////////////// Search Manager State /////////////////////////////
 
+// Searches whose results exceed this many bytes are not cached
+#define SEARCH_CACHE_MAX_BYTES 1048576
+
 class search_manager::state
 {
     public:
@@ -116,7 +134,16 @@ class search_manager::state
         const region_id region;
         const std::auto_ptr<e::buffer> backing;
         std::vector<attribute_check> checks;
+        // set for the searches chosen for profiling
+        std::auto_ptr<datalayer::profile> profile;
         datalayer::snapshot snap;
+        // results come from here instead of snap when the search hit the cache
+        e::intrusive_ptr<cache::result> cached;
+        size_t cached_idx;
+        // results sent so far, for insertion into the cache once complete
+        e::intrusive_ptr<cache::result> recording;
+        uint64_t epoch;
+        std::string cache_key;
 
     private:
         friend class e::intrusive_ptr<state>;
@@ -136,7 +163,13 @@ search_manager :: state :: state(const region_id& r,
     , region(r)
     , backing(msg)
     , checks()
+    , profile()
     , snap()
+    , cached()
+    , cached_idx(0)
+    , recording()
+    , epoch(0)
+    , cache_key()
     , m_ref(0)
 {
     checks.swap(*c);
@@ -151,6 +184,14 @@ search_manager :: state :: ~state() throw ()
 search_manager :: search_manager(daemon* d)
     : m_daemon(d)
     , m_searches(10)
+    , m_sorted_searches(10)
+    , m_exports(10)
+    , m_cache(new cache())
+    , m_profile_searches(0)
+    , m_searches_started(0)
+    , m_reaper_lock()
+    , m_shutdown(true)
+    , m_reaper(std::tr1::bind(&search_manager::reaper, this))
 {
 }
 
@@ -159,14 +200,25 @@ search_manager :: ~search_manager() throw ()
 }
 
 bool
-search_manager :: setup()
+search_manager :: setup(size_t query_cache, size_t profile_searches)
 {
+    m_cache->set_capacity(query_cache);
+    m_profile_searches = profile_searches;
+    po6::threads::mutex::hold hold(&m_reaper_lock);
+    m_shutdown = false;
+    m_reaper.start();
     return true;
 }
 
 void
 search_manager :: teardown()
 {
+    {
+        po6::threads::mutex::hold hold(&m_reaper_lock);
+        m_shutdown = true;
+    }
+
+    m_reaper.join();
 }
 
 void
@@ -175,6 +227,7 @@ search_manager :: reconfigure(const configuration&,
                               const server_id&)
 {
     // XXX cleanup dead or old searches
+    m_cache->clear();
 }
 
 void
@@ -183,7 +236,9 @@ search_manager :: start(const server_id& from,
                         std::auto_ptr<e::buffer> msg,
                         uint64_t nonce,
                         uint64_t search_id,
-                        std::vector<attribute_check>* checks)
+                        std::vector<attribute_check>* checks,
+                        const e::slice& lower,
+                        const e::slice& upper)
 {
     region_id ri(m_daemon->m_config.get_region_id(to));
     id sid(ri, from, search_id);
@@ -195,26 +250,53 @@ search_manager :: start(const server_id& from,
         return;
     }
 
-    LOG(INFO) << "SEARCH STARTS";
-
     const schema* sc = m_daemon->m_config.get_schema(ri);
     assert(sc);
     e::intrusive_ptr<state> st = new state(ri, msg, checks);
     datalayer::returncode rc;
     std::stable_sort(st->checks.begin(), st->checks.end());
-    uint64_t t_start = e::time();
-    rc = m_daemon->m_data.make_snapshot(st->region, *sc, &st->checks, &st->snap, NULL);
-    uint64_t t_end = e::time();
 
-    LOG(INFO)<< "\t m_data.make_snapshot takes = "<<(t_end - t_start)<<" ns";
+    bool bounded = !lower.empty() || !upper.empty();
+
+    // the epoch must be read before the snapshot is taken.  Searches over
+    // part of a region are not cached, as their results are partial.
+    if (!bounded && m_cache->enabled() && m_daemon->m_data.epoch(ri, &st->epoch))
+    {
+        st->cache_key = cache::make_key("search", st->checks);
+
+        if (m_cache->lookup(ri, st->epoch, st->cache_key, &st->cached))
+        {
+            m_searches.insert(sid, st);
+            next(from, to, nonce, search_id);
+            return;
+        }
+
+        st->recording = new cache::result();
+    }
+
+    if (m_profile_searches > 0 &&
+        __sync_add_and_fetch(&m_searches_started, 1) % m_profile_searches == 0)
+    {
+        st->profile.reset(new datalayer::profile());
+    }
+
+    rc = m_daemon->m_data.make_snapshot(st->region, *sc, &st->checks, lower, upper, &st->snap, st->profile.get());
 
     switch (rc)
     {
         case datalayer::SUCCESS:
             break;
+        case datalayer::BAD_SEARCH:
+        {
+            // end the search for this region, telling the client why
+            uint16_t result = static_cast<uint16_t>(NET_BADSEARCH);
+            std::auto_ptr<e::buffer> done(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t) + sizeof(uint16_t)));
+            done->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << result;
+            m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, done);
+            return;
+        }
         case datalayer::NOT_FOUND:
         case datalayer::BAD_ENCODING:
-        case datalayer::BAD_SEARCH:
         case datalayer::CORRUPTION:
         case datalayer::IO_ERROR:
         case datalayer::LEVELDB_ERROR:
@@ -238,10 +320,6 @@ search_manager :: next(const server_id& from,
     id sid(ri, from, search_id);
     e::intrusive_ptr<state> st;
 
-    LOG(INFO) <<"SEARCH NEXT";
-
-
-    uint64_t t_start = e::time();
     if (!m_searches.lookup(sid, &st))
     {
         std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
@@ -249,21 +327,42 @@ search_manager :: next(const server_id& from,
         m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, msg);
         return;
     }
-    uint64_t t_end = e::time();
-    LOG(INFO) <<"\t m_searches.lookup(sid, &st) takes = "<<(t_end - t_start)<<" ns";
 
-    t_start = e::time();
     po6::threads::mutex::hold hold(&st->lock);
-    t_end = e::time();
-    LOG(INFO) <<"\t threads::mutex hold takes = "<<(t_end - t_start)<<" ns";
+    e::slice key;
+    std::vector<e::slice> val;
+    bool found = false;
 
-    t_start = e::time();
-    if (st->snap.valid())
+    if (st->cached.get())
+    {
+        if (st->cached_idx < st->cached->size())
+        {
+            key = st->cached->key(st->cached_idx);
+            val = st->cached->value(st->cached_idx);
+            ++st->cached_idx;
+            found = true;
+        }
+    }
+    else if (st->snap.valid())
     {
-        e::slice key;
-        std::vector<e::slice> val;
         uint64_t ver;
         st->snap.unpack(&key, &val, &ver);
+        found = true;
+
+        if (st->recording.get())
+        {
+            st->recording->append(key, val);
+
+            // too big to be worth keeping
+            if (st->recording->bytes() > SEARCH_CACHE_MAX_BYTES)
+            {
+                st->recording = e::intrusive_ptr<cache::result>();
+            }
+        }
+    }
+
+    if (found)
+    {
         size_t sz = HYPERDEX_HEADER_SIZE_VC
                   + sizeof(uint64_t)
                   + pack_size(key)
@@ -271,17 +370,31 @@ search_manager :: next(const server_id& from,
         std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
         msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << key << val;
         m_daemon->m_comm.send_client(to, from, RESP_SEARCH_ITEM, msg);
-        st->snap.next();
+
+        if (!st->cached.get())
+        {
+            st->snap.next();
+        }
     }
     else
     {
+        if (st->recording.get())
+        {
+            m_cache->insert(st->region, st->epoch, st->cache_key, st->recording);
+            st->recording = e::intrusive_ptr<cache::result>();
+        }
+
+        if (st->profile.get())
+        {
+            LOG(INFO) << "search " << search_id << " from " << from
+                      << " on " << st->region << ":\n" << *st->profile;
+        }
+
         std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
         msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
         m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, msg);
         stop(from, to, search_id);
     }
-    t_end = e::time();
-    LOG(INFO) <<"\t st->snap.valid() takes = "<<(t_end - t_start)<<" ns";
 }
 
 void
@@ -417,21 +530,109 @@ operator > (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
 
 } // namespace hyperdex
 
+/////////////////////////// Search Manager Sorted State ///////////////////////////
+
+// Soft limit on the size of one batch of sorted results
+#define SORTED_SEARCH_BATCH_BYTES 65536
+
+class search_manager::sorted_state
+{
+    public:
+        sorted_state(const schema* sc, uint16_t sort_by, bool maximize);
+        ~sorted_state() throw ();
+
+    public:
+        po6::threads::mutex lock;
+        _sorted_search_params params;
+        std::vector<_sorted_search_item> results;
+        size_t sent;
+        // backs the results when they came from the cache
+        e::intrusive_ptr<cache::result> cached;
+
+    private:
+        friend class e::intrusive_ptr<sorted_state>;
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+search_manager :: sorted_state :: sorted_state(const schema* sc,
+                                               uint16_t sort_by,
+                                               bool maximize)
+    : lock()
+    , params(sc, sort_by, maximize)
+    , results()
+    , sent(0)
+    , cached()
+    , m_ref(0)
+{
+}
+
+search_manager :: sorted_state :: ~sorted_state() throw ()
+{
+}
+
 void
 search_manager :: sorted_search(const server_id& from,
                                 const virtual_server_id& to,
                                 uint64_t nonce,
+                                uint64_t search_id,
                                 std::vector<attribute_check>* checks,
                                 uint64_t limit,
                                 uint16_t sort_by,
                                 bool maximize)
 {
     region_id ri(m_daemon->m_config.get_region_id(to));
+    id sid(ri, from, search_id);
+
+    if (m_sorted_searches.contains(sid))
+    {
+        LOG(WARNING) << "received request for sorted search " << search_id << " from client "
+                     << from << " but the search is already in progress";
+        return;
+    }
+
     const schema* sc = m_daemon->m_config.get_schema(ri);
     assert(sc);
+    e::intrusive_ptr<sorted_state> st = new sorted_state(sc, sort_by, maximize);
+    std::vector<_sorted_search_item>& top_n(st->results);
+    std::stable_sort(checks->begin(), checks->end());
+    uint64_t epoch = 0;
+    std::string cache_key;
+    bool cacheable = m_cache->enabled() && m_daemon->m_data.epoch(ri, &epoch);
+
+    if (cacheable)
+    {
+        std::ostringstream prefix;
+        prefix << "sorted " << limit << " " << sort_by << " " << maximize << " ";
+        cache_key = cache::make_key(prefix.str(), *checks);
+
+        if (m_cache->lookup(ri, epoch, cache_key, &st->cached))
+        {
+            for (size_t i = 0; i < st->cached->size(); ++i)
+            {
+                top_n.push_back(_sorted_search_item(&st->params));
+                top_n.back().key = st->cached->key(i);
+                top_n.back().value = st->cached->value(i);
+            }
+
+            po6::threads::mutex::hold hold(&st->lock);
+
+            if (send_sorted_batch(from, to, nonce, st.get()))
+            {
+                m_sorted_searches.insert(sid, st);
+            }
+
+            return;
+        }
+    }
+
     datalayer::snapshot snap;
     datalayer::returncode rc;
-    std::stable_sort(checks->begin(), checks->end());
     rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, NULL);
 
     switch (rc)
@@ -445,18 +646,17 @@ search_manager :: sorted_search(const server_id& from,
         case datalayer::IO_ERROR:
         case datalayer::LEVELDB_ERROR:
             LOG(ERROR) << "could not make snapshot for search:  " << rc;
+            cacheable = false;
             break;
         default:
             abort();
     }
 
-    _sorted_search_params params(sc, sort_by, maximize);
-    std::vector<_sorted_search_item> top_n;
     top_n.reserve(limit);
 
     while (snap.valid())
     {
-        top_n.push_back(_sorted_search_item(&params));
+        top_n.push_back(_sorted_search_item(&st->params));
         snap.unpack(&top_n.back().key, &top_n.back().value, &top_n.back().version, &top_n.back().ref);
         std::push_heap(top_n.begin(), top_n.end());
 
@@ -470,32 +670,252 @@ search_manager :: sorted_search(const server_id& from,
     }
 
     std::sort(top_n.begin(), top_n.end(), std::greater<_sorted_search_item>());
-    size_t sz = HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t) + sizeof(uint64_t);
 
-    for (size_t i = 0; i < top_n.size(); ++i)
+    if (cacheable)
     {
-        sz += pack_size(top_n[i].key) + pack_size(top_n[i].value);
+        e::intrusive_ptr<cache::result> cr = new cache::result();
+
+        for (size_t i = 0; i < top_n.size(); ++i)
+        {
+            cr->append(top_n[i].key, top_n[i].value);
+        }
+
+        if (cr->bytes() <= SEARCH_CACHE_MAX_BYTES)
+        {
+            m_cache->insert(ri, epoch, cache_key, cr);
+        }
     }
 
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
-    pa = pa << nonce << static_cast<uint64_t>(top_n.size());
+    po6::threads::mutex::hold hold(&st->lock);
 
-    for (size_t i = 0; i < top_n.size(); ++i)
+    if (send_sorted_batch(from, to, nonce, st.get()))
     {
-        pa = pa << top_n[i].key << top_n[i].value;
+        m_sorted_searches.insert(sid, st);
     }
+}
 
-    m_daemon->m_comm.send_client(to, from, RESP_SORTED_SEARCH, msg);
+void
+search_manager :: sorted_search_next(const server_id& from,
+                                     const virtual_server_id& to,
+                                     uint64_t nonce,
+                                     uint64_t search_id)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    id sid(ri, from, search_id);
+    e::intrusive_ptr<sorted_state> st;
+
+    if (!m_sorted_searches.lookup(sid, &st))
+    {
+        // an empty, final batch
+        sorted_state empty(NULL, 0, false);
+        send_sorted_batch(from, to, nonce, &empty);
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&st->lock);
+
+    if (!send_sorted_batch(from, to, nonce, st.get()))
+    {
+        m_sorted_searches.remove(sid);
+    }
 }
 
+void
+search_manager :: sorted_search_stop(const server_id& from,
+                                     const virtual_server_id& to,
+                                     uint64_t search_id)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    id sid(ri, from, search_id);
+    m_sorted_searches.remove(sid);
+}
+
+/////////////////////////// Search Manager Export State ///////////////////////////
+
+// Soft limit on the uncompressed size of one batch of an export
+#define EXPORT_BATCH_BYTES 4194304
+// An export nobody has asked for in this many nanoseconds is dropped so that
+// it stops pinning its LevelDB snapshot; the reaper checks this often.
+#define EXPORT_IDLE_TIMEOUT (60 * 1000000000ULL)
+#define EXPORT_REAP_INTERVAL 1000000000ULL
+// RESP_EXPORT_BATCH flags
+#define EXPORT_MORE 1
+#define EXPORT_ERROR 2
+
+class search_manager::export_state
+{
+    public:
+        export_state(const region_id& region);
+        ~export_state() throw ();
+
+    public:
+        po6::threads::mutex lock;
+        const region_id region;
+        datalayer::region_iterator iter;
+        // when the client last asked for a batch; protected by lock
+        uint64_t last_used;
+
+    private:
+        friend class e::intrusive_ptr<export_state>;
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+search_manager :: export_state :: export_state(const region_id& r)
+    : lock()
+    , region(r)
+    , iter()
+    , last_used(e::time())
+    , m_ref(0)
+{
+}
+
+search_manager :: export_state :: ~export_state() throw ()
+{
+}
+
+void
+search_manager :: export_start(const server_id& from,
+                               const virtual_server_id& to,
+                               uint64_t nonce,
+                               uint64_t export_id)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    id sid(ri, from, export_id);
+
+    if (m_exports.contains(sid))
+    {
+        LOG(WARNING) << "received request for export " << export_id << " from client "
+                     << from << " but the export is already in progress";
+        return;
+    }
+
+    e::intrusive_ptr<export_state> st = new export_state(ri);
+    leveldb_snapshot_ptr snap = m_daemon->m_data.make_raw_snapshot();
+    m_daemon->m_data.make_region_iterator(&st->iter, snap, ri);
+    po6::threads::mutex::hold hold(&st->lock);
+
+    if (send_export_batch(from, to, nonce, st.get()))
+    {
+        m_exports.insert(sid, st);
+    }
+}
+
+void
+search_manager :: export_next(const server_id& from,
+                              const virtual_server_id& to,
+                              uint64_t nonce,
+                              uint64_t export_id)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    id sid(ri, from, export_id);
+    e::intrusive_ptr<export_state> st;
+
+    if (!m_exports.lookup(sid, &st))
+    {
+        // The export expired or never existed.  Ending it with an empty batch
+        // would pass off a truncated export as complete.
+        LOG(WARNING) << "received request for export " << export_id << " from client "
+                     << from << " but the export is not in progress";
+        std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC
+                                                       + sizeof(uint64_t)
+                                                       + sizeof(uint8_t)
+                                                       + sizeof(uint32_t)));
+        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << uint8_t(EXPORT_ERROR) << e::slice();
+        m_daemon->m_comm.send_client(to, from, RESP_EXPORT_BATCH, msg);
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&st->lock);
+    st->last_used = e::time();
+
+    if (!send_export_batch(from, to, nonce, st.get()))
+    {
+        m_exports.remove(sid);
+    }
+}
+
+void
+search_manager :: reaper()
+{
+    LOG(INFO) << "export reaper thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        {
+            po6::threads::mutex::hold hold(&m_reaper_lock);
+
+            if (m_shutdown)
+            {
+                break;
+            }
+        }
+
+        timespec ts;
+        ts.tv_sec = EXPORT_REAP_INTERVAL / 1000000000ULL;
+        ts.tv_nsec = EXPORT_REAP_INTERVAL % 1000000000ULL;
+        nanosleep(&ts, NULL);
+        expire_exports(e::time());
+    }
+
+    LOG(INFO) << "export reaper thread shutting down";
+}
+
+void
+search_manager :: expire_exports(uint64_t now)
+{
+    std::vector<id> expired;
+
+    for (e::lockfree_hash_map<id, e::intrusive_ptr<export_state>, hash>::iterator it = m_exports.begin();
+            it != m_exports.end(); it.next())
+    {
+        e::intrusive_ptr<export_state> st = it.value();
+        po6::threads::mutex::hold hold(&st->lock);
+
+        if (st->last_used + EXPORT_IDLE_TIMEOUT < now)
+        {
+            expired.push_back(it.key());
+        }
+    }
+
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+        LOG(INFO) << "dropping export " << expired[i].search_id << " from client "
+                  << expired[i].client << " after it sat idle";
+        m_exports.remove(expired[i]);
+    }
+}
+
+// Keys for one point leader travel together in a REQ_ATOMIC_BATCH of at most
+// this many keys or bytes
+#define GROUP_KEYOP_BATCH_KEYS 1024
+#define GROUP_KEYOP_BATCH_BYTES 1048576
+
 void
 search_manager :: group_keyop(const server_id& from,
                               const virtual_server_id& to,
                               uint64_t nonce,
                               std::vector<attribute_check>* checks,
-                              network_msgtype mt,
-                              const e::slice& remain,
+                              uint8_t flags,
+                              const std::vector<funcall>& funcs,
                               network_msgtype resp)
 {
     region_id ri(m_daemon->m_config.get_region_id(to));
@@ -504,6 +924,7 @@ search_manager :: group_keyop(const server_id& from,
     datalayer::snapshot snap;
     datalayer::returncode rc;
     std::stable_sort(checks->begin(), checks->end());
+    snap.set_keys_only();
     rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, NULL);
     uint64_t result = 0;
 
@@ -524,25 +945,30 @@ search_manager :: group_keyop(const server_id& from,
             abort();
     }
 
+    // pending keys and their total size, by point leader
+    typedef std::map<virtual_server_id, std::pair<std::vector<std::string>, size_t> > batch_map_t;
+    batch_map_t batches;
+
     while (snap.valid() && result < UINT64_MAX)
     {
         e::slice key;
         std::vector<e::slice> val;
         uint64_t ver;
         snap.unpack(&key, &val, &ver);
-        size_t sz = HYPERDEX_HEADER_SIZE_SV // SV because we imitate a client
-                  + sizeof(uint64_t)
-                  + pack_size(key)
-                  + remain.size();
-        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-        e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_SV);
-        pa = pa << static_cast<uint64_t>(0) << key;
-        pa = pa.copy(remain);
         virtual_server_id vsi = m_daemon->m_config.point_leader(ri, key);
 
         if (vsi != virtual_server_id())
         {
-            m_daemon->m_comm.send(vsi, mt, msg);
+            std::pair<std::vector<std::string>, size_t>& batch(batches[vsi]);
+            batch.first.push_back(std::string(reinterpret_cast<const char*>(key.data()), key.size()));
+            batch.second += key.size();
+
+            if (batch.first.size() >= GROUP_KEYOP_BATCH_KEYS ||
+                batch.second >= GROUP_KEYOP_BATCH_BYTES)
+            {
+                send_group_keyop(vsi, flags, *checks, funcs, &batch.first);
+                batch.second = 0;
+            }
         }
         else
         {
@@ -552,6 +978,14 @@ search_manager :: group_keyop(const server_id& from,
         snap.next();
     }
 
+    for (batch_map_t::iterator it = batches.begin(); it != batches.end(); ++it)
+    {
+        if (!it->second.first.empty())
+        {
+            send_group_keyop(it->first, flags, *checks, funcs, &it->second.first);
+        }
+    }
+
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint64_t);
@@ -560,6 +994,36 @@ search_manager :: group_keyop(const server_id& from,
     m_daemon->m_comm.send_client(to, from, resp, msg);
 }
 
+void
+search_manager :: send_group_keyop(const virtual_server_id& vsi,
+                                   uint8_t flags,
+                                   const std::vector<attribute_check>& checks,
+                                   const std::vector<funcall>& funcs,
+                                   std::vector<std::string>* keys)
+{
+    std::vector<e::slice> ks;
+    ks.reserve(keys->size());
+
+    for (size_t i = 0; i < keys->size(); ++i)
+    {
+        ks.push_back(e::slice((*keys)[i].data(), (*keys)[i].size()));
+    }
+
+    // The point leader re-checks the search's predicate atomically with the
+    // update, so objects which changed since the snapshot are left alone.
+    size_t sz = HYPERDEX_HEADER_SIZE_SV // SV because we imitate a client
+              + sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + pack_size(checks)
+              + pack_size(funcs)
+              + pack_size(ks);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_SV) << static_cast<uint64_t>(0) << flags
+                                          << checks << funcs << ks;
+    m_daemon->m_comm.send(vsi, REQ_ATOMIC_BATCH, msg);
+    keys->clear();
+}
+
 void
 search_manager :: count(const server_id& from,
                         const virtual_server_id& to,
@@ -572,6 +1036,28 @@ search_manager :: count(const server_id& from,
     datalayer::snapshot snap;
     datalayer::returncode rc;
     std::stable_sort(checks->begin(), checks->end());
+    uint64_t epoch = 0;
+    std::string cache_key;
+    e::intrusive_ptr<cache::result> cr;
+    bool cacheable = m_cache->enabled() && m_daemon->m_data.epoch(ri, &epoch);
+
+    if (cacheable)
+    {
+        cache_key = cache::make_key("count", *checks);
+
+        if (m_cache->lookup(ri, epoch, cache_key, &cr))
+        {
+            size_t sz = HYPERDEX_HEADER_SIZE_VC
+                      + sizeof(uint64_t)
+                      + sizeof(uint64_t);
+            std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+            msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << cr->count;
+            m_daemon->m_comm.send_client(to, from, RESP_COUNT, msg);
+            return;
+        }
+    }
+
+    snap.set_keys_only();
     rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, NULL);
     uint64_t result = 0;
 
@@ -598,6 +1084,13 @@ search_manager :: count(const server_id& from,
         snap.next();
     }
 
+    if (cacheable && result < UINT64_MAX)
+    {
+        cr = new cache::result();
+        cr->count = result;
+        m_cache->insert(ri, epoch, cache_key, cr);
+    }
+
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint64_t);
@@ -606,6 +1099,185 @@ search_manager :: count(const server_id& from,
     m_daemon->m_comm.send_client(to, from, RESP_COUNT, msg);
 }
 
+// Candidates examined before count_approx extrapolates
+#define COUNT_APPROX_BUDGET 4096
+
+void
+search_manager :: count_approx(const server_id& from,
+                               const virtual_server_id& to,
+                               uint64_t nonce,
+                               std::vector<attribute_check>* checks)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+    assert(sc);
+    datalayer::snapshot snap;
+    datalayer::returncode rc;
+    std::stable_sort(checks->begin(), checks->end());
+    snap.set_keys_only();
+    rc = m_daemon->m_data.make_snapshot(ri, *sc, checks, &snap, NULL);
+    uint64_t estimate = 0;
+    uint64_t variance = 0;
+    bool error = false;
+
+    switch (rc)
+    {
+        case datalayer::SUCCESS:
+            break;
+        case datalayer::NOT_FOUND:
+        case datalayer::BAD_ENCODING:
+        case datalayer::BAD_SEARCH:
+        case datalayer::CORRUPTION:
+        case datalayer::IO_ERROR:
+        case datalayer::LEVELDB_ERROR:
+            LOG(ERROR) << "could not make snapshot for search:  " << rc;
+            error = true;
+            break;
+        default:
+            abort();
+    }
+
+    uint64_t matched = 0;
+    snap.set_budget(COUNT_APPROX_BUDGET);
+
+    while (!error)
+    {
+        while (snap.valid())
+        {
+            ++matched;
+            snap.next();
+        }
+
+        double frac = 0;
+
+        if (!snap.over_budget())
+        {
+            // we saw every candidate, so the count is exact
+            estimate = matched;
+            break;
+        }
+        else if (snap.progress(&frac) && frac > 0)
+        {
+            // Candidates are visited in key order, so this assumes that
+            // matches are spread evenly across the scanned ranges.  The
+            // variance is that of the selectivity observed so far.
+            double candidates = snap.num_gets() / std::min(frac, 1.0);
+            double p = static_cast<double>(matched) / snap.num_gets();
+            estimate = static_cast<uint64_t>(p * candidates + 0.5);
+            variance = static_cast<uint64_t>(candidates * candidates * p * (1 - p) / snap.num_gets() + 0.5);
+            break;
+        }
+
+        // LevelDB cannot tell us how far along we are yet; keep going
+        snap.set_budget(snap.budget() + COUNT_APPROX_BUDGET);
+    }
+
+    if (error)
+    {
+        estimate = UINT64_MAX;
+        variance = 0;
+    }
+
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << estimate << variance;
+    m_daemon->m_comm.send_client(to, from, RESP_COUNT_APPROX, msg);
+}
+
+void
+search_manager :: sample(const server_id& from,
+                         const virtual_server_id& to,
+                         uint64_t nonce,
+                         std::vector<attribute_check>* checks,
+                         uint64_t n)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+    assert(sc);
+    datalayer::snapshot snap;
+    datalayer::returncode rc;
+    std::stable_sort(checks->begin(), checks->end());
+    rc = m_daemon->m_data.make_snapshot(ri, *sc, checks, &snap, NULL);
+
+    switch (rc)
+    {
+        case datalayer::SUCCESS:
+            break;
+        case datalayer::NOT_FOUND:
+        case datalayer::BAD_ENCODING:
+        case datalayer::BAD_SEARCH:
+        case datalayer::CORRUPTION:
+        case datalayer::IO_ERROR:
+        case datalayer::LEVELDB_ERROR:
+            LOG(ERROR) << "could not make snapshot for search:  " << rc;
+            break;
+        default:
+            abort();
+    }
+
+    drand48_data rng;
+    srand48_r(e::time() ^ nonce, &rng);
+    std::vector<_sorted_search_item> reservoir;
+    uint64_t seen = 0;
+
+    // Algorithm R:  the i'th match replaces a random slot with probability n/i
+    while (n > 0 && snap.valid())
+    {
+        size_t slot = reservoir.size();
+
+        if (seen < n)
+        {
+            reservoir.push_back(_sorted_search_item(NULL));
+        }
+        else
+        {
+            double r;
+            drand48_r(&rng, &r);
+            slot = r * (seen + 1);
+        }
+
+        if (slot < reservoir.size())
+        {
+            _sorted_search_item& it(reservoir[slot]);
+            snap.unpack(&it.key, &it.value, &it.version, &it.ref);
+        }
+
+        ++seen;
+        snap.next();
+    }
+
+    // the client seeds its merge of the regions' samples with this
+    long int seed_hi;
+    long int seed_lo;
+    lrand48_r(&rng, &seed_hi);
+    lrand48_r(&rng, &seed_lo);
+    uint64_t seed = (static_cast<uint64_t>(seed_hi) << 32) | static_cast<uint64_t>(seed_lo);
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + sizeof(uint64_t);
+
+    for (size_t i = 0; i < reservoir.size(); ++i)
+    {
+        sz += pack_size(reservoir[i].key) + pack_size(reservoir[i].value);
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << seen << seed << static_cast<uint64_t>(reservoir.size());
+
+    for (size_t i = 0; i < reservoir.size(); ++i)
+    {
+        pa = pa << reservoir[i].key << reservoir[i].value;
+    }
+
+    m_daemon->m_comm.send_client(to, from, RESP_SAMPLE, msg);
+}
+
 void
 search_manager :: search_describe(const server_id& from,
                                   const virtual_server_id& to,
@@ -618,12 +1290,10 @@ search_manager :: search_describe(const server_id& from,
     datalayer::snapshot snap;
     datalayer::returncode rc;
     std::stable_sort(checks->begin(), checks->end());
+    datalayer::profile prof;
+    rc = m_daemon->m_data.make_snapshot(ri, *sc, checks, &snap, &prof);
     std::ostringstream ostr;
-    ostr << "search\n";
-    uint64_t t_start = e::time();
-    rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, &ostr);
-    uint64_t t_end = e::time();
-    ostr << " snapshot took " << t_end - t_start << "ns\n";
+    ostr << "region " << ri << "\n";
 
     switch (rc)
     {
@@ -636,22 +1306,24 @@ search_manager :: search_describe(const server_id& from,
         case datalayer::IO_ERROR:
         case datalayer::LEVELDB_ERROR:
             LOG(ERROR) << "could not make snapshot for search:  " << rc;
+            ostr << "error " << rc << "\n";
             break;
         default:
             abort();
     }
 
-    uint64_t num = 0;
-    t_start = e::time();
-
-    while (snap.valid())
+    // Execute the search so the profile reflects what it actually costs,
+    // just as it would for a real search.
+    if (rc == datalayer::SUCCESS)
     {
-        ++num;
-        snap.next();
+        while (snap.valid())
+        {
+            snap.next();
+        }
+
+        ostr << prof;
     }
 
-    t_end = e::time();
-    ostr << " retrieved " << num << " objects in " << t_end - t_start << "ns\n";
     std::string str(ostr.str());
     const char* text = str.c_str();
     size_t text_sz = strlen(text);
@@ -664,8 +1336,141 @@ search_manager :: search_describe(const server_id& from,
     m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DESCRIBE, msg);
 }
 
+// splitting finer than this just makes many tiny searches
+#define SEARCH_SPLITS_MAX 256
+
+void
+search_manager :: search_splits(const server_id& from,
+                                const virtual_server_id& to,
+                                uint64_t nonce,
+                                uint64_t n)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    std::vector<std::string> splits;
+    m_daemon->m_data.split_points(ri, std::min(n, uint64_t(SEARCH_SPLITS_MAX)), &splits);
+    std::vector<e::slice> slices;
+
+    for (size_t i = 0; i < splits.size(); ++i)
+    {
+        slices.push_back(e::slice(splits[i].data(), splits[i].size()));
+    }
+
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + pack_size(slices);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << ri.get() << slices;
+    m_daemon->m_comm.send_client(to, from, RESP_SEARCH_SPLITS, msg);
+}
+
 uint64_t
 search_manager :: hash(const id& sid)
 {
     return sid.region.get() + sid.client.get() + sid.search_id;
 }
+
+// A batch is a single frame of the export format:  the region, the number of
+// objects, the uncompressed and compressed sizes, and the objects compressed
+// with snappy.  Each object is its key and its value as the datalayer stores
+// it, each prefixed by a 32-bit length.
+bool
+search_manager :: send_export_batch(const server_id& from,
+                                    const virtual_server_id& to,
+                                    uint64_t nonce,
+                                    export_state* st)
+{
+    std::string raw;
+    uint64_t count = 0;
+
+    // always make progress, even if a single object exceeds the batch size
+    while (st->iter.valid())
+    {
+        e::slice key;
+        e::slice val;
+        st->iter.raw(&key, &val);
+        size_t item_sz = 2 * sizeof(uint32_t) + key.size() + val.size();
+
+        if (count > 0 && raw.size() + item_sz > EXPORT_BATCH_BYTES)
+        {
+            break;
+        }
+
+        char buf[sizeof(uint32_t)];
+        e::pack32be(key.size(), buf);
+        raw.append(buf, sizeof(buf));
+        raw.append(reinterpret_cast<const char*>(key.data()), key.size());
+        e::pack32be(val.size(), buf);
+        raw.append(buf, sizeof(buf));
+        raw.append(reinterpret_cast<const char*>(val.data()), val.size());
+        ++count;
+        st->iter.next();
+    }
+
+    bool more = st->iter.valid();
+    uint8_t flags = more ? EXPORT_MORE : 0;
+    std::string compressed;
+    snappy::Compress(raw.data(), raw.size(), &compressed);
+    size_t frame_sz = 2 * sizeof(uint64_t)
+                    + 2 * sizeof(uint32_t)
+                    + compressed.size();
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + sizeof(uint32_t)
+              + frame_sz;
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << flags << static_cast<uint32_t>(frame_sz)
+            << st->region.get() << count
+            << static_cast<uint32_t>(raw.size())
+            << static_cast<uint32_t>(compressed.size());
+    pa.copy(e::slice(compressed.data(), compressed.size()));
+    m_daemon->m_comm.send_client(to, from, RESP_EXPORT_BATCH, msg);
+    return more;
+}
+
+bool
+search_manager :: send_sorted_batch(const server_id& from,
+                                    const virtual_server_id& to,
+                                    uint64_t nonce,
+                                    sorted_state* st)
+{
+    size_t start = st->sent;
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + sizeof(uint64_t);
+
+    // always make progress, even if a single object exceeds the batch size
+    while (st->sent < st->results.size())
+    {
+        size_t item_sz = pack_size(st->results[st->sent].key)
+                       + pack_size(st->results[st->sent].value);
+
+        if (st->sent > start && sz + item_sz > SORTED_SEARCH_BATCH_BYTES)
+        {
+            break;
+        }
+
+        sz += item_sz;
+        ++st->sent;
+    }
+
+    bool more = st->sent < st->results.size();
+    uint8_t flags = more ? 1 : 0;
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << flags << static_cast<uint64_t>(st->sent - start);
+
+    for (size_t i = start; i < st->sent; ++i)
+    {
+        pa = pa << st->results[i].key << st->results[i].value;
+        // release the backing for objects the client now has
+        datalayer::reference empty;
+        st->results[i].ref.swap(&empty);
+    }
+
+    m_daemon->m_comm.send_client(to, from, RESP_SORTED_SEARCH, msg);
+    return more;
+}
@@ -28,11 +28,20 @@
 #ifndef hyperdex_daemon_search_manager_h_
 #define hyperdex_daemon_search_manager_h_
 
+// STL
+#include <memory>
+#include <string>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
 // e
 #include <e/intrusive_ptr.h>
 #include <e/lockfree_hash_map.h>
 
 // HyperDex
+#include "common/funcall.h"
 #include "common/ids.h"
 #include "common/network_msgtype.h"
 #include "daemon/datalayer.h"
@@ -50,7 +59,10 @@ class search_manager
         ~search_manager() throw ();
 
     public:
-        bool setup();
+        // query_cache is the number of search results cached per region;
+        // zero disables the cache.  One in every profile_searches searches
+        // logs its plan and cost; zero disables profiling.
+        bool setup(size_t query_cache, size_t profile_searches);
         void teardown();
         void reconfigure(const configuration& old_config,
                          const configuration& new_config,
@@ -62,7 +74,9 @@ class search_manager
                    std::auto_ptr<e::buffer> msg,
                    uint64_t nonce,
                    uint64_t search_id,
-                   std::vector<attribute_check>* checks);
+                   std::vector<attribute_check>* checks,
+                   const e::slice& lower,
+                   const e::slice& upper);
         void next(const server_id& from,
                   const virtual_server_id& to,
                   uint64_t nonce,
@@ -70,32 +84,77 @@ class search_manager
         void stop(const server_id& from,
                   const virtual_server_id& to,
                   uint64_t search_id);
+        // sorted searches compute the region's top "limit" objects up front
+        // and stream them to the client in ordered batches
         void sorted_search(const server_id& from,
                            const virtual_server_id& to,
                            uint64_t nonce,
+                           uint64_t search_id,
                            std::vector<attribute_check>* checks,
                            uint64_t limit,
                            uint16_t sort_by,
                            bool maximize);
+        void sorted_search_next(const server_id& from,
+                                const virtual_server_id& to,
+                                uint64_t nonce,
+                                uint64_t search_id);
+        void sorted_search_stop(const server_id& from,
+                                const virtual_server_id& to,
+                                uint64_t search_id);
+        // apply "funcs" to every object matching "checks", sending keys to
+        // their point leaders in batches
         void group_keyop(const server_id& from,
                          const virtual_server_id& to,
                          uint64_t nonce,
                          std::vector<attribute_check>* checks,
-                         network_msgtype mt,
-                         const e::slice& remain,
+                         uint8_t flags,
+                         const std::vector<funcall>& funcs,
                          network_msgtype resp);
         void count(const server_id& from,
                    const virtual_server_id& to,
                    uint64_t nonce,
                    std::vector<attribute_check>* checks);
+        // estimate the count by examining a bounded number of candidates and
+        // extrapolating with LevelDB's approximate sizes
+        void count_approx(const server_id& from,
+                          const virtual_server_id& to,
+                          uint64_t nonce,
+                          std::vector<attribute_check>* checks);
+        // reservoir sample of up to n matching objects
+        void sample(const server_id& from,
+                    const virtual_server_id& to,
+                    uint64_t nonce,
+                    std::vector<attribute_check>* checks,
+                    uint64_t n);
         void search_describe(const server_id& from,
                              const virtual_server_id& to,
                              uint64_t nonce,
                              std::vector<attribute_check>* checks);
+        // keys that divide the region into up to n ranges of roughly equal
+        // size, for searching the ranges in parallel
+        void search_splits(const server_id& from,
+                           const virtual_server_id& to,
+                           uint64_t nonce,
+                           uint64_t n);
+        // exports stream every object in the region, as stored, in large
+        // compressed batches; the client asks for each batch in turn.  An
+        // export the client stops asking for is dropped after a while, and
+        // asking for it afterward gets a batch flagged as an error.
+        void export_start(const server_id& from,
+                          const virtual_server_id& to,
+                          uint64_t nonce,
+                          uint64_t export_id);
+        void export_next(const server_id& from,
+                         const virtual_server_id& to,
+                         uint64_t nonce,
+                         uint64_t export_id);
 
     private:
+        class cache;
+        class export_state;
         class id;
         class state;
+        class sorted_state;
 
     private:
         search_manager(const search_manager&);
@@ -103,10 +162,37 @@ class search_manager
 
     private:
         static uint64_t hash(const id&);
+        // send the next batch; returns true if more batches remain
+        bool send_sorted_batch(const server_id& from,
+                               const virtual_server_id& to,
+                               uint64_t nonce,
+                               sorted_state* st);
+        // send the next batch; returns true if more batches remain
+        bool send_export_batch(const server_id& from,
+                               const virtual_server_id& to,
+                               uint64_t nonce,
+                               export_state* st);
+        // drop exports that have sat idle, releasing their snapshots
+        void reaper();
+        void expire_exports(uint64_t now);
+        // send one REQ_ATOMIC_BATCH and clear "keys"
+        void send_group_keyop(const virtual_server_id& vsi,
+                              uint8_t flags,
+                              const std::vector<attribute_check>& checks,
+                              const std::vector<funcall>& funcs,
+                              std::vector<std::string>* keys);
 
     private:
         daemon* m_daemon;
         e::lockfree_hash_map<id, e::intrusive_ptr<state>, hash> m_searches;
+        e::lockfree_hash_map<id, e::intrusive_ptr<sorted_state>, hash> m_sorted_searches;
+        e::lockfree_hash_map<id, e::intrusive_ptr<export_state>, hash> m_exports;
+        const std::auto_ptr<cache> m_cache;
+        size_t m_profile_searches;
+        uint64_t m_searches_started;
+        po6::threads::mutex m_reaper_lock;
+        bool m_shutdown;
+        po6::threads::thread m_reaper;
 };
 
 } // namespace hyperdex
@@ -0,0 +1,252 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "daemon/search_manager_cache.h"
+
+using hyperdex::search_manager;
+
+class search_manager::cache::entry
+{
+    public:
+        entry(uint64_t epoch, const std::string& key, e::intrusive_ptr<result> r);
+        ~entry() throw ();
+
+    public:
+        uint64_t epoch;
+        std::string key;
+        e::intrusive_ptr<result> res;
+};
+
+search_manager :: cache :: entry :: entry(uint64_t e,
+                                          const std::string& k,
+                                          e::intrusive_ptr<result> r)
+    : epoch(e)
+    , key(k)
+    , res(r)
+{
+}
+
+search_manager :: cache :: entry :: ~entry() throw ()
+{
+}
+
+static bool
+compare_checks(const hyperdex::attribute_check* lhs,
+               const hyperdex::attribute_check* rhs)
+{
+    if (lhs->attr != rhs->attr)
+    {
+        return lhs->attr < rhs->attr;
+    }
+
+    if (lhs->predicate != rhs->predicate)
+    {
+        return lhs->predicate < rhs->predicate;
+    }
+
+    if (lhs->datatype != rhs->datatype)
+    {
+        return lhs->datatype < rhs->datatype;
+    }
+
+    return std::lexicographical_compare(lhs->value.data(), lhs->value.data() + lhs->value.size(),
+                                        rhs->value.data(), rhs->value.data() + rhs->value.size());
+}
+
+search_manager :: cache :: cache()
+    : m_lock()
+    , m_capacity(0)
+    , m_regions()
+{
+}
+
+search_manager :: cache :: ~cache() throw ()
+{
+}
+
+void
+search_manager :: cache :: set_capacity(size_t capacity)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    m_capacity = capacity;
+    m_regions.clear();
+}
+
+std::string
+search_manager :: cache :: make_key(const std::string& prefix,
+                                    const std::vector<attribute_check>& checks)
+{
+    std::vector<const attribute_check*> sorted;
+
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        sorted.push_back(&checks[i]);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), compare_checks);
+    std::string key(prefix);
+
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        char buf[sizeof(uint16_t) * 3 + sizeof(uint32_t)];
+        char* ptr = buf;
+        ptr = e::pack16be(sorted[i]->attr, ptr);
+        ptr = e::pack16be(static_cast<uint16_t>(sorted[i]->predicate), ptr);
+        ptr = e::pack16be(static_cast<uint16_t>(sorted[i]->datatype), ptr);
+        ptr = e::pack32be(sorted[i]->value.size(), ptr);
+        key.append(buf, ptr - buf);
+        key.append(reinterpret_cast<const char*>(sorted[i]->value.data()), sorted[i]->value.size());
+    }
+
+    return key;
+}
+
+bool
+search_manager :: cache :: lookup(const region_id& ri,
+                                  uint64_t epoch,
+                                  const std::string& key,
+                                  e::intrusive_ptr<result>* r)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    std::map<region_id, entry_list_t>::iterator reg = m_regions.find(ri);
+
+    if (reg == m_regions.end())
+    {
+        return false;
+    }
+
+    for (entry_list_t::iterator it = reg->second.begin();
+            it != reg->second.end(); ++it)
+    {
+        if (it->key != key)
+        {
+            continue;
+        }
+
+        if (it->epoch != epoch)
+        {
+            reg->second.erase(it);
+            return false;
+        }
+
+        *r = it->res;
+        reg->second.splice(reg->second.begin(), reg->second, it);
+        return true;
+    }
+
+    return false;
+}
+
+void
+search_manager :: cache :: insert(const region_id& ri,
+                                  uint64_t epoch,
+                                  const std::string& key,
+                                  e::intrusive_ptr<result> r)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+
+    if (m_capacity == 0)
+    {
+        return;
+    }
+
+    entry_list_t& entries(m_regions[ri]);
+
+    for (entry_list_t::iterator it = entries.begin(); it != entries.end(); )
+    {
+        // drop older copies of this key and anything from an older epoch
+        if (it->key == key || it->epoch < epoch)
+        {
+            it = entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    entries.push_front(entry(epoch, key, r));
+
+    while (entries.size() > m_capacity)
+    {
+        entries.pop_back();
+    }
+}
+
+void
+search_manager :: cache :: clear()
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    m_regions.clear();
+}
+
+search_manager :: cache :: result :: result()
+    : count(0)
+    , m_ref(0)
+    , m_backing()
+    , m_keys()
+    , m_values()
+    , m_bytes(0)
+{
+}
+
+search_manager :: cache :: result :: ~result() throw ()
+{
+}
+
+void
+search_manager :: cache :: result :: append(const e::slice& key,
+                                            const std::vector<e::slice>& value)
+{
+    std::string backing(reinterpret_cast<const char*>(key.data()), key.size());
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        backing.append(reinterpret_cast<const char*>(value[i].data()), value[i].size());
+    }
+
+    m_backing.push_back(backing);
+    const char* ptr = m_backing.back().data();
+    m_keys.push_back(e::slice(ptr, key.size()));
+    ptr += key.size();
+    m_values.push_back(std::vector<e::slice>());
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        m_values.back().push_back(e::slice(ptr, value[i].size()));
+        ptr += value[i].size();
+    }
+
+    m_bytes += backing.size();
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_search_manager_cache_h_
+#define hyperdex_daemon_search_manager_cache_h_
+
+// STL
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/intrusive_ptr.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "common/attribute_check.h"
+#include "common/ids.h"
+#include "daemon/search_manager.h"
+
+// Caches the results of searches and counts per region.  Each result is tagged
+// with the region's write epoch as read before taking the snapshot it was
+// computed from, and is discarded once the epoch moves on.
+class hyperdex::search_manager::cache
+{
+    public:
+        class result;
+
+    public:
+        cache();
+        ~cache() throw ();
+
+    public:
+        // the number of results kept per region; zero disables the cache
+        void set_capacity(size_t capacity);
+        bool enabled() const { return m_capacity > 0; }
+        // normalize "checks" (with a prefix distinguishing the kind of query)
+        // into a key that identical queries share regardless of check order
+        static std::string make_key(const std::string& prefix,
+                                    const std::vector<attribute_check>& checks);
+        bool lookup(const region_id& ri,
+                    uint64_t epoch,
+                    const std::string& key,
+                    e::intrusive_ptr<result>* r);
+        void insert(const region_id& ri,
+                    uint64_t epoch,
+                    const std::string& key,
+                    e::intrusive_ptr<result> r);
+        void clear();
+
+    private:
+        class entry;
+        typedef std::list<entry> entry_list_t;
+
+    private:
+        cache(const cache&);
+        cache& operator = (const cache&);
+
+    private:
+        po6::threads::mutex m_lock;
+        size_t m_capacity;
+        // most recently used first
+        std::map<region_id, entry_list_t> m_regions;
+};
+
+// An immutable (once inserted) result shared by all queries that hit it.
+class hyperdex::search_manager::cache::result
+{
+    public:
+        result();
+        ~result() throw ();
+
+    public:
+        void append(const e::slice& key, const std::vector<e::slice>& value);
+        size_t size() const { return m_keys.size(); }
+        size_t bytes() const { return m_bytes; }
+        const e::slice& key(size_t idx) const { return m_keys[idx]; }
+        const std::vector<e::slice>& value(size_t idx) const { return m_values[idx]; }
+
+    public:
+        uint64_t count;
+
+    private:
+        friend class e::intrusive_ptr<result>;
+
+    private:
+        result(const result&);
+        result& operator = (const result&);
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+        std::list<std::string> m_backing;
+        std::vector<e::slice> m_keys;
+        std::vector<std::vector<e::slice> > m_values;
+        size_t m_bytes;
+};
+
+#endif // hyperdex_daemon_search_manager_cache_h_
@@ -0,0 +1,804 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+// STL
+#include <tr1/functional>
+
+// Google Log
+#include <glog/logging.h>
+
+// e
+#include <e/time.h>
+
+// HyperDex
+#include "common/serialization.h"
+#include "daemon/daemon.h"
+#include "daemon/subscription_manager.h"
+#include "datatypes/apply.h"
+#include "datatypes/microerror.h"
+
+using hyperdex::subscription_manager;
+
+// Bounds on each region's log; the oldest changes fall off first
+#define SUBSCRIPTION_LOG_CHANGES 4096
+#define SUBSCRIPTION_LOG_BYTES 16777216
+// Bound on the number of remembered stops
+#define SUBSCRIPTION_MAX_STOPPED 1024
+// A parked poll is answered with the client's position after this many
+// nanoseconds; a live client simply polls again
+#define SUBSCRIPTION_WAIT_TIMEOUT (30 * 1000000000ULL)
+// A log without waiters that has not been polled for this many nanoseconds is
+// dropped; subscribers that come back see a gap
+#define SUBSCRIPTION_LOG_IDLE (600 * 1000000000ULL)
+// How often the expirer looks for both
+#define SUBSCRIPTION_EXPIRE_INTERVAL 1000000000ULL
+
+//////////////////////////// Subscription Manager Change ///////////////////////////
+
+class subscription_manager::change
+{
+    public:
+        change(const e::slice& key,
+               bool has_old_value,
+               const std::vector<e::slice>& old_value,
+               bool has_new_value,
+               const std::vector<e::slice>& new_value,
+               uint64_t version);
+        ~change() throw ();
+
+    public:
+        size_t bytes() const { return backing.size(); }
+
+    public:
+        std::vector<char> backing;
+        e::slice key;
+        bool has_old_value;
+        std::vector<e::slice> old_value;
+        bool has_new_value;
+        std::vector<e::slice> new_value;
+        uint64_t version;
+
+    private:
+        friend class e::intrusive_ptr<change>;
+
+    private:
+        change(const change&);
+        change& operator = (const change&);
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+static size_t
+value_size(const std::vector<e::slice>& value)
+{
+    size_t sz = 0;
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        sz += value[i].size();
+    }
+
+    return sz;
+}
+
+static char*
+copy_value(const std::vector<e::slice>& in, char* ptr, std::vector<e::slice>* out)
+{
+    out->reserve(in.size());
+
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        memmove(ptr, in[i].data(), in[i].size());
+        out->push_back(e::slice(ptr, in[i].size()));
+        ptr += in[i].size();
+    }
+
+    return ptr;
+}
+
+subscription_manager :: change :: change(const e::slice& k,
+                                         bool hov,
+                                         const std::vector<e::slice>& ov,
+                                         bool hnv,
+                                         const std::vector<e::slice>& nv,
+                                         uint64_t ver)
+    : backing(k.size() + (hov ? value_size(ov) : 0) + (hnv ? value_size(nv) : 0) + 1)
+    , key()
+    , has_old_value(hov)
+    , old_value()
+    , has_new_value(hnv)
+    , new_value()
+    , version(ver)
+    , m_ref(0)
+{
+    char* ptr = &backing.front();
+    memmove(ptr, k.data(), k.size());
+    key = e::slice(ptr, k.size());
+    ptr += k.size();
+
+    if (has_old_value)
+    {
+        ptr = copy_value(ov, ptr, &old_value);
+    }
+
+    if (has_new_value)
+    {
+        ptr = copy_value(nv, ptr, &new_value);
+    }
+}
+
+subscription_manager :: change :: ~change() throw ()
+{
+}
+
+//////////////////////////// Subscription Manager Waiter ///////////////////////////
+
+class subscription_manager::waiter
+{
+    public:
+        waiter(const server_id& client,
+               const virtual_server_id& us,
+               std::auto_ptr<e::buffer> msg,
+               uint64_t nonce,
+               uint64_t sub_id,
+               std::vector<attribute_check>* checks);
+        ~waiter() throw ();
+
+    public:
+        const server_id client;
+        const virtual_server_id us;
+        const std::auto_ptr<e::buffer> backing;
+        const uint64_t nonce;
+        const uint64_t sub_id;
+        std::vector<attribute_check> checks;
+        const uint64_t deadline;
+
+    private:
+        friend class e::intrusive_ptr<waiter>;
+
+    private:
+        waiter(const waiter&);
+        waiter& operator = (const waiter&);
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+subscription_manager :: waiter :: waiter(const server_id& c,
+                                         const virtual_server_id& u,
+                                         std::auto_ptr<e::buffer> msg,
+                                         uint64_t n,
+                                         uint64_t s,
+                                         std::vector<attribute_check>* chks)
+    : client(c)
+    , us(u)
+    , backing(msg)
+    , nonce(n)
+    , sub_id(s)
+    , checks()
+    , deadline(e::time() + SUBSCRIPTION_WAIT_TIMEOUT)
+    , m_ref(0)
+{
+    checks.swap(*chks);
+}
+
+subscription_manager :: waiter :: ~waiter() throw ()
+{
+}
+
+///////////////////////////// Subscription Manager Log /////////////////////////////
+
+class subscription_manager::region_log
+{
+    public:
+        region_log(uint64_t incarnation);
+        ~region_log() throw ();
+
+    public:
+        // the sequence number of the newest change; zero if there is none
+        uint64_t last() const { return first_seq + changes.size() - 1; }
+        // append c and return its sequence number
+        uint64_t append(e::intrusive_ptr<change> c);
+
+    public:
+        const uint64_t incarnation;
+        // everything below is protected by lock
+        po6::threads::mutex lock;
+        // changes[i] has sequence number first_seq + i
+        std::deque<e::intrusive_ptr<change> > changes;
+        uint64_t first_seq;
+        size_t bytes;
+        std::list<e::intrusive_ptr<waiter> > waiters;
+        uint64_t last_polled;
+        // removed from the map; look it up again
+        bool dead;
+
+    private:
+        friend class e::intrusive_ptr<region_log>;
+
+    private:
+        region_log(const region_log&);
+        region_log& operator = (const region_log&);
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+subscription_manager :: region_log :: region_log(uint64_t i)
+    : incarnation(i)
+    , lock()
+    , changes()
+    , first_seq(1)
+    , bytes(0)
+    , waiters()
+    , last_polled(e::time())
+    , dead(false)
+    , m_ref(0)
+{
+}
+
+subscription_manager :: region_log :: ~region_log() throw ()
+{
+}
+
+uint64_t
+subscription_manager :: region_log :: append(e::intrusive_ptr<change> c)
+{
+    changes.push_back(c);
+    bytes += c->bytes();
+
+    while (changes.size() > 1 &&
+           (changes.size() > SUBSCRIPTION_LOG_CHANGES ||
+            bytes > SUBSCRIPTION_LOG_BYTES))
+    {
+        bytes -= changes.front()->bytes();
+        changes.pop_front();
+        ++first_seq;
+    }
+
+    return last();
+}
+
+///////////////////////////////// Subscription Manager /////////////////////////////////
+
+subscription_manager :: subscription_manager(daemon* d)
+    : m_daemon(d)
+    , m_logs(16)
+    , m_protect()
+    , m_stopped()
+    , m_stopped_order()
+    , m_incarnation(e::time())
+    , m_shutdown(true)
+    , m_expirer(std::tr1::bind(&subscription_manager::expirer, this))
+{
+}
+
+subscription_manager :: ~subscription_manager() throw ()
+{
+}
+
+bool
+subscription_manager :: setup()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_shutdown = false;
+    m_expirer.start();
+    return true;
+}
+
+void
+subscription_manager :: teardown()
+{
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        m_shutdown = true;
+    }
+
+    m_expirer.join();
+}
+
+void
+subscription_manager :: reconfigure(const configuration&,
+                                    const configuration& new_config,
+                                    const server_id& us)
+{
+    std::vector<e::intrusive_ptr<waiter> > orphaned;
+    std::vector<region_id> dropped;
+
+    for (log_map_t::iterator it = m_logs.begin(); it != m_logs.end(); it.next())
+    {
+        virtual_server_id tail = new_config.tail_of_region(it.key());
+
+        if (new_config.get_server_id(tail) == us)
+        {
+            continue;
+        }
+
+        // We are no longer the tail; whoever is starts a new incarnation.
+        e::intrusive_ptr<region_log> l = it.value();
+        po6::threads::mutex::hold hold(&l->lock);
+        orphaned.insert(orphaned.end(), l->waiters.begin(), l->waiters.end());
+        l->waiters.clear();
+        l->dead = true;
+        dropped.push_back(it.key());
+    }
+
+    for (size_t i = 0; i < dropped.size(); ++i)
+    {
+        m_logs.remove(dropped[i]);
+    }
+
+    for (size_t i = 0; i < orphaned.size(); ++i)
+    {
+        send_type(orphaned[i]->client, orphaned[i]->us, orphaned[i]->nonce, CONFIGMISMATCH);
+    }
+}
+
+void
+subscription_manager :: committed(const region_id& ri,
+                                  const e::slice& key,
+                                  bool has_old_value,
+                                  const std::vector<e::slice>& old_value,
+                                  bool has_new_value,
+                                  const std::vector<e::slice>& new_value,
+                                  uint64_t version)
+{
+    e::intrusive_ptr<region_log> l = get_log(ri, false);
+
+    if (!l)
+    {
+        return;
+    }
+
+    std::vector<std::pair<e::intrusive_ptr<waiter>, subscription_event> > ready;
+    e::intrusive_ptr<change> c;
+    uint64_t incarnation;
+    uint64_t seq;
+
+    {
+        po6::threads::mutex::hold hold(&l->lock);
+
+        if (l->dead)
+        {
+            return;
+        }
+
+        c = new change(key, has_old_value, old_value, has_new_value, new_value, version);
+        incarnation = l->incarnation;
+        seq = l->append(c);
+        std::list<e::intrusive_ptr<waiter> >::iterator w = l->waiters.begin();
+
+        while (w != l->waiters.end())
+        {
+            subscription_event ev;
+
+            if (classify(ri, (*w)->checks, *c, &ev))
+            {
+                ready.push_back(std::make_pair(*w, ev));
+                w = l->waiters.erase(w);
+            }
+            else
+            {
+                ++w;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i)
+    {
+        const waiter& w(*ready[i].first);
+        send_item(w.client, w.us, w.nonce, incarnation, seq, ready[i].second, c.get());
+    }
+}
+
+void
+subscription_manager :: poll(const server_id& from,
+                             const virtual_server_id& to,
+                             std::auto_ptr<e::buffer> msg,
+                             uint64_t nonce,
+                             uint64_t sub_id,
+                             std::vector<attribute_check>* checks,
+                             uint64_t incarnation,
+                             uint64_t after)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+
+    // Only the tail of a key-subspace region sees every write to the region's
+    // keys exactly once, and only after it is committed everywhere.
+    if (m_daemon->m_config.tail_of_region(ri) != to ||
+        m_daemon->m_config.subspace_prev(m_daemon->m_config.subspace_of(ri)) != subspace_id())
+    {
+        send_type(from, to, nonce, CONFIGMISMATCH);
+        return;
+    }
+
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+
+    for (size_t i = 0; i < checks->size(); ++i)
+    {
+        if ((*checks)[i].attr >= sc->attrs_sz)
+        {
+            send_type(from, to, nonce, RESP_SUBSCRIBE_DONE);
+            return;
+        }
+    }
+
+    e::intrusive_ptr<change> c;
+    subscription_event ev = SUBSCRIPTION_POSITION;
+    uint64_t seq = 0;
+    uint64_t log_incarnation = 0;
+    bool stopped = false;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        // the stop for this poll may have overtaken it
+        stopped = m_stopped.erase(stop_t(from, std::make_pair(ri, sub_id))) > 0;
+
+        while (!stopped)
+        {
+            e::intrusive_ptr<region_log> l = get_log(ri, true);
+            po6::threads::mutex::hold hold_log(&l->lock);
+
+            if (l->dead)
+            {
+                continue;
+            }
+
+            l->last_polled = e::time();
+            log_incarnation = l->incarnation;
+            seq = l->last();
+
+            if (incarnation != 0)
+            {
+                if (incarnation != l->incarnation || after + 1 < l->first_seq || after > l->last())
+                {
+                    ev = SUBSCRIPTION_GAP;
+                }
+                else
+                {
+                    for (seq = after + 1; seq <= l->last(); ++seq)
+                    {
+                        e::intrusive_ptr<change> cand = l->changes[seq - l->first_seq];
+
+                        if (classify(ri, *checks, *cand, &ev))
+                        {
+                            c = cand;
+                            break;
+                        }
+                    }
+
+                    // Nothing in the log is of interest; wait for the next write.
+                    if (!c)
+                    {
+                        e::intrusive_ptr<waiter> w = new waiter(from, to, msg, nonce, sub_id, checks);
+                        l->waiters.push_back(w);
+                        return;
+                    }
+                }
+            }
+
+            break;
+        }
+    }
+
+    if (stopped)
+    {
+        send_type(from, to, nonce, RESP_SUBSCRIBE_DONE);
+    }
+    else
+    {
+        send_item(from, to, nonce, log_incarnation, seq, ev, c.get());
+    }
+}
+
+void
+subscription_manager :: stop(const server_id& from,
+                             const virtual_server_id& to,
+                             uint64_t sub_id)
+{
+    region_id ri(m_daemon->m_config.get_region_id(to));
+    e::intrusive_ptr<waiter> w;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        e::intrusive_ptr<region_log> l = get_log(ri, false);
+
+        if (l)
+        {
+            po6::threads::mutex::hold hold_log(&l->lock);
+            std::list<e::intrusive_ptr<waiter> >::iterator wit;
+
+            for (wit = l->waiters.begin(); wit != l->waiters.end(); ++wit)
+            {
+                if ((*wit)->client == from && (*wit)->sub_id == sub_id)
+                {
+                    w = *wit;
+                    l->waiters.erase(wit);
+                    break;
+                }
+            }
+        }
+
+        // The poll we are meant to cancel has not arrived yet (or its answer
+        // is already on the way); remember to cancel it.
+        if (!w)
+        {
+            stop_t st(from, std::make_pair(ri, sub_id));
+
+            if (m_stopped.insert(st).second)
+            {
+                m_stopped_order.push_back(st);
+            }
+
+            while (m_stopped_order.size() > SUBSCRIPTION_MAX_STOPPED)
+            {
+                m_stopped.erase(m_stopped_order.front());
+                m_stopped_order.pop_front();
+            }
+
+            return;
+        }
+    }
+
+    send_type(w->client, w->us, w->nonce, RESP_SUBSCRIBE_DONE);
+}
+
+e::intrusive_ptr<subscription_manager::region_log>
+subscription_manager :: get_log(const region_id& ri, bool create)
+{
+    e::intrusive_ptr<region_log> l;
+
+    while (!m_logs.lookup(ri, &l))
+    {
+        if (!create)
+        {
+            return l;
+        }
+
+        e::intrusive_ptr<region_log> nl = new region_log(__sync_add_and_fetch(&m_incarnation, 1));
+
+        if (m_logs.insert(ri, nl))
+        {
+            return nl;
+        }
+    }
+
+    return l;
+}
+
+void
+subscription_manager :: expirer()
+{
+    LOG(INFO) << "subscription expirer thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        {
+            po6::threads::mutex::hold hold(&m_protect);
+
+            if (m_shutdown)
+            {
+                break;
+            }
+        }
+
+        timespec ts;
+        ts.tv_sec = SUBSCRIPTION_EXPIRE_INTERVAL / 1000000000ULL;
+        ts.tv_nsec = SUBSCRIPTION_EXPIRE_INTERVAL % 1000000000ULL;
+        nanosleep(&ts, NULL);
+        expire(e::time());
+    }
+
+    LOG(INFO) << "subscription expirer thread shutting down";
+}
+
+void
+subscription_manager :: expire(uint64_t now)
+{
+    std::vector<e::intrusive_ptr<waiter> > expired;
+    std::vector<std::pair<uint64_t, uint64_t> > positions;
+    std::vector<region_id> idle;
+
+    for (log_map_t::iterator it = m_logs.begin(); it != m_logs.end(); it.next())
+    {
+        e::intrusive_ptr<region_log> l = it.value();
+        po6::threads::mutex::hold hold(&l->lock);
+        std::list<e::intrusive_ptr<waiter> >::iterator w = l->waiters.begin();
+
+        // every change up to l->last() was checked against each waiter, so
+        // that is where each of them resumes
+        while (w != l->waiters.end())
+        {
+            if ((*w)->deadline <= now)
+            {
+                expired.push_back(*w);
+                positions.push_back(std::make_pair(l->incarnation, l->last()));
+                w = l->waiters.erase(w);
+            }
+            else
+            {
+                ++w;
+            }
+        }
+
+        if (l->waiters.empty() && l->last_polled + SUBSCRIPTION_LOG_IDLE <= now)
+        {
+            l->dead = true;
+            idle.push_back(it.key());
+        }
+    }
+
+    for (size_t i = 0; i < idle.size(); ++i)
+    {
+        m_logs.remove(idle[i]);
+    }
+
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+        const waiter& w(*expired[i]);
+        send_item(w.client, w.us, w.nonce, positions[i].first, positions[i].second, SUBSCRIPTION_POSITION, NULL);
+    }
+}
+
+bool
+subscription_manager :: passes(const schema& sc,
+                               const std::vector<attribute_check>& checks,
+                               const e::slice& key,
+                               const std::vector<e::slice>& value)
+{
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        microerror e;
+
+        if (checks[i].attr >= sc.attrs_sz)
+        {
+            return false;
+        }
+        else if (checks[i].attr == 0)
+        {
+            if (!passes_attribute_check(sc.attrs[0].type, checks[i], key, &e))
+            {
+                return false;
+            }
+        }
+        else if (checks[i].attr - 1U >= value.size() ||
+                 !passes_attribute_check(sc.attrs[checks[i].attr].type, checks[i], value[checks[i].attr - 1], &e))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+subscription_manager :: classify(const region_id& ri,
+                                 const std::vector<attribute_check>& checks,
+                                 const change& c,
+                                 subscription_event* ev)
+{
+    const schema* sc = m_daemon->m_config.get_schema(ri);
+
+    if (c.has_new_value && passes(*sc, checks, c.key, c.new_value))
+    {
+        *ev = SUBSCRIPTION_MATCH;
+        return true;
+    }
+
+    if (c.has_old_value && passes(*sc, checks, c.key, c.old_value))
+    {
+        *ev = SUBSCRIPTION_LEAVE;
+        return true;
+    }
+
+    return false;
+}
+
+void
+subscription_manager :: send_item(const server_id& client,
+                                  const virtual_server_id& us,
+                                  uint64_t nonce,
+                                  uint64_t incarnation,
+                                  uint64_t seq,
+                                  subscription_event ev,
+                                  const change* c)
+{
+    const uint8_t type = static_cast<uint8_t>(ev);
+    e::slice key;
+    std::vector<e::slice> value;
+    uint64_t version = 0;
+
+    if (c && ev == SUBSCRIPTION_MATCH)
+    {
+        key = c->key;
+        value = c->new_value;
+        version = c->version;
+    }
+    else if (c && ev == SUBSCRIPTION_LEAVE)
+    {
+        key = c->key;
+        value = c->old_value;
+        version = c->version;
+    }
+
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + sizeof(uint64_t)
+              + pack_size(key)
+              + pack_size(value);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << incarnation << seq
+                                          << type << version << key << value;
+    m_daemon->m_comm.send_client(us, client, RESP_SUBSCRIBE_ITEM, msg);
+}
+
+void
+subscription_manager :: send_type(const server_id& client,
+                                  const virtual_server_id& us,
+                                  uint64_t nonce,
+                                  network_msgtype type)
+{
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+    m_daemon->m_comm.send_client(us, client, type, msg);
+}
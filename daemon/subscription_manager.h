@@ -0,0 +1,164 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_subscription_manager_h_
+#define hyperdex_daemon_subscription_manager_h_
+
+// STL
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
+// e
+#include <e/buffer.h>
+#include <e/intrusive_ptr.h>
+#include <e/lockfree_hash_map.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "common/attribute_check.h"
+#include "common/configuration.h"
+#include "common/ids.h"
+#include "common/network_msgtype.h"
+#include "common/schema.h"
+#include "common/subscription.h"
+
+namespace hyperdex
+{
+// Forward declarations
+class daemon;
+
+// Continuous queries.  The tail of each key-subspace region keeps a bounded log
+// of the writes it commits.  Subscribers poll the log with the position of the
+// last change they have seen; a poll that finds nothing new is parked until a
+// matching write commits.  A position is the log's incarnation (which changes
+// whenever the log is recreated, e.g., because the tail moved) and a sequence
+// number within it, so a client that reconnects with its last position
+// resumes exactly where it left off for as long as the log reaches back that
+// far.  A parked poll is answered with the client's position after a while so
+// that it does not outlive its client, and a log nobody polls is dropped.
+class subscription_manager
+{
+    public:
+        subscription_manager(daemon*);
+        ~subscription_manager() throw ();
+
+    public:
+        bool setup();
+        void teardown();
+        void reconfigure(const configuration& old_config,
+                         const configuration& new_config,
+                         const server_id& us);
+
+    public:
+        // called by the tail of a key-subspace region after the write of
+        // "version" commits; the old value is the one it replaced on disk
+        void committed(const region_id& ri,
+                       const e::slice& key,
+                       bool has_old_value,
+                       const std::vector<e::slice>& old_value,
+                       bool has_new_value,
+                       const std::vector<e::slice>& new_value,
+                       uint64_t version);
+        // return the first change after (incarnation, after) which passes the
+        // checks, or wait for one.  incarnation zero subscribes from now.
+        void poll(const server_id& from,
+                  const virtual_server_id& to,
+                  std::auto_ptr<e::buffer> msg,
+                  uint64_t nonce,
+                  uint64_t sub_id,
+                  std::vector<attribute_check>* checks,
+                  uint64_t incarnation,
+                  uint64_t after);
+        void stop(const server_id& from,
+                  const virtual_server_id& to,
+                  uint64_t sub_id);
+
+    private:
+        class change;
+        class region_log;
+        class waiter;
+        static uint64_t hash(const region_id& ri) { return ri.get(); }
+        typedef e::lockfree_hash_map<region_id, e::intrusive_ptr<region_log>, hash> log_map_t;
+        typedef std::pair<server_id, std::pair<region_id, uint64_t> > stop_t;
+
+    private:
+        subscription_manager(const subscription_manager&);
+        subscription_manager& operator = (const subscription_manager&);
+
+    private:
+        // the log for ri, created if "create" is true and there is none
+        e::intrusive_ptr<region_log> get_log(const region_id& ri, bool create);
+        // answer parked polls that have waited too long and drop idle logs
+        void expirer();
+        void expire(uint64_t now);
+        bool passes(const schema& sc,
+                    const std::vector<attribute_check>& checks,
+                    const e::slice& key,
+                    const std::vector<e::slice>& value);
+        // false if the change is of no interest to a subscriber with checks
+        bool classify(const region_id& ri,
+                      const std::vector<attribute_check>& checks,
+                      const change& c,
+                      subscription_event* ev);
+        void send_item(const server_id& client,
+                       const virtual_server_id& us,
+                       uint64_t nonce,
+                       uint64_t incarnation,
+                       uint64_t seq,
+                       subscription_event ev,
+                       const change* c);
+        void send_type(const server_id& client,
+                       const virtual_server_id& us,
+                       uint64_t nonce,
+                       network_msgtype type);
+
+    private:
+        daemon* m_daemon;
+        // each log has its own lock, so commits to different regions do not
+        // contend; m_protect orders polls against stops and is taken before
+        // any log's lock
+        log_map_t m_logs;
+        po6::threads::mutex m_protect;
+        // stops which arrived before the poll they were meant to cancel
+        std::set<stop_t> m_stopped;
+        std::deque<stop_t> m_stopped_order;
+        uint64_t m_incarnation;
+        bool m_shutdown;
+        po6::threads::thread m_expirer;
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_subscription_manager_h_
@@ -29,8 +29,19 @@
 
 // C
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <stdint.h>
 
+// STL
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// e
+#include <e/endian.h>
+
 // Google Test
 #include <gtest/gtest.h>
 
@@ -42,6 +53,7 @@
 using hyperdex::index_encode_int64;
 using hyperdex::index_encode_double;
 using hyperdex::index_encode_bump;
+using hyperdex::index_encode_attr;
 
 namespace
 {
@@ -90,15 +102,15 @@ TEST(IndexEncode, Double)
         double d = drand48() * mrand48() * mrand48();
         index_encode_double(d, buf);
 
-        if (isinf(d) && d < 0)
+        if (std::isinf(d) && d < 0)
         {
             ASSERT_TRUE(memcmp(buf, ninf_buf, 8) == 0);
         }
-        else if (isinf(d) && d > 0)
+        else if (std::isinf(d) && d > 0)
         {
             ASSERT_TRUE(memcmp(buf, pinf_buf, 8) == 0);
         }
-        else if (isnan(d))
+        else if (std::isnan(d))
         {
             ASSERT_TRUE(memcmp(buf, nan_buf, 8) == 0);
         }
@@ -152,11 +164,107 @@ TEST(IndexEncode, Double)
 
 TEST(IndexEncode, Bump)
 {
-    char buf[2] = {0xfd, 0xff};
+    char buf[2] = {'\xfd', '\xff'};
     index_encode_bump(buf, buf + 1);
     ASSERT_TRUE(memcmp("\xfe\xff", buf, 2) == 0);
     index_encode_bump(buf, buf + 2);
     ASSERT_TRUE(memcmp("\xff\x00", buf, 2) == 0);
 }
 
+// compare as LevelDB does, byte by byte and unsigned
+static bool
+encoded_lt(const std::vector<char>& lhs, const std::vector<char>& rhs)
+{
+    int cmp = memcmp(&lhs.front(), &rhs.front(), std::min(lhs.size(), rhs.size()));
+    return cmp < 0 || (cmp == 0 && lhs.size() < rhs.size());
+}
+
+static std::vector<char>
+encode_tuple(int64_t i, const std::string& s, double d)
+{
+    char buf_i[sizeof(int64_t)];
+    char buf_d[sizeof(double)];
+    e::pack64le(i, buf_i);
+    e::packdoublele(d, buf_d);
+    std::vector<char> out;
+    index_encode_attr(HYPERDATATYPE_INT64, e::slice(buf_i, sizeof(buf_i)), true, &out);
+    index_encode_attr(HYPERDATATYPE_STRING, e::slice(s.data(), s.size()), true, &out);
+    index_encode_attr(HYPERDATATYPE_FLOAT, e::slice(buf_d, sizeof(buf_d)), true, &out);
+    return out;
+}
+
+static std::vector<char>
+encode_string(const std::string& s, bool terminate)
+{
+    std::vector<char> out;
+    index_encode_attr(HYPERDATATYPE_STRING, e::slice(s.data(), s.size()), terminate, &out);
+    return out;
+}
+
+TEST(IndexEncode, AttrString)
+{
+    std::vector<char> empty(encode_string("", true));
+    ASSERT_EQ(2U, empty.size());
+    ASSERT_TRUE(memcmp("\0\x01", &empty.front(), 2) == 0);
+    std::vector<char> nul(encode_string(std::string("a\0b", 3), true));
+    ASSERT_EQ(6U, nul.size());
+    ASSERT_TRUE(memcmp("a\0\xff" "b\0\x01", &nul.front(), 6) == 0);
+
+    // the escapes keep strings ordered, even around embedded NUL bytes
+    const char* strs[] = {"", "\0", "\0\0", "\0\x01", "a", "a\0", "a\0a", "aa", "ab", "b"};
+    const size_t lens[] = {0, 1, 2, 2, 1, 2, 3, 2, 2, 1};
+    const size_t strs_sz = sizeof(lens) / sizeof(size_t);
+
+    for (size_t i = 0; i + 1 < strs_sz; ++i)
+    {
+        std::string a(strs[i], lens[i]);
+        std::string b(strs[i + 1], lens[i + 1]);
+        ASSERT_LT(a, b);
+        ASSERT_TRUE(encoded_lt(encode_string(a, true), encode_string(b, true)));
+    }
+
+    // an unterminated string is a prefix of every string that extends it
+    std::vector<char> pre(encode_string("ab", false));
+    std::vector<char> ext(encode_string("abc", true));
+    ASSERT_TRUE(std::equal(pre.begin(), pre.end(), ext.begin()));
+    ext = encode_string("a", true);
+    ASSERT_FALSE(ext.size() >= pre.size() &&
+                 std::equal(pre.begin(), pre.end(), ext.begin()));
+}
+
+TEST(IndexEncode, AttrTuple)
+{
+    std::vector<char> buf(encode_tuple(1, "x", 0.5));
+    ASSERT_EQ(19U, buf.size());
+    char expected[8];
+    index_encode_int64(1, expected);
+    ASSERT_TRUE(memcmp(expected, &buf[0], 8) == 0);
+    ASSERT_TRUE(memcmp("x\0\x01", &buf[8], 3) == 0);
+    index_encode_double(0.5, expected);
+    ASSERT_TRUE(memcmp(expected, &buf[11], 8) == 0);
+
+    // tuples compare lexicographically, attribute by attribute
+    const int64_t ints[] = {INT64_MIN, -1, 0, 1, INT64_MAX};
+    const char* strs[] = {"", "\0", "a", "a\0", "ab", "b"};
+    const size_t lens[] = {0, 1, 1, 2, 2, 1};
+    const double dbls[] = {-INFINITY, -1.5, 0, 1e-300, 2.5, INFINITY};
+    std::vector<std::vector<char> > tuples;
+
+    for (size_t i = 0; i < sizeof(ints) / sizeof(int64_t); ++i)
+    {
+        for (size_t s = 0; s < sizeof(lens) / sizeof(size_t); ++s)
+        {
+            for (size_t d = 0; d < sizeof(dbls) / sizeof(double); ++d)
+            {
+                tuples.push_back(encode_tuple(ints[i], std::string(strs[s], lens[s]), dbls[d]));
+            }
+        }
+    }
+
+    for (size_t i = 0; i + 1 < tuples.size(); ++i)
+    {
+        ASSERT_TRUE(encoded_lt(tuples[i], tuples[i + 1]));
+    }
+}
+
 } // namespace
@@ -25,6 +25,14 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <regex.h>
+#include <string.h>
+
+// STL
+#include <memory>
+#include <string>
+
 // e
 #include <e/endian.h>
 
@@ -33,16 +41,128 @@
 #include "datatypes/apply.h"
 #include "datatypes/compare.h"
 #include "datatypes/sizeof.h"
+#include "datatypes/step.h"
 #include "datatypes/validate.h"
 
 using hyperdex::attribute_check;
 using hyperdex::funcall;
 
+static bool
+compile_regex(const e::slice& regex, regex_t* re)
+{
+    // regcomp wants a NUL-terminated pattern, so one cannot contain a NUL
+    if (regex.size() > 0 && memchr(regex.data(), '\0', regex.size()))
+    {
+        return false;
+    }
+
+    std::string r(reinterpret_cast<const char*>(regex.data()), regex.size());
+    return regcomp(re, r.c_str(), REG_EXTENDED | REG_NOSUB) == 0;
+}
+
+static void
+free_regex(regex_t* re)
+{
+    regfree(re);
+    delete re;
+}
+
+static bool
+matches_regex(const regex_t* re, const e::slice& value)
+{
+#ifdef REG_STARTEND
+    // match the value in place, embedded NULs and all
+    regmatch_t range;
+    range.rm_so = 0;
+    range.rm_eo = value.size();
+    const char* v = value.size() ? reinterpret_cast<const char*>(value.data()) : "";
+    return regexec(re, v, 1, &range, REG_STARTEND) == 0;
+#else
+    std::string v(reinterpret_cast<const char*>(value.data()), value.size());
+    return regexec(re, v.c_str(), 0, NULL, 0) == 0;
+#endif
+}
+
+static bool
+passes_regex(const e::slice& regex, const regex_t* re, const e::slice& value)
+{
+    if (re)
+    {
+        return matches_regex(re, value);
+    }
+
+    regex_t tmp;
+
+    if (!compile_regex(regex, &tmp))
+    {
+        return false;
+    }
+
+    bool matches = matches_regex(&tmp, value);
+    regfree(&tmp);
+    return matches;
+}
+
+static bool
+passes_in(hyperdatatype type, const e::slice& list, const e::slice& value)
+{
+    const uint8_t* ptr = list.data();
+    const uint8_t* end = ptr + list.size();
+    e::slice elem;
+
+    while (ptr < end && step_as_type(type, &ptr, end, &elem))
+    {
+        if (elem == value)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+compile_regexes(const std::vector<attribute_check>& checks,
+                std::vector<std::tr1::shared_ptr<regex_t> >* regexes)
+{
+    regexes->clear();
+    regexes->resize(checks.size());
+
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        if (checks[i].predicate != HYPERPREDICATE_REGEX)
+        {
+            continue;
+        }
+
+        std::auto_ptr<regex_t> re(new regex_t());
+
+        if (!compile_regex(checks[i].value, re.get()))
+        {
+            return false;
+        }
+
+        (*regexes)[i].reset(re.release(), free_regex);
+    }
+
+    return true;
+}
+
 bool
 passes_attribute_check(hyperdatatype type,
                        const attribute_check& check,
                        const e::slice& value,
                        microerror* error)
+{
+    return passes_attribute_check(type, check, value, NULL, error);
+}
+
+bool
+passes_attribute_check(hyperdatatype type,
+                       const attribute_check& check,
+                       const e::slice& value,
+                       const regex_t* re,
+                       microerror* error)
 {
     bool valid = false;
     char buf_i[sizeof(int64_t)];
@@ -79,6 +199,22 @@ passes_attribute_check(hyperdatatype type,
                     CONTAINER_TYPE(type) == HYPERDATATYPE_SET_GENERIC ||
                     CONTAINER_TYPE(type) == HYPERDATATYPE_MAP_GENERIC) &&
                    valid && static_cast<int64_t>(tmp_u) < tmp_i;
+        case HYPERPREDICATE_PREFIX:
+            *error = MICROERR_CMPFAIL;
+            return check.datatype == HYPERDATATYPE_STRING &&
+                   type == HYPERDATATYPE_STRING &&
+                   check.value.size() <= value.size() &&
+                   memcmp(check.value.data(), value.data(), check.value.size()) == 0;
+        case HYPERPREDICATE_REGEX:
+            *error = MICROERR_CMPFAIL;
+            return check.datatype == HYPERDATATYPE_STRING &&
+                   type == HYPERDATATYPE_STRING &&
+                   passes_regex(check.value, re, value);
+        case HYPERPREDICATE_IN:
+            *error = MICROERR_CMPFAIL;
+            return CONTAINER_TYPE(check.datatype) == HYPERDATATYPE_LIST_GENERIC &&
+                   CONTAINER_ELEM(check.datatype) == type &&
+                   passes_in(type, check.value, value);
         default:
             return false;
     }
@@ -28,7 +28,11 @@
 #ifndef datatypes_apply_h_
 #define datatypes_apply_h_
 
+// C
+#include <regex.h>
+
 // STL
+#include <vector>
 #ifdef _MSC_VER
 #include <memory>
 #else
@@ -52,6 +56,22 @@ passes_attribute_check(hyperdatatype type,
                        const e::slice& value,
                        microerror* error);
 
+// Like the above, but a REGEX check is matched with "re" (from
+// compile_regexes) instead of compiling its pattern again.
+bool
+passes_attribute_check(hyperdatatype type,
+                       const hyperdex::attribute_check& check,
+                       const e::slice& value,
+                       const regex_t* re,
+                       microerror* error);
+
+// Compile the pattern of every REGEX check once, so that a search need not
+// compile it for every object.  Entries for other checks are NULL.  Returns
+// false if a pattern is not a valid regular expression.
+bool
+compile_regexes(const std::vector<hyperdex::attribute_check>& checks,
+                std::vector<std::tr1::shared_ptr<regex_t> >* regexes);
+
 size_t
 perform_checks_and_apply_funcs(const hyperdex::schema* sc,
                                const std::vector<hyperdex::attribute_check>& checks,
@@ -77,3 +77,22 @@ step_float(const uint8_t** ptr,
     *ptr += sizeof(double);
     return true;
 }
+
+bool
+step_as_type(hyperdatatype type,
+             const uint8_t** ptr,
+             const uint8_t* end,
+             e::slice* elem)
+{
+    switch (type)
+    {
+        case HYPERDATATYPE_STRING:
+            return step_string(ptr, end, elem);
+        case HYPERDATATYPE_INT64:
+            return step_int64(ptr, end, elem);
+        case HYPERDATATYPE_FLOAT:
+            return step_float(ptr, end, elem);
+        default:
+            return false;
+    }
+}
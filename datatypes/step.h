@@ -49,4 +49,11 @@ step_float(const uint8_t** ptr,
            const uint8_t* end,
            e::slice* elem);
 
+// step over one primitive of the given type
+bool
+step_as_type(hyperdatatype type,
+             const uint8_t** ptr,
+             const uint8_t* end,
+             e::slice* elem);
+
 #endif // datatypes_step_h_
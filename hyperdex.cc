@@ -84,9 +84,12 @@ static subcommand subcommands[] = {
     subcommand("daemon",                "Start a new HyperDex daemon"),
     subcommand("add-space",             "Create a new space"),
     subcommand("rm-space",              "Remove an existing space"),
+    subcommand("add-index",             "Build a new index on an existing space"),
+    subcommand("rm-index",              "Remove an index from an existing space"),
     subcommand("initialize-cluster",    "One time initialization of a HyperDex coordinator"),
     subcommand("initiate-transfer",     "Manually start a data transfer to repair a failure"),
     subcommand("show-config",           "Output a human-readable version of the cluster configuration"),
+    subcommand("export",                "Export every object in a space to a file"),
     subcommand(NULL, NULL)
 };
 
@@ -91,7 +91,10 @@ enum hyperpredicate
     HYPERPREDICATE_EQUALS        = 9729,
     HYPERPREDICATE_LESS_EQUAL    = 9730,
     HYPERPREDICATE_GREATER_EQUAL = 9731,
-    HYPERPREDICATE_CONTAINS_LESS_THAN = 9732
+    HYPERPREDICATE_CONTAINS_LESS_THAN = 9732,
+    HYPERPREDICATE_PREFIX        = 9733,
+    HYPERPREDICATE_REGEX         = 9734,
+    HYPERPREDICATE_IN            = 9735
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,212 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// POSIX
+#include <errno.h>
+
+// po6
+#include <po6/error.h>
+
+// e
+#include <e/endian.h>
+#include <e/guard.h>
+#include <e/time.h>
+
+// HyperDex
+#include "client/hyperclient.h"
+#include "tools/common.h"
+
+static const char* _output = NULL;
+
+static struct poptOption popts[] = {
+    POPT_AUTOHELP
+    {"output", 'o', POPT_ARG_STRING, &_output, 'o',
+     "write the export to a file (default: standard output)", "file"},
+    CONNECT_TABLE
+    POPT_TABLEEND
+};
+
+int
+main(int argc, const char* argv[])
+{
+    poptContext poptcon;
+    poptcon = poptGetContext(NULL, argc, argv, popts, POPT_CONTEXT_POSIXMEHARDER);
+    e::guard g = e::makeguard(poptFreeContext, poptcon); g.use_variable();
+    poptSetOtherOptionHelp(poptcon, "[OPTIONS] <space>");
+    int rc;
+
+    while ((rc = poptGetNextOpt(poptcon)) != -1)
+    {
+        switch (rc)
+        {
+            case 'o':
+                break;
+            case 'h':
+                if (!check_host())
+                {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                if (!check_port())
+                {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case POPT_ERROR_NOARG:
+            case POPT_ERROR_BADOPT:
+            case POPT_ERROR_BADNUMBER:
+            case POPT_ERROR_OVERFLOW:
+                std::cerr << poptStrerror(rc) << " " << poptBadOption(poptcon, 0) << std::endl;
+                return EXIT_FAILURE;
+            case POPT_ERROR_OPTSTOODEEP:
+            case POPT_ERROR_BADQUOTE:
+            case POPT_ERROR_ERRNO:
+            default:
+                std::cerr << "logic error in argument parsing" << std::endl;
+                return EXIT_FAILURE;
+        }
+    }
+
+    const char** args = poptGetArgs(poptcon);
+    size_t num_args = 0;
+
+    while (args && args[num_args])
+    {
+        ++num_args;
+    }
+
+    if (num_args != 1)
+    {
+        std::cerr << "command takes exactly one argument" << std::endl;
+        poptPrintUsage(poptcon, stderr, 0);
+        return EXIT_FAILURE;
+    }
+
+    FILE* fout = stdout;
+
+    if (_output)
+    {
+        fout = fopen(_output, "w");
+
+        if (!fout)
+        {
+            std::cerr << "could not open " << _output << ": " << strerror(errno) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    try
+    {
+        hyperclient h(_connect_host, _connect_port);
+        hyperclient_returncode status;
+        char* batch = NULL;
+        size_t batch_sz = 0;
+        int64_t id = h.export_space(args[0], &status, &batch, &batch_sz);
+
+        if (id < 0)
+        {
+            std::cerr << "could not export " << args[0] << ": " << status << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        uint64_t t_start = e::time();
+        uint64_t objects = 0;
+        uint64_t batches = 0;
+        uint64_t bytes = 0;
+
+        while (true)
+        {
+            hyperclient_returncode lstatus;
+            int64_t lid = h.loop(-1, &lstatus);
+
+            if (lid < 0)
+            {
+                std::cerr << "export failed: " << lstatus << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            assert(lid == id);
+
+            if (status == HYPERCLIENT_SEARCHDONE)
+            {
+                break;
+            }
+
+            if (status != HYPERCLIENT_SUCCESS)
+            {
+                std::cerr << "export failed: " << status << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            // batches are complete frames of the export format, so they
+            // are written verbatim, without decompressing them
+            e::guard gb = e::makeguard(free, batch); gb.use_variable();
+            uint64_t count;
+            e::unpack64be(batch + sizeof(uint64_t), &count);
+
+            if (fwrite(batch, 1, batch_sz, fout) != batch_sz)
+            {
+                std::cerr << "could not write export: " << strerror(errno) << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            objects += count;
+            ++batches;
+            bytes += batch_sz;
+        }
+
+        if (fflush(fout) != 0 || (_output && fclose(fout) != 0))
+        {
+            std::cerr << "could not write export: " << strerror(errno) << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        double secs = (e::time() - t_start) / 1e9;
+        std::cerr << "exported " << objects << " objects in " << batches
+                  << " batches (" << bytes << " bytes) in " << secs << " seconds"
+                  << std::endl;
+        return EXIT_SUCCESS;
+    }
+    catch (po6::error& e)
+    {
+        std::cerr << "system error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
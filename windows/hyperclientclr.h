@@ -49,6 +49,7 @@ HyperDex
                                  HYPERCLIENT_INTERRUPTED  = 8530,
                                  HYPERCLIENT_CLUSTER_JUMP = 8531,
                                  HYPERCLIENT_COORD_LOGGED = 8532,
+                                 HYPERCLIENT_BADSEARCH    = 8533,
 
                                  /* This should never happen.  It indicates a bug */
                                  HYPERCLIENT_INTERNAL     = 8573,